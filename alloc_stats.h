@@ -0,0 +1,84 @@
+#ifndef ALLOC_STATS_H
+#define ALLOC_STATS_H
+
+#include <cstddef>
+#include <cstdlib>
+#include <iostream>
+
+using namespace std;
+
+// Phases of a game tick that heap allocations are charged to
+enum AllocPhase { PHASE_OTHER = 0, PHASE_INPUT, PHASE_UPDATE, PHASE_DRAW, PHASE_FLUSH, PHASE_COUNT };
+
+// Opt-in heap allocation accounting.
+//
+// Build with -DSNAKE_ALLOC_STATS to replace the global operator new/delete
+// with versions that count every allocation against the current thread's
+// phase. Without the flag nothing is hooked and enabled() returns false.
+class AllocStats {
+public:
+    static constexpr bool enabled() {
+#ifdef SNAKE_ALLOC_STATS
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    // Sets the phase for the calling thread and returns the previous one
+    static AllocPhase setPhase(AllocPhase phase);
+    static AllocPhase getPhase();
+
+    // Called by the operator new/delete hooks
+    static void recordAllocation(size_t bytes);
+    static void recordFree();
+
+    // Totals since start-up
+    static unsigned long long getAllocations(AllocPhase phase);
+    static unsigned long long getBytes(AllocPhase phase);
+    static unsigned long long getFrees(AllocPhase phase);
+    static unsigned long long getTotalAllocations();
+
+    // Closes the current tick; the per-phase counts of the tick just closed
+    // are available from getLastTickAllocations()
+    static void endTick();
+    static unsigned long long getLastTickAllocations(AllocPhase phase);
+    static unsigned long long getTicks();
+
+    static const char* phaseName(AllocPhase phase);
+    static void printSummary(ostream& out);
+};
+
+// Charges allocations in a block of code to a phase
+class AllocPhaseScope {
+private:
+    AllocPhase previous;
+
+public:
+    explicit AllocPhaseScope(AllocPhase phase) : previous(AllocStats::setPhase(phase)) {}
+    ~AllocPhaseScope() { AllocStats::setPhase(previous); }
+};
+
+// Counts the allocations made (by any thread) since it was created
+class AllocBudget {
+private:
+    unsigned long long start;
+
+public:
+    AllocBudget() : start(AllocStats::getTotalAllocations()) {}
+    unsigned long long used() const { return AllocStats::getTotalAllocations() - start; }
+    bool within(unsigned long long limit) const { return used() <= limit; }
+};
+
+// Aborts with a message if a budget has gone over its limit (only checked in
+// SNAKE_ALLOC_STATS builds, where the counts exist)
+#define SNAKE_ASSERT_ALLOC_BUDGET(budget, limit)                                              \
+    do {                                                                                      \
+        if (AllocStats::enabled() && !(budget).within(limit)) {                               \
+            cerr << __FILE__ << ":" << __LINE__ << ": allocation budget exceeded: "           \
+                 << (budget).used() << " allocations, limit " << (limit) << endl;             \
+            abort();                                                                          \
+        }                                                                                     \
+    } while (0)
+
+#endif
@@ -0,0 +1,120 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstdint>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "game.h"
+
+using namespace std;
+
+// Phases of an arena tick, for timing
+enum ArenaPhase { ARENA_BUCKET = 0, ARENA_DECIDE, ARENA_RESOLVE, ARENA_APPLY, ARENA_RESPAWN, ARENA_PHASE_COUNT };
+
+extern const char* const ARENA_PHASE_NAMES[ARENA_PHASE_COUNT];
+
+// Headless arena: thousands of AI snakes on one large board.
+//
+// Every cell of a shared occupancy grid holds the snake on it (id + 1), food
+// or nothing. The board is cut into horizontal bands, one per thread, and a
+// tick runs in phases with a barrier between them:
+//
+//   bucket   snakes are sorted by the band their head is in
+//   decide   each band picks the moves of its snakes from the grid as it was
+//            at the start of the tick and files them by the band they enter
+//   resolve  each band settles the moves into its cells: two or more heads on
+//            one cell all die, a head on a body (tails included) dies, a head
+//            on food grows
+//   apply    each band moves its snakes, writing only cells no other snake
+//            writes this tick
+//   respawn  one thread replaces eaten food and dead snakes in id order
+//
+// Nothing a band decides depends on another band's work in the same phase,
+// the collision rules don't depend on the order moves are looked at, and
+// every random number comes from the snake's own generator or (serially) the
+// arena's, so a tick gives the same board for any number of threads.
+class Arena {
+public:
+    static const int MAX_LENGTH = 32; // Longer snakes stop growing
+    static constexpr uint32_t EMPTY = 0;
+    static constexpr uint32_t FOOD = 0xffffffffU;
+    static constexpr uint32_t NO_CELL = 0xffffffffU; // Off the board
+
+private:
+    enum Fate : unsigned char { FATE_MOVE = 0, FATE_GROW, FATE_DIE };
+
+    int width;
+    int height;
+    int snakeCount;
+    int foodCount;
+    vector<uint32_t> occupancy;   // EMPTY, FOOD or snake id + 1, per cell
+    vector<unsigned char> claims; // Heads entering each cell this tick (resolve phase only)
+
+    // Snakes, structure of arrays indexed by id. Bodies are ring buffers of
+    // cell indices, MAX_LENGTH per snake, head at headSlot.
+    vector<uint32_t> bodies;
+    vector<unsigned char> headSlot;
+    vector<unsigned char> lengths;
+    vector<Direction> directions;
+    vector<FastRandom> snakeRng;
+    vector<uint32_t> targets;     // Cell the head enters this tick
+    vector<Fate> fates;
+
+    FastRandom rng; // Respawns
+    long long ticks;
+    long long deaths;
+    long long foodEaten;
+
+    // Bands
+    int bandCount;
+    int bandHeight;
+    vector<int> bandStart;        // Offsets into bandSnakes, bandCount + 1 of them
+    vector<uint32_t> bandSnakes;  // Snake ids grouped by head band, ascending within a band
+    vector<vector<uint32_t>> moves; // [band * 3 + 1 + (target band - band)] = snake ids
+    vector<long long> bandFoodEaten;
+
+    // Thread pool, one thread per band (the caller runs band 0)
+    vector<thread> threads;
+    mutex poolMutex;
+    condition_variable phaseReady;
+    condition_variable phaseDone;
+    ArenaPhase phase;
+    int generation;
+    int pending;
+    bool stopping;
+
+    double phaseSeconds[ARENA_PHASE_COUNT];
+
+    void workerLoop(int band);
+    void runParallel(ArenaPhase parallelPhase);
+    void runBand(ArenaPhase bandPhase, int band);
+    void decideBand(int band);
+    void resolveBand(int band);
+    void applyBand(int band);
+    void bucket();
+    void respawn();
+    bool placeSnake(uint32_t id);
+    uint32_t randomEmptyCell();
+    // The cell one step from cell in a direction, or NO_CELL if that leaves the board
+    uint32_t neighbor(uint32_t cell, Direction dir) const;
+
+public:
+    // threads <= 0 uses one per hardware thread
+    Arena(int boardWidth, int boardHeight, int snakes, int food, uint32_t seed, int threads = 0);
+    ~Arena();
+
+    void tick();
+
+    int getThreadCount() const { return bandCount; }
+    long long getTicks() const { return ticks; }
+    long long getDeaths() const { return deaths; }
+    long long getFoodEaten() const { return foodEaten; }
+    double getAverageLength() const;
+    double getPhaseSeconds(ArenaPhase which) const { return phaseSeconds[which]; }
+    // Hash of every snake and the food on the board, for comparing runs
+    uint64_t getStateHash() const;
+};
+
+#endif
@@ -0,0 +1,138 @@
+#ifndef AUTOPILOT_H
+#define AUTOPILOT_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include "game.h"
+#include "zobrist.h"
+
+using namespace std;
+
+// Monte Carlo tree search pilot.
+//
+// Every decide() searches from a copy of the live game for a fixed wall-clock
+// budget and returns the move whose subtree was visited most. Each thread grows
+// its own open-loop tree (nodes are move sequences, not stored states): one
+// iteration memcpy-copies the root state, reseeds it so future spawns are
+// sampled instead of known, replays the tree path through the real
+// Simulation::update(), then plays out a short rollout with a light
+// food-seeking policy. The root counts of all threads are added up at the end.
+//
+// The food it heads for is picked once a decision over the distance field,
+// as the path pilots do: the special food if it can be reached in time, else
+// the nearest food by the way there. A search out from it gives the moves to
+// it from every cell, so rollouts follow the way around the body and earn
+// for each move closer along it, until they eat it. The move picked is the
+// most visited one, unless a step along that way has an average about as good.
+//
+// While searching, the threads also pool what they learn through a
+// transposition table keyed by the Zobrist position hash (which the game
+// keeps up to date, so it costs nothing to read after each step): a tree
+// node scores itself by the statistics of its position across all threads,
+// and positions reached by different move orders share theirs too.
+template <class Rules>
+class Autopilot {
+public:
+    static constexpr int DEFAULT_BUDGET_MS = 40;
+    static constexpr int MAX_BUDGET_MS = 75;
+    static const int HORIZON = 40; // Ticks looked ahead from the root, tree path included
+
+private:
+    static const int NODES_PER_THREAD = 1 << 16;
+    static const int EXPAND_AFTER = 32; // Visits before a leaf gets children
+    static const int TABLE_SLOTS = 1 << 17;
+    static constexpr float EXPLORATION = 0.5f; // UCT exploration weight (rewards are in [0, 1])
+    static constexpr float DISCOUNT = 0.9f;    // Per tick, so points scored sooner count for more
+    static constexpr float STEP_POINTS = 1.0f; // Shaping reward for each cell closer to the nearest food
+    static constexpr double TIE_MARGIN = 0.05; // Average reward a step towards the target may lag the best move by
+
+    struct Node {
+        float value;      // Sum of rewards
+        int visits;
+        int firstChild;   // Index in the node pool, -1 while a leaf
+        unsigned char childCount;
+        Direction move;   // Move that leads from the parent to this node
+        uint64_t position; // Position hash the last time the search got here, 0 before that
+    };
+
+    // One simulated line of play from the root
+    struct Playout {
+        Simulation<Rules> state;
+        int ticks;
+        int lastScore;
+        int lastDistance; // To the nearest food after the last tick, -1 if there is none
+        bool lastOnTarget; // lastDistance is by toTarget, not the straight line
+        float weight;     // DISCOUNT to the power of ticks
+        float gain;       // Points won (or lost to poison) and food approached, discounted by when
+    };
+
+    struct Worker {
+        vector<Node> nodes;
+        FastRandom rng;
+        long long rollouts;
+    };
+
+    int threadCount;
+    int budgetMs;
+    vector<Worker> workers; // workers[0] is the calling thread
+    vector<thread> threads;
+    TranspositionTable table; // Statistics by position, shared by the threads
+
+    // The food the rollouts head for, and the moves to it from every cell
+    // around the body as it stands at the root (set by decide(), see aim())
+    bool hasTarget;
+    Cell target;
+    uint16_t toTarget[WIDTH * HEIGHT];
+
+    // Search job shared with the pool
+    mutex jobMutex;
+    condition_variable jobReady;
+    condition_variable jobDone;
+    const Simulation<Rules>* root;
+    chrono::steady_clock::time_point deadline;
+    int generation;
+    int pending;
+    bool stopping;
+
+    // Statistics
+    long long lastRollouts;
+    double lastSeconds;
+    long long totalRollouts;
+    double totalSeconds;
+
+    void workerLoop(int index);
+    void search(Worker& worker);
+    int expand(Worker& worker, int node, Direction current);
+    int select(const Worker& worker, int node) const;
+    void step(Playout& playout, Direction dir) const;
+    // Plays on to the horizon and scores the outcome in [0, 1]
+    float rollout(Playout& playout, FastRandom& rng) const;
+    Direction rolloutMove(const Simulation<Rules>& state, FastRandom& rng) const;
+    // Picks the target and searches toTarget from it
+    void aim(const Simulation<Rules>& sim);
+    // The moves from the head to the root's target while it's still there and
+    // the head is on a cell the search reached, else -1
+    int movesToTarget(const Simulation<Rules>& state) const;
+    // Manhattan distance to the nearest food that isn't poison, or -1 if there is none
+    int nearestFood(const Simulation<Rules>& state, Cell& target) const;
+
+public:
+    // threadsWanted <= 0 uses one per hardware thread; the budget is clamped to MAX_BUDGET_MS
+    Autopilot(int threadsWanted = 0, int budget = DEFAULT_BUDGET_MS);
+    ~Autopilot();
+
+    // Searches from the given game for the time budget and returns the move to make
+    Direction decide(const Simulation<Rules>& sim);
+
+    int getThreadCount() const { return threadCount; }
+    int getBudgetMs() const { return budgetMs; }
+    long long getLastRollouts() const { return lastRollouts; }
+    // Rollouts per second of search time, over the last decision and since start-up
+    double getLastRolloutsPerSecond() const;
+    double getRolloutsPerSecond() const;
+};
+
+#endif
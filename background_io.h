@@ -0,0 +1,120 @@
+#ifndef BACKGROUND_IO_H
+#define BACKGROUND_IO_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Called on the I/O thread once a request is done; error is empty on success
+typedef function<void(bool ok, const string& error)> IoCallback;
+
+// File output off the game thread.
+//
+// Callers queue requests and return at once; the only thing the game thread
+// does is take a mutex and wake the I/O thread, never a file syscall. The I/O
+// thread takes everything queued in one go and runs it as a batch: on Linux
+// through an io_uring set up with raw syscalls (writes, fsyncs and renames
+// for the whole batch in one submission, each file's steps linked so they run
+// in order), elsewhere or when io_uring is missing or lacks an operation,
+// with plain write/fsync/rename calls on the same thread. Files are opened
+// and closed by the I/O thread itself.
+//
+// Appends to a file are written in order and fsynced at most once every
+// SYNC_INTERVAL_MS, however many arrive, so a busy log costs one fsync a
+// second; their callbacks run once the data is written. A replace is atomic:
+// the data goes to <path>.tmp, which is fsynced and renamed over the file,
+// and then the directory is fsynced, so a crash leaves the old contents or
+// the new, never a mix. Several replaces of one file in a batch only write
+// the last.
+class BackgroundIO {
+public:
+    static constexpr int SYNC_INTERVAL_MS = 1000;
+    static constexpr unsigned RING_ENTRIES = 64;
+
+private:
+    enum RequestType { REQUEST_APPEND, REQUEST_REPLACE };
+
+    struct Request {
+        RequestType type;
+        string path;
+        string data;
+        IoCallback done;
+    };
+
+    // An append target, kept open by the I/O thread
+    struct AppendFile {
+        int fd;
+        bool dirty; // Written since the last fsync
+        chrono::steady_clock::time_point lastSync;
+    };
+
+    // One write, fsync or rename of a batch. A linked step runs only if the
+    // one before it succeeded.
+    struct Step {
+        enum Kind { WRITE, FSYNC, RENAME } kind;
+        bool link;
+        int fd;
+        long long offset;   // WRITE: -1 appends
+        const string* data; // WRITE
+        const string* from; // RENAME
+        const string* to;
+        int request;        // Index in the batch, -1 for a sync of earlier appends
+        int result;         // Bytes written or 0, -errno on failure
+    };
+
+    struct Ring; // io_uring mappings (Linux)
+    Ring* ring;  // Null when plain syscalls are used
+
+    vector<Request> queue;
+    mutex queueMutex;
+    condition_variable queueReady;
+    condition_variable queueDone;
+    bool stopping;
+    bool syncRequested;    // flush() wants everything fsynced now
+    long long queuedCount; // Requests ever queued
+    long long doneCount;   // and finished
+    map<string, AppendFile> appendFiles;
+    atomic<long long> completed;
+    atomic<long long> failures;
+    atomic<long long> fsyncs;
+    atomic<long long> submissions; // io_uring_enter calls, or syscalls on the fallback
+    thread worker; // Started once the ring is set up
+
+    void run();
+    void process(vector<Request>& batch, bool syncAll);
+    void execute(vector<Step>& steps);
+    void executeWithSyscalls(vector<Step>& steps);
+    bool openRing();
+    void closeRing();
+    void enqueue(RequestType type, const string& path, string&& data, IoCallback&& done);
+
+public:
+    // useUring = false always takes the plain syscall path
+    explicit BackgroundIO(bool useUring = true);
+    // Finishes and fsyncs everything queued
+    ~BackgroundIO();
+
+    // Adds data to the end of the file, creating it if needed
+    void append(const string& path, string data, IoCallback done = nullptr);
+    // Swaps the file's contents for data atomically
+    void replace(const string& path, string data, IoCallback done = nullptr);
+    // Blocks until everything queued so far is written and fsynced. Not for
+    // the game thread while a game runs.
+    void flush();
+
+    bool usesUring() const { return ring != nullptr; }
+    long long getCompleted() const { return completed.load(memory_order_relaxed); }
+    long long getFailures() const { return failures.load(memory_order_relaxed); }
+    long long getFsyncs() const { return fsyncs.load(memory_order_relaxed); }
+    long long getSubmissions() const { return submissions.load(memory_order_relaxed); }
+};
+
+#endif
@@ -0,0 +1,628 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <string>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <memory>
+#include "game.h"
+#include "alloc_stats.h"
+#include "autopilot.h"
+#include "arena.h"
+#include "world.h"
+#include "versus.h"
+#include "rewind.h"
+#include "dashboard.h"
+
+using namespace std;
+
+// Headless simulation benchmark: plays games with a simple greedy pilot for
+// each rule set and reports how many ticks per second the engine runs and how
+// many bytes one game state takes (plus a hash of the final states, which
+// must not change between builds unless the rules do), then measures the
+// distance field, practice-mode rewind, the dashboard's terminal output, the
+// SIMD cell scan, the autopilot's rollout rate for growing thread counts, the
+// arena, the endless world and versus rollback.
+//
+// Usage: snake_bench [ticks per mode] [arena snakes] [arena ticks]
+//
+// Built with -DSNAKE_ALLOC_STATS it also checks that update() never touches
+// the heap once a game has been set up, and aborts if it does.
+
+// Heads for the nearest apple, taking the first safe direction otherwise
+template <class Rules>
+Direction chooseDirection(const Simulation<Rules>& sim) {
+    const typename Simulation<Rules>::Items& items = sim.getItems();
+    Cell head = sim.getSnake().getHead();
+
+    int target = NO_ITEM;
+    int bestDistance = WIDTH + HEIGHT;
+    for (int slot = 0; slot < items.count(); slot++) {
+        if (items.typeAt(slot) == ITEM_POISON_FOOD) continue;
+        int distance = abs(items.cellAt(slot).x - head.x) + abs(items.cellAt(slot).y - head.y);
+        if (distance < bestDistance) {
+            bestDistance = distance;
+            target = slot;
+        }
+    }
+
+    Direction preferred[4] = { RIGHT, DOWN, LEFT, UP };
+    if (target != NO_ITEM) {
+        int dx = items.cellAt(target).x - head.x;
+        int dy = items.cellAt(target).y - head.y;
+        preferred[0] = dx > 0 ? RIGHT : LEFT;
+        preferred[1] = dy > 0 ? DOWN : UP;
+        preferred[2] = dx > 0 ? LEFT : RIGHT;
+        preferred[3] = dy > 0 ? UP : DOWN;
+        if (abs(dy) > abs(dx)) swap(preferred[0], preferred[1]);
+    }
+
+    Direction current = sim.getSnake().getDirection();
+    for (Direction dir : preferred) {
+        if (!isReverse(dir, current) && !sim.wouldCollide(dir)) return dir;
+    }
+    return current;
+}
+
+template <class Rules>
+void benchmarkRules(long long tickBudget) {
+    long long ticks = 0;
+    long long games = 0;
+    long long totalLength = 0;
+    uint32_t seed = 1;
+    uint64_t hash = 0;     // Of every game's final state, to compare builds and machines
+    long long rehashErrors = 0;
+
+    auto start = chrono::steady_clock::now();
+    while (ticks < tickBudget) {
+        Simulation<Rules> sim(seed++);
+        // Cap the game length so the greedy pilot can't circle forever
+        for (int tick = 0; tick < 5000 && !sim.isGameOver(); tick++) {
+            sim.changeDirection(chooseDirection(sim));
+            AllocBudget budget;
+            sim.update();
+            SNAKE_ASSERT_ALLOC_BUDGET(budget, 0); // Steady state: no heap traffic per tick
+            ticks++;
+        }
+        totalLength += sim.getSnake().getLength();
+        hash ^= zobristMix(sim.getStateHash() + games);
+        if (sim.getPositionHash() != sim.rehashPosition()) rehashErrors++;
+        games++;
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << left << setw(12) << Rules::NAME << right
+         << setw(8) << games << " games"
+         << setw(10) << ticks << " ticks"
+         << setw(12) << fixed << setprecision(0) << ticks / seconds << " ticks/s"
+         << setw(8) << setprecision(1) << (double)totalLength / games << " avg length"
+         << setw(8) << sizeof(Simulation<Rules>) << " bytes/state"
+         << setw(8) << (1ULL << 30) / sizeof(Simulation<Rules>) / 1000 << "k states/GiB"
+         << "  hash " << hex << setw(16) << setfill('0') << hash << dec << setfill(' ')
+         << (rehashErrors ? "  MISMATCH: incremental hash differs from a full rehash" : "") << endl;
+}
+
+// The distance field: how far spawned special food is from the head against
+// how many moves its timer allows, how often the game searched (plain games,
+// greedy pilot) and what a search costs, then the path pilot, which asks for
+// distances every tick, against the greedy one on the same seeds. The cached
+// distances must match a fresh search after every tick.
+template <class Rules>
+void benchmarkDistanceField(long long tickBudget) {
+    long long ticks = 0, mismatches = 0, specials = 0, tooFar = 0, boxedIn = 0;
+    long long searches = -DistanceField<Rules::WRAP_WALLS>::getSearches();
+    uint32_t seed = 1;
+    while (ticks < tickBudget) {
+        Simulation<Rules> sim(seed++);
+        for (int tick = 0; tick < 5000 && !sim.isGameOver(); tick++, ticks++) {
+            int spawned = sim.getSpecialFoodSpawned();
+            sim.changeDirection(chooseDirection(sim));
+            sim.update();
+            if (sim.getSpecialFoodSpawned() == spawned) continue;
+
+            // The new one runs out last; an older one may have been cut off since
+            const DistanceField<Rules::WRAP_WALLS>& field = sim.getDistanceField();
+            const typename Simulation<Rules>::Items& items = sim.getItems();
+            int newest = NO_ITEM;
+            for (int slot = 0; slot < items.count(); slot++) {
+                if (items.typeAt(slot) == ITEM_SPECIAL_FOOD &&
+                    (newest == NO_ITEM || items.expiryAt(slot) > items.expiryAt(newest))) {
+                    newest = slot;
+                }
+            }
+            int allowed = (Rules::SPECIAL_FOOD_DURATION * 1000 - 1) / sim.getGameSpeed();
+            if (newest != NO_ITEM && field.distanceTo(items.cellAt(newest)) > allowed) {
+                // Fine if the snake has boxed itself in and no free cell was close
+                // enough (items don't spawn on the outermost ring)
+                bool couldReach = false;
+                for (int cell = 0; cell < (WIDTH - 2) * (HEIGHT - 2) && !couldReach; cell++) {
+                    Cell free(cell % (WIDTH - 2) + 1, cell / (WIDTH - 2) + 1);
+                    couldReach = field.distanceTo(free) <= allowed && !field.isBlocked(free) &&
+                                 free != sim.getSnake().getHead() && items.findAt(free) == NO_ITEM;
+                }
+                (couldReach ? tooFar : boxedIn)++;
+            }
+            specials++;
+        }
+    }
+    searches += DistanceField<Rules::WRAP_WALLS>::getSearches();
+
+    const int rounds = 20000;
+    Simulation<Rules> fresh(1);
+    uint16_t distances[DistanceField<Rules::WRAP_WALLS>::CELLS];
+    long long sum = 0;
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++) {
+        fresh.getDistanceField().search(distances);
+        sum += distances[i % DistanceField<Rules::WRAP_WALLS>::CELLS];
+    }
+    double searchNs = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / rounds;
+    if (sum == 42) cout << "";
+
+    long long pathTicks = 0, pathScore = 0, greedyScore = 0, games = 0;
+    seed = 1;
+    start = chrono::steady_clock::now();
+    while (pathTicks < tickBudget / 4) {
+        Simulation<Rules> path(seed), greedy(seed);
+        seed++;
+        for (int tick = 0; tick < 5000 && !path.isGameOver(); tick++, pathTicks++) {
+            path.changeDirection(pathTowardsNearestItem(path));
+            path.update();
+            uint16_t check[DistanceField<Rules::WRAP_WALLS>::CELLS];
+            path.getDistanceField().search(check);
+            for (int cell = 0; cell < DistanceField<Rules::WRAP_WALLS>::CELLS; cell++) {
+                if (check[cell] != path.getDistanceField().distanceTo(Cell(cell % WIDTH, cell / WIDTH))) {
+                    mismatches++;
+                    break;
+                }
+            }
+        }
+        for (int tick = 0; tick < 5000 && !greedy.isGameOver(); tick++) {
+            greedy.changeDirection(chooseDirection(greedy));
+            greedy.update();
+        }
+        pathScore += path.getScore();
+        greedyScore += greedy.getScore();
+        games++;
+    }
+    double pathSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << left << setw(12) << Rules::NAME << right << " distance field: " << specials << " special foods, "
+         << tooFar << " out of reach in time (" << boxedIn << " more with no free cell in reach), "
+         << fixed << setprecision(1) << 1000.0 * searches / max(ticks, 1LL) << " searches per 1000 ticks, "
+         << setprecision(0) << searchNs << " ns each; path pilot avg score " << pathScore / games << " (greedy "
+         << greedyScore / games << "), " << pathTicks / pathSeconds << " ticks/s with both games and a check, "
+         << (mismatches ? to_string(mismatches) + " TICKS DIFFER FROM A FRESH SEARCH" : "matches a fresh search")
+         << endl;
+}
+
+// Records every tick of games played by the greedy pilot. In every other game
+// it also rewinds every so often, checks the state against a copy taken at
+// the time and plays on from there, as in practice mode (mostly short
+// rewinds, so games get on); the others show how much of a minute is kept.
+template <class Rules>
+void benchmarkRewind(long long tickBudget) {
+    typedef RewindBuffer<Rules> Buffer;
+    const int CHECK_EVERY = 128; // Ticks, on average
+    const int SHORT_REWIND = 96;
+    unique_ptr<Buffer> buffer(new Buffer());
+    vector<Simulation<Rules>> past(Buffer::MAX_TICKS, Simulation<Rules>(1)); // By tick count
+    long long ticks = 0, rewinds = 0, rewoundTicks = 0, mismatches = 0, checks = 0, keptWords = 0, keptTicks = 0;
+    double recordNs = 0, rewindNs = 0;
+    int longestRewind = 0, shortestWindowMs = Buffer::WINDOW_MS;
+    FastRandom rng(7);
+    uint32_t seed = 1;
+    while (ticks < tickBudget) {
+        bool practice = seed % 2 == 0;
+        Simulation<Rules> sim(seed++);
+        buffer->reset(sim);
+        past[0] = sim;
+        for (int tick = 0; tick < 5000 && !sim.isGameOver(); tick++, ticks++) {
+            sim.changeDirection(chooseDirection(sim));
+            sim.update();
+            AllocBudget budget;
+            auto start = chrono::steady_clock::now();
+            buffer->record(sim);
+            recordNs += chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+            SNAKE_ASSERT_ALLOC_BUDGET(budget, 0);
+            past[sim.getTickCount() % Buffer::MAX_TICKS] = sim;
+            if (!practice) {
+                keptWords += buffer->getPoolUsed();
+                keptTicks += buffer->getTicksAvailable();
+                if (sim.getTime() > Buffer::WINDOW_MS + 1000) {
+                    shortestWindowMs = min(shortestWindowMs, buffer->getMsAvailable());
+                }
+                continue;
+            }
+            if (rng.below(CHECK_EVERY) != 0 || buffer->getTicksAvailable() == 0) continue;
+
+            int range = rng.below(8) == 0 ? buffer->getTicksAvailable() : min(buffer->getTicksAvailable(), SHORT_REWIND);
+            int back = 1 + rng.below(range);
+            start = chrono::steady_clock::now();
+            rewoundTicks += buffer->rewind(sim, back);
+            rewindNs += chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+            rewinds++;
+            longestRewind = max(longestRewind, back);
+
+            // Every byte, as recording only looks at what a tick can touch, and
+            // the distances, which come from the rewound blocker counts
+            const Simulation<Rules>& then = past[sim.getTickCount() % Buffer::MAX_TICKS];
+            bool same = memcmp(static_cast<const void*>(&sim), static_cast<const void*>(&then), sizeof(sim)) == 0 &&
+                        sim.getPositionHash() == sim.rehashPosition();
+            uint16_t expected[DistanceField<Rules::WRAP_WALLS>::CELLS];
+            then.getDistanceField().search(expected);
+            const uint16_t* distances = sim.getDistanceField().getDistances();
+            for (int cell = 0; cell < DistanceField<Rules::WRAP_WALLS>::CELLS && same; cell++) {
+                same = distances[cell] == expected[cell];
+            }
+            mismatches += !same;
+            checks++;
+        }
+    }
+
+    cout << left << setw(12) << Rules::NAME << right << " rewind: " << ticks << " ticks recorded, " << fixed
+         << setprecision(0) << recordNs / max(ticks, 1LL) << " ns each, " << setprecision(1)
+         << static_cast<double>(keptWords) / max(keptTicks, 1LL) << " words/tick kept, " << shortestWindowMs / 1000.0
+         << " s kept at the least, " << Buffer::getMemoryBytes() / 1024 << " KB; " << rewinds << " rewinds of up to "
+         << longestRewind << " ticks, " << setprecision(2) << rewindNs / 1000.0 / max(rewinds, 1LL)
+         << " us each, " << (mismatches ? to_string(mismatches) + " DIFFER FROM THE STATE AT THE TIME" : "all match")
+         << endl;
+}
+
+// A 4x4 dashboard of classic games, one refresh a tick: the bytes it sends
+// against the board of one game as the game draws it every tick
+void benchmarkDashboard(long long tickBudget) {
+    const int COLUMNS = 4, ROWS = 4;
+    Dashboard dashboard(COLUMNS, ROWS, false);
+    vector<Simulation<ClassicRules>> games;
+    uint32_t seed = 1;
+    for (int i = 0; i < COLUMNS * ROWS; i++) {
+        games.emplace_back(seed++);
+    }
+    Glyph frame[FRAME_WIDTH * FRAME_HEIGHT];
+    char stats[32];
+    long long ticks = 0, refreshes = 0, firstBytes = 0, firstCells = 0;
+    size_t largest = 0;
+    double composeNs = 0;
+    while (ticks < tickBudget) {
+        for (Simulation<ClassicRules>& sim : games) {
+            if (sim.isGameOver()) sim = Simulation<ClassicRules>(seed++);
+            sim.changeDirection(pathTowardsNearestItem(sim));
+            sim.update();
+        }
+        ticks += games.size();
+        AllocBudget budget;
+        auto start = chrono::steady_clock::now();
+        for (int i = 0; i < COLUMNS * ROWS; i++) {
+            composeBoard(games[i], frame);
+            snprintf(stats, sizeof(stats), "#%-2d %6d pts L%-4d", i + 1, games[i].getScore(),
+                     games[i].getSnake().getLength());
+            dashboard.drawTile(i, frame, stats);
+        }
+        const string& output = dashboard.refresh();
+        composeNs += chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+        SNAKE_ASSERT_ALLOC_BUDGET(budget, 0);
+        if (refreshes++ == 0) {
+            firstBytes = output.size();
+            firstCells = dashboard.getCellsSent();
+        } else {
+            largest = max(largest, output.size());
+        }
+    }
+
+    // One game's board as the game sends it every tick
+    Screen screen;
+    composeBoard(games[0], frame);
+    size_t boardBytes[2];
+    RenderMode modes[2] = { RENDER_EMOJI, RENDER_ASCII };
+    for (int m = 0; m < 2; m++) {
+        screen.setRenderMode(modes[m]);
+        screen.clear();
+        screen.addBoard(frame, FRAME_WIDTH, FRAME_HEIGHT, "*");
+        boardBytes[m] = screen.getLastBoardBytes();
+    }
+
+    long long later = max(refreshes - 1, 1LL);
+    cout << "dashboard   " << COLUMNS * ROWS << " games, " << refreshes << " refreshes: " << firstBytes
+         << " bytes for the first, then " << (dashboard.getBytesSent() - firstBytes) / later << " on average ("
+         << (dashboard.getCellsSent() - firstCells) / later << " cells), "
+         << largest << " at most, " << fixed << setprecision(1) << composeNs / 1000.0 / max(refreshes, 1LL)
+         << " us to compose; one game's board is " << boardBytes[0] << " bytes (emoji), " << boardBytes[1]
+         << " (ascii)" << endl;
+}
+
+// Cells compared per second when searching a full-board body for a cell that
+// isn't there (the worst case of a collision or spawn check)
+template <int (*Scan)(const Cell*, int, Cell)>
+double scanThroughput(const Cell* cells, int count) {
+    const int rounds = 200000;
+    long long found = 0;
+    auto start = chrono::steady_clock::now();
+    for (int round = 0; round < rounds; round++) {
+        // Vary the target so the loop can't be hoisted
+        found += Scan(cells, count, Cell(-1, round & 63));
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    if (found == 42) cout << "";
+    return (double)rounds * count / seconds;
+}
+
+void benchmarkScan() {
+    Cell body[Snake::CAPACITY];
+    for (int i = 0; i < Snake::CAPACITY; i++) {
+        body[i] = Cell(i % WIDTH, i / WIDTH);
+    }
+#if defined(__AVX2__)
+    const char* simd = "AVX2";
+#elif defined(__SSE2__) || defined(_M_X64)
+    const char* simd = "SSE2";
+#else
+    const char* simd = "none";
+#endif
+    double simdRate = scanThroughput<findCell>(body, Snake::CAPACITY);
+    double scalarRate = scanThroughput<findCellScalar>(body, Snake::CAPACITY);
+    cout << "cell scan (" << Snake::CAPACITY << " cells, SIMD: " << simd << "): "
+         << fixed << setprecision(0) << simdRate / 1e6 << "M cells/s, scalar "
+         << scalarRate / 1e6 << "M cells/s" << endl;
+}
+
+// Rollouts per second of the search pilot on a mid-game position, and the
+// score it reaches at the default budget against the greedy and path pilots
+// on the same seeds; it should do at least as well as greedy
+void benchmarkAutopilot() {
+    typedef Autopilot<ClassicRules> Pilot;
+    Simulation<ClassicRules> position(7);
+    for (int tick = 0; tick < 60 && !position.isGameOver(); tick++) {
+        position.changeDirection(chooseDirection(position));
+        position.update();
+    }
+
+    int hardwareThreads = max(1, static_cast<int>(thread::hardware_concurrency()));
+    for (int threads = 1; threads <= max(4, hardwareThreads); threads *= 2) {
+        Pilot pilot(threads, Pilot::DEFAULT_BUDGET_MS);
+        for (int i = 0; i < 10; i++) {
+            pilot.decide(position);
+        }
+        cout << "autopilot " << setw(3) << threads << " threads: " << fixed << setprecision(0)
+             << pilot.getRolloutsPerSecond() << " rollouts/s" << endl;
+    }
+
+    const int games = 3;
+    const int tickCap = 600;
+    long long greedyScore = 0, pathScore = 0, searchScore = 0, greedyTicks = 0, pathTicks = 0, searchTicks = 0;
+    Pilot pilot(0, Pilot::DEFAULT_BUDGET_MS);
+    for (uint32_t seed = 1; seed <= games; seed++) {
+        Simulation<ClassicRules> greedy(seed), path(seed), search(seed);
+        for (int tick = 0; tick < tickCap && !greedy.isGameOver(); tick++, greedyTicks++) {
+            greedy.changeDirection(chooseDirection(greedy));
+            greedy.update();
+        }
+        for (int tick = 0; tick < tickCap && !path.isGameOver(); tick++, pathTicks++) {
+            path.changeDirection(pathTowardsNearestItem(path));
+            path.update();
+        }
+        for (int tick = 0; tick < tickCap && !search.isGameOver(); tick++, searchTicks++) {
+            search.changeDirection(pilot.decide(search));
+            search.update();
+        }
+        greedyScore += greedy.getScore();
+        pathScore += path.getScore();
+        searchScore += search.getScore();
+    }
+    cout << "avg over " << games << " games of up to " << tickCap << " ticks: greedy score " << greedyScore / games
+         << " (" << greedyTicks / games << " ticks), path pilot " << pathScore / games << " (" << pathTicks / games
+         << " ticks), autopilot at " << Pilot::DEFAULT_BUDGET_MS << " ms " << searchScore / games << " ("
+         << searchTicks / games << " ticks), " << (searchScore >= greedyScore ? "at least greedy's" : "BELOW GREEDY")
+         << endl;
+}
+
+// Ticks per second of a 2048x2048 arena and the time each phase takes, for
+// one thread and more; every run must end on the same board
+void benchmarkArena(int snakes, int tickCount) {
+    const int side = 2048;
+    int hardwareThreads = max(1, static_cast<int>(thread::hardware_concurrency()));
+    vector<int> threadCounts = { 1, 4 };
+    if (hardwareThreads != 1 && hardwareThreads != 4) threadCounts.push_back(hardwareThreads);
+
+    uint64_t expectedHash = 0;
+    for (int threads : threadCounts) {
+        Arena arena(side, side, snakes, snakes * 2, 42, threads);
+        auto start = chrono::steady_clock::now();
+        for (int tick = 0; tick < tickCount; tick++) {
+            arena.tick();
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        uint64_t hash = arena.getStateHash();
+        if (threads == threadCounts[0]) expectedHash = hash;
+        cout << "arena " << snakes << " snakes " << side << "x" << side << setw(3) << threads << " threads: "
+             << fixed << setprecision(1) << tickCount / seconds << " ticks/s, ms/tick";
+        for (int phase = 0; phase < ARENA_PHASE_COUNT; phase++) {
+            cout << " " << ARENA_PHASE_NAMES[phase] << " " << setprecision(2)
+                 << arena.getPhaseSeconds(static_cast<ArenaPhase>(phase)) * 1000 / tickCount;
+        }
+        cout << ", " << arena.getDeaths() << " deaths, avg length " << setprecision(1) << arena.getAverageLength()
+             << (hash == expectedHash ? "" : "  MISMATCH: result depends on thread count") << endl;
+    }
+}
+
+// Endless world games run away from the start (down and right, by turns) for
+// up to the tick budget. The tick cost of the first and last tenth of the
+// ticks shows whether it grows with the distance travelled.
+void benchmarkWorld(long long tickBudget) {
+    const Direction HEADINGS[2] = { RIGHT, DOWN };
+    long long ticks = 0;
+    long long games = 0;
+    long long farthest = 0;
+    long long generated = 0;
+    long long evicted = 0;
+    int peakResident = 0;
+    size_t reserved = 0;
+    double firstSeconds = 0, lastSeconds = 0;
+    long long firstTicks = 0, lastTicks = 0;
+    uint32_t seed = 1;
+
+    auto start = chrono::steady_clock::now();
+    while (ticks < tickBudget) {
+        World world(seed++);
+        for (long long tick = 0; ticks < tickBudget && !world.isGameOver(); tick++) {
+            // The heading first, then either side: the first way that isn't a rock or the snake
+            Direction heading = HEADINGS[(tick / 300) % 2];
+            Direction current = world.getDirection();
+            Direction options[3] = { heading, heading == RIGHT ? DOWN : RIGHT, heading == RIGHT ? UP : LEFT };
+            for (Direction dir : options) {
+                WorldPos next = world.getHead();
+                if (dir == LEFT) next.x--;
+                else if (dir == RIGHT) next.x++;
+                else if (dir == UP) next.y--;
+                else next.y++;
+                uint8_t cell = world.peek(next);
+                if (!isReverse(dir, current) && !(cell & World::CELL_SNAKE) && cell != World::CELL_ROCK) {
+                    world.changeDirection(dir);
+                    break;
+                }
+            }
+
+            auto tickStart = chrono::steady_clock::now();
+            AllocBudget budget;
+            world.update();
+            SNAKE_ASSERT_ALLOC_BUDGET(budget, 0); // Chunks come from the pool
+            double tickSeconds = chrono::duration<double>(chrono::steady_clock::now() - tickStart).count();
+            if (ticks < tickBudget / 10) {
+                firstSeconds += tickSeconds;
+                firstTicks++;
+            } else if (ticks >= tickBudget - tickBudget / 10) {
+                lastSeconds += tickSeconds;
+                lastTicks++;
+            }
+            ticks++;
+        }
+        WorldPos head = world.getHead();
+        farthest = max(farthest, static_cast<long long>(abs(head.x)) + abs(head.y));
+        generated += world.getChunksGenerated();
+        evicted += world.getChunksEvicted();
+        peakResident = max(peakResident, world.getPeakResidentChunks());
+        reserved = world.getReservedBytes();
+        games++;
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << left << setw(12) << EndlessRules::NAME << right
+         << setw(8) << games << " games"
+         << setw(10) << ticks << " ticks"
+         << setw(12) << fixed << setprecision(0) << ticks / seconds << " ticks/s, "
+         << firstSeconds * 1e9 / max(firstTicks, 1LL) << " ns/tick in the first tenth, "
+         << lastSeconds * 1e9 / max(lastTicks, 1LL) << " in the last, " << farthest << " cells out at most, "
+         << generated << " chunks made, " << evicted << " dropped, " << peakResident << " of " << World::MAX_CHUNKS
+         << " in memory at most (" << reserved / 1024 << " KB reserved)" << endl;
+}
+
+// Keeps going (STOP, as a player who presses nothing) unless that runs into
+// something, with a random turn now and then
+static Direction versusPilot(const Versus& state, int player, FastRandom& rng) {
+    const Snake& snake = state.getSnake(player);
+    Direction current = snake.getDirection();
+    Direction options[4] = { current, UP, DOWN, LEFT };
+    if (current == UP || current == DOWN) {
+        options[1] = LEFT;
+        options[2] = RIGHT;
+    }
+    if (rng.below(8) == 0) swap(options[0], options[1 + rng.below(2)]);
+    for (int i = 0; i < 3; i++) {
+        Cell next = snake.getHead();
+        if (options[i] == LEFT) next.x--;
+        else if (options[i] == RIGHT) next.x++;
+        else if (options[i] == UP) next.y--;
+        else next.y++;
+        if (next.x >= 0 && next.x < WIDTH && next.y >= 0 && next.y < HEIGHT &&
+            !state.getSnake(0).occupies(next) && !state.getSnake(1).occupies(next)) {
+            return options[i] == current ? STOP : options[i];
+        }
+    }
+    return STOP;
+}
+
+// Two rollback sessions whose inputs reach each other MAX_ROLLBACK - 1 ticks
+// late, so nearly every turn is a deep rollback. Both must end up exactly where
+// one Versus played straight with the real inputs does.
+void benchmarkRollback(long long tickBudget) {
+    const int DELAY = RollbackSession::MAX_ROLLBACK - 1;
+    const int MAX_TICKS = 5000; // Per game
+    vector<Direction> played[2] = { vector<Direction>(MAX_TICKS), vector<Direction>(MAX_TICKS) };
+    long long ticks = 0, games = 0, mismatches = 0, rollbacks = 0, replayed = 0;
+    int deepest = 0;
+    uint64_t slowestNs = 0, totalNs = 0;
+    uint32_t seed = 1;
+
+    auto start = chrono::steady_clock::now();
+    while (ticks < tickBudget) {
+        RollbackSession sides[2] = { RollbackSession(seed, 0), RollbackSession(seed, 1) };
+        Versus straight(seed);
+        FastRandom rng(seed++);
+        int tick = 0;
+        for (; tick < MAX_TICKS && !straight.isOver(); tick++) {
+            AllocBudget budget;
+            for (int p = 0; p < 2; p++) {
+                if (tick >= DELAY) sides[p].receiveRemote(tick - DELAY, played[1 - p][tick - DELAY]);
+                played[p][tick] = versusPilot(sides[p].getState(), p, rng);
+                sides[p].advance(played[p][tick]);
+            }
+            SNAKE_ASSERT_ALLOC_BUDGET(budget, 0);
+            Direction inputs[2] = { played[0][tick], played[1][tick] };
+            straight.update(inputs);
+        }
+        for (int p = 0; p < 2; p++) {
+            for (int late = max(tick - DELAY, 0); late < tick; late++) {
+                sides[p].receiveRemote(late, played[1 - p][late]);
+            }
+            sides[p].reconcile();
+            if (sides[p].getState().getStateHash() != straight.getStateHash()) mismatches++;
+            rollbacks += sides[p].getRollbacks();
+            replayed += sides[p].getTicksReplayed();
+            deepest = max(deepest, sides[p].getDeepestRollback());
+            slowestNs = max(slowestNs, sides[p].getSlowestRollbackNs());
+            totalNs += sides[p].getAverageRollbackNs() * sides[p].getRollbacks();
+        }
+        ticks += tick;
+        games++;
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << left << setw(12) << VersusRules::NAME << right
+         << setw(8) << games << " games"
+         << setw(10) << ticks << " ticks"
+         << setw(12) << fixed << setprecision(0) << ticks / seconds << " ticks/s (two sides), "
+         << rollbacks << " rollbacks, " << replayed << " ticks replayed, deepest " << deepest << ", "
+         << setprecision(2) << totalNs / 1000.0 / max(rollbacks, 1LL) << " us each on average, worst "
+         << slowestNs / 1000.0 << " us, state " << sizeof(Versus) << " bytes, "
+         << (mismatches ? to_string(mismatches) + " SIDES DIFFER FROM A STRAIGHT RUN" : "all match a straight run")
+         << endl;
+}
+
+int main(int argc, char* argv[]) {
+    long long tickBudget = argc > 1 ? atoll(argv[1]) : 200000;
+    int arenaSnakes = argc > 2 ? atoi(argv[2]) : 10000;
+    int arenaTicks = argc > 3 ? atoi(argv[3]) : 200;
+
+    benchmarkRules<ClassicRules>(tickBudget);
+    benchmarkRules<WrapRules>(tickBudget);
+    benchmarkRules<NoPowerUpRules>(tickBudget);
+    benchmarkRules<ObstacleHeavyRules>(tickBudget);
+    benchmarkRules<FrenzyRules>(tickBudget);
+    benchmarkRules<MazeRules>(tickBudget);
+    benchmarkDistanceField<ClassicRules>(tickBudget);
+    benchmarkDistanceField<WrapRules>(tickBudget);
+    benchmarkDistanceField<ObstacleHeavyRules>(tickBudget);
+    benchmarkDistanceField<MazeRules>(tickBudget);
+    benchmarkRewind<ClassicRules>(tickBudget);
+    benchmarkRewind<FrenzyRules>(tickBudget);
+    benchmarkRewind<MazeRules>(tickBudget);
+    benchmarkDashboard(tickBudget);
+    benchmarkWorld(tickBudget);
+    benchmarkRollback(tickBudget);
+    benchmarkScan();
+    benchmarkAutopilot();
+    benchmarkArena(arenaSnakes, arenaTicks);
+    return 0;
+}
@@ -0,0 +1,90 @@
+#ifndef BOT_HOST_H
+#define BOT_HOST_H
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <iostream>
+#include "bot_plugin.h"
+#include "shared_state.h"
+
+using namespace std;
+
+// Loads a controller plugin (see bot_plugin.h) and asks it for a move every
+// tick without ever letting it hold up the game.
+//
+// The plugin runs on a thread of its own. decide() fills the view, hands it
+// over and waits at most the budget: a late answer counts as an overrun and
+// the snake keeps its direction, a call that is still running when the next
+// tick comes makes that tick skip the plugin, and SNAKE_BOT_MAX_OVERRUNS
+// overruns in a row demote the plugin for good. A plugin that never returns
+// is abandoned at exit (no teardown, library left loaded), its thread
+// keeping the call state it shares with the host alive.
+class BotHost {
+public:
+    static constexpr int DEFAULT_BUDGET_MS = 10;
+    static constexpr int MAX_BUDGET_MS = 50;
+    static const int HISTOGRAM_BUCKETS = 16; // Bucket i counts calls under 2^i us, the last one the rest
+
+private:
+    string name;
+    void* library;
+    SnakeBotTeardownFn teardownFn;
+    int budgetMs;
+
+    // Everything the plugin thread touches. The thread shares it, so it
+    // outlives the host if the plugin is stuck in decide at exit.
+    struct Call {
+        SnakeBotDecideFn decideFn;
+        void* context;
+        SharedGameState state; // What the view points into
+        SnakeBotView view;
+
+        mutex callMutex;
+        condition_variable callReady;
+        condition_variable callDone;
+        bool calling;  // The plugin is inside decide
+        bool stopping;
+        int answer;
+
+        long long decisions;
+        long long totalLatencyNs;
+        long long maxLatencyNs;
+        long long histogram[HISTOGRAM_BUCKETS];
+
+        Call();
+    };
+
+    shared_ptr<Call> call;
+    thread worker;
+
+    // Statistics kept by the game thread
+    long long overruns;
+    long long skipped;
+    int overrunStreak;
+    long long demotedAtTick; // -1 while the plugin is in use
+
+    static void workerLoop(shared_ptr<Call> call);
+    void unload();
+
+public:
+    explicit BotHost(int budget = DEFAULT_BUDGET_MS);
+    ~BotHost();
+
+    // Loads the library and calls its init; on failure returns false with a message in error
+    bool load(const string& path, const string& args, string& error);
+
+    // The plugin's move for this tick, STOP to keep the current direction
+    template <class Rules>
+    Direction decide(const Simulation<Rules>& sim);
+
+    const string& getName() const { return name; }
+    int getBudgetMs() const { return budgetMs; }
+    long long getOverruns() const { return overruns; }
+    bool isDemoted() const { return demotedAtTick >= 0; }
+    void printReport(ostream& out);
+};
+
+#endif
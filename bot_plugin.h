@@ -0,0 +1,99 @@
+#ifndef BOT_PLUGIN_H
+#define BOT_PLUGIN_H
+
+/*
+ * C ABI for snake controller plugins (--bot=<library>).
+ *
+ * A plugin is a shared library exporting the three functions below with C
+ * linkage. The game loads it with dlopen (LoadLibrary on Windows), calls
+ * snake_bot_init once, snake_bot_decide once per tick on a thread of its own,
+ * and snake_bot_teardown at exit. The view and everything it points to is
+ * owned by the game and only valid during the decide call.
+ *
+ * Each decision has a time budget (--bot-budget). A late answer is dropped
+ * and the snake keeps its direction; while a call is still running no new
+ * one is made; a plugin that overruns SNAKE_BOT_MAX_OVERRUNS ticks in a row
+ * is never called again for the rest of the game.
+ *
+ * This header is plain C so plugins can be written in C or anything that
+ * speaks the C ABI. Structures only ever grow at the end, with a new
+ * SNAKE_BOT_ABI_VERSION.
+ */
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SNAKE_BOT_ABI_VERSION 1
+#define SNAKE_BOT_MAX_OVERRUNS 3
+
+/* Return values of snake_bot_decide */
+#define SNAKE_BOT_KEEP  0 /* Keep going the current way */
+#define SNAKE_BOT_LEFT  1
+#define SNAKE_BOT_RIGHT 2
+#define SNAKE_BOT_UP    3
+#define SNAKE_BOT_DOWN  4
+
+/* Board codes, one byte per cell in SnakeBotView.board */
+#define SNAKE_BOT_EMPTY     0
+#define SNAKE_BOT_BODY      1
+#define SNAKE_BOT_HEAD      2
+#define SNAKE_BOT_OBSTACLE  3
+#define SNAKE_BOT_MAZE_WALL 4
+#define SNAKE_BOT_ITEM      5 /* SNAKE_BOT_ITEM + item type */
+
+/* Item types */
+#define SNAKE_BOT_FOOD         0
+#define SNAKE_BOT_SPECIAL_FOOD 1
+#define SNAKE_BOT_POISON_FOOD  2
+#define SNAKE_BOT_SHIELD       3
+
+typedef struct SnakeBotCell {
+    int8_t x;
+    int8_t y;
+} SnakeBotCell;
+
+typedef struct SnakeBotItem {
+    SnakeBotCell cell;
+    uint8_t type;
+    uint8_t unused;
+    int32_t expiresAt;  /* Game time in ms, -1 if it never expires */
+} SnakeBotItem;
+
+/* Read-only state of the game at the start of a tick */
+typedef struct SnakeBotView {
+    uint32_t abiVersion;
+    int32_t width;
+    int32_t height;
+    uint64_t tick;
+    int32_t timeMs;
+    int32_t score;
+    int32_t speedMs;            /* Length of this tick */
+    int32_t shieldRemainingMs;  /* 0 unless the snake is shielded */
+    uint8_t mode;               /* Rule set: 0 classic, 1 wrap, 2 nopowerups, 3 obstacles, 4 frenzy, 5 maze */
+    uint8_t direction;          /* SNAKE_BOT_LEFT..DOWN */
+    uint8_t unused[2];
+    int32_t length;
+    int32_t itemCount;
+    const SnakeBotCell* body;   /* length cells, head first */
+    const SnakeBotItem* items;  /* itemCount items */
+    const uint8_t* board;       /* height rows of width codes */
+} SnakeBotView;
+
+/* Exported by the plugin. init returns 0 on success and may set *context,
+ * which is handed back to the other two; args is the --bot-args text, or "". */
+typedef int (*SnakeBotInitFn)(uint32_t abiVersion, const char* args, void** context);
+typedef int (*SnakeBotDecideFn)(void* context, const SnakeBotView* view);
+typedef void (*SnakeBotTeardownFn)(void* context);
+
+#define SNAKE_BOT_INIT_SYMBOL     "snake_bot_init"
+#define SNAKE_BOT_DECIDE_SYMBOL   "snake_bot_decide"
+#define SNAKE_BOT_TEARDOWN_SYMBOL "snake_bot_teardown"
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef CELL_H
+#define CELL_H
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX2__)
+    #include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+    #include <emmintrin.h>
+#endif
+#if defined(_MSC_VER)
+    #include <intrin.h>
+#endif
+
+// Packed board coordinate: one signed byte per axis, two bytes in total.
+// The board is at most 127 cells on a side, which also leaves room for the
+// one-cell-out-of-bounds positions used when the snake hits a wall.
+struct Cell {
+    int8_t x;
+    int8_t y;
+
+    Cell() : x(0), y(0) {}
+    Cell(int cx, int cy) : x(static_cast<int8_t>(cx)), y(static_cast<int8_t>(cy)) {}
+
+    // Both coordinates as one 16-bit value, for comparisons and hashing
+    uint16_t key() const {
+        uint16_t k;
+        memcpy(&k, this, sizeof(k));
+        return k;
+    }
+
+    bool operator==(const Cell& other) const { return key() == other.key(); }
+    bool operator!=(const Cell& other) const { return key() != other.key(); }
+};
+
+static_assert(sizeof(Cell) == 2, "Cell must stay packed into 16 bits");
+
+// Position of the lowest set bit of a non-zero mask
+inline int lowestSetBit(unsigned mask) {
+#if defined(_MSC_VER)
+    unsigned long bit;
+    _BitScanForward(&bit, mask);
+    return static_cast<int>(bit);
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+// Index of the first cell equal to target in cells[0, count), or -1.
+// Compares 16 cells per step with AVX2 or 8 with SSE2, with a scalar tail
+// (and a scalar fallback on other targets).
+inline int findCell(const Cell* cells, int count, Cell target) {
+    int i = 0;
+#if defined(__AVX2__)
+    const __m256i wanted = _mm256_set1_epi16(static_cast<short>(target.key()));
+    for (; i + 16 <= count; i += 16) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(cells + i));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi16(block, wanted)));
+        if (mask) return i + lowestSetBit(mask) / 2;
+    }
+#elif defined(__SSE2__) || defined(_M_X64)
+    const __m128i wanted = _mm_set1_epi16(static_cast<short>(target.key()));
+    for (; i + 8 <= count; i += 8) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cells + i));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi16(block, wanted)));
+        if (mask) return i + lowestSetBit(mask) / 2;
+    }
+#endif
+    const uint16_t wantedKey = target.key();
+    for (; i < count; i++) {
+        if (cells[i].key() == wantedKey) return i;
+    }
+    return -1;
+}
+
+// Plain loop version of findCell(), kept for benchmarking against the SIMD one
+inline int findCellScalar(const Cell* cells, int count, Cell target) {
+    const uint16_t wantedKey = target.key();
+    for (int i = 0; i < count; i++) {
+        if (cells[i].key() == wantedKey) return i;
+    }
+    return -1;
+}
+
+#endif
@@ -0,0 +1,163 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <random>
+#include <cstdio>
+#include <cstdlib>
+#include "game.h"
+#include "autopilot.h"
+#include "dashboard.h"
+#include "event_loop.h"
+#include "input_handler.h"
+#include "key_decoder.h"
+
+using namespace std;
+
+// Watches many games at once: a grid of live games, each steered by a pilot,
+// in one terminal.
+//
+// Usage: snake_dashboard [--grid=<cols>x<rows>] [--mode=<rules>] [--tick=<ms>]
+//                        [--autopilot=<ms>] [--render=ascii] [--ticks=<n>]
+//
+// Every game ticks once every --tick ms (default 100) and starts again with a
+// new seed when it ends. The games are steered by a shortest-path pilot over
+// the game's distance field, or with --autopilot by the tree search pilot,
+// given that many ms per game and tick (keep --tick above the grid's total).
+// --render=ascii draws the boards with plain characters for terminals
+// without the Unicode quadrant blocks. --ticks stops after that many ticks
+// (for scripts); otherwise Q or Ctrl+C quits. At the end it prints the
+// terminal bytes sent per refresh.
+
+const int DEFAULT_COLUMNS = 4;
+const int DEFAULT_ROWS = 4;
+const int DEFAULT_TICK_MS = 100;
+const int INPUT_BUFFER_SIZE = 64;
+
+template <class Rules>
+int watch(int columns, int rows, int tickMs, int autopilotMs, bool ascii, long long tickLimit) {
+    Dashboard dashboard(columns, rows, ascii);
+    int count = dashboard.getTileCount();
+    random_device device;
+    uint32_t nextSeed = device();
+    vector<Simulation<Rules>> games;
+    games.reserve(count);
+    for (int i = 0; i < count; i++) {
+        games.emplace_back(nextSeed++);
+    }
+    unique_ptr<Autopilot<Rules>> autopilot;
+    if (autopilotMs > 0) autopilot.reset(new Autopilot<Rules>(1, autopilotMs));
+
+    vector<Glyph> frame(FRAME_WIDTH * FRAME_HEIGHT);
+    char line[128];
+    auto draw = [&](long long ticks, long long gamesOver, int best) {
+        for (int i = 0; i < count; i++) {
+            composeBoard(games[i], frame.data());
+            snprintf(line, sizeof(line), "#%-2d %6d pts L%-4d", i + 1, games[i].getScore(),
+                     games[i].getSnake().getLength());
+            dashboard.drawTile(i, frame.data(), line);
+        }
+        snprintf(line, sizeof(line), "%s x%d  tick %d ms  #%lld  over %lld  best %d  %zu B  Q quits",
+                 Rules::NAME, count, tickMs, ticks, gamesOver, best, dashboard.getLastBytes());
+        dashboard.drawHeader(line);
+        cout << dashboard.refresh() << flush;
+    };
+
+    EventLoop loop;
+    InputHandler::enableRawInput();
+    KeyDecoder decoder;
+    cout << "\033[?25l";
+    loop.setTickInterval(tickMs);
+    long long ticks = 0;
+    long long gamesOver = 0;
+    int best = 0;
+    bool quit = false;
+    draw(ticks, gamesOver, best);
+    while (!quit && (tickLimit == 0 || ticks < tickLimit)) {
+        LoopEvents events = loop.wait();
+        if (events.quit) break;
+        if (events.resized) dashboard.redrawAll();
+        if (events.input) {
+            unsigned char bytes[INPUT_BUFFER_SIZE];
+            Key keys[INPUT_BUFFER_SIZE];
+            int read = InputHandler::readAvailable(bytes, INPUT_BUFFER_SIZE);
+            int found = decoder.feed(bytes, read, keys);
+            for (int k = 0; k < found; k++) {
+                if (keys[k] == KEY_QUIT) quit = true;
+            }
+        }
+        // Behind by several ticks (a slow pilot): one step and catch up, not a burst
+        if (events.ticks > 0) {
+            for (int i = 0; i < count; i++) {
+                Simulation<Rules>& sim = games[i];
+                if (sim.isGameOver()) {
+                    gamesOver++;
+                    sim = Simulation<Rules>(nextSeed++);
+                    continue;
+                }
+                sim.changeDirection(autopilot ? autopilot->decide(sim) : pathTowardsNearestItem(sim));
+                sim.update();
+                best = max(best, sim.getScore());
+            }
+            ticks++;
+        }
+        if (events.ticks > 0 || events.resized) draw(ticks, gamesOver, best);
+    }
+    cout << "\033[?25h" << flush;
+    InputHandler::disableRawInput();
+
+    long long refreshes = max(dashboard.getRefreshes(), 1LL);
+    cout << count << " " << Rules::NAME << " games, " << ticks << " ticks, " << gamesOver << " games over, best "
+         << best << "\n" << dashboard.getRefreshes() << " refreshes, " << dashboard.getBytesSent() / refreshes
+         << " bytes and " << dashboard.getCellsSent() / refreshes << " cells each on average" << endl;
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    int columns = DEFAULT_COLUMNS;
+    int rows = DEFAULT_ROWS;
+    int tickMs = DEFAULT_TICK_MS;
+    int autopilotMs = 0;
+    bool ascii = false;
+    long long tickLimit = 0;
+    string mode = ClassicRules::NAME;
+    bool usage = false;
+    for (int i = 1; i < argc && !usage; i++) {
+        string arg = argv[i];
+        if (arg.rfind("--grid=", 0) == 0) {
+            usage = sscanf(arg.c_str() + 7, "%dx%d", &columns, &rows) != 2 || columns <= 0 || rows <= 0 ||
+                    columns * rows > Dashboard::MAX_TILES;
+        } else if (arg.rfind("--mode=", 0) == 0) {
+            mode = arg.substr(7);
+        } else if (arg.rfind("--tick=", 0) == 0) {
+            tickMs = atoi(arg.c_str() + 7);
+            usage = tickMs <= 0;
+        } else if (arg.rfind("--autopilot=", 0) == 0) {
+            autopilotMs = atoi(arg.c_str() + 12);
+            usage = autopilotMs <= 0 || autopilotMs > Autopilot<ClassicRules>::MAX_BUDGET_MS;
+        } else if (arg == "--render=ascii") {
+            ascii = true;
+        } else if (arg.rfind("--ticks=", 0) == 0) {
+            tickLimit = atoll(arg.c_str() + 8);
+            usage = tickLimit <= 0;
+        } else {
+            usage = true;
+        }
+    }
+
+    int (*run)(int, int, int, int, bool, long long) = nullptr;
+    if (mode == ClassicRules::NAME) run = watch<ClassicRules>;
+    else if (mode == WrapRules::NAME) run = watch<WrapRules>;
+    else if (mode == NoPowerUpRules::NAME) run = watch<NoPowerUpRules>;
+    else if (mode == ObstacleHeavyRules::NAME) run = watch<ObstacleHeavyRules>;
+    else if (mode == FrenzyRules::NAME) run = watch<FrenzyRules>;
+    else if (mode == MazeRules::NAME) run = watch<MazeRules>;
+    if (usage || !run) {
+        cout << "Usage: " << argv[0] << " [--grid=<cols>x<rows>] [--mode=classic|wrap|nopowerups|obstacles|frenzy|maze]\n"
+             << "       [--tick=<ms>] [--autopilot=<ms>] [--render=ascii] [--ticks=<n>]" << endl;
+        return 1;
+    }
+    setupConsole();
+    return run(columns, rows, tickMs, autopilotMs, ascii, tickLimit);
+}
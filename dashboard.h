@@ -0,0 +1,85 @@
+#ifndef DASHBOARD_H
+#define DASHBOARD_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "game.h"
+
+using namespace std;
+
+// Many games in one terminal, as a grid of tiles, for watching soak tests
+// and AI batches.
+//
+// Every tile is a game's board at half size, each character standing for a
+// 2x2 block of board cells (a quadrant block in the colour of the most
+// important thing in it: head, then items, then body, then walls), with a
+// line of stats under it. Tiles are drawn into one shared grid of terminal
+// cells. A refresh compares that grid with what the terminal shows and sends
+// only the cells that changed, jumping the cursor over the rest. A tick
+// changes a few cells per game (the head, the tail, an item, the score), so
+// 16 games cost about what one full single-game frame does.
+class Dashboard {
+public:
+    static constexpr int TILE_BOARD_WIDTH = (FRAME_WIDTH + 1) / 2; // Characters
+    static constexpr int TILE_BOARD_HEIGHT = (FRAME_HEIGHT + 1) / 2;
+    static constexpr int TILE_WIDTH = TILE_BOARD_WIDTH + 1;        // With a blank column between tiles
+    static constexpr int TILE_HEIGHT = TILE_BOARD_HEIGHT + 1;      // With the stats line
+    static constexpr int HEADER_LINES = 1;
+    static constexpr int MAX_TILES = 64;
+
+private:
+    // One character on the terminal: ASCII, or QUADRANTS + a mask of the
+    // 2x2 block (1 top left, 2 top right, 4 bottom left, 8 bottom right)
+    struct TerminalCell {
+        uint8_t symbol;
+        uint8_t color; // 16-colour SGR foreground code, 0 for the default
+        bool operator==(const TerminalCell& other) const {
+            return symbol == other.symbol && color == other.color;
+        }
+    };
+    static constexpr uint8_t QUADRANTS = 0x80;
+
+    int columns;  // Tiles across
+    int rows;     // Tiles down
+    int width;    // Terminal cells
+    int height;
+    bool ascii;   // Plain characters instead of quadrant blocks
+    vector<TerminalCell> cells; // This frame
+    vector<TerminalCell> shown; // On the terminal
+    bool clearFirst;            // The terminal holds something else; start from a blank screen
+    string output;
+
+    long long refreshes;
+    long long bytesSent;
+    long long cellsSent;
+    size_t lastBytes;
+
+    void put(int x, int y, uint8_t symbol, uint8_t color) { cells[y * width + x] = TerminalCell{ symbol, color }; }
+
+public:
+    // columns x rows tiles (at most MAX_TILES); ascii draws boards with
+    // GLYPH_STYLES characters instead of quadrant blocks
+    Dashboard(int tileColumns, int tileRows, bool asciiBoards);
+
+    // Draws tile (numbered row by row) from a FRAME_WIDTH x FRAME_HEIGHT glyph
+    // grid (see composeBoard) and a line of stats, cut to the tile's width
+    void drawTile(int tile, const Glyph* frame, const char* stats);
+    // Writes text across the top of the dashboard
+    void drawHeader(const char* text);
+    // The escape sequences that take the terminal from what it shows to this
+    // frame; the caller must write all of them before the next refresh
+    const string& refresh();
+    // The terminal was cleared or resized: the next refresh sends everything
+    void redrawAll() { clearFirst = true; }
+
+    int getTileCount() const { return columns * rows; }
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    long long getRefreshes() const { return refreshes; }
+    long long getBytesSent() const { return bytesSent; }
+    long long getCellsSent() const { return cellsSent; }
+    size_t getLastBytes() const { return lastBytes; }
+};
+
+#endif
@@ -0,0 +1,126 @@
+#ifndef DISTANCE_FIELD_H
+#define DISTANCE_FIELD_H
+
+#include <cstdint>
+#include "screen.h"
+#include "cell.h"
+
+// The four cells next to each cell of the board, worked out at compile time.
+// Off the board (without wrapping) they are the extra cell WIDTH * HEIGHT.
+template <bool WRAP>
+struct NeighbourTable {
+    int16_t of[WIDTH * HEIGHT][4];
+
+    constexpr NeighbourTable() : of() {
+        for (int y = 0; y < HEIGHT; y++) {
+            for (int x = 0; x < WIDTH; x++) {
+                int16_t* around = of[y * WIDTH + x];
+                int edge = WIDTH * HEIGHT;
+                int left = x > 0 ? x - 1 : WRAP ? WIDTH - 1 : -1;
+                int right = x < WIDTH - 1 ? x + 1 : WRAP ? 0 : -1;
+                int up = y > 0 ? y - 1 : WRAP ? HEIGHT - 1 : -1;
+                int down = y < HEIGHT - 1 ? y + 1 : WRAP ? 0 : -1;
+                around[0] = static_cast<int16_t>(left < 0 ? edge : y * WIDTH + left);
+                around[1] = static_cast<int16_t>(right < 0 ? edge : y * WIDTH + right);
+                around[2] = static_cast<int16_t>(up < 0 ? edge : up * WIDTH + x);
+                around[3] = static_cast<int16_t>(down < 0 ? edge : down * WIDTH + x);
+            }
+        }
+    }
+};
+
+// Distances from a head, searched on one thread. A stamp names the open
+// cells and the head's position they were searched for (see DistanceField).
+struct DistanceCache {
+    uint64_t stamp; // 0 before the first search
+    long long searches;
+    uint16_t distances[WIDTH * HEIGHT];
+};
+
+// This thread's cache, shared by every field queried on it
+DistanceCache& distanceCache();
+// A stamp no field has had before, on any thread
+uint64_t newDistanceStamp();
+
+// Moves from the snake's head to every cell of the board, for placing items
+// the player can get to in time and for pilots that plan a way around walls.
+//
+// Every cell counts what stands on it (snake segments behind the head,
+// obstacles, maze walls), kept up to date as things move; a cell with nothing
+// is open. The distances are a breadth-first search from the head over the
+// open cells, run again when a distance is asked for and something has
+// changed since the last search: at most once a tick, and only on the ticks
+// something asks (the game itself only does when it places an item).
+//
+// They aren't repaired in place instead: counting from the head, every step
+// changes the distance of about every cell on the board.
+//
+// The body counts as wall, so a distance is how far a cell is with the board
+// as it stands; the real way only gets shorter as the tail moves on.
+//
+// Only the counts are part of the game, so copies stay small. The distances
+// live in a per-thread cache (1.6 KB), tagged with the stamp the field took
+// when a cell last opened or closed or the head moved. Stamps are never
+// reused, so a copy of a field, or a state rewound to, finds the distances
+// searched for the same board still good. One cache entry per thread: asking
+// two fields in turn searches every time.
+template <bool WRAP>
+class DistanceField {
+public:
+    static constexpr int CELLS = WIDTH * HEIGHT;
+    static constexpr uint16_t UNREACHABLE = 0xffff;
+
+private:
+    // Every cell has four neighbours; past the edge it's this one, always
+    // closed, so the search needs no bounds checks
+    static constexpr int EDGE = CELLS;
+    static constexpr NeighbourTable<WRAP> NEIGHBOURS{};
+
+    uint8_t blockers[CELLS + 1]; // Things on each cell; the head's own segment doesn't count
+    int16_t source;              // The head's cell
+    uint64_t stamp;              // New whenever a cell opens or closes or the head moves
+
+    static int index(Cell cell) { return cell.y * WIDTH + cell.x; }
+    static const int16_t* neighbours(int cell) { return NEIGHBOURS.of[cell]; }
+    bool isOpen(int cell) const { return (blockers[cell] == 0) | (cell == source); }
+
+public:
+    DistanceField();
+
+    // Something now stands on, or has left, the cell
+    void addBlocker(Cell cell);
+    void removeBlocker(Cell cell);
+    // The head moved (a step, or a jump through the wall). Block the cell it
+    // left first if the body still covers it.
+    void moveSource(Cell head);
+
+    // All CELLS distances, searched on this thread unless its cache already
+    // holds them; good until a field with another board is asked on this thread
+    const uint16_t* getDistances() const;
+    // O(1) once searched; UNREACHABLE for closed cells and cells cut off from the head
+    uint16_t distanceTo(Cell cell) const { return getDistances()[index(cell)]; }
+    bool isReachable(Cell cell) const { return distanceTo(cell) != UNREACHABLE; }
+    bool isBlocked(Cell cell) const { return blockers[index(cell)] != 0; }
+    // The cell next to the head on a shortest way to target, walking back from
+    // target (so O(distance)); the head's cell if target is unreachable or the head
+    Cell stepTowards(Cell target) const;
+
+    // For Simulation::markTouched(): the count of one cell (none off the
+    // board), and the rest of the field after the counts
+    template <class Mark>
+    void markCell(Cell cell, Mark& mark) const {
+        if (cell.x >= 0 && cell.x < WIDTH && cell.y >= 0 && cell.y < HEIGHT) mark(&blockers[index(cell)], 1);
+    }
+    template <class Mark>
+    void markSource(Mark& mark) const {
+        mark(&source, reinterpret_cast<const char*>(this + 1) - reinterpret_cast<const char*>(&source));
+    }
+
+    // A breadth-first search from the head into out (CELLS distances)
+    void search(uint16_t* out) const;
+    // Searches run on this thread so far, i.e. how often distances were asked
+    // for after a change
+    static long long getSearches() { return distanceCache().searches; }
+};
+
+#endif
@@ -0,0 +1,92 @@
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include <chrono>
+
+// Platform-specific includes
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <unistd.h>
+    #include <signal.h>
+    #include <sys/select.h>
+    #include <sys/ioctl.h>
+    #ifdef __linux__
+        #include <sys/epoll.h>
+        #include <sys/timerfd.h>
+        #include <sys/signalfd.h>
+    #endif
+#endif
+
+using namespace std;
+
+// What woke the loop up. Several things can be ready at once.
+struct LoopEvents {
+    static const int MAX_READY = 8;
+
+    bool input;        // Keyboard bytes are waiting on stdin
+    bool inputClosed;  // stdin hit end of file and is no longer watched
+    int ticks;         // Tick periods that ran out since the last wait (0 while the timer is stopped)
+    bool quit;         // SIGINT or SIGTERM arrived
+    bool resized;      // SIGWINCH: the terminal changed size
+    int readyCount;
+    int ready[MAX_READY]; // Tags of watched descriptors that are ready
+};
+
+// Event loop for the game.
+//
+// wait() blocks until the keyboard, the tick timer, a signal or a watched
+// descriptor needs attention, so no CPU is burnt between ticks, while paused
+// (timer stopped) or on the game over screen. On Linux it is one epoll set
+// over stdin, a timerfd and a signalfd; SIGINT, SIGTERM and SIGWINCH are
+// blocked and read from the signalfd, so the game can restore the terminal
+// on Ctrl+C. Other POSIX systems fall back to select() with a timeout up to
+// the next tick and flag-setting signal handlers; Windows waits on the
+// console input handle.
+class EventLoop {
+public:
+    static const int MAX_WATCHED = 8;
+
+private:
+    int tickIntervalMs; // 0 while the timer is stopped
+    long long wakeups;
+    bool stdinWatched;
+    chrono::steady_clock::time_point nextTick; // Only used by the fallbacks
+
+#ifdef __linux__
+    int epollFd;
+    int timerFd;
+    int signalFd;
+    sigset_t oldMask;
+#elif !defined(_WIN32)
+    int watchedFds[MAX_WATCHED];
+    int watchedTags[MAX_WATCHED];
+    bool watchedForWriting[MAX_WATCHED];
+    int watchedCount;
+    struct sigaction oldActions[3];
+#endif
+
+    void checkStdinClosed(LoopEvents& events);
+
+public:
+    // Create it before starting other threads, so they inherit the blocked signals
+    EventLoop();
+    ~EventLoop();
+
+    // Starts a periodic tick every intervalMs from now, 0 stops the timer
+    void setTickInterval(int intervalMs);
+    int getTickInterval() const { return tickIntervalMs; }
+
+    // Also wake up when fd is readable (or writable), reported as tag (>= 0).
+    // Not available on Windows.
+    bool watch(int fd, int tag, bool forWriting = false);
+    void unwatch(int fd);
+
+    // Blocks until at least one thing is ready
+    LoopEvents wait();
+    long long getWakeups() const { return wakeups; }
+    // False once stdin has closed, or if it can't be watched at all (a regular file)
+    bool isInputOpen() const { return stdinWatched; }
+};
+
+#endif
@@ -0,0 +1,92 @@
+/*
+ * Example controller plugin: heads for the nearest food that isn't poison and
+ * avoids cells that would kill it on the next tick.
+ *
+ * Build:  gcc -O2 -shared -fPIC example_bot.c -o example_bot.so
+ * Run:    ./snake_game --bot=./example_bot.so
+ *
+ * --bot-args=delay=<ms> makes every decision sleep that long first, to watch
+ * the game enforce its time budget.
+ */
+
+#ifndef _WIN32
+    #define _POSIX_C_SOURCE 199309L /* nanosleep under -std=c99 */
+#endif
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "bot_plugin.h"
+
+#ifdef _WIN32
+    #include <windows.h>
+    #define SNAKE_BOT_EXPORT __declspec(dllexport)
+#else
+    #define SNAKE_BOT_EXPORT __attribute__((visibility("default")))
+#endif
+
+typedef struct {
+    int delayMs;
+} ExampleBot;
+
+static void sleepMs(int ms) {
+#ifdef _WIN32
+    Sleep(ms);
+#else
+    struct timespec pause = { ms / 1000, (ms % 1000) * 1000000L };
+    nanosleep(&pause, NULL);
+#endif
+}
+
+static int isDeadly(const SnakeBotView* view, int x, int y) {
+    if (x < 0 || x >= view->width || y < 0 || y >= view->height) return view->mode != 1; /* Wrap mode wraps */
+    int code = view->board[y * view->width + x];
+    return code == SNAKE_BOT_BODY || code == SNAKE_BOT_OBSTACLE || code == SNAKE_BOT_MAZE_WALL;
+}
+
+SNAKE_BOT_EXPORT int snake_bot_init(uint32_t abiVersion, const char* args, void** context) {
+    if (abiVersion != SNAKE_BOT_ABI_VERSION) return 1;
+    ExampleBot* bot = (ExampleBot*)calloc(1, sizeof(ExampleBot));
+    if (!bot) return 1;
+    if (strncmp(args, "delay=", 6) == 0) bot->delayMs = atoi(args + 6);
+    *context = bot;
+    return 0;
+}
+
+SNAKE_BOT_EXPORT int snake_bot_decide(void* context, const SnakeBotView* view) {
+    ExampleBot* bot = (ExampleBot*)context;
+    if (bot->delayMs > 0) sleepMs(bot->delayMs);
+
+    SnakeBotCell head = view->body[0];
+    int targetX = head.x, targetY = head.y, bestDistance = -1;
+    for (int i = 0; i < view->itemCount; i++) {
+        const SnakeBotItem* item = &view->items[i];
+        if (item->type == SNAKE_BOT_POISON_FOOD || item->type == SNAKE_BOT_SHIELD) continue;
+        int distance = abs(item->cell.x - head.x) + abs(item->cell.y - head.y);
+        if (bestDistance < 0 || distance < bestDistance) {
+            bestDistance = distance;
+            targetX = item->cell.x;
+            targetY = item->cell.y;
+        }
+    }
+
+    /* Moves closer to the target first, never straight back */
+    static const int DX[5] = { 0, -1, 1, 0, 0 };
+    static const int DY[5] = { 0, 0, 0, -1, 1 };
+    static const int OPPOSITE[5] = { 0, SNAKE_BOT_RIGHT, SNAKE_BOT_LEFT, SNAKE_BOT_DOWN, SNAKE_BOT_UP };
+    int best = SNAKE_BOT_KEEP, bestScore = 0;
+    for (int move = SNAKE_BOT_LEFT; move <= SNAKE_BOT_DOWN; move++) {
+        if (view->length > 1 && move == OPPOSITE[view->direction]) continue;
+        int x = head.x + DX[move], y = head.y + DY[move];
+        if (isDeadly(view, x, y)) continue;
+        int score = 1000 - abs(targetX - x) - abs(targetY - y);
+        if (best == SNAKE_BOT_KEEP || score > bestScore) {
+            best = move;
+            bestScore = score;
+        }
+    }
+    return best;
+}
+
+SNAKE_BOT_EXPORT void snake_bot_teardown(void* context) {
+    free(context);
+}
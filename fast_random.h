@@ -0,0 +1,41 @@
+#ifndef FAST_RANDOM_H
+#define FAST_RANDOM_H
+
+#include <cstdint>
+
+// Small deterministic random number generator (xorshift32).
+// Each game owns one, so a game is reproducible from its seed and can be
+// copied together with its random state.
+class FastRandom {
+private:
+    uint32_t state;
+
+public:
+    explicit FastRandom(uint32_t seed = 1) { setSeed(seed); }
+
+    void setSeed(uint32_t seed) {
+        // Scramble the seed so nearby seeds give unrelated sequences (xorshift must not start at 0)
+        seed ^= seed >> 16;
+        seed *= 0x7feb352dU;
+        seed ^= seed >> 15;
+        seed *= 0x846ca68bU;
+        seed ^= seed >> 16;
+        state = seed ? seed : 0x9e3779b9U;
+    }
+
+    uint32_t next() {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+
+    // Uniform-ish integer in [0, n)
+    int below(int n) {
+        return static_cast<int>((static_cast<uint64_t>(next()) * static_cast<uint64_t>(n)) >> 32);
+    }
+
+    uint32_t getState() const { return state; }
+};
+
+#endif
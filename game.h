@@ -11,87 +11,252 @@
 #include <string>
 #include <algorithm>
 #include <cmath>
+#include <type_traits>
 #include "input_handler.h"
+#include "key_decoder.h"
 #include "screen.h"
+#include "item_store.h"
+#include "level_generator.h"
+#include "distance_field.h"
+#include "fast_random.h"
+#include "telemetry.h"
+#include "zobrist.h"
+#include "rules.h"
 
 using namespace std;
 
-enum Direction { STOP = 0, LEFT, RIGHT, UP, DOWN };
+enum Direction : unsigned char { STOP = 0, LEFT, RIGHT, UP, DOWN };
+
+// A snake can't turn straight back into its own neck
+inline bool isReverse(Direction dir, Direction current) {
+    return (dir == LEFT && current == RIGHT) || (dir == RIGHT && current == LEFT) ||
+           (dir == UP && current == DOWN) || (dir == DOWN && current == UP);
+}
 
 class Snake {
+public:
+    static const int CAPACITY = WIDTH * HEIGHT;
+
 private:
-    vector<pair<int, int>> body;
+    // Ring buffer of segments: the head is body[headIndex], segment i is
+    // body[(headIndex + i) % CAPACITY]. Moving writes one cell and never
+    // shifts the rest of the body.
+    Cell body[CAPACITY];
+    short headIndex;
+    short length;
+    short growAmount;
     Direction dir;
     Direction nextDir;
     bool grow;
-    int growAmount;
     bool shieldActive; // New: Shield status
-    chrono::steady_clock::time_point shieldStartTime; // New: Shield timer
+    int shieldExpiry; // Game time (ms) when the shield wears off
+    uint64_t hash; // Zobrist keys of the segments and the head, kept up to date by every change
 
 public:
-    Snake(int startX, int startY);
+    Snake(int startX, int startY, Direction startDir = RIGHT);
     void changeDirection(Direction newDir);
     void move();
+    void wrapHead(); // Brings a head that left the board back in on the opposite side
     void setGrow(bool shouldGrow, int amount = 1);
     void shrink(int amount); // New: Method to shrink snake
-    const vector<pair<int, int>>& getBody() const;
-    pair<int, int> getHead() const;
+    Cell getHead() const { return body[headIndex]; }
+    Cell getSegment(int index) const { return body[(headIndex + index) % CAPACITY]; }
+    // True if any segment from firstSegment (0 = head) to the tail is on the cell
+    bool occupies(Cell cell, int firstSegment = 0) const;
+    Direction getDirection() const;
     int getLength() const;
+    // Segments still to grow by
+    int getGrowth() const { return grow ? growAmount : 0; }
+    uint64_t getHash() const { return hash; }
     
-    // New: Shield methods
-    void activateShield();
+    // New: Shield methods (times are game time in ms)
+    void activateShield(int until);
     void deactivateShield();
     bool hasShield() const;
-    int getShieldTimeRemaining() const;
-    bool shouldBlink() const; // For blinking effect
-    // MODIFIED: Use steady_clock's native duration type
-    void adjustShieldStartTime(chrono::steady_clock::duration pauseDuration); 
+    int getShieldExpiry() const;
+    int getShieldTimeRemaining(int now) const;
+    bool shouldBlink(int now) const; // For blinking effect
+
+    // Calls mark(at, bytes) on every part of the snake that can differ from
+    // before, the snake some moves ago: the ring slots from the head to the
+    // old head, and the fields after the ring
+    template <class Mark>
+    void markTouched(const Snake& before, Mark& mark) const;
 };
 
-class Game {
+// Why a game ended
+enum DeathCause : unsigned char { DEATH_NONE = 0, DEATH_WALL, DEATH_SELF, DEATH_OBSTACLE, DEATH_RIVAL };
+
+// The game rules and state, without any terminal or file I/O.
+//
+// Instantiated once per rule set (see rules.h). Time is game time: the clock
+// advances by one tick length on every update(), so timers freeze while the
+// game is paused and a game is fully reproducible from its seed and inputs.
+//
+// The state is plain fixed-size data (no heap, trivially copyable), sized by
+// the rule set, so games can be copied with memcpy and packed by the million.
+template <class Rules>
+class Simulation {
+public:
+    typedef ItemStore<Rules::ITEM_CAPACITY> Items;
+
 private:
+    static const int CELLS = WIDTH * HEIGHT;
+    static const int MAX_OBSTACLES = Rules::OBSTACLES ? Rules::OBSTACLE_COUNT : 1;
+
     Snake snake;
-    pair<int, int> food;
-    pair<int, int> specialFood;
-    pair<int, int> poisonFood; // New: Poison food
-    pair<int, int> shield; // New: Shield power-up
+    Items items; // Food, special food, poison food and shield pick-ups
+    unsigned char mazeWalls[Rules::MAZE ? CELLS : 1]; // One flag per cell, only used by maze rules
+    DistanceField<Rules::WRAP_WALLS> field; // From the head, for spawning and for pilots
+    Cell obstacles[MAX_OBSTACLES];
+    FastRandom rng;
+    uint32_t seed; // What the game started from, for replays
+    uint64_t wallHash; // Zobrist keys of the maze walls and the obstacles that are up
+    int timeMs; // Game time
     int score;
-    bool gameOver;
-    bool quit;
-    bool paused; // New: Pause state
-    Screen screen;
     int foodEaten;
     int specialFoodEaten; // New: Counter for special food
     int poisonFoodEaten; // New: Counter for poison food
-    bool specialFoodActive;
-    bool poisonFoodActive; // New: Poison food status
-    bool shieldActive; // New: Shield power-up status
-    chrono::steady_clock::time_point specialFoodSpawnTime;
-    chrono::steady_clock::time_point poisonFoodSpawnTime; // New: Poison food timer
-    chrono::steady_clock::time_point shieldSpawnTime; // New: Shield spawn timer
-    chrono::steady_clock::time_point lastShieldSpawnTime; // New: Last shield spawn time
-    
-    // ADDED: Pause tracking variable
-    chrono::steady_clock::time_point pauseStartTime;
-
-    const int SPECIAL_FOOD_DURATION = 10;
-    const int POISON_FOOD_DURATION = 10; // New: Poison food duration
-    const int SHIELD_DURATION = 10; // New: Shield power-up duration
-    const int SHIELD_SPAWN_INTERVAL = 45; // Changed: Shield spawn interval to 60 seconds
-    pair<int, int> crashPosition;
+    int lastShieldSpawnTime; // New: Last shield spawn time
+    int specialFoodSpawned; // Picks the special food glyph, which rotates with every spawn
+    int shieldsCollected;
+    int tickCount;
+    int obstacleExpiry;
+    short obstacleCount;
+    Cell crashPosition;
+    DeathCause deathCause;
+    bool gameOver;
     bool wallCrash;
-
-    // Obstacle members
-    const int OBSTACLE_DURATION = 10;
-    const int OBSTACLE_COUNT = 7;
-    vector<pair<int, int>> obstacles;
-    chrono::steady_clock::time_point obstacleSpawnTime;
     bool obstaclesActive;
+    bool reachChecks; // Items only go where the head can get to (in time)
+
+    static const int FREE_CELL_GUESSES = 32; // Random tries before the free cells are counted
+
+    // Helper methods
+    bool findFreeCell(Cell& cell, int maxDistance);
+    void trackMove(Cell oldHead, Cell oldTail, int oldLength);
+    bool spawnItem(ItemType type, int durationSeconds); // durationSeconds <= 0 means it never expires
+    void consumeItem(int slot);
+    void spawnObstacles();
+    void clearObstacles();
+    void updateShield(); // New: Update shield power-up
+    void updateObstacles();
+    void endGame(DeathCause cause);
+
+public:
+    explicit Simulation(uint32_t seed);
+
+    void changeDirection(Direction newDir) { snake.changeDirection(newDir); }
+    void update();
+    // Restarts the random generator, so copies of a game (e.g. search
+    // rollouts) sample future spawns instead of replaying the real ones
+    void reseed(uint32_t seed) { rng.setSeed(seed); }
+    // True if moving this way would kill the snake on the next tick, not
+    // counting the shield or anything that spawns in the meantime
+    bool wouldCollide(Direction dir) const;
+
+    const Snake& getSnake() const { return snake; }
+    const Items& getItems() const { return items; }
+    const Cell* getObstacles() const { return obstacles; }
+    int getObstacleCount() const { return obstaclesActive ? obstacleCount : 0; }
+    bool isObstacle(Cell cell) const;
+    bool isMazeWall(Cell cell) const;
+    bool hasObstacles() const { return obstaclesActive; }
+    // Moves from the head to every cell, searched on the first query after a change
+    const DistanceField<Rules::WRAP_WALLS>& getDistanceField() const { return field; }
+    // For copies that don't need fair spawns (search playouts): items go on
+    // any free cell, without a search
+    void skipReachChecks() { reachChecks = false; }
+    int getTime() const { return timeMs; }
+    int getScore() const { return score; }
+    int getFoodEaten() const { return foodEaten; }
+    int getSpecialFoodEaten() const { return specialFoodEaten; }
+    int getPoisonFoodEaten() const { return poisonFoodEaten; }
+    int getSpecialFoodSpawned() const { return specialFoodSpawned; }
+    int getShieldsCollected() const { return shieldsCollected; }
+    int getTickCount() const { return tickCount; }
+    bool isGameOver() const { return gameOver; }
+    DeathCause getDeathCause() const { return deathCause; }
+    bool isWallCrash() const { return wallCrash; }
+    Cell getCrashPosition() const { return crashPosition; }
+    int getGameSpeed() const;
+    uint32_t getSeed() const { return seed; }
+
+    // Zobrist hash of the position: the snake's cells and direction, the
+    // shield, the items and the walls. Kept up to date as the game changes,
+    // so reading it is O(1); equal positions reached in different ways hash
+    // the same (for transposition tables).
+    uint64_t getPositionHash() const {
+        return snake.getHash() ^ items.getHash() ^ wallHash ^ ZOBRIST.direction[snake.getDirection()] ^
+               (snake.hasShield() ? ZOBRIST.shield : 0);
+    }
+    // The position hash plus everything else that decides how the game goes
+    // on (time, score, counters, timers, the random generator), for checking
+    // that two runs of a game are still in step. Also O(1).
+    uint64_t getStateHash() const;
+    // getPositionHash() worked out from scratch, to check the incremental one
+    uint64_t rehashPosition() const;
+    // Calls mark(at, bytes) on every part of this state the last update() can
+    // have changed, given the state before it (ranges may repeat). The rest,
+    // most of the ring, the board-sized arrays and the maze, is as it was.
+    // For RewindBuffer, which keeps only what changed.
+    template <class Mark>
+    void markTouched(const Simulation& before, Mark&& mark) const;
+    // Telemetry row for the game so far; startTime and flags are left for the caller
+    SessionRecord getSessionRecord() const;
+
+    // Timer calculation helpers (for drawing stats), in whole seconds
+    int getItemTimeRemaining(ItemType type) const;
+    int getShieldSpawnRemaining() const;
+    int getObstacleTimeRemaining() const;
+};
+
+// The path pilot: the first step of a shortest path, by the distance field,
+// to the nearest item that isn't poison. When there's none, or that step
+// isn't safe, the first safe way of going on, right, down, left or up.
+template <class Rules>
+Direction pathTowardsNearestItem(const Simulation<Rules>& sim);
+
+// The glyph grid a board is drawn from: the board plus its outer wall
+const int FRAME_WIDTH = WIDTH + 2;
+const int FRAME_HEIGHT = HEIGHT + 2;
+
+// Lays a game out as FRAME_WIDTH x FRAME_HEIGHT glyphs, row by row, for any
+// renderer. Board cell (x, y) is frame cell (x + 1, y + 1).
+template <class Rules>
+void composeBoard(const Simulation<Rules>& sim, Glyph* frame);
+
+template <class Rules> class Autopilot;
+template <class Rules> class RewindBuffer;
+class BotHost;
+class BackgroundIO;
+
+// The terminal front end: owns a Simulation and adds drawing, keyboard input,
+// pausing and the high score file.
+template <class Rules>
+class BasicGame {
+private:
+    static const int INPUT_BUFFER_SIZE = 64;
+    static const int MAX_QUEUED_TURNS = 2;
+    static const int REWIND_REPEAT_MS = 600; // Rewind keys closer than this count as the key held down
+    static const int MAX_REWIND_STEP = 16;   // Ticks
 
-    // Speed control
-    int baseSpeed = 200;
-    int minSpeed = 75;
-    int speedDecrement = 9;
+    Simulation<Rules> sim;
+    bool quit;
+    bool paused; // New: Pause state
+    KeyDecoder keys;
+    // The first turn in a tick takes effect right away, quick follow-ups
+    // (e.g. up, left for a U-turn) wait for the next ticks instead of being lost
+    Direction queuedTurns[MAX_QUEUED_TURNS];
+    int queuedTurnCount;
+    bool turnedThisTick;
+    Autopilot<Rules>* autopilot; // Steers the snake when set (not owned)
+    BotHost* bot;                // Plugin controller, steers when set (not owned)
+    BackgroundIO* io;            // Writes the high score file when set (not owned)
+    RewindBuffer<Rules>* rewind; // Practice mode: keeps recent ticks for the rewind key (not owned)
+    int rewindPresses;           // Rewind keys in a row, which go further back each time
+    uint64_t lastRewindNs;
+    Screen screen;
 
     // --- HIGH SCORE ADDITIONS ---
     // Variable to hold the loaded high score
@@ -100,34 +265,31 @@ private:
     const string HIGHSCORE_FILE = "highscore.txt";
     // ----------------------------
 
-    // Helper methods
-    bool isObstacle(int x, int y) const;
-    void spawnFood();
-    void spawnSpecialFood();
-    void spawnPoisonFood(); // New: Spawn poison food
-    void spawnShield(); // New: Spawn shield power-up
-    void spawnObstacles();
-    void updateSpecialFood();
-    void updatePoisonFood(); // New: Update poison food
-    void updateShield(); // New: Update shield power-up
-    void updateObstacles();
-    
-    // Timer calculation helpers (for drawing stats)
-    int getSpecialFoodTimeRemaining() const; // ADDED
-    int getShieldSpawnRemaining() const;     // ADDED
-    int getObstacleTimeRemaining() const;
-
 public:
-    Game();
-    ~Game();
+    BasicGame();
+    ~BasicGame();
     void draw();
     void update();
     void handleInput();
     bool isGameOver() const;
     bool shouldQuit() const;
     bool isPaused() const; // New: Get pause state
-    void togglePause(); // MODIFIED: Logic updated to handle timer compensation
+    void togglePause();
     int getGameSpeed();
+    void turn(Direction dir);
+    // Practice mode: pauses and goes back a tick, or more if the key is held
+    void stepBack();
+    long long getKeysDecoded() const { return keys.getKeysDecoded(); }
+    void setAutopilot(Autopilot<Rules>* pilot) { autopilot = pilot; }
+    void setBot(BotHost* host) { bot = host; }
+    void setBackgroundIO(BackgroundIO* backgroundIO) { io = backgroundIO; }
+    // Practice mode: a game over can be rewound, so it doesn't end the game,
+    // and the high score is left alone
+    void setRewind(RewindBuffer<Rules>* buffer);
+    void setRenderMode(RenderMode mode) { screen.setRenderMode(mode); }
+    RenderMode getRenderMode() const { return screen.getRenderMode(); }
+    Screen& getScreen() { return screen; }
+    const Simulation<Rules>& getSimulation() const { return sim; }
 
     // --- HIGH SCORE METHODS ---
     // Loads the score from the file
@@ -137,4 +299,9 @@ public:
     // --------------------------
 };
 
+// The classic game
+typedef BasicGame<ClassicRules> Game;
+
+static_assert(is_trivially_copyable<Simulation<ClassicRules>>::value, "Game state must stay memcpy-able");
+
 #endif
@@ -1,6 +1,24 @@
 #include "input_handler.h"
 #include "screen.h"
 #include "game.h"
+#include "level_generator.h"
+#include "alloc_stats.h"
+#include "autopilot.h"
+#include "event_loop.h"
+#include "key_decoder.h"
+#include "telemetry.h"
+#include "shared_state.h"
+#include "bot_host.h"
+#include "arena.h"
+#include "metrics.h"
+#include "zobrist.h"
+#include "replay.h"
+#include "background_io.h"
+#include "world.h"
+#include "versus.h"
+#include "session_server.h"
+#include "rewind.h"
+#include "dashboard.h"
 #include <iostream>
 #include <vector>
 #include <cstdlib>
@@ -13,6 +31,40 @@
 #include <cmath>
 #include <stdexcept> // Added for exception handling with stoi
 #include <iomanip>   // For formatted output
+#include <atomic>
+#include <new>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <cstdio>
+#include <fcntl.h>
+#ifdef _WIN32
+    #include <io.h>
+    #include <sys/stat.h>
+#else
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <dlfcn.h>
+    #include <poll.h>
+    #include <sys/socket.h>
+    #include <netinet/in.h>
+    #include <arpa/inet.h>
+    #include <netdb.h>
+    #include <sys/ioctl.h>
+#endif
+#ifdef __linux__
+    #include <sys/syscall.h>
+    #include <sys/eventfd.h>
+    #include <sys/un.h>
+    #include <sys/resource.h>
+    #include <netinet/tcp.h>
+    #include <linux/version.h>
+    // Raw io_uring, no liburing: needs the headers of a kernel with IORING_OP_RENAMEAT
+    #if defined(__NR_io_uring_setup) && LINUX_VERSION_CODE >= KERNEL_VERSION(5, 11, 0)
+        #include <linux/io_uring.h>
+        #define SNAKE_HAVE_URING
+    #endif
+#endif
 
 using namespace std;
 
@@ -26,11 +78,142 @@ string FOOD_EMOJI = "🍎";
 string SPECIAL_FOOD_EMOJI = "🍇";
 string POISON_FOOD_EMOJI = "🍄"; // New: Poison food emoji
 string SHIELD_EMOJI = "🛡️"; // New: Shield power-up emoji
+string RIVAL_HEAD = "🐲";
+string RIVAL_BODY = "🔵";
 string WALL = "⬜";
 string EMPTY_SPACE = "  ";
 
-vector<string> SPECIAL_FOODS = {"🍇", "🍌", "🍋"};
-int currentSpecialFoodIndex = 0;
+const vector<string> SPECIAL_FOODS = {"🍇", "🍌", "🍋"};
+
+// AllocStats implementation
+static atomic<unsigned long long> allocCounts[PHASE_COUNT];
+static atomic<unsigned long long> allocBytes[PHASE_COUNT];
+static atomic<unsigned long long> freeCounts[PHASE_COUNT];
+static unsigned long long tickStartCounts[PHASE_COUNT];
+static unsigned long long lastTickCounts[PHASE_COUNT];
+static unsigned long long tickCount = 0;
+static thread_local AllocPhase currentAllocPhase = PHASE_OTHER;
+
+AllocPhase AllocStats::setPhase(AllocPhase phase) {
+    AllocPhase previous = currentAllocPhase;
+    currentAllocPhase = phase;
+    return previous;
+}
+
+AllocPhase AllocStats::getPhase() {
+    return currentAllocPhase;
+}
+
+void AllocStats::recordAllocation(size_t bytes) {
+    allocCounts[currentAllocPhase].fetch_add(1, memory_order_relaxed);
+    allocBytes[currentAllocPhase].fetch_add(bytes, memory_order_relaxed);
+}
+
+void AllocStats::recordFree() {
+    freeCounts[currentAllocPhase].fetch_add(1, memory_order_relaxed);
+}
+
+unsigned long long AllocStats::getAllocations(AllocPhase phase) {
+    return allocCounts[phase].load(memory_order_relaxed);
+}
+
+unsigned long long AllocStats::getBytes(AllocPhase phase) {
+    return allocBytes[phase].load(memory_order_relaxed);
+}
+
+unsigned long long AllocStats::getFrees(AllocPhase phase) {
+    return freeCounts[phase].load(memory_order_relaxed);
+}
+
+unsigned long long AllocStats::getTotalAllocations() {
+    unsigned long long total = 0;
+    for (int phase = 0; phase < PHASE_COUNT; phase++) {
+        total += getAllocations(static_cast<AllocPhase>(phase));
+    }
+    return total;
+}
+
+void AllocStats::endTick() {
+    for (int phase = 0; phase < PHASE_COUNT; phase++) {
+        unsigned long long now = getAllocations(static_cast<AllocPhase>(phase));
+        lastTickCounts[phase] = now - tickStartCounts[phase];
+        tickStartCounts[phase] = now;
+    }
+    tickCount++;
+}
+
+unsigned long long AllocStats::getLastTickAllocations(AllocPhase phase) {
+    return lastTickCounts[phase];
+}
+
+unsigned long long AllocStats::getTicks() {
+    return tickCount;
+}
+
+const char* AllocStats::phaseName(AllocPhase phase) {
+    static const char* const names[PHASE_COUNT] = { "other", "input", "update", "draw", "flush" };
+    return names[phase];
+}
+
+void AllocStats::printSummary(ostream& out) {
+    if (!enabled()) return;
+    out << "Heap allocations by phase (" << tickCount << " ticks):" << endl;
+    for (int i = 0; i < PHASE_COUNT; i++) {
+        AllocPhase phase = static_cast<AllocPhase>(i);
+        double perTick = tickCount ? (double)getAllocations(phase) / tickCount : 0.0;
+        out << "  " << left << setw(8) << phaseName(phase) << right
+            << setw(10) << getAllocations(phase) << " allocs"
+            << setw(12) << getBytes(phase) << " bytes"
+            << setw(10) << getFrees(phase) << " frees"
+            << setw(10) << fixed << setprecision(2) << perTick << " allocs/tick" << endl;
+    }
+}
+
+#ifdef SNAKE_ALLOC_STATS
+// Counting replacements for the global allocation functions
+static void* countedAlloc(size_t size) {
+    AllocStats::recordAllocation(size);
+    void* p = malloc(size ? size : 1);
+    if (!p) throw bad_alloc();
+    return p;
+}
+
+static void* countedAlignedAlloc(size_t size, align_val_t alignment) {
+    AllocStats::recordAllocation(size);
+    size_t align = static_cast<size_t>(alignment);
+    void* p = aligned_alloc(align, ((size ? size : 1) + align - 1) / align * align);
+    if (!p) throw bad_alloc();
+    return p;
+}
+
+static void countedFree(void* p) {
+    if (!p) return;
+    AllocStats::recordFree();
+    free(p);
+}
+
+void* operator new(size_t size) { return countedAlloc(size); }
+void* operator new[](size_t size) { return countedAlloc(size); }
+void* operator new(size_t size, const nothrow_t&) noexcept {
+    try { return countedAlloc(size); } catch (...) { return nullptr; }
+}
+void* operator new[](size_t size, const nothrow_t&) noexcept {
+    try { return countedAlloc(size); } catch (...) { return nullptr; }
+}
+void* operator new(size_t size, align_val_t alignment) { return countedAlignedAlloc(size, alignment); }
+void* operator new[](size_t size, align_val_t alignment) { return countedAlignedAlloc(size, alignment); }
+
+void operator delete(void* p) noexcept { countedFree(p); }
+void operator delete[](void* p) noexcept { countedFree(p); }
+void operator delete(void* p, size_t) noexcept { countedFree(p); }
+void operator delete[](void* p, size_t) noexcept { countedFree(p); }
+void operator delete(void* p, const nothrow_t&) noexcept { countedFree(p); }
+void operator delete[](void* p, const nothrow_t&) noexcept { countedFree(p); }
+void operator delete(void* p, align_val_t) noexcept { countedFree(p); }
+void operator delete[](void* p, align_val_t) noexcept { countedFree(p); }
+void operator delete(void* p, size_t, align_val_t) noexcept { countedFree(p); }
+void operator delete[](void* p, size_t, align_val_t) noexcept { countedFree(p); }
+#endif
 
 // Initialize static members for non-Windows systems
 #ifndef _WIN32
@@ -38,6 +221,8 @@ struct termios InputHandler::oldt;
 struct termios InputHandler::newt;
 bool InputHandler::rawModeEnabled = false;
 #endif
+long long InputHandler::readCalls = 0;
+long long InputHandler::bytesRead = 0;
 
 // InputHandler implementation
 void InputHandler::enableRawInput() {
@@ -91,919 +276,6176 @@ int InputHandler::getChar() {
 #endif
 }
 
-// Screen implementation
-void Screen::clear() {
-    screenBuffer.clear();
-    screenBuffer += "\033[H";
+int InputHandler::readAvailable(unsigned char* buffer, int capacity) {
+    int count = 0;
+#ifdef _WIN32
+    while (count < capacity && _kbhit()) {
+        buffer[count++] = static_cast<unsigned char>(_getch());
+    }
+#else
+    ssize_t result = read(STDIN_FILENO, buffer, capacity);
+    if (result > 0) count = static_cast<int>(result);
+#endif
+    readCalls++;
+    bytesRead += count;
+    return count;
 }
 
-void Screen::addToBuffer(const string& content) {
-    screenBuffer += content;
+// Telemetry implementation
+const int TELEMETRY_COLUMN_WIDTHS[COLUMN_COUNT] = { 4, 1, 1, 1, 1, 4, 2, 2, 2, 2, 2, 4, 4 };
+const char* const TELEMETRY_COLUMN_NAMES[COLUMN_COUNT] = {
+    "start_time", "mode", "death_cause", "flags", "final_speed", "score", "length",
+    "food", "special_food", "poison_food", "shields", "ticks", "game_time_ms"
+};
+
+// Where each column's value lives in a SessionRecord
+static const size_t TELEMETRY_FIELD_OFFSETS[COLUMN_COUNT] = {
+    offsetof(SessionRecord, startTime), offsetof(SessionRecord, mode), offsetof(SessionRecord, deathCause),
+    offsetof(SessionRecord, flags), offsetof(SessionRecord, finalSpeed), offsetof(SessionRecord, score),
+    offsetof(SessionRecord, length), offsetof(SessionRecord, foodEaten), offsetof(SessionRecord, specialFoodEaten),
+    offsetof(SessionRecord, poisonFoodEaten), offsetof(SessionRecord, shieldsCollected),
+    offsetof(SessionRecord, ticks), offsetof(SessionRecord, gameTimeMs)
+};
+
+static size_t paddedColumnSize(uint32_t rowCount, int column) {
+    return (static_cast<size_t>(rowCount) * TELEMETRY_COLUMN_WIDTHS[column] + 7) & ~static_cast<size_t>(7);
 }
 
-void Screen::draw() {
-    cout << "\033[H" << screenBuffer;
-    cout.flush();
+size_t telemetryBlockSize(uint32_t rowCount) {
+    return telemetryColumnOffset(rowCount, COLUMN_COUNT);
 }
 
-void Screen::hideCursor() {
+size_t telemetryColumnOffset(uint32_t rowCount, int column) {
+    size_t offset = sizeof(TelemetryBlockHeader);
+    for (int i = 0; i < column; i++) {
+        offset += paddedColumnSize(rowCount, i);
+    }
+    return offset;
+}
+
+void encodeTelemetryBlock(const SessionRecord* records, uint32_t count, vector<char>& out) {
+    size_t start = out.size();
+    out.resize(start + telemetryBlockSize(count), 0);
+    char* block = out.data() + start;
+
+    TelemetryBlockHeader header;
+    memcpy(header.magic, TELEMETRY_MAGIC, sizeof(header.magic));
+    header.version = TELEMETRY_VERSION;
+    header.columnCount = COLUMN_COUNT;
+    header.rowCount = count;
+    header.byteSize = static_cast<uint32_t>(telemetryBlockSize(count));
+    memcpy(block, &header, sizeof(header));
+
+    for (int column = 0; column < COLUMN_COUNT; column++) {
+        int width = TELEMETRY_COLUMN_WIDTHS[column];
+        char* values = block + telemetryColumnOffset(count, column);
+        for (uint32_t row = 0; row < count; row++) {
+            memcpy(values + row * width, reinterpret_cast<const char*>(&records[row]) + TELEMETRY_FIELD_OFFSETS[column], width);
+        }
+    }
+}
+
+void decodeTelemetryRow(const char* block, uint32_t rowCount, uint32_t row, SessionRecord& record) {
+    record = SessionRecord();
+    for (int column = 0; column < COLUMN_COUNT; column++) {
+        int width = TELEMETRY_COLUMN_WIDTHS[column];
+        memcpy(reinterpret_cast<char*>(&record) + TELEMETRY_FIELD_OFFSETS[column],
+               block + telemetryColumnOffset(rowCount, column) + static_cast<size_t>(row) * width, width);
+    }
+}
+
+bool isValidTelemetryBlock(const char* data, size_t size, size_t offset) {
+    if (offset + sizeof(TelemetryBlockHeader) > size) return false;
+    TelemetryBlockHeader header;
+    memcpy(&header, data + offset, sizeof(header));
+    return memcmp(header.magic, TELEMETRY_MAGIC, sizeof(header.magic)) == 0 &&
+           header.version == TELEMETRY_VERSION && header.columnCount == COLUMN_COUNT &&
+           header.byteSize == telemetryBlockSize(header.rowCount) && offset + header.byteSize <= size;
+}
+
+TelemetryWriter::TelemetryWriter(const string& logPath, BackgroundIO& backgroundIO) : path(logPath), io(backgroundIO),
+             written(0), failures(0) {}
+
+TelemetryWriter::~TelemetryWriter() {
+    io.flush(); // The callbacks below use this writer
+}
+
+// One block per record, appended with a single write so it lands in one piece
+void TelemetryWriter::append(const SessionRecord& record) {
+    vector<char> block;
+    encodeTelemetryBlock(&record, 1, block);
+    io.append(path, string(block.begin(), block.end()), [this](bool ok, const string&) {
+        (ok ? written : failures).fetch_add(1, memory_order_relaxed);
+    });
+}
+
+// BackgroundIO implementation
+#ifdef SNAKE_HAVE_URING
+struct BackgroundIO::Ring {
+    int fd;
+    void* sqMap;
+    size_t sqMapSize;
+    void* cqMap;
+    size_t cqMapSize;
+    io_uring_sqe* sqes;
+    size_t sqesSize;
+    unsigned* sqHead;
+    unsigned* sqTail;
+    unsigned* sqArray;
+    unsigned sqMask;
+    unsigned sqEntries;
+    unsigned* cqHead;
+    unsigned* cqTail;
+    io_uring_cqe* cqes;
+    unsigned cqMask;
+};
+#else
+struct BackgroundIO::Ring {};
+#endif
+
+BackgroundIO::BackgroundIO(bool useUring) : ring(nullptr), stopping(false), syncRequested(false), queuedCount(0),
+             doneCount(0), completed(0), failures(0), fsyncs(0), submissions(0) {
+    if (useUring) openRing();
+    worker = thread(&BackgroundIO::run, this);
+}
+
+BackgroundIO::~BackgroundIO() {
+    {
+        lock_guard<mutex> lock(queueMutex);
+        stopping = true;
+    }
+    queueReady.notify_one();
+    worker.join();
+    for (auto& file : appendFiles) {
 #ifdef _WIN32
-    HANDLE consoleHandle = GetStdHandle(STD_OUTPUT_HANDLE);
-    CONSOLE_CURSOR_INFO info;
-    info.dwSize = 100;
-    info.bVisible = FALSE;
-    SetConsoleCursorInfo(consoleHandle, &info);
+        _close(file.second.fd);
 #else
-    cout << "\033[?25l";
+        close(file.second.fd);
 #endif
+    }
+    closeRing();
 }
 
-void Screen::showCursor() {
+void BackgroundIO::append(const string& path, string data, IoCallback done) {
+    enqueue(REQUEST_APPEND, path, move(data), move(done));
+}
+
+void BackgroundIO::replace(const string& path, string data, IoCallback done) {
+    enqueue(REQUEST_REPLACE, path, move(data), move(done));
+}
+
+void BackgroundIO::enqueue(RequestType type, const string& path, string&& data, IoCallback&& done) {
+    {
+        lock_guard<mutex> lock(queueMutex);
+        queue.push_back(Request());
+        Request& request = queue.back();
+        request.type = type;
+        request.path = path;
+        request.data = move(data);
+        request.done = move(done);
+        queuedCount++;
+    }
+    queueReady.notify_one();
+}
+
+void BackgroundIO::flush() {
+    unique_lock<mutex> lock(queueMutex);
+    long long target = queuedCount;
+    syncRequested = true;
+    queueReady.notify_one();
+    queueDone.wait(lock, [&] { return doneCount >= target && !syncRequested; });
+}
+
+void BackgroundIO::run() {
+    vector<Request> batch;
+    while (true) {
+        bool syncAll;
+        {
+            unique_lock<mutex> lock(queueMutex);
+            // Sleep until there is work, or until the oldest unsynced append is due its fsync
+            auto due = chrono::steady_clock::time_point::max();
+            for (auto& file : appendFiles) {
+                if (file.second.dirty) due = min(due, file.second.lastSync + chrono::milliseconds(SYNC_INTERVAL_MS));
+            }
+            auto ready = [&] { return stopping || syncRequested || !queue.empty(); };
+            if (due == chrono::steady_clock::time_point::max()) {
+                queueReady.wait(lock, ready);
+            } else {
+                queueReady.wait_until(lock, due, ready);
+            }
+            batch.swap(queue);
+            syncAll = stopping || syncRequested;
+        }
+
+        process(batch, syncAll);
+
+        bool finished;
+        {
+            lock_guard<mutex> lock(queueMutex);
+            doneCount += batch.size();
+            // A flush that came in while this batch ran still gets its own pass
+            if (syncAll && queue.empty()) syncRequested = false;
+            finished = stopping && queue.empty();
+        }
+        queueDone.notify_all();
+        batch.clear();
+        if (finished) return;
+    }
+}
+
+static int openForIo(const string& path, bool append) {
 #ifdef _WIN32
-    HANDLE consoleHandle = GetStdHandle(STD_OUTPUT_HANDLE);
-    CONSOLE_CURSOR_INFO info;
-    info.dwSize = 100;
-    info.bVisible = TRUE;
-    SetConsoleCursorInfo(consoleHandle, &info);
+    return _open(path.c_str(), _O_WRONLY | _O_CREAT | _O_BINARY | (append ? _O_APPEND : _O_TRUNC),
+                 _S_IREAD | _S_IWRITE);
 #else
-    cout << "\033[?25h";
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC | (append ? O_APPEND : O_TRUNC), 0644);
+    return fd < 0 ? -errno : fd;
 #endif
 }
 
-void setupConsole() {
+static void closeForIo(int fd) {
 #ifdef _WIN32
-    SetConsoleOutputCP(65001);
-    HANDLE hOut = GetStdHandle(STD_OUTPUT_HANDLE);
-    DWORD dwMode = 0;
-    GetConsoleMode(hOut, &dwMode);
-    dwMode |= ENABLE_VIRTUAL_TERMINAL_PROCESSING;
-    SetConsoleMode(hOut, dwMode);
+    _close(fd);
 #else
-    setlocale(LC_ALL, "en_US.UTF-8");
+    close(fd);
 #endif
 }
 
-bool loadCustomGraphics() {
-    bool loaded = false;
-    
-    ifstream headFile("head.txt");
-    if (headFile.is_open()) {
-        string line;
-        if (getline(headFile, line)) {
-            if (!line.empty()) {
-                SNAKE_HEAD = line;
-                loaded = true;
+// Directory holding path, for fsyncing a rename into it
+static string directoryOf(const string& path) {
+    size_t slash = path.find_last_of('/');
+    if (slash == string::npos) return ".";
+    return slash == 0 ? "/" : path.substr(0, slash);
+}
+
+// Turns the batch into steps, runs them and reports back
+void BackgroundIO::process(vector<Request>& batch, bool syncAll) {
+    vector<Step> steps;
+    vector<string> errors(batch.size());
+    vector<int> tempFds(batch.size(), -1), dirFds(batch.size(), -1);
+    vector<string> tempPaths(batch.size());
+    auto now = chrono::steady_clock::now();
+    auto addStep = [&](Step::Kind kind, int fd, int request) -> Step& {
+        Step step = Step();
+        step.kind = kind;
+        step.fd = fd;
+        step.request = request;
+        step.result = -ECANCELED; // Until it runs
+        steps.push_back(step);
+        return steps.back();
+    };
+
+    // Appends: one chain per file, in the order they were queued, ending in
+    // the file's fsync when that is due
+    map<string, vector<int>> appendsByPath;
+    for (size_t i = 0; i < batch.size(); i++) {
+        if (batch[i].type == REQUEST_APPEND) appendsByPath[batch[i].path].push_back(static_cast<int>(i));
+    }
+    auto syncDue = [&](const AppendFile& file) {
+        return syncAll || now - file.lastSync >= chrono::milliseconds(SYNC_INTERVAL_MS);
+    };
+    for (auto& group : appendsByPath) {
+        auto found = appendFiles.find(group.first);
+        if (found == appendFiles.end()) {
+            int fd = openForIo(group.first, true);
+            submissions.fetch_add(1, memory_order_relaxed);
+            if (fd < 0) {
+                for (int request : group.second) errors[request] = "can't open " + group.first + ": " + strerror(-fd);
+                continue;
             }
+            AppendFile file = { fd, false, now };
+            found = appendFiles.emplace(group.first, file).first;
+        }
+        for (int request : group.second) {
+            Step& write = addStep(Step::WRITE, found->second.fd, request);
+            write.offset = -1;
+            write.data = &batch[request].data;
+            write.link = true;
+        }
+        found->second.dirty = true;
+        if (syncDue(found->second)) {
+            addStep(Step::FSYNC, found->second.fd, -1);
+            found->second.dirty = false;
+            found->second.lastSync = now;
+        } else {
+            steps.back().link = false;
         }
-        headFile.close();
     }
-    
-    ifstream bodyFile("body.txt");
-    if (bodyFile.is_open()) {
-        string line;
-        if (getline(bodyFile, line)) {
-            if (!line.empty()) {
-                SNAKE_BODY = line;
-                loaded = true;
-            }
+    // Files written by earlier batches whose fsync is due now
+    for (auto& file : appendFiles) {
+        if (file.second.dirty && syncDue(file.second)) {
+            addStep(Step::FSYNC, file.second.fd, -1);
+            file.second.dirty = false;
+            file.second.lastSync = now;
         }
-        bodyFile.close();
     }
 
-    ifstream specialFoodFile("food.txt");
-    if (specialFoodFile.is_open()) {
-        string line;
-        if (getline(specialFoodFile, line)) {
-            if (!line.empty()) {
-                SPECIAL_FOOD_EMOJI = line;
-                loaded = true;
-            }
+    // Replaces: only the last one of each file counts; each is write, fsync, rename, directory fsync
+    map<string, int> lastReplace;
+    for (size_t i = 0; i < batch.size(); i++) {
+        if (batch[i].type == REQUEST_REPLACE) lastReplace[batch[i].path] = static_cast<int>(i);
+    }
+    for (auto& last : lastReplace) {
+        int request = last.second;
+        tempPaths[request] = last.first + ".tmp";
+        int fd = openForIo(tempPaths[request], false);
+        submissions.fetch_add(1, memory_order_relaxed);
+        if (fd < 0) {
+            errors[request] = "can't create " + tempPaths[request] + ": " + strerror(-fd);
+            continue;
         }
-        specialFoodFile.close();
+        tempFds[request] = fd;
+        Step& write = addStep(Step::WRITE, fd, request);
+        write.offset = 0;
+        write.data = &batch[request].data;
+        write.link = true;
+        addStep(Step::FSYNC, fd, request).link = true;
+        Step& rename = addStep(Step::RENAME, -1, request);
+        rename.from = &tempPaths[request];
+        rename.to = &batch[request].path;
+#ifndef _WIN32
+        dirFds[request] = open(directoryOf(last.first).c_str(), O_RDONLY | O_CLOEXEC);
+        if (dirFds[request] >= 0) {
+            rename.link = true;
+            addStep(Step::FSYNC, dirFds[request], request);
+        }
+#endif
     }
-    
-    return loaded;
-}
 
-// Helper function to safely create padded strings
-string createPaddedString(const string& content, int totalLength) {
-    int contentLength = content.length();
-    if (contentLength >= totalLength) {
-        return content;
+    if (!steps.empty()) execute(steps);
+
+    // Results
+    for (const Step& step : steps) {
+        if (step.kind == Step::FSYNC && step.result >= 0) fsyncs.fetch_add(1, memory_order_relaxed);
+        bool failed = step.result < 0 ||
+                      (step.kind == Step::WRITE && static_cast<size_t>(step.result) != step.data->size());
+        if (!failed) continue;
+        string message = step.result < 0 ? strerror(-step.result) : "short write";
+        if (step.request < 0) {
+            failures.fetch_add(1, memory_order_relaxed); // A late sync of earlier appends
+        } else if (errors[step.request].empty()) {
+            const char* what = step.kind == Step::WRITE ? "write" : step.kind == Step::FSYNC ? "fsync" : "rename";
+            errors[step.request] = string(what) + " of " + batch[step.request].path + " failed: " + message;
+        }
+    }
+    for (size_t i = 0; i < batch.size(); i++) {
+        if (tempFds[i] >= 0) {
+            closeForIo(tempFds[i]);
+            if (!errors[i].empty()) remove(tempPaths[i].c_str());
+        }
+        if (dirFds[i] >= 0) closeForIo(dirFds[i]);
+    }
+    for (size_t i = 0; i < batch.size(); i++) {
+        bool ok = errors[i].empty();
+        if (ok) {
+            completed.fetch_add(1, memory_order_relaxed);
+        } else {
+            failures.fetch_add(1, memory_order_relaxed);
+        }
+        if (batch[i].done) batch[i].done(ok, errors[i]);
     }
-    return content + string(totalLength - contentLength, ' ');
 }
 
-// Snake implementation
-Snake::Snake(int startX, int startY) {
-    body.push_back({startX, startY});
-    dir = RIGHT;
-    nextDir = RIGHT;
-    grow = false;
-    growAmount = 1;
-    shieldActive = false;
-}
+#ifdef SNAKE_HAVE_URING
+bool BackgroundIO::openRing() {
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int fd = static_cast<int>(syscall(__NR_io_uring_setup, RING_ENTRIES, &params));
+    if (fd < 0) return false; // No io_uring (old kernel, seccomp, disabled by sysctl)
 
-void Snake::changeDirection(Direction newDir) {
-    if ((dir == LEFT && newDir != RIGHT) ||
-        (dir == RIGHT && newDir != LEFT) ||
-        (dir == UP && newDir != DOWN) ||
-        (dir == DOWN && newDir != UP)) {
-        nextDir = newDir;
+    // Every operation a batch uses must be there, or the fallback takes over
+    vector<char> probeBuffer(sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op), 0);
+    io_uring_probe* probe = reinterpret_cast<io_uring_probe*>(probeBuffer.data());
+    bool supported = syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, 256) >= 0;
+    const int NEEDED[3] = { IORING_OP_WRITE, IORING_OP_FSYNC, IORING_OP_RENAMEAT };
+    for (int op : NEEDED) {
+        supported = supported && op <= probe->last_op && (probe->ops[op].flags & IO_URING_OP_SUPPORTED);
     }
-}
-
-void Snake::move() {
-    dir = nextDir;
-    
-    pair<int, int> newHead = body[0];
-    
-    switch (dir) {
-        case LEFT:  newHead.first--; break;
-        case RIGHT: newHead.first++; break;
-        case UP:    newHead.second--; break;
-        case DOWN:  newHead.second++; break;
-        case STOP:  // Do nothing when stopped
-            break;
+    if (!supported) {
+        close(fd);
+        return false;
     }
 
-    body.insert(body.begin(), newHead);
-    
-    if (grow) {
-        growAmount--;
-        if (growAmount <= 0) {
-            grow = false;
-            growAmount = 1;
-        }
-    } else {
-        body.pop_back();
+    Ring* mapped = new Ring();
+    mapped->fd = fd;
+    mapped->sqMapSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    mapped->cqMapSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single) mapped->sqMapSize = mapped->cqMapSize = max(mapped->sqMapSize, mapped->cqMapSize);
+    mapped->sqMap = mmap(nullptr, mapped->sqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                         IORING_OFF_SQ_RING);
+    mapped->cqMap = single ? mapped->sqMap
+                           : mmap(nullptr, mapped->cqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                                  IORING_OFF_CQ_RING);
+    mapped->sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = mmap(nullptr, mapped->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                      IORING_OFF_SQES);
+    if (mapped->sqMap == MAP_FAILED || mapped->cqMap == MAP_FAILED || sqes == MAP_FAILED) {
+        if (sqes != MAP_FAILED) munmap(sqes, mapped->sqesSize);
+        if (mapped->sqMap != MAP_FAILED) munmap(mapped->sqMap, mapped->sqMapSize);
+        if (!single && mapped->cqMap != MAP_FAILED) munmap(mapped->cqMap, mapped->cqMapSize);
+        close(fd);
+        delete mapped;
+        return false;
     }
+
+    char* sq = static_cast<char*>(mapped->sqMap);
+    char* cq = static_cast<char*>(mapped->cqMap);
+    mapped->sqes = static_cast<io_uring_sqe*>(sqes);
+    mapped->sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    mapped->sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    mapped->sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    mapped->sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    mapped->sqEntries = params.sq_entries;
+    mapped->cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    mapped->cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    mapped->cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    mapped->cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    ring = mapped;
+    return true;
 }
 
-void Snake::setGrow(bool shouldGrow, int amount) {
-    grow = shouldGrow;
-    growAmount = amount;
+void BackgroundIO::closeRing() {
+    if (!ring) return;
+    munmap(ring->sqes, ring->sqesSize);
+    if (ring->cqMap != ring->sqMap) munmap(ring->cqMap, ring->cqMapSize);
+    munmap(ring->sqMap, ring->sqMapSize);
+    close(ring->fd);
+    delete ring;
+    ring = nullptr;
 }
 
-// New: Method to shrink snake by removing tail segments
-void Snake::shrink(int amount) {
-    for (int i = 0; i < amount && body.size() > 1; i++) {
-        body.pop_back();
+// Queues whole chains of steps into the submission ring, submits them with
+// one io_uring_enter() that also waits for their completions, and repeats
+// until every step has run. A chain longer than the ring goes in pieces,
+// each finished before the next is queued, which keeps its order.
+void BackgroundIO::execute(vector<Step>& steps) {
+    if (!ring) {
+        executeWithSyscalls(steps);
+        return;
     }
-}
+    size_t next = 0;
+    while (next < steps.size()) {
+        // As many whole chains as fit
+        size_t end = next, chainStart = next;
+        while (end < steps.size() && end - next < ring->sqEntries) {
+            bool chainEnds = !steps[end].link;
+            end++;
+            if (chainEnds) chainStart = end;
+        }
+        if (chainStart > next) end = chainStart; // Don't split a chain that fits next time
+        unsigned count = static_cast<unsigned>(end - next);
 
-const vector<pair<int, int>>& Snake::getBody() const {
-    return body;
-}
+        unsigned tail = *ring->sqTail;
+        for (size_t i = next; i < end; i++) {
+            const Step& step = steps[i];
+            unsigned index = tail & ring->sqMask;
+            io_uring_sqe* sqe = &ring->sqes[index];
+            memset(sqe, 0, sizeof(*sqe));
+            sqe->user_data = i;
+            if (step.link && i + 1 < end) sqe->flags = IOSQE_IO_LINK;
+            if (step.kind == Step::WRITE) {
+                sqe->opcode = IORING_OP_WRITE;
+                sqe->fd = step.fd;
+                sqe->addr = reinterpret_cast<uint64_t>(step.data->data());
+                sqe->len = static_cast<uint32_t>(step.data->size());
+                sqe->off = static_cast<uint64_t>(step.offset);
+            } else if (step.kind == Step::FSYNC) {
+                sqe->opcode = IORING_OP_FSYNC;
+                sqe->fd = step.fd;
+            } else {
+                sqe->opcode = IORING_OP_RENAMEAT;
+                sqe->fd = AT_FDCWD;
+                sqe->addr = reinterpret_cast<uint64_t>(step.from->c_str());
+                sqe->len = AT_FDCWD;
+                sqe->addr2 = reinterpret_cast<uint64_t>(step.to->c_str());
+            }
+            ring->sqArray[index] = index;
+            tail++;
+        }
+        __atomic_store_n(ring->sqTail, tail, __ATOMIC_RELEASE);
 
-pair<int, int> Snake::getHead() const {
-    return body[0];
+        unsigned toSubmit = count, reaped = 0;
+        while (reaped < count) {
+            int entered = static_cast<int>(syscall(__NR_io_uring_enter, ring->fd, toSubmit, count - reaped,
+                                                   IORING_ENTER_GETEVENTS, nullptr, 0));
+            submissions.fetch_add(1, memory_order_relaxed);
+            if (entered < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+                // The ring is unusable: whatever didn't complete has failed,
+                // and later batches go through plain syscalls
+                closeRing();
+                return;
+            }
+            if (entered > 0) toSubmit -= min(toSubmit, static_cast<unsigned>(entered));
+            unsigned head = *ring->cqHead;
+            unsigned cqTail = __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE);
+            while (head != cqTail) {
+                const io_uring_cqe& cqe = ring->cqes[head & ring->cqMask];
+                steps[cqe.user_data].result = cqe.res;
+                head++;
+                reaped++;
+            }
+            __atomic_store_n(ring->cqHead, head, __ATOMIC_RELEASE);
+        }
+        next = end;
+    }
+}
+#else
+bool BackgroundIO::openRing() {
+    return false;
 }
 
-int Snake::getLength() const {
-    return body.size();
+void BackgroundIO::closeRing() {}
+
+void BackgroundIO::execute(vector<Step>& steps) {
+    executeWithSyscalls(steps);
 }
+#endif
 
-// New: Shield methods implementation
-void Snake::activateShield() {
-    shieldActive = true;
-    shieldStartTime = chrono::steady_clock::now();
+// The same steps one syscall at a time
+void BackgroundIO::executeWithSyscalls(vector<Step>& steps) {
+    bool previousFailed = false;
+    bool linked = false; // The step before links to this one
+    for (Step& step : steps) {
+        if (linked && previousFailed) {
+            step.result = -ECANCELED;
+        } else {
+            submissions.fetch_add(1, memory_order_relaxed);
+#ifdef _WIN32
+            if (step.kind == Step::WRITE) {
+                int written = _write(step.fd, step.data->data(), static_cast<unsigned>(step.data->size()));
+                step.result = written < 0 ? -errno : written;
+            } else if (step.kind == Step::FSYNC) {
+                step.result = _commit(step.fd) == 0 ? 0 : -errno;
+            } else {
+                step.result = MoveFileExA(step.from->c_str(), step.to->c_str(), MOVEFILE_REPLACE_EXISTING) ? 0 : -EIO;
+            }
+#else
+            if (step.kind == Step::WRITE) {
+                ssize_t written = step.offset < 0 ? write(step.fd, step.data->data(), step.data->size())
+                                                  : pwrite(step.fd, step.data->data(), step.data->size(), step.offset);
+                step.result = written < 0 ? -errno : static_cast<int>(written);
+            } else if (step.kind == Step::FSYNC) {
+                step.result = fsync(step.fd) == 0 ? 0 : -errno;
+            } else {
+                step.result = rename(step.from->c_str(), step.to->c_str()) == 0 ? 0 : -errno;
+            }
+#endif
+        }
+        previousFailed = step.result < 0 ||
+                         (step.kind == Step::WRITE && static_cast<size_t>(step.result) != step.data->size());
+        linked = step.link;
+    }
 }
 
-void Snake::deactivateShield() {
-    shieldActive = false;
+// Replay implementation
+template <class Rules>
+void ReplayRecorder::start(const string& replayPath, const Simulation<Rules>& sim) {
+    path = replayPath;
+    header = ReplayHeader();
+    memcpy(header.magic, REPLAY_MAGIC, sizeof(header.magic));
+    header.version = REPLAY_VERSION;
+    header.mode = Rules::ID;
+    header.seed = sim.getSeed();
+    header.startHash = sim.getStateHash();
+    ticks.clear();
+    ticks.reserve(1 << 16); // About 80 minutes at the top speed before it has to grow
 }
 
-bool Snake::hasShield() const {
-    return shieldActive;
+template <class Rules>
+void ReplayRecorder::record(const Simulation<Rules>& sim) {
+    ReplayTick tick = ReplayTick();
+    tick.direction = sim.getSnake().getDirection();
+    tick.hash = sim.getStateHash();
+    ticks.push_back(tick);
 }
 
-int Snake::getShieldTimeRemaining() const {
-    if (!shieldActive) return 0;
-    auto now = chrono::steady_clock::now();
-    auto elapsed = chrono::duration_cast<chrono::seconds>(now - shieldStartTime).count();
-    return max(0, 10 - (int)elapsed); // 10 seconds shield duration
+void ReplayRecorder::save(BackgroundIO& io, IoCallback done) const {
+    string data(reinterpret_cast<const char*>(&header), sizeof(header));
+    data.append(reinterpret_cast<const char*>(ticks.data()), ticks.size() * sizeof(ReplayTick));
+    io.replace(path, move(data), move(done));
 }
 
-bool Snake::shouldBlink() const {
-    if (!shieldActive) return false;
-    auto now = chrono::steady_clock::now();
-    auto elapsed = chrono::duration_cast<chrono::milliseconds>(now - shieldStartTime).count();
-    // Blink every 500ms
-    return (elapsed / 500) % 2 == 0;
+bool loadReplay(const string& path, ReplayHeader& header, vector<ReplayTick>& ticks, string& error) {
+    ifstream file(path, ios::binary | ios::ate);
+    if (!file) {
+        error = "can't open " + path;
+        return false;
+    }
+    streamoff size = file.tellg();
+    file.seekg(0);
+    if (size < static_cast<streamoff>(sizeof(header)) || !file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        memcmp(header.magic, REPLAY_MAGIC, sizeof(header.magic)) != 0) {
+        error = path + " is not a replay";
+        return false;
+    }
+    if (header.version != REPLAY_VERSION) {
+        error = path + " is replay version " + to_string(header.version) + ", this build reads " +
+                to_string(REPLAY_VERSION);
+        return false;
+    }
+    ticks.resize((size - sizeof(header)) / sizeof(ReplayTick));
+    if (!file.read(reinterpret_cast<char*>(ticks.data()), ticks.size() * sizeof(ReplayTick))) {
+        error = "can't read " + path;
+        return false;
+    }
+    return true;
 }
 
-// MODIFIED: Adjust shield timer after a pause
-// The parameter now uses the correct duration type (steady_clock::duration)
-void Snake::adjustShieldStartTime(chrono::steady_clock::duration pauseDuration) {
-    if (shieldActive) {
-        // When resuming, add the pause duration to the start time. 
-        // This shifts the 'start' further into the past, compensating for the time that elapsed while paused.
-        shieldStartTime += pauseDuration; 
+template <class Rules>
+ReplayPlayer<Rules>::ReplayPlayer(const ReplayHeader& header, const ReplayTick* replayTicks, long long count)
+    : sim(header.seed), ticks(replayTicks), tickCount(count), played(0), inStep(sim.getStateHash() == header.startHash) {}
+
+template <class Rules>
+bool ReplayPlayer<Rules>::step() {
+    if (!inStep || played >= tickCount) return false;
+    sim.changeDirection(static_cast<Direction>(ticks[played].direction));
+    sim.update();
+    if (sim.getStateHash() != ticks[played].hash) {
+        inStep = false;
+        return false;
     }
+    played++;
+    return true;
 }
 
-// Game implementation
-Game::Game() : snake(WIDTH / 4, HEIGHT / 2), score(0), gameOver(false), quit(false), 
-             paused(false), foodEaten(0), specialFoodEaten(0), poisonFoodEaten(0), 
-             specialFoodActive(false), poisonFoodActive(false), shieldActive(false),
-             wallCrash(false), obstaclesActive(false), highScore(0) {
-    srand(static_cast<unsigned int>(time(0)));
-    
-    setupConsole();
-    screen.hideCursor();
-    
-    if (loadCustomGraphics()) {
-        // Custom graphics loaded silently
+// Metrics implementation
+#if !defined(_WIN32) && !defined(MSG_NOSIGNAL)
+    #define MSG_NOSIGNAL 0
+#endif
+
+static atomic<uint64_t> metricCounters[METRIC_COUNTER_COUNT];
+static atomic<int64_t> metricGauges[METRIC_GAUGE_COUNT];
+static atomic<uint64_t> metricBuckets[METRIC_HISTOGRAM_COUNT][Metrics::HISTOGRAM_BUCKETS];
+static atomic<uint64_t> metricSumsNs[METRIC_HISTOGRAM_COUNT];
+
+struct MetricInfo {
+    const char* name;
+    const char* help;
+};
+
+static const MetricInfo COUNTER_INFO[METRIC_COUNTER_COUNT] = {
+    { "snake_ticks_total", "Simulation ticks played." },
+    { "snake_tick_overruns_total", "Tick periods that ran out before the game got to them and were dropped." },
+    { "snake_bytes_written_total", "Frame bytes written to the terminal." },
+    { "snake_games_started_total", "Games started." },
+    { "snake_games_finished_total", "Games that ended in a game over." },
+    { "snake_output_stalls_total", "Times a frame found the terminal still busy with earlier ones." },
+    { "snake_frames_dropped_total", "Frames replaced by a newer one before the terminal could take them." },
+};
+
+static const MetricInfo GAUGE_INFO[METRIC_GAUGE_COUNT] = {
+    { "snake_length", "Current length of the snake." },
+    { "snake_speed_milliseconds", "Current tick length." },
+    { "snake_output_level", "How much of each frame is sent: 0 all, 1 changed lines, 2 changed lines and a short panel." },
+};
+
+static const MetricInfo HISTOGRAM_INFO[METRIC_HISTOGRAM_COUNT] = {
+    { "snake_frame_compose_seconds", "Time to build a frame in memory." },
+    { "snake_frame_flush_seconds", "Time to write a frame to the terminal." },
+    { "snake_input_latency_seconds", "Time from reading a key to flushing the frame that shows it." },
+};
+
+// The game thread is the only writer (screens on other threads, such as a
+// server's sessions, are left out), so a load and a store do instead of a
+// locked read-modify-write; readers still see whole values
+void Metrics::add(MetricCounter counter, uint64_t amount) {
+    metricCounters[counter].store(metricCounters[counter].load(memory_order_relaxed) + amount, memory_order_relaxed);
+}
+
+void Metrics::set(MetricGauge gauge, int64_t value) {
+    metricGauges[gauge].store(value, memory_order_relaxed);
+}
+
+void Metrics::observe(MetricHistogram histogram, uint64_t ns) {
+    int bucket = 0;
+    while (bucket < HISTOGRAM_BUCKETS - 1 && ns > (16000ULL << bucket)) bucket++;
+    atomic<uint64_t>& count = metricBuckets[histogram][bucket];
+    count.store(count.load(memory_order_relaxed) + 1, memory_order_relaxed);
+    metricSumsNs[histogram].store(metricSumsNs[histogram].load(memory_order_relaxed) + ns, memory_order_relaxed);
+}
+
+uint64_t Metrics::get(MetricCounter counter) {
+    return metricCounters[counter].load(memory_order_relaxed);
+}
+
+int64_t Metrics::get(MetricGauge gauge) {
+    return metricGauges[gauge].load(memory_order_relaxed);
+}
+
+string Metrics::format() {
+    string out;
+    char line[160];
+    // snprintf returns what the line would have needed, which may be more than fits
+    auto appendLine = [&](int length) {
+        if (length > 0) out.append(line, min<size_t>(length, sizeof(line) - 1));
+    };
+    // The help text has no length limit, so it goes straight in
+    auto header = [&](const MetricInfo& info, const char* type) {
+        out += "# HELP ";
+        out += info.name;
+        out += ' ';
+        out += info.help;
+        out += "\n# TYPE ";
+        out += info.name;
+        out += ' ';
+        out += type;
+        out += '\n';
+    };
+
+    for (int i = 0; i < METRIC_COUNTER_COUNT; i++) {
+        header(COUNTER_INFO[i], "counter");
+        appendLine(snprintf(line, sizeof(line), "%s %llu\n", COUNTER_INFO[i].name,
+                            static_cast<unsigned long long>(get(static_cast<MetricCounter>(i)))));
     }
-    
-    // Initialize last shield spawn time
-    lastShieldSpawnTime = chrono::steady_clock::now();
-    
-    // --- HIGH SCORE ADDITION: Load the score upon starting the game
-    loadHighScore();
-    
-    spawnFood();
+    for (int i = 0; i < METRIC_GAUGE_COUNT; i++) {
+        header(GAUGE_INFO[i], "gauge");
+        appendLine(snprintf(line, sizeof(line), "%s %lld\n", GAUGE_INFO[i].name,
+                            static_cast<long long>(get(static_cast<MetricGauge>(i)))));
+    }
+    for (int i = 0; i < METRIC_HISTOGRAM_COUNT; i++) {
+        const char* name = HISTOGRAM_INFO[i].name;
+        header(HISTOGRAM_INFO[i], "histogram");
+        // The count is the sum of the buckets read, so the two always agree
+        unsigned long long cumulative = 0;
+        for (int bucket = 0; bucket < HISTOGRAM_BUCKETS; bucket++) {
+            cumulative += metricBuckets[i][bucket].load(memory_order_relaxed);
+            if (bucket < HISTOGRAM_BUCKETS - 1) {
+                appendLine(snprintf(line, sizeof(line), "%s_bucket{le=\"%g\"} %llu\n", name,
+                                    (16 << bucket) / 1e6, cumulative));
+            } else {
+                appendLine(snprintf(line, sizeof(line), "%s_bucket{le=\"+Inf\"} %llu\n", name, cumulative));
+            }
+        }
+        appendLine(snprintf(line, sizeof(line), "%s_sum %.9f\n%s_count %llu\n", name,
+                            metricSumsNs[i].load(memory_order_relaxed) / 1e9, name, cumulative));
+    }
+    return out;
 }
 
-Game::~Game() {
-    screen.showCursor();
+MetricsServer::MetricsServer() : listenFd(-1), stopPipe{-1, -1}, scrapes(0) {}
+
+MetricsServer::~MetricsServer() {
+#ifndef _WIN32
+    if (worker.joinable()) {
+        char stop = 0;
+        if (write(stopPipe[1], &stop, 1) < 0) {} // The pipe is empty, so this can't fail
+        worker.join();
+    }
+    if (listenFd >= 0) close(listenFd);
+    if (stopPipe[0] >= 0) close(stopPipe[0]);
+    if (stopPipe[1] >= 0) close(stopPipe[1]);
+#endif
 }
 
-// --- HIGH SCORE IMPLEMENTATIONS ---
+#ifdef _WIN32
+bool MetricsServer::start(int, string& error) {
+    error = "the metrics endpoint needs POSIX sockets";
+    return false;
+}
 
-/**
- * Loads the high score from the file, setting to 0 if the file doesn't exist
- * or contains invalid data.
- */
-void Game::loadHighScore() {
-    ifstream file(HIGHSCORE_FILE);
-    if (file.is_open()) {
-        string line;
-        if (getline(file, line)) {
-            try {
-                // Attempt to convert string to integer
-                highScore = stoi(line);
-            } catch (const std::invalid_argument& e) {
-                // Non-numeric data found
-                highScore = 0; 
-            } catch (const std::out_of_range& e) {
-                // Number too large/small
-                highScore = 0;
+void MetricsServer::run() {}
+void MetricsServer::serve(int) {}
+#else
+bool MetricsServer::start(int port, string& error) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        error = strerror(errno);
+        return false;
+    }
+    int reuse = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    // Loopback only: the numbers are for a local scraper, not the network
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<uint16_t>(port));
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(fd, 8) != 0 ||
+        pipe(stopPipe) != 0) {
+        error = "127.0.0.1:" + to_string(port) + ": " + strerror(errno);
+        close(fd);
+        return false;
+    }
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    fcntl(stopPipe[0], F_SETFD, FD_CLOEXEC);
+    fcntl(stopPipe[1], F_SETFD, FD_CLOEXEC);
+    listenFd = fd;
+    worker = thread(&MetricsServer::run, this);
+    return true;
+}
+
+void MetricsServer::run() {
+    pollfd fds[2] = { { listenFd, POLLIN, 0 }, { stopPipe[0], POLLIN, 0 } };
+    while (true) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        if (fds[1].revents) return;
+        if (fds[0].revents & POLLIN) {
+            int connection = accept(listenFd, nullptr, nullptr);
+            if (connection >= 0) {
+                fcntl(connection, F_SETFD, FD_CLOEXEC);
+                serve(connection);
+                close(connection);
             }
         }
-        file.close();
+    }
+}
+
+// Reads the request line and answers it. A client that sends nothing gets
+// dropped after a second so it can't hold up the next scrape for long.
+void MetricsServer::serve(int connection) {
+    timeval timeout = { 1, 0 };
+    setsockopt(connection, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(connection, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+#ifdef SO_NOSIGPIPE
+    int noSignal = 1; // macOS has no MSG_NOSIGNAL
+    setsockopt(connection, SOL_SOCKET, SO_NOSIGPIPE, &noSignal, sizeof(noSignal));
+#endif
+
+    char request[2048];
+    size_t length = 0;
+    while (length < sizeof(request) - 1) {
+        ssize_t got = recv(connection, request + length, sizeof(request) - 1 - length, 0);
+        if (got <= 0) break;
+        length += got;
+        request[length] = '\0';
+        if (strstr(request, "\r\n\r\n") || strstr(request, "\n\n")) break;
+    }
+    request[length] = '\0';
+
+    string body, status;
+    if (strncmp(request, "GET /metrics ", 13) == 0 || strncmp(request, "GET / ", 6) == 0) {
+        status = "200 OK";
+        body = Metrics::format();
+        scrapes.fetch_add(1, memory_order_relaxed);
     } else {
-        highScore = 0;
+        status = "404 Not Found";
+        body = "Try GET /metrics\n";
+    }
+    string response = "HTTP/1.1 " + status + "\r\nContent-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                      "Content-Length: " + to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+    size_t sent = 0;
+    while (sent < response.size()) {
+        ssize_t wrote = send(connection, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+        if (wrote <= 0) break;
+        sent += wrote;
     }
 }
+#endif
 
-/**
- * Saves the current score as the new high score if it is greater than the
- * currently loaded high score.
- */
-void Game::saveHighScore() {
-    if (score > highScore) {
-        highScore = score;
-        ofstream file(HIGHSCORE_FILE);
-        if (file.is_open()) {
-            file << highScore;
-            file.close();
+// KeyDecoder implementation
+enum DecodeAction : unsigned char { ACTION_NONE = 0, ACTION_KEY, ACTION_RETRY };
+
+// Per state and input byte: the state to go to, what to do and the key to emit
+struct DecodeTables {
+    unsigned char next[KeyDecoder::STATE_COUNT][256];
+    unsigned char action[KeyDecoder::STATE_COUNT][256];
+    Key key[KeyDecoder::STATE_COUNT][256];
+};
+
+static DecodeTables buildDecodeTables() {
+    DecodeTables tables;
+    for (int state = 0; state < KeyDecoder::STATE_COUNT; state++) {
+        for (int byte = 0; byte < 256; byte++) {
+            tables.next[state][byte] = KeyDecoder::GROUND;
+            tables.action[state][byte] = ACTION_NONE;
+            tables.key[state][byte] = KEY_NONE;
         }
     }
-}
+    auto emit = [&](KeyDecoder::State state, unsigned char byte, Key key) {
+        tables.action[state][byte] = ACTION_KEY;
+        tables.key[state][byte] = key;
+    };
 
-// --- END HIGH SCORE IMPLEMENTATIONS ---
+    // Plain keys
+    const char* letters = "wWsSaAdD";
+    const Key letterKeys[] = { KEY_UP, KEY_UP, KEY_DOWN, KEY_DOWN, KEY_LEFT, KEY_LEFT, KEY_RIGHT, KEY_RIGHT };
+    for (int i = 0; letters[i]; i++) {
+        emit(KeyDecoder::GROUND, letters[i], letterKeys[i]);
+    }
+    emit(KeyDecoder::GROUND, ' ', KEY_PAUSE);
+    emit(KeyDecoder::GROUND, 'q', KEY_QUIT);
+    emit(KeyDecoder::GROUND, 'Q', KEY_QUIT);
+    emit(KeyDecoder::GROUND, 'r', KEY_RENDER);
+    emit(KeyDecoder::GROUND, 'R', KEY_RENDER);
+    emit(KeyDecoder::GROUND, 'b', KEY_REWIND);
+    emit(KeyDecoder::GROUND, 'B', KEY_REWIND);
+    tables.next[KeyDecoder::GROUND][27] = KeyDecoder::ESCAPE;
 
+    // ESC [ starts a CSI sequence, ESC O an SS3 one. After any other byte the
+    // ESC is dropped and the byte is decoded as if it came on its own.
+    for (int byte = 0; byte < 256; byte++) {
+        tables.action[KeyDecoder::ESCAPE][byte] = ACTION_RETRY;
+    }
+    tables.action[KeyDecoder::ESCAPE]['['] = ACTION_NONE;
+    tables.next[KeyDecoder::ESCAPE]['['] = KeyDecoder::CSI;
+    tables.action[KeyDecoder::ESCAPE]['O'] = ACTION_NONE;
+    tables.next[KeyDecoder::ESCAPE]['O'] = KeyDecoder::SS3;
+    tables.action[KeyDecoder::ESCAPE][27] = ACTION_NONE;
+    tables.next[KeyDecoder::ESCAPE][27] = KeyDecoder::ESCAPE;
 
-bool Game::isObstacle(int x, int y) const {
-    if (!obstaclesActive) return false;
-    for (const auto& obs : obstacles) {
-        if (x == obs.first && y == obs.second) {
-            return true;
+    // CSI: parameter and intermediate bytes (0x20-0x3F) keep the sequence
+    // going, a final byte (0x40-0x7E) ends it. SS3 ends after one byte.
+    for (int byte = 0x20; byte <= 0x3F; byte++) {
+        tables.next[KeyDecoder::CSI][byte] = KeyDecoder::CSI;
+    }
+    const Key arrows[] = { KEY_UP, KEY_DOWN, KEY_RIGHT, KEY_LEFT };
+    for (int i = 0; i < 4; i++) {
+        emit(KeyDecoder::CSI, 'A' + i, arrows[i]);
+        emit(KeyDecoder::SS3, 'A' + i, arrows[i]);
+    }
+    tables.next[KeyDecoder::CSI][27] = KeyDecoder::ESCAPE;
+    tables.next[KeyDecoder::SS3][27] = KeyDecoder::ESCAPE;
+
+#ifdef _WIN32
+    // _getch() returns 224 (or 0 on the keypad) and then a scan code for arrows
+    tables.next[KeyDecoder::GROUND][224] = KeyDecoder::WIN_PREFIX;
+    tables.next[KeyDecoder::GROUND][0] = KeyDecoder::WIN_PREFIX;
+    emit(KeyDecoder::WIN_PREFIX, 72, KEY_UP);
+    emit(KeyDecoder::WIN_PREFIX, 80, KEY_DOWN);
+    emit(KeyDecoder::WIN_PREFIX, 75, KEY_LEFT);
+    emit(KeyDecoder::WIN_PREFIX, 77, KEY_RIGHT);
+#endif
+    return tables;
+}
+
+static const DecodeTables DECODE_TABLES = buildDecodeTables();
+
+int KeyDecoder::feed(const unsigned char* bytes, int count, Key* keys) {
+    int found = 0;
+    for (int i = 0; i < count; i++) {
+        unsigned char byte = bytes[i];
+        unsigned char action = DECODE_TABLES.action[state][byte];
+        if (action == ACTION_RETRY) {
+            state = GROUND;
+            i--;
+            continue;
+        }
+        if (action == ACTION_KEY) {
+            keys[found++] = DECODE_TABLES.key[state][byte];
         }
+        state = static_cast<State>(DECODE_TABLES.next[state][byte]);
     }
-    return false;
+    keysDecoded += found;
+    return found;
+}
+
+// EventLoop implementation
+#ifndef __linux__
+// Counts the tick periods that have run out on the fallback timer
+static int takeTicks(chrono::steady_clock::time_point& nextTick, int intervalMs) {
+    if (intervalMs <= 0) return 0;
+    int ticks = 0;
+    auto now = chrono::steady_clock::now();
+    while (now >= nextTick) {
+        nextTick += chrono::milliseconds(intervalMs);
+        ticks++;
+    }
+    return ticks;
+}
+#endif
+
+#ifndef _WIN32
+// Readable stdin with nothing to read means end of file (or a hung-up terminal)
+void EventLoop::checkStdinClosed(LoopEvents& events) {
+    int pending = 0;
+    if (ioctl(STDIN_FILENO, FIONREAD, &pending) == 0 && pending == 0) {
+        unwatch(STDIN_FILENO);
+        stdinWatched = false;
+        events.input = false;
+        events.inputClosed = true;
+    }
+}
+#endif
+
+#ifdef __linux__
+static const int TAG_STDIN = -1;
+static const int TAG_TIMER = -2;
+static const int TAG_SIGNAL = -3;
+
+static uint64_t packWatch(int fd, int tag) {
+    return (static_cast<uint64_t>(static_cast<uint32_t>(fd)) << 32) | static_cast<uint32_t>(tag);
+}
+
+EventLoop::EventLoop() : tickIntervalMs(0), wakeups(0), stdinWatched(false) {
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    sigaddset(&mask, SIGWINCH);
+    pthread_sigmask(SIG_BLOCK, &mask, &oldMask);
+    signalFd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.u64 = packWatch(timerFd, TAG_TIMER);
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, timerFd, &event);
+    event.data.u64 = packWatch(signalFd, TAG_SIGNAL);
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, signalFd, &event);
+    // Fails for regular files, which epoll can't watch
+    event.data.u64 = packWatch(STDIN_FILENO, TAG_STDIN);
+    stdinWatched = epoll_ctl(epollFd, EPOLL_CTL_ADD, STDIN_FILENO, &event) == 0;
+}
+
+EventLoop::~EventLoop() {
+    close(signalFd);
+    close(timerFd);
+    close(epollFd);
+    pthread_sigmask(SIG_SETMASK, &oldMask, nullptr);
 }
 
-void Game::spawnFood() {
-    bool occupied;
+void EventLoop::setTickInterval(int intervalMs) {
+    tickIntervalMs = max(0, intervalMs);
+    itimerspec spec = {};
+    spec.it_interval.tv_sec = tickIntervalMs / 1000;
+    spec.it_interval.tv_nsec = (tickIntervalMs % 1000) * 1000000L;
+    spec.it_value = spec.it_interval; // All zero stops the timer
+    timerfd_settime(timerFd, 0, &spec, nullptr);
+}
+
+bool EventLoop::watch(int fd, int tag, bool forWriting) {
+    epoll_event event = {};
+    event.events = forWriting ? EPOLLOUT : EPOLLIN;
+    event.data.u64 = packWatch(fd, tag);
+    return epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) == 0;
+}
+
+void EventLoop::unwatch(int fd) {
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+}
+
+LoopEvents EventLoop::wait() {
+    LoopEvents events = {};
+    epoll_event ready[MAX_WATCHED + 3];
+    int count;
     do {
-        occupied = false;
-        food.first = rand() % (WIDTH - 2) + 1;
-        food.second = rand() % (HEIGHT - 2) + 1;
-        
-        for (const auto& segment : snake.getBody()) {
-            if (segment.first == food.first && segment.second == food.second) {
-                occupied = true;
-                break;
+        count = epoll_wait(epollFd, ready, MAX_WATCHED + 3, -1);
+    } while (count < 0 && errno == EINTR);
+    wakeups++;
+
+    for (int i = 0; i < count; i++) {
+        int tag = static_cast<int>(static_cast<uint32_t>(ready[i].data.u64));
+        if (tag == TAG_STDIN) {
+            events.input = true;
+            if (ready[i].events & (EPOLLHUP | EPOLLERR)) checkStdinClosed(events);
+        } else if (tag == TAG_TIMER) {
+            uint64_t expirations = 0;
+            if (read(timerFd, &expirations, sizeof(expirations)) == sizeof(expirations)) {
+                events.ticks += static_cast<int>(expirations);
+            }
+        } else if (tag == TAG_SIGNAL) {
+            signalfd_siginfo info;
+            while (read(signalFd, &info, sizeof(info)) == sizeof(info)) {
+                if (info.ssi_signo == SIGWINCH) events.resized = true;
+                else events.quit = true;
             }
+        } else if (events.readyCount < LoopEvents::MAX_READY) {
+            events.ready[events.readyCount++] = tag;
+        }
+    }
+    return events;
+}
+
+#elif !defined(_WIN32)
+// Fallback for other POSIX systems: select() and flag-setting signal handlers
+static volatile sig_atomic_t quitRequested = 0;
+static volatile sig_atomic_t resizeRequested = 0;
+static const int LOOP_SIGNALS[3] = { SIGINT, SIGTERM, SIGWINCH };
+
+static void onLoopSignal(int signal) {
+    if (signal == SIGWINCH) resizeRequested = 1;
+    else quitRequested = 1;
+}
+
+EventLoop::EventLoop() : tickIntervalMs(0), wakeups(0), stdinWatched(true), watchedCount(0) {
+    struct sigaction action = {};
+    action.sa_handler = onLoopSignal;
+    sigemptyset(&action.sa_mask);
+    for (int i = 0; i < 3; i++) {
+        sigaction(LOOP_SIGNALS[i], &action, &oldActions[i]); // No SA_RESTART, so select() wakes up
+    }
+}
+
+EventLoop::~EventLoop() {
+    for (int i = 0; i < 3; i++) {
+        sigaction(LOOP_SIGNALS[i], &oldActions[i], nullptr);
+    }
+}
+
+void EventLoop::setTickInterval(int intervalMs) {
+    tickIntervalMs = max(0, intervalMs);
+    nextTick = chrono::steady_clock::now() + chrono::milliseconds(tickIntervalMs);
+}
+
+bool EventLoop::watch(int fd, int tag, bool forWriting) {
+    if (watchedCount == MAX_WATCHED) return false;
+    watchedFds[watchedCount] = fd;
+    watchedTags[watchedCount] = tag;
+    watchedForWriting[watchedCount] = forWriting;
+    watchedCount++;
+    return true;
+}
+
+void EventLoop::unwatch(int fd) {
+    for (int i = 0; i < watchedCount; i++) {
+        if (watchedFds[i] == fd) {
+            watchedCount--;
+            watchedFds[i] = watchedFds[watchedCount];
+            watchedTags[i] = watchedTags[watchedCount];
+            watchedForWriting[i] = watchedForWriting[watchedCount];
+            return;
+        }
+    }
+}
+
+LoopEvents EventLoop::wait() {
+    LoopEvents events = {};
+    while (true) {
+        events.ticks += takeTicks(nextTick, tickIntervalMs);
+        if (quitRequested) { events.quit = true; quitRequested = 0; }
+        if (resizeRequested) { events.resized = true; resizeRequested = 0; }
+        bool due = events.ticks > 0 || events.quit || events.resized;
+
+        fd_set readSet, writeSet;
+        FD_ZERO(&readSet);
+        FD_ZERO(&writeSet);
+        int maxFd = -1;
+        if (stdinWatched) {
+            FD_SET(STDIN_FILENO, &readSet);
+            maxFd = STDIN_FILENO;
         }
-        if (specialFoodActive && food.first == specialFood.first && food.second == specialFood.second) {
-            occupied = true;
+        for (int i = 0; i < watchedCount; i++) {
+            FD_SET(watchedFds[i], watchedForWriting[i] ? &writeSet : &readSet);
+            maxFd = max(maxFd, watchedFds[i]);
         }
-        if (poisonFoodActive && food.first == poisonFood.first && food.second == poisonFood.second) {
-            occupied = true;
+
+        // Sleep until the next tick (or forever while the timer is stopped)
+        timeval timeout = {};
+        timeval* timeoutPtr = &timeout;
+        if (!due) {
+            if (tickIntervalMs > 0) {
+                long long us = chrono::duration_cast<chrono::microseconds>(nextTick - chrono::steady_clock::now()).count();
+                timeout.tv_sec = static_cast<long>(max(0LL, us) / 1000000);
+                timeout.tv_usec = static_cast<long>(max(0LL, us) % 1000000);
+            } else {
+                timeoutPtr = nullptr;
+            }
+        }
+        int count = select(maxFd + 1, &readSet, &writeSet, nullptr, timeoutPtr);
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            break;
         }
-        if (shieldActive && food.first == shield.first && food.second == shield.second) {
-            occupied = true;
+
+        if (stdinWatched && FD_ISSET(STDIN_FILENO, &readSet)) {
+            events.input = true;
+            checkStdinClosed(events);
         }
-        if (isObstacle(food.first, food.second)) {
-            occupied = true;
+        for (int i = 0; i < watchedCount && events.readyCount < LoopEvents::MAX_READY; i++) {
+            if (FD_ISSET(watchedFds[i], watchedForWriting[i] ? &writeSet : &readSet)) {
+                events.ready[events.readyCount++] = watchedTags[i];
+            }
         }
-    } while (occupied);
+        if (due || count > 0) break;
+    }
+    wakeups++;
+    return events;
 }
 
-void Game::spawnSpecialFood() {
-    bool occupied;
-    do {
-        occupied = false;
-        specialFood.first = rand() % (WIDTH - 2) + 1;
-        specialFood.second = rand() % (HEIGHT - 2) + 1;
-        
-        for (const auto& segment : snake.getBody()) {
-            if (segment.first == specialFood.first && specialFood.second == specialFood.second) {
-                occupied = true;
-                break;
+#else
+// Windows: wait on the console input handle with a timeout up to the next tick
+EventLoop::EventLoop() : tickIntervalMs(0), wakeups(0), stdinWatched(true) {}
+
+EventLoop::~EventLoop() {}
+
+void EventLoop::checkStdinClosed(LoopEvents&) {}
+
+void EventLoop::setTickInterval(int intervalMs) {
+    tickIntervalMs = max(0, intervalMs);
+    nextTick = chrono::steady_clock::now() + chrono::milliseconds(tickIntervalMs);
+}
+
+bool EventLoop::watch(int, int, bool) { return false; }
+
+void EventLoop::unwatch(int) {}
+
+LoopEvents EventLoop::wait() {
+    LoopEvents events = {};
+    HANDLE input = GetStdHandle(STD_INPUT_HANDLE);
+    while (true) {
+        events.ticks += takeTicks(nextTick, tickIntervalMs);
+        events.input = _kbhit() != 0;
+        if (events.ticks > 0 || events.input) break;
+
+        DWORD timeout = INFINITE;
+        if (tickIntervalMs > 0) {
+            long long ms = chrono::duration_cast<chrono::milliseconds>(nextTick - chrono::steady_clock::now()).count();
+            timeout = static_cast<DWORD>(max(0LL, ms));
+        }
+        if (WaitForSingleObject(input, timeout) == WAIT_OBJECT_0 && !_kbhit()) {
+            // Mouse, focus and key-up events keep the handle signalled; drop them
+            FlushConsoleInputBuffer(input);
+        }
+    }
+    wakeups++;
+    return events;
+}
+#endif
+
+// Screen implementation
+const char* const RENDER_MODE_NAMES[RENDER_MODE_COUNT] = { "emoji", "halfblock", "halfblock256", "ascii" };
+const char* const OUTPUT_LEVEL_NAMES[OUTPUT_LEVEL_COUNT] = { "full", "lines", "hud" };
+
+const GlyphStyle GLYPH_STYLES[GLYPH_COUNT] = {
+    {   0,   0,   0,  16, 37, ' ' }, // GLYPH_EMPTY
+    { 200, 200, 200, 250, 37, '#' }, // GLYPH_WALL
+    {  40, 200,  70,  34, 32, 'o' }, // GLYPH_BODY
+    { 220,  40,  40, 160, 31, 'x' }, // GLYPH_BODY_DEAD
+    { 160,  60, 220, 135, 35, 'o' }, // GLYPH_BODY_SHIELD
+    { 120, 240, 120, 120, 92, '@' }, // GLYPH_HEAD
+    { 255, 140,   0, 208, 93, 'X' }, // GLYPH_HEAD_DEAD
+    { 230,  30,  30, 196, 91, '*' }, // GLYPH_FOOD
+    { 150,  80, 220,  99, 95, '$' }, // GLYPH_SPECIAL_FOOD
+    { 150, 110,  60,  94, 33, '!' }, // GLYPH_POISON_FOOD
+    {  80, 170, 255,  75, 94, '+' }, // GLYPH_SHIELD
+    {  40, 110, 230,  27, 34, '=' }, // GLYPH_RIVAL_BODY
+    { 110, 170, 255,  75, 96, '&' }, // GLYPH_RIVAL_HEAD
+};
+
+Screen::Screen() : mode(RENDER_EMOJI), modeChanged(false), lastBoardBytes(0), lastFrameBytes(0), outputFd(1),
+                   nonBlocking(false),
+                   savedFlags(0), pendingSent(0), frameWaiting(false), stallStart(0), level(OUTPUT_FULL),
+                   recentDrops(0), cleanFrames(0), stats(), reportMetrics(true), levelPinned(false) {}
+
+Screen::~Screen() {
+    finishOutput();
+}
+
+void Screen::clear() {
+    screenBuffer.clear(); // draw() puts the cursor home, or on each changed line
+}
+
+void Screen::addToBuffer(const string& content) {
+    screenBuffer += content;
+}
+
+void Screen::setRenderMode(RenderMode newMode) {
+    if (newMode == mode) return;
+    mode = newMode;
+    modeChanged = true; // The frame changes shape, so leftovers must go
+}
+
+void Screen::addBoard(const Glyph* glyphs, int width, int height, const string& specialFood,
+                      const char* overlay, int overlayRow) {
+    size_t before = screenBuffer.size();
+    switch (mode) {
+        case RENDER_EMOJI:
+            addEmojiBoard(glyphs, width, height, specialFood, overlay, overlayRow);
+            break;
+        case RENDER_HALF_BLOCK:
+        case RENDER_HALF_BLOCK_256:
+            addHalfBlockBoard(glyphs, width, height, overlay, overlayRow);
+            break;
+        default:
+            addAsciiBoard(glyphs, width, height, overlay, overlayRow);
+            break;
+    }
+    lastBoardBytes = screenBuffer.size() - before;
+}
+
+void Screen::addEmojiBoard(const Glyph* glyphs, int width, int height, const string& specialFood,
+                           const char* overlay, int overlayRow) {
+    const string* emoji[GLYPH_COUNT] = {
+        &EMPTY_SPACE, &WALL, &SNAKE_BODY, &SNAKE_BODY_DEAD, &SNAKE_BODY_SHIELD, &SNAKE_HEAD, &SNAKE_HEAD_DEAD,
+        &FOOD_EMOJI, &specialFood, &POISON_FOOD_EMOJI, &SHIELD_EMOJI, &RIVAL_BODY, &RIVAL_HEAD
+    };
+    // Glyphs are copied a fixed 16 bytes at a time into room made up front
+    // (the extra bytes get overwritten or cut off): a session server draws
+    // tens of thousands of these boards a second
+    const int CHUNK = 16;
+    char padded[GLYPH_COUNT][CHUNK] = {};
+    size_t lengths[GLYPH_COUNT];
+    bool fits = true;
+    for (int i = 0; i < GLYPH_COUNT; i++) {
+        lengths[i] = emoji[i]->size();
+        fits = fits && lengths[i] <= CHUNK;
+        memcpy(padded[i], emoji[i]->data(), min<size_t>(lengths[i], CHUNK));
+    }
+    // The exact size first, so the buffer grows no more than it used to
+    size_t needed = height + (overlay ? strlen(overlay) + 1 : 0);
+    for (int i = 0; i < width * height; i++) needed += lengths[glyphs[i]];
+    size_t start = screenBuffer.size();
+    screenBuffer.resize(start + needed + CHUNK);
+    char* out = &screenBuffer[start];
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            if (overlay && y == overlayRow) {
+                // The text covers whole two-column cells
+                int length = static_cast<int>(strlen(overlay));
+                int covered = (length + 1) / 2;
+                if (x == (width - covered) / 2) {
+                    memcpy(out, overlay, length);
+                    out += length;
+                    if (length % 2) *out++ = ' ';
+                    x += covered - 1;
+                    continue;
+                }
+            }
+            Glyph glyph = glyphs[y * width + x];
+            if (fits) {
+                memcpy(out, padded[glyph], CHUNK);
+                out += lengths[glyph];
+            } else {
+                memcpy(out, emoji[glyph]->data(), emoji[glyph]->size());
+                out += emoji[glyph]->size();
             }
         }
-        if (specialFood.first == food.first && specialFood.second == food.second) {
-            occupied = true;
+        *out++ = '\n';
+    }
+    screenBuffer.resize(out - screenBuffer.data()); // Below needed with an overlay
+}
+
+// Colour layers of the compact renderers. GLYPH_EMPTY stands for the
+// terminal's default colour.
+static const int FOREGROUND = 38, BACKGROUND = 48;
+
+// Sets the foreground and/or background colour (-1 leaves it) in one sequence
+static void appendColors(string& out, int foreground, int background, bool trueColor) {
+    char sequence[48];
+    int length = 0;
+    auto add = [&](int glyph, int layer) {
+        const GlyphStyle& style = GLYPH_STYLES[glyph];
+        const char* separator = length > 0 ? ";" : "";
+        if (glyph == GLYPH_EMPTY) {
+            length += snprintf(sequence + length, sizeof(sequence) - length, "%s%d", separator, layer + 1);
+        } else if (trueColor) {
+            length += snprintf(sequence + length, sizeof(sequence) - length, "%s%d;2;%d;%d;%d",
+                               separator, layer, style.red, style.green, style.blue);
+        } else {
+            length += snprintf(sequence + length, sizeof(sequence) - length, "%s%d;5;%d", separator, layer, style.palette);
         }
-        if (poisonFoodActive && specialFood.first == poisonFood.first && specialFood.second == poisonFood.second) {
-            occupied = true;
+    };
+    if (foreground >= 0) add(foreground, FOREGROUND);
+    if (background >= 0) add(background, BACKGROUND);
+    out += "\033[";
+    out.append(sequence, length);
+    out += 'm';
+}
+
+// Moves past count cells that the line erase already blanked
+static void appendSkip(string& out, int count) {
+    if (count <= 0) return;
+    if (count < 5) {
+        out.append(count, ' ');
+    } else {
+        char sequence[16];
+        out.append(sequence, snprintf(sequence, sizeof(sequence), "\033[%dC", count));
+    }
+}
+
+// Each line shows two board rows with half blocks. Every line is erased
+// first, so empty cells are skipped with a cursor move instead of being
+// drawn, and colours are only sent when they change. Cells with one empty
+// half use the default background, so the background only changes for
+// cells with two colours.
+void Screen::addHalfBlockBoard(const Glyph* glyphs, int width, int height, const char* overlay, int overlayRow) {
+    bool trueColor = mode == RENDER_HALF_BLOCK;
+    int overlayLength = overlay ? static_cast<int>(strlen(overlay)) : 0;
+    int overlayStart = (width - overlayLength) / 2;
+    int foreground = GLYPH_EMPTY, background = GLYPH_EMPTY;
+    for (int y = 0; y < height; y += 2) {
+        if (background != GLYPH_EMPTY) {
+            appendColors(screenBuffer, -1, GLYPH_EMPTY, trueColor); // The erase fills with the background
+            background = GLYPH_EMPTY;
         }
-        if (shieldActive && specialFood.first == shield.first && specialFood.second == shield.second) {
-            occupied = true;
+        screenBuffer += "\033[2K";
+        int skipped = 0;
+        for (int x = 0; x < width; x++) {
+            bool text = overlay && y / 2 == overlayRow / 2 && x >= overlayStart && x < overlayStart + overlayLength;
+            int top = glyphs[y * width + x];
+            int bottom = y + 1 < height ? glyphs[(y + 1) * width + x] : GLYPH_EMPTY;
+            if (!text && top == GLYPH_EMPTY && bottom == GLYPH_EMPTY) {
+                skipped++;
+                continue;
+            }
+
+            // Spaces drawn over the skipped cells must not be coloured
+            if (skipped > 0 && skipped < 5 && background != GLYPH_EMPTY) {
+                appendColors(screenBuffer, -1, GLYPH_EMPTY, trueColor);
+                background = GLYPH_EMPTY;
+            }
+            appendSkip(screenBuffer, skipped);
+            skipped = 0;
+
+            if (text) {
+                if (foreground != GLYPH_EMPTY || background != GLYPH_EMPTY) screenBuffer += "\033[0m";
+                foreground = background = GLYPH_EMPTY;
+                screenBuffer += overlay[x - overlayStart];
+                continue;
+            }
+
+            // Glyph colours wanted, and the block character that shows them
+            int wantForeground, wantBackground;
+            const char* block;
+            if (top == bottom) {
+                wantForeground = top;
+                wantBackground = background; // Hidden behind a full block
+                block = "█";
+            } else if (bottom == GLYPH_EMPTY) {
+                wantForeground = top;
+                wantBackground = GLYPH_EMPTY;
+                block = "▀";
+            } else if (top == GLYPH_EMPTY) {
+                wantForeground = bottom;
+                wantBackground = GLYPH_EMPTY;
+                block = "▄";
+            } else if (foreground == bottom && background == top) {
+                wantForeground = bottom;
+                wantBackground = top;
+                block = "▄";
+            } else {
+                wantForeground = top;
+                wantBackground = bottom;
+                block = "▀";
+            }
+            if (wantForeground != foreground || wantBackground != background) {
+                appendColors(screenBuffer, wantForeground != foreground ? wantForeground : -1,
+                             wantBackground != background ? wantBackground : -1, trueColor);
+                foreground = wantForeground;
+                background = wantBackground;
+            }
+            screenBuffer += block;
         }
-        if (isObstacle(specialFood.first, specialFood.second)) {
-            occupied = true;
+        if (hasSelfContainedLines() && (foreground != GLYPH_EMPTY || background != GLYPH_EMPTY)) {
+            screenBuffer += "\033[0m";
+            foreground = background = GLYPH_EMPTY;
         }
-    } while (occupied);
-    specialFoodActive = true;
-    specialFoodSpawnTime = chrono::steady_clock::now();
-    
-    SPECIAL_FOOD_EMOJI = SPECIAL_FOODS[currentSpecialFoodIndex];
-    currentSpecialFoodIndex = (currentSpecialFoodIndex + 1) % SPECIAL_FOODS.size();
+        screenBuffer += '\n';
+    }
+    screenBuffer += "\033[0m";
 }
 
-// New: Spawn poison food
-void Game::spawnPoisonFood() {
-    bool occupied;
-    do {
-        occupied = false;
-        poisonFood.first = rand() % (WIDTH - 2) + 1;
-        poisonFood.second = rand() % (HEIGHT - 2) + 1;
-        
-        for (const auto& segment : snake.getBody()) {
-            if (segment.first == poisonFood.first && poisonFood.second == poisonFood.second) {
-                occupied = true;
-                break;
+// One character per cell. Lines are erased first and runs of empty cells
+// skipped, and the colour is only changed when a character needs another one.
+void Screen::addAsciiBoard(const Glyph* glyphs, int width, int height, const char* overlay, int overlayRow) {
+    int overlayLength = overlay ? static_cast<int>(strlen(overlay)) : 0;
+    int overlayStart = (width - overlayLength) / 2;
+    int color = 0;
+    char sequence[8];
+    for (int y = 0; y < height; y++) {
+        screenBuffer += "\033[2K";
+        int skipped = 0;
+        for (int x = 0; x < width; x++) {
+            bool text = overlay && y == overlayRow && x >= overlayStart && x < overlayStart + overlayLength;
+            const GlyphStyle& style = GLYPH_STYLES[glyphs[y * width + x]];
+            if (!text && style.ascii == ' ') {
+                skipped++;
+                continue;
+            }
+            appendSkip(screenBuffer, skipped);
+            skipped = 0;
+
+            if (text) {
+                if (color != 0) screenBuffer += "\033[0m";
+                color = 0;
+                screenBuffer += overlay[x - overlayStart];
+                continue;
+            }
+            if (style.sgr != color) {
+                screenBuffer.append(sequence, snprintf(sequence, sizeof(sequence), "\033[%dm", style.sgr));
+                color = style.sgr;
             }
+            screenBuffer += style.ascii;
         }
-        if (poisonFood.first == food.first && poisonFood.second == food.second) {
-            occupied = true;
+        if (hasSelfContainedLines() && color != 0) {
+            screenBuffer += "\033[0m";
+            color = 0;
         }
-        if (specialFoodActive && poisonFood.first == specialFood.first && poisonFood.second == specialFood.second) {
-            occupied = true;
+        screenBuffer += '\n';
+    }
+    screenBuffer += "\033[0m";
+}
+
+// Sends the lines of after that differ from before, each placed with a
+// cursor move and followed by an erase to the end of the line. The cursor
+// ends below the frame, where a whole frame would leave it.
+static void appendChangedLines(string& out, const string& before, const string& after) {
+    size_t beforeAt = 0, afterAt = 0;
+    char sequence[16];
+    int row = 1;
+    for (; afterAt < after.size(); row++) {
+        size_t afterEnd = after.find('\n', afterAt);
+        if (afterEnd == string::npos) afterEnd = after.size();
+        size_t beforeEnd = beforeAt < before.size() ? before.find('\n', beforeAt) : before.size();
+        if (beforeEnd == string::npos) beforeEnd = before.size();
+        if (before.compare(beforeAt, beforeEnd - beforeAt, after, afterAt, afterEnd - afterAt) != 0) {
+            out.append(sequence, snprintf(sequence, sizeof(sequence), "\033[%d;1H", row));
+            out.append(after, afterAt, afterEnd - afterAt);
+            out += "\033[K";
+        }
+        afterAt = afterEnd + 1;
+        beforeAt = min(beforeEnd + 1, before.size());
+    }
+    out.append(sequence, snprintf(sequence, sizeof(sequence), "\033[%d;1H", row));
+    if (beforeAt < before.size()) out += "\033[J"; // The old frame was longer
+}
+
+void Screen::draw(bool droppable) {
+    AllocPhaseScope phase(PHASE_FLUSH);
+    uint64_t start = monotonicNs();
+    if (!nonBlocking) {
+        size_t written = screenBuffer.size() + 3;
+        if (modeChanged) {
+            cout << "\033[2J";
+            modeChanged = false;
+            written += 4;
         }
-        if (shieldActive && poisonFood.first == shield.first && poisonFood.second == shield.second) {
-            occupied = true;
+        cout << "\033[H" << screenBuffer;
+        cout.flush();
+        lastFrameBytes = screenBuffer.size();
+        stats.framesSent++;
+        if (reportMetrics) {
+            Metrics::observe(METRIC_FRAME_FLUSH, monotonicNs() - start);
+            Metrics::add(METRIC_BYTES_WRITTEN, written);
         }
-        if (isObstacle(poisonFood.first, poisonFood.second)) {
-            occupied = true;
+        return;
+    }
+
+    // Anything the terminal has taken since the last frame makes room first
+    writePending();
+    size_t queued = terminalQueued();
+    stats.maxQueuedBytes = max(stats.maxQueuedBytes, queued + pending.size() - pendingSent);
+    // More than a frame still in the terminal's queue means it is behind too
+    bool busy = hasPendingOutput() || (droppable && queued > max<size_t>(lastFrameBytes, 1024));
+    if (busy) {
+        if (frameWaiting) {
+            noteDrop();
+        } else if (stallStart == 0) {
+            stallStart = start;
+            stats.stalls++;
+            if (reportMetrics) Metrics::add(METRIC_OUTPUT_STALLS);
         }
-    } while (occupied);
-    poisonFoodActive = true;
-    poisonFoodSpawnTime = chrono::steady_clock::now();
+        // Keep the newest frame only; the buffers swap, so nothing is allocated
+        waitingFrame.swap(screenBuffer);
+        frameWaiting = true;
+        return;
+    }
+    if (frameWaiting) {
+        noteDrop(); // The terminal caught up, but this frame is newer
+        frameWaiting = false;
+    }
+    send(screenBuffer);
+    if (reportMetrics) Metrics::observe(METRIC_FRAME_FLUSH, monotonicNs() - start);
+}
+
+// Bytes written but not yet taken by the terminal (SSH, terminal emulator),
+// where the system can tell. On Linux sockets answer too (SIOCOUTQ is the
+// same request), so a slow client counts as a slow terminal.
+size_t Screen::terminalQueued() const {
+#if !defined(_WIN32) && defined(TIOCOUTQ)
+    int queued = 0;
+    if (ioctl(outputFd, TIOCOUTQ, &queued) == 0 && queued > 0) return static_cast<size_t>(queued);
+#endif
+    return 0;
+}
+
+// Starts writing a frame: the whole of it, or only its changed lines
+void Screen::send(string& frame) {
+    pending.clear();
+    pendingSent = 0;
+    if (modeChanged) {
+        pending += "\033[2J";
+        modeChanged = false;
+        lastSent.clear();
+    }
+    if (level >= OUTPUT_DIFF && !lastSent.empty()) {
+        appendChangedLines(pending, lastSent, frame);
+        stats.diffFrames++;
+    } else {
+        pending += "\033[H";
+        pending += frame;
+    }
+    lastSent.swap(frame); // frame is cleared before it is used again
+    lastFrameBytes = pending.size();
+    stats.framesSent++;
+    if (reportMetrics) Metrics::add(METRIC_BYTES_WRITTEN, pending.size());
+
+    if (!levelPinned && stallStart == 0 && ++cleanFrames >= CLEAN_FRAMES_TO_STEP_UP) {
+        cleanFrames = 0;
+        recentDrops = 0;
+        if (level > OUTPUT_FULL) setLevel(static_cast<OutputLevel>(level - 1));
+    }
+    writePending();
+}
+
+void Screen::writePending() {
+#ifndef _WIN32
+    while (hasPendingOutput()) {
+        ssize_t written = write(outputFd, pending.data() + pendingSent, pending.size() - pendingSent);
+        if (written > 0) {
+            pendingSent += written;
+        } else if (written < 0 && errno == EINTR) {
+            continue;
+        } else if (written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        } else {
+            pendingSent = pending.size(); // The terminal is gone; nothing to wait for
+        }
+    }
+#endif
+    if (stallStart != 0 && !frameWaiting) {
+        stats.stallNs += monotonicNs() - stallStart;
+        stallStart = 0;
+    }
+}
+
+void Screen::flushOutput() {
+    writePending();
+    if (!hasPendingOutput() && frameWaiting) {
+        frameWaiting = false;
+        send(waitingFrame);
+    }
+}
+
+void Screen::noteDrop() {
+    stats.framesDropped++;
+    if (reportMetrics) Metrics::add(METRIC_FRAMES_DROPPED);
+    cleanFrames = 0;
+    if (!levelPinned && ++recentDrops >= DROPS_TO_STEP_DOWN && level + 1 < OUTPUT_LEVEL_COUNT) {
+        recentDrops = 0;
+        setLevel(static_cast<OutputLevel>(level + 1));
+    }
+}
+
+void Screen::setLevel(OutputLevel newLevel) {
+    level = newLevel;
+    lastSent.clear(); // Lines change shape, so the next frame goes out whole
+    stats.levelChanges++;
+    if (reportMetrics) Metrics::set(METRIC_OUTPUT_LEVEL, level);
+}
+
+void Screen::pinOutputLevel(OutputLevel newLevel) {
+    if (newLevel != level) setLevel(newLevel);
+    levelPinned = true;
+}
+
+void Screen::startOutput() {
+#ifndef _WIN32
+    if (nonBlocking) return;
+    if (outputFd == STDOUT_FILENO) cout.flush();
+    savedFlags = fcntl(outputFd, F_GETFL);
+    if (savedFlags >= 0 && fcntl(outputFd, F_SETFL, savedFlags | O_NONBLOCK) == 0) nonBlocking = true;
+#endif
+}
+
+void Screen::finishOutput() {
+#ifndef _WIN32
+    if (!nonBlocking) return;
+    // A slow terminal still gets the last frame, so the game ends on what really happened
+    while (hasPendingOutput() || frameWaiting) {
+        pollfd output = { outputFd, POLLOUT, 0 };
+        if (hasPendingOutput() && poll(&output, 1, 1000) <= 0) break;
+        flushOutput();
+    }
+    fcntl(outputFd, F_SETFL, savedFlags);
+    nonBlocking = false;
+    if (stallStart != 0) {
+        stats.stallNs += monotonicNs() - stallStart;
+        stallStart = 0;
+    }
+#endif
+}
+
+void Screen::discardOutput() {
+    pending.clear();
+    pendingSent = 0;
+    frameWaiting = false;
+    nonBlocking = false;
+    stallStart = 0;
+}
+
+void Screen::hideCursor() {
+#ifdef _WIN32
+    HANDLE consoleHandle = GetStdHandle(STD_OUTPUT_HANDLE);
+    CONSOLE_CURSOR_INFO info;
+    info.dwSize = 100;
+    info.bVisible = FALSE;
+    SetConsoleCursorInfo(consoleHandle, &info);
+#else
+    cout << "\033[?25l";
+#endif
+}
+
+void Screen::showCursor() {
+#ifdef _WIN32
+    HANDLE consoleHandle = GetStdHandle(STD_OUTPUT_HANDLE);
+    CONSOLE_CURSOR_INFO info;
+    info.dwSize = 100;
+    info.bVisible = TRUE;
+    SetConsoleCursorInfo(consoleHandle, &info);
+#else
+    cout << "\033[?25h";
+#endif
+}
+
+void setupConsole() {
+#ifdef _WIN32
+    SetConsoleOutputCP(65001);
+    HANDLE hOut = GetStdHandle(STD_OUTPUT_HANDLE);
+    DWORD dwMode = 0;
+    GetConsoleMode(hOut, &dwMode);
+    dwMode |= ENABLE_VIRTUAL_TERMINAL_PROCESSING;
+    SetConsoleMode(hOut, dwMode);
+#else
+    setlocale(LC_ALL, "en_US.UTF-8");
+#endif
+}
+
+static bool readCustomGraphics() {
+    bool loaded = false;
+    
+    ifstream headFile("head.txt");
+    if (headFile.is_open()) {
+        string line;
+        if (getline(headFile, line)) {
+            if (!line.empty()) {
+                SNAKE_HEAD = line;
+                loaded = true;
+            }
+        }
+        headFile.close();
+    }
+    
+    ifstream bodyFile("body.txt");
+    if (bodyFile.is_open()) {
+        string line;
+        if (getline(bodyFile, line)) {
+            if (!line.empty()) {
+                SNAKE_BODY = line;
+                loaded = true;
+            }
+        }
+        bodyFile.close();
+    }
+
+    ifstream specialFoodFile("food.txt");
+    if (specialFoodFile.is_open()) {
+        string line;
+        if (getline(specialFoodFile, line)) {
+            if (!line.empty()) {
+                SPECIAL_FOOD_EMOJI = line;
+                loaded = true;
+            }
+        }
+        specialFoodFile.close();
+    }
+    
+    return loaded;
+}
+
+// A function-local static is set up exactly once, even with several threads
+// calling at the same time, and the others wait for it
+bool loadCustomGraphics() {
+    static const bool loaded = readCustomGraphics();
+    return loaded;
+}
+
+// Helper function to safely create padded strings
+string createPaddedString(const string& content, int totalLength) {
+    int contentLength = content.length();
+    if (contentLength >= totalLength) {
+        return content;
+    }
+    return content + string(totalLength - contentLength, ' ');
+}
+
+// Item effects, indexed by ItemType
+const ItemEffect ITEM_EFFECTS[ITEM_TYPE_COUNT] = {
+    {  10, 1, 0, false }, // ITEM_FOOD
+    {  30, 3, 0, false }, // ITEM_SPECIAL_FOOD
+    { -30, 0, 3, false }, // ITEM_POISON_FOOD
+    {   0, 0, 0, true  }, // ITEM_SHIELD
+};
+
+// Zobrist keys, from a fixed seed so every build hashes alike
+static ZobristKeys buildZobristKeys() {
+    ZobristKeys keys;
+    uint64_t counter = 0x5a0b1257ULL;
+    auto fillKeys = [&counter](uint64_t* first, int count) {
+        for (int i = 0; i < count; i++) first[i] = zobristMix(counter++);
+    };
+    fillKeys(keys.body, ZOBRIST_CELLS);
+    fillKeys(keys.head, ZOBRIST_CELLS);
+    for (int type = 0; type < ITEM_TYPE_COUNT; type++) fillKeys(keys.item[type], ZOBRIST_CELLS);
+    fillKeys(keys.obstacle, ZOBRIST_CELLS);
+    fillKeys(keys.mazeWall, ZOBRIST_CELLS);
+    fillKeys(keys.direction, 5);
+    fillKeys(&keys.shield, 1);
+    return keys;
+}
+
+const ZobristKeys ZOBRIST = buildZobristKeys();
+
+// TranspositionTable implementation
+TranspositionTable::TranspositionTable(int slotCount) {
+    size_t size = 1;
+    while (size < static_cast<size_t>(max(slotCount, 1))) size *= 2;
+    slots = vector<Slot>(size);
+    mask = size - 1;
+    clear();
+}
+
+void TranspositionTable::clear() {
+    for (Slot& slot : slots) {
+        slot.check.store(0, memory_order_relaxed);
+        slot.data.store(0, memory_order_relaxed);
+    }
+}
+
+void TranspositionTable::add(uint64_t key, float reward) {
+    Slot& slot = slots[key & mask];
+    uint64_t data = slot.data.load(memory_order_relaxed);
+    if ((slot.check.load(memory_order_relaxed) ^ data) != key) data = 0; // Empty, torn or another position
+    uint64_t value = (data & ((1ULL << VALUE_BITS) - 1)) + static_cast<uint64_t>(reward * VALUE_SCALE + 0.5f);
+    uint64_t visits = (data >> VALUE_BITS) + 1;
+    data = (visits << VALUE_BITS) | (value & ((1ULL << VALUE_BITS) - 1));
+    slot.data.store(data, memory_order_relaxed);
+    slot.check.store(key ^ data, memory_order_relaxed);
+}
+
+bool TranspositionTable::find(uint64_t key, int& visits, float& value) const {
+    const Slot& slot = slots[key & mask];
+    uint64_t data = slot.data.load(memory_order_relaxed);
+    if ((slot.check.load(memory_order_relaxed) ^ data) != key || data == 0) return false;
+    visits = static_cast<int>(data >> VALUE_BITS);
+    value = static_cast<float>(data & ((1ULL << VALUE_BITS) - 1)) / VALUE_SCALE;
+    return true;
+}
+
+// ItemStore implementation
+template <int Capacity>
+ItemStore<Capacity>::ItemStore() {
+    clear();
+}
+
+template <int Capacity>
+void ItemStore<Capacity>::clear() {
+    size = 0;
+    hash = 0;
+    fill(begin(typeCounts), end(typeCounts), (short)0);
+    fill(begin(cellSlot), end(cellSlot), EMPTY_CELL);
+    fill(begin(touched), end(touched), (unsigned char)0);
+    clearTouched();
+}
+
+template <int Capacity>
+void ItemStore<Capacity>::touch(int slot) {
+    for (int i = 0; i < min<int>(touchedCount, MAX_TOUCHED); i++) {
+        if (touched[i] == slot) return;
+    }
+    if (touchedCount < MAX_TOUCHED) touched[touchedCount] = static_cast<unsigned char>(slot);
+    if (touchedCount <= MAX_TOUCHED) touchedCount++;
+}
+
+template <int Capacity>
+int ItemStore<Capacity>::add(ItemType type, Cell cell, int expiresAt) {
+    if (isFull() || cell.x < 0 || cell.x >= WIDTH || cell.y < 0 || cell.y >= HEIGHT) return NO_ITEM;
+    if (findAt(cell) != NO_ITEM) return NO_ITEM;
+
+    int slot = size++;
+    touch(slot);
+    types[slot] = type;
+    cells[slot] = cell;
+    expiries[slot] = expiresAt;
+    if constexpr (INDEXED) {
+        cellSlot[cell.y * WIDTH + cell.x] = slot;
+    }
+    typeCounts[type]++;
+    hash ^= ZOBRIST.item[type][zobristCell(cell)];
+    return slot;
+}
+
+template <int Capacity>
+void ItemStore<Capacity>::removeAt(int slot) {
+    typeCounts[types[slot]]--;
+    hash ^= ZOBRIST.item[types[slot]][zobristCell(cells[slot])];
+    if constexpr (INDEXED) {
+        cellSlot[cells[slot].y * WIDTH + cells[slot].x] = EMPTY_CELL;
+    }
+
+    // Move the last item into the hole to keep the arrays dense
+    int last = --size;
+    touch(slot);
+    touch(last);
+    if (slot != last) {
+        types[slot] = types[last];
+        cells[slot] = cells[last];
+        expiries[slot] = expiries[last];
+        if constexpr (INDEXED) {
+            cellSlot[cells[slot].y * WIDTH + cells[slot].x] = slot;
+        }
+    }
+}
+
+template <int Capacity>
+int ItemStore<Capacity>::removeExpired(int now) {
+    int removed = 0;
+    // Walk backwards so the swapped-in item has already been checked
+    for (int slot = size - 1; slot >= 0; slot--) {
+        if (expiries[slot] != NEVER_EXPIRES && now >= expiries[slot]) {
+            removeAt(slot);
+            removed++;
+        }
+    }
+    return removed;
+}
+
+template <int Capacity>
+int ItemStore<Capacity>::findAt(Cell cell) const {
+    if constexpr (INDEXED) {
+        if (cell.x < 0 || cell.x >= WIDTH || cell.y < 0 || cell.y >= HEIGHT) return NO_ITEM;
+        unsigned char slot = cellSlot[cell.y * WIDTH + cell.x];
+        return slot == EMPTY_CELL ? NO_ITEM : slot;
+    } else {
+        return findCell(cells, size, cell);
+    }
+}
+
+template <int Capacity>
+int ItemStore<Capacity>::findFirst(ItemType type) const {
+    if (typeCounts[type] == 0) return NO_ITEM;
+    for (int slot = 0; slot < size; slot++) {
+        if (types[slot] == type) return slot;
+    }
+    return NO_ITEM;
+}
+
+// Untouched slots hold the same items as before, so only an item in a
+// touched slot, then or now, can have moved in the cell index
+template <int Capacity>
+template <class Mark>
+void ItemStore<Capacity>::markTouched(const ItemStore& before, Mark& mark) const {
+    mark(this, reinterpret_cast<const char*>(types) - reinterpret_cast<const char*>(this));
+    if (touchedCount > MAX_TOUCHED) {
+        int slots = max(size, before.size);
+        mark(types, slots);
+        mark(cells, slots * sizeof(Cell));
+        mark(expiries, slots * sizeof(int));
+        if constexpr (INDEXED) mark(cellSlot, sizeof(cellSlot));
+        return;
+    }
+    for (int i = 0; i < touchedCount; i++) {
+        int slot = touched[i];
+        mark(&types[slot], 1);
+        mark(&cells[slot], sizeof(Cell));
+        mark(&expiries[slot], sizeof(int));
+        if constexpr (INDEXED) {
+            if (slot < before.size) mark(&cellSlot[before.cells[slot].y * WIDTH + before.cells[slot].x], 1);
+            if (slot < size) mark(&cellSlot[cells[slot].y * WIDTH + cells[slot].x], 1);
+        }
+    }
+}
+
+// LevelGenerator implementation
+LevelGenerator::LevelGenerator() : targetCount(0), headCell(-1), regionSize(0), minRegionSize(0), floodFills(0) {
+    reset(-1, -1, 0, 0);
+}
+
+void LevelGenerator::reset(int headX, int headY, int dirX, int dirY) {
+    fill(begin(blocked), end(blocked), 0);
+    fill(begin(reserved), end(reserved), 0);
+    fill(begin(reachable), end(reachable), 0);
+    targetCount = 0;
+    regionSize = 0;
+    floodFills = 0;
+    headCell = -1;
+
+    if (headX < 0 || headX >= WIDTH || headY < 0 || headY >= HEIGHT) return;
+    headCell = headY * WIDTH + headX;
+    reserve(headX, headY);
+    for (int i = 1; i <= SAFE_LANE_LENGTH; i++) {
+        reserve(headX + dirX * i, headY + dirY * i);
+    }
+}
+
+void LevelGenerator::addWall(int x, int y) {
+    if (x < 0 || x >= WIDTH || y < 0 || y >= HEIGHT) return;
+    blocked[y * WIDTH + x] = 1;
+}
+
+void LevelGenerator::reserve(int x, int y) {
+    if (x < 0 || x >= WIDTH || y < 0 || y >= HEIGHT) return;
+    reserved[y * WIDTH + x] = 1;
+}
+
+void LevelGenerator::addTarget(int x, int y) {
+    if (x < 0 || x >= WIDTH || y < 0 || y >= HEIGHT) return;
+    reserve(x, y);
+    if (targetCount < CELLS) targets[targetCount++] = y * WIDTH + x;
+}
+
+void LevelGenerator::setMinRegionSize(int cells) {
+    minRegionSize = cells;
+}
+
+bool LevelGenerator::isFreeAt(int x, int y) const {
+    return x >= 0 && x < WIDTH && y >= 0 && y < HEIGHT && !blocked[y * WIDTH + x];
+}
+
+bool LevelGenerator::isReachable(int x, int y) const {
+    if (x < 0 || x >= WIDTH || y < 0 || y >= HEIGHT) return false;
+    return reachable[y * WIDTH + x] != 0;
+}
+
+// A free cell is "simple" when its free 4-neighbours form a single group around
+// it (linked through free diagonal cells), so blocking it cannot split the region.
+bool LevelGenerator::isSimpleCell(int cell) const {
+    static const int ringX[8] = { 0, 1, 1, 1, 0, -1, -1, -1 };
+    static const int ringY[8] = { -1, -1, 0, 1, 1, 1, 0, -1 };
+
+    int x = cell % WIDTH;
+    int y = cell / WIDTH;
+    bool isFree[8];
+    for (int k = 0; k < 8; k++) {
+        isFree[k] = isFreeAt(x + ringX[k], y + ringY[k]);
+    }
+
+    // Count runs of free ring cells that touch the centre through an edge
+    int groups = 0;
+    for (int k = 0; k < 8; k++) {
+        if (!isFree[k] || isFree[(k + 7) % 8]) continue;
+        bool touchesEdge = false;
+        for (int j = k; isFree[j % 8] && j < k + 8; j++) {
+            if (j % 2 == 0) touchesEdge = true;
+        }
+        if (touchesEdge) groups++;
+    }
+    return groups <= 1;
+}
+
+void LevelGenerator::floodFromHead() {
+    floodFills++;
+    fill(begin(reachable), end(reachable), 0);
+    regionSize = 0;
+    if (headCell < 0 || blocked[headCell]) return;
+
+    static const int stepX[4] = { 1, -1, 0, 0 };
+    static const int stepY[4] = { 0, 0, 1, -1 };
+    int queue[CELLS];
+    int head = 0, tail = 0;
+    queue[tail++] = headCell;
+    reachable[headCell] = 1;
+    while (head < tail) {
+        int cell = queue[head++];
+        int x = cell % WIDTH;
+        int y = cell / WIDTH;
+        for (int k = 0; k < 4; k++) {
+            int nx = x + stepX[k];
+            int ny = y + stepY[k];
+            if (!isFreeAt(nx, ny)) continue;
+            int next = ny * WIDTH + nx;
+            if (!reachable[next]) {
+                reachable[next] = 1;
+                queue[tail++] = next;
+            }
+        }
+    }
+    regionSize = tail;
+}
+
+bool LevelGenerator::targetsReachable() const {
+    for (int i = 0; i < targetCount; i++) {
+        if (!reachable[targets[i]]) return false;
+    }
+    return true;
+}
+
+bool LevelGenerator::tryBlock(int x, int y) {
+    if (x < 0 || x >= WIDTH || y < 0 || y >= HEIGHT) return false;
+    int cell = y * WIDTH + x;
+    if (blocked[cell] || reserved[cell]) return false;
+
+    // Cells outside the head's region can be blocked freely
+    if (!reachable[cell]) {
+        blocked[cell] = 1;
+        return true;
+    }
+
+    if (regionSize - 1 < minRegionSize) return false;
+
+    if (isSimpleCell(cell)) {
+        blocked[cell] = 1;
+        reachable[cell] = 0;
+        regionSize--;
+        return true;
+    }
+
+    // Cut cell: only a full flood can tell what gets separated
+    blocked[cell] = 1;
+    floodFromHead();
+    if (targetsReachable() && regionSize >= minRegionSize) {
+        return true;
+    }
+    blocked[cell] = 0;
+    floodFromHead();
+    return false;
+}
+
+int LevelGenerator::placeObstacles(int count, FastRandom& rng, Cell* placed) {
+    int placedCount = 0;
+    floodFromHead();
+
+    // Edge cells are never used so the border stays walkable
+    int attempts = count * 20;
+    while (placedCount < count && attempts-- > 0) {
+        int x = rng.below(WIDTH - 2) + 1;
+        int y = rng.below(HEIGHT - 2) + 1;
+        if (tryBlock(x, y)) {
+            placed[placedCount++] = Cell(x, y);
+        }
+    }
+    return placedCount;
+}
+
+// Kruskal's algorithm over rooms on even coordinates: every wall between two
+// rooms is knocked out if the rooms are not yet joined (tracked by union-find).
+void LevelGenerator::generateMaze(int loopPercent, FastRandom& rng, unsigned char* walls) {
+    const int roomsX = (WIDTH + 1) / 2;
+    const int roomsY = (HEIGHT + 1) / 2;
+    const int rooms = roomsX * roomsY;
+
+    for (int y = 0; y < HEIGHT; y++) {
+        for (int x = 0; x < WIDTH; x++) {
+            // Rooms sit on even coordinates; a trailing odd column/row is left open
+            bool room = (x % 2 == 0 && y % 2 == 0);
+            bool trailing = (x == WIDTH - 1 && WIDTH % 2 == 0) || (y == HEIGHT - 1 && HEIGHT % 2 == 0);
+            blocked[y * WIDTH + x] = (room || trailing) ? 0 : 1;
+        }
+    }
+
+    // Each entry is the wall cell between two neighbouring rooms
+    int between[2 * rooms];
+    int betweenCount = 0;
+    for (int ry = 0; ry < roomsY; ry++) {
+        for (int rx = 0; rx < roomsX; rx++) {
+            if (rx + 1 < roomsX && rx * 2 + 1 < WIDTH) between[betweenCount++] = (ry * 2) * WIDTH + rx * 2 + 1;
+            if (ry + 1 < roomsY && ry * 2 + 1 < HEIGHT) between[betweenCount++] = (ry * 2 + 1) * WIDTH + rx * 2;
+        }
+    }
+    for (int i = betweenCount - 1; i > 0; i--) {
+        swap(between[i], between[rng.below(i + 1)]);
+    }
+
+    int parent[rooms];
+    for (int i = 0; i < rooms; i++) parent[i] = i;
+    auto findRoot = [&parent](int room) {
+        while (parent[room] != room) {
+            parent[room] = parent[parent[room]]; // Path halving
+            room = parent[room];
+        }
+        return room;
+    };
+
+    for (int i = 0; i < betweenCount; i++) {
+        int wall = between[i];
+        int x = wall % WIDTH;
+        int y = wall / WIDTH;
+        // The two rooms on either side of this wall
+        int a = (y / 2) * roomsX + (x / 2);
+        int b = (x % 2 == 1) ? a + 1 : a + roomsX;
+        int rootA = findRoot(a);
+        int rootB = findRoot(b);
+        if (rootA != rootB) {
+            parent[rootA] = rootB;
+            blocked[wall] = 0;
+        } else if (rng.below(100) < loopPercent) {
+            blocked[wall] = 0; // Extra opening: braids the maze so it has loops
+        }
+    }
+
+    // Opening reserved cells (head and the lane ahead) can only add connections
+    for (int cell = 0; cell < CELLS; cell++) {
+        if (reserved[cell]) blocked[cell] = 0;
+    }
+    floodFromHead();
+    memcpy(walls, blocked, sizeof(blocked));
+}
+
+// Snake implementation
+Snake::Snake(int startX, int startY, Direction startDir) {
+    headIndex = 0;
+    length = 1;
+    body[0] = Cell(startX, startY);
+    dir = startDir;
+    nextDir = startDir;
+    grow = false;
+    growAmount = 1;
+    shieldActive = false;
+    shieldExpiry = 0;
+    hash = ZOBRIST.body[zobristCell(body[0])] ^ ZOBRIST.head[zobristCell(body[0])];
+}
+
+void Snake::changeDirection(Direction newDir) {
+    if ((dir == LEFT && newDir != RIGHT) ||
+        (dir == RIGHT && newDir != LEFT) ||
+        (dir == UP && newDir != DOWN) ||
+        (dir == DOWN && newDir != UP)) {
+        nextDir = newDir;
+    }
+}
+
+void Snake::move() {
+    dir = nextDir;
+    
+    Cell oldHead = body[headIndex];
+    Cell tail = body[(headIndex + length - 1) % CAPACITY];
+    Cell newHead = oldHead;
+    
+    switch (dir) {
+        case LEFT:  newHead.x--; break;
+        case RIGHT: newHead.x++; break;
+        case UP:    newHead.y--; break;
+        case DOWN:  newHead.y++; break;
+        case STOP:  // Do nothing when stopped
+            break;
+    }
+
+    // The new head takes the slot in front of the old one. When the snake
+    // doesn't grow that slot's old content (the tail) simply drops off.
+    headIndex = (headIndex + CAPACITY - 1) % CAPACITY;
+    body[headIndex] = newHead;
+    hash ^= ZOBRIST.head[zobristCell(oldHead)] ^ ZOBRIST.head[zobristCell(newHead)] ^ ZOBRIST.body[zobristCell(newHead)];
+    
+    if (grow && length < CAPACITY) {
+        length++;
+        growAmount--;
+        if (growAmount <= 0) {
+            grow = false;
+            growAmount = 1;
+        }
+    } else {
+        hash ^= ZOBRIST.body[zobristCell(tail)];
+    }
+}
+
+void Snake::setGrow(bool shouldGrow, int amount) {
+    grow = shouldGrow;
+    growAmount = amount;
+}
+
+// New: Method to shrink snake by removing tail segments
+void Snake::shrink(int amount) {
+    int newLength = max(1, length - amount);
+    for (int i = newLength; i < length; i++) {
+        hash ^= ZOBRIST.body[zobristCell(getSegment(i))];
+    }
+    length = newLength;
+}
+
+template <class Mark>
+void Snake::markTouched(const Snake& before, Mark& mark) const {
+    int moved = (before.headIndex - headIndex + CAPACITY) % CAPACITY;
+    for (int i = 0; i < max(moved, 1); i++) {
+        mark(&body[(headIndex + i) % CAPACITY], sizeof(Cell));
+    }
+    mark(&headIndex, reinterpret_cast<const char*>(this + 1) - reinterpret_cast<const char*>(&headIndex));
+}
+
+bool Snake::occupies(Cell cell, int firstSegment) const {
+    int remaining = length - firstSegment;
+    if (remaining <= 0) return false;
+
+    // The live segments form at most two contiguous runs of the ring
+    int start = (headIndex + firstSegment) % CAPACITY;
+    int firstRun = min(remaining, CAPACITY - start);
+    if (findCell(body + start, firstRun, cell) >= 0) return true;
+    return findCell(body, remaining - firstRun, cell) >= 0;
+}
+
+Direction Snake::getDirection() const {
+    return dir;
+}
+
+int Snake::getLength() const {
+    return length;
+}
+
+// Brings a head that left the board back in on the opposite side
+void Snake::wrapHead() {
+    Cell& head = body[headIndex];
+    Cell wrapped((head.x + WIDTH) % WIDTH, (head.y + HEIGHT) % HEIGHT);
+    hash ^= ZOBRIST.body[zobristCell(head)] ^ ZOBRIST.head[zobristCell(head)] ^
+            ZOBRIST.body[zobristCell(wrapped)] ^ ZOBRIST.head[zobristCell(wrapped)];
+    head = wrapped;
+}
+
+// New: Shield methods implementation
+void Snake::activateShield(int until) {
+    shieldActive = true;
+    shieldExpiry = until;
+}
+
+void Snake::deactivateShield() {
+    shieldActive = false;
+}
+
+bool Snake::hasShield() const {
+    return shieldActive;
+}
+
+int Snake::getShieldExpiry() const {
+    return shieldExpiry;
+}
+
+int Snake::getShieldTimeRemaining(int now) const {
+    if (!shieldActive) return 0;
+    return max(0, (shieldExpiry - now + 999) / 1000);
+}
+
+bool Snake::shouldBlink(int now) const {
+    if (!shieldActive) return false;
+    // Blink every 500ms
+    return ((shieldExpiry - now) / 500) % 2 == 0;
+}
+
+// DistanceField implementation
+static thread_local DistanceCache threadDistances = { 0, 0, {} };
+static atomic<uint64_t> distanceThreads(0);
+// Stamps count up per thread above the thread's number, so no two threads
+// (or two changes) ever give out the same one
+static thread_local uint64_t lastDistanceStamp = (distanceThreads.fetch_add(1, memory_order_relaxed) + 1) << 40;
+
+DistanceCache& distanceCache() {
+    return threadDistances;
+}
+
+uint64_t newDistanceStamp() {
+    return ++lastDistanceStamp;
+}
+
+template <bool WRAP>
+DistanceField<WRAP>::DistanceField() : source(0), stamp(newDistanceStamp()) {
+    fill(begin(blockers), end(blockers), 0);
+    blockers[EDGE] = 1;
+}
+
+template <bool WRAP>
+void DistanceField<WRAP>::addBlocker(Cell cell) {
+    if (blockers[index(cell)]++ == 0) stamp = newDistanceStamp();
+}
+
+template <bool WRAP>
+void DistanceField<WRAP>::removeBlocker(Cell cell) {
+    if (--blockers[index(cell)] == 0) stamp = newDistanceStamp();
+}
+
+template <bool WRAP>
+void DistanceField<WRAP>::moveSource(Cell head) {
+    int to = index(head);
+    if (to == source) return;
+    source = static_cast<int16_t>(to);
+    stamp = newDistanceStamp();
+}
+
+template <bool WRAP>
+const uint16_t* DistanceField<WRAP>::getDistances() const {
+    DistanceCache& cache = threadDistances;
+    if (cache.stamp != stamp) {
+        search(cache.distances);
+        cache.stamp = stamp;
+        cache.searches++;
+    }
+    return cache.distances;
+}
+
+template <bool WRAP>
+Cell DistanceField<WRAP>::stepTowards(Cell target) const {
+    int cell = index(target);
+    const uint16_t* distances = getDistances();
+    uint16_t distance = distances[cell];
+    if (distance == UNREACHABLE || distance == 0) return Cell(source % WIDTH, source / WIDTH);
+    for (; distance > 1; distance--) {
+        const int16_t* around = neighbours(cell);
+        int i = 0;
+        while (!(isOpen(around[i]) && distances[around[i]] == distance - 1)) i++;
+        cell = around[i];
+    }
+    return Cell(cell % WIDTH, cell / WIDTH);
+}
+
+template <bool WRAP>
+void DistanceField<WRAP>::search(uint16_t* out) const {
+    fill(out, out + CELLS, UNREACHABLE);
+    // Whether a neighbour is new is as good as random, so it's queued without
+    // a branch (one spare slot for the write past the end)
+    int16_t queue[CELLS + 1];
+    int head = 0, tail = 0;
+    out[source] = 0;
+    queue[tail++] = source;
+    while (head < tail) {
+        int cell = queue[head++];
+        uint16_t next = out[cell] + 1;
+        const int16_t* around = neighbours(cell);
+        for (int i = 0; i < 4; i++) {
+            int neighbour = around[i];
+            bool found = isOpen(neighbour) && out[neighbour] == UNREACHABLE;
+            if (found) out[neighbour] = next;
+            queue[tail] = static_cast<int16_t>(neighbour);
+            tail += found;
+        }
+    }
+}
+
+// Simulation implementation
+template <class Rules>
+Simulation<Rules>::Simulation(uint32_t seed) : snake(WIDTH / 4, HEIGHT / 2), rng(seed), seed(seed), wallHash(0), timeMs(0), score(0),
+             foodEaten(0), specialFoodEaten(0), poisonFoodEaten(0), lastShieldSpawnTime(0),
+             specialFoodSpawned(0), shieldsCollected(0), tickCount(0), obstacleExpiry(0),
+             obstacleCount(0), crashPosition(0, 0), deathCause(DEATH_NONE), gameOver(false), wallCrash(false),
+             obstaclesActive(false), reachChecks(true) {
+    fill(begin(mazeWalls), end(mazeWalls), 0);
+
+    if constexpr (Rules::MAZE) {
+        Cell head = snake.getHead();
+        LevelGenerator level;
+        level.reset(head.x, head.y, 1, 0); // The snake starts moving right
+        level.generateMaze(Rules::MAZE_LOOP_PERCENT, rng, mazeWalls);
+        for (int cell = 0; cell < CELLS; cell++) {
+            if (!mazeWalls[cell]) continue;
+            Cell wall(cell % WIDTH, cell / WIDTH);
+            wallHash ^= ZOBRIST.mazeWall[zobristCell(wall)];
+            field.addBlocker(wall);
+        }
+    }
+    field.moveSource(snake.getHead());
+
+    for (int i = 0; i < Rules::FOOD_COUNT; i++) {
+        spawnItem(ITEM_FOOD, 0);
+    }
+}
+
+template <class Rules>
+bool Simulation<Rules>::isObstacle(Cell cell) const {
+    if constexpr (!Rules::OBSTACLES) return false;
+    if (!obstaclesActive) return false;
+    return findCell(obstacles, obstacleCount, cell) >= 0;
+}
+
+template <class Rules>
+bool Simulation<Rules>::isMazeWall(Cell cell) const {
+    if constexpr (!Rules::MAZE) return false;
+    if (cell.x < 0 || cell.x >= WIDTH || cell.y < 0 || cell.y >= HEIGHT) return false;
+    return mazeWalls[cell.y * WIDTH + cell.x] != 0;
+}
+
+template <class Rules>
+bool Simulation<Rules>::wouldCollide(Direction dir) const {
+    Cell next = snake.getHead();
+    switch (dir) {
+        case LEFT:  next.x--; break;
+        case RIGHT: next.x++; break;
+        case UP:    next.y--; break;
+        case DOWN:  next.y++; break;
+        case STOP:  break;
+    }
+    if constexpr (Rules::WRAP_WALLS) {
+        next = Cell((next.x + WIDTH) % WIDTH, (next.y + HEIGHT) % HEIGHT);
+    } else if (next.x < 0 || next.x >= WIDTH || next.y < 0 || next.y >= HEIGHT) {
+        return true;
+    }
+    if (isMazeWall(next) || isObstacle(next)) return true;
+
+    // The tail moves out of the way, so only the segments before it count
+    return snake.getLength() > 2 && snake.occupies(next, 1) && next != snake.getSegment(snake.getLength() - 1);
+}
+
+// Picks a random cell inside the walls that holds no snake, item or obstacle
+// and that the head can get to in at most maxDistance moves, going by the
+// distance field. When no cell is that close, any free cell the head can get
+// to will do, then any free cell at all (the body may be in the way now but
+// not by the time the head gets there).
+template <class Rules>
+bool Simulation<Rules>::findFreeCell(Cell& cell, int maxDistance) {
+    int freeCells = (WIDTH - 2) * (HEIGHT - 2) - snake.getLength() - items.count();
+    if (freeCells <= 0) return false;
+
+    // Random guesses first: on an open board the first one nearly always
+    // does. A distance means the cell is open (no body, obstacle or wall).
+    Cell head = snake.getHead();
+    for (int i = 0; i < FREE_CELL_GUESSES; i++) {
+        cell = Cell(rng.below(WIDTH - 2) + 1, rng.below(HEIGHT - 2) + 1);
+        bool inReach = reachChecks ? field.distanceTo(cell) <= maxDistance : !field.isBlocked(cell);
+        if (inReach && cell != head && items.findAt(cell) == NO_ITEM) return true;
+    }
+
+    // A crowded board: count the cells that qualify and take one of them. The
+    // field's blocker counts stand in for the body, obstacle and wall checks.
+    for (int limit : { maxDistance, static_cast<int>(DistanceField<Rules::WRAP_WALLS>::UNREACHABLE) - 1,
+                       static_cast<int>(DistanceField<Rules::WRAP_WALLS>::UNREACHABLE) }) {
+        int count = 0;
+        for (int pass = 0; pass < 2; pass++) {
+            int pick = pass ? static_cast<int>(rng.below(count)) : -1;
+            for (int y = 1; y < HEIGHT - 1; y++) {
+                for (int x = 1; x < WIDTH - 1; x++) {
+                    Cell candidate(x, y);
+                    if ((reachChecks && field.distanceTo(candidate) > limit) || field.isBlocked(candidate) ||
+                        candidate == head || items.findAt(candidate) != NO_ITEM) {
+                        continue;
+                    }
+                    if (pass == 0) {
+                        count++;
+                    } else if (pick-- == 0) {
+                        cell = candidate;
+                        return true;
+                    }
+                }
+            }
+            if (count == 0) break;
+        }
+    }
+    return false;
+}
+
+// Places one item of the given type on a free cell
+template <class Rules>
+bool Simulation<Rules>::spawnItem(ItemType type, int durationSeconds) {
+    // A timed item has to be reachable before it runs out: at the current
+    // speed, the head gets durationSeconds * 1000 / speed moves, minus the one
+    // on which it would vanish
+    int maxDistance = DistanceField<Rules::WRAP_WALLS>::UNREACHABLE - 1;
+    if (durationSeconds > 0) maxDistance = (durationSeconds * 1000 - 1) / getGameSpeed();
+    Cell cell;
+    if (items.isFull() || !findFreeCell(cell, maxDistance)) return false;
+
+    int expiresAt = durationSeconds > 0 ? timeMs + durationSeconds * 1000 : NEVER_EXPIRES;
+    items.add(type, cell, expiresAt);
+
+    if (type == ITEM_SPECIAL_FOOD) {
+        specialFoodSpawned++;
+    }
+    return true;
+}
+
+// Applies the effect of the item in the given slot and removes it from the board
+template <class Rules>
+void Simulation<Rules>::consumeItem(int slot) {
+    ItemType type = items.typeAt(slot);
+    const ItemEffect& effect = ITEM_EFFECTS[type];
+    items.removeAt(slot);
+
+    score = max(0, score + effect.score);
+    if (effect.grow > 0) snake.setGrow(true, effect.grow);
+    if (effect.shrink > 0) {
+        for (int i = max(1, snake.getLength() - effect.shrink); i < snake.getLength(); i++) {
+            field.removeBlocker(snake.getSegment(i));
+        }
+        snake.shrink(effect.shrink);
+    }
+    if (effect.shield) snake.activateShield(timeMs + Rules::SHIELD_ACTIVE_DURATION * 1000);
+
+    switch (type) {
+        case ITEM_FOOD:
+            foodEaten++;
+            // Obstacles move first, so the new items are placed (and checked
+            // for reach) on the board the player will see
+            if constexpr (Rules::OBSTACLES) {
+                if (foodEaten % Rules::OBSTACLES_EVERY == 0) {
+                    spawnObstacles();
+                }
+            }
+            spawnItem(ITEM_FOOD, 0);
+
+            if constexpr (Rules::POWER_UPS) {
+                if (foodEaten % Rules::SPECIAL_FOOD_EVERY == 0) {
+                    spawnItem(ITEM_SPECIAL_FOOD, Rules::SPECIAL_FOOD_DURATION);
+                    spawnItem(ITEM_POISON_FOOD, Rules::POISON_FOOD_DURATION); // Spawn poison food along with special food
+                }
+            }
+            break;
+        case ITEM_SPECIAL_FOOD: specialFoodEaten++; break;
+        case ITEM_POISON_FOOD:  poisonFoodEaten++; break;
+        case ITEM_SHIELD:       shieldsCollected++; break;
+        default: break;
+    }
+}
+
+// Places the obstacles through the level generator so they can never wall the
+// snake in or cut it off from any item on the board
+template <class Rules>
+void Simulation<Rules>::spawnObstacles() {
+    if constexpr (Rules::OBSTACLES) {
+        Cell head = snake.getHead();
+        int dirX = 0, dirY = 0;
+        switch (snake.getDirection()) {
+            case LEFT:  dirX = -1; break;
+            case RIGHT: dirX = 1; break;
+            case UP:    dirY = -1; break;
+            case DOWN:  dirY = 1; break;
+            case STOP:  break;
+        }
+
+        LevelGenerator level;
+        level.reset(head.x, head.y, dirX, dirY);
+        int openCells = CELLS;
+        if constexpr (Rules::MAZE) {
+            for (int y = 0; y < HEIGHT; y++) {
+                for (int x = 0; x < WIDTH; x++) {
+                    if (isMazeWall(Cell(x, y))) {
+                        level.addWall(x, y);
+                        openCells--;
+                    }
+                }
+            }
+        }
+        for (int i = 0; i < snake.getLength(); i++) {
+            Cell segment = snake.getSegment(i);
+            level.reserve(segment.x, segment.y);
+        }
+        for (int slot = 0; slot < items.count(); slot++) {
+            level.addTarget(items.cellAt(slot).x, items.cellAt(slot).y);
+        }
+        level.setMinRegionSize(openCells * Rules::MIN_FREE_REGION_PERCENT / 100);
+
+        clearObstacles();
+        obstacleCount = level.placeObstacles(Rules::OBSTACLE_COUNT, rng, obstacles);
+        for (int i = 0; i < obstacleCount; i++) {
+            wallHash ^= ZOBRIST.obstacle[zobristCell(obstacles[i])];
+            field.addBlocker(obstacles[i]);
+        }
+        obstaclesActive = true;
+        obstacleExpiry = timeMs + Rules::OBSTACLE_DURATION * 1000;
+    }
+}
+
+// New: Update shield power-up
+template <class Rules>
+void Simulation<Rules>::updateShield() {
+    // Check if it's time to spawn a new shield
+    if (items.countOf(ITEM_SHIELD) == 0 && timeMs - lastShieldSpawnTime >= Rules::SHIELD_SPAWN_INTERVAL * 1000) {
+        spawnItem(ITEM_SHIELD, Rules::SHIELD_DURATION);
+        lastShieldSpawnTime = timeMs;
+    }
+    
+    // Update snake's shield status timer
+    if (snake.hasShield() && timeMs >= snake.getShieldExpiry()) {
+        snake.deactivateShield();
+    }
+}
+
+template <class Rules>
+void Simulation<Rules>::clearObstacles() {
+    for (int i = 0; i < obstacleCount; i++) {
+        wallHash ^= ZOBRIST.obstacle[zobristCell(obstacles[i])];
+        field.removeBlocker(obstacles[i]);
+    }
+    obstaclesActive = false;
+    obstacleCount = 0;
+}
+
+template <class Rules>
+void Simulation<Rules>::updateObstacles() {
+    if (obstaclesActive && timeMs >= obstacleExpiry) {
+        clearObstacles();
+    }
+}
+
+template <class Rules>
+int Simulation<Rules>::getGameSpeed() const {
+    int speedReduction = min(snake.getLength() * Rules::SPEED_DECREMENT, Rules::BASE_SPEED - Rules::MIN_SPEED);
+    int calculatedSpeed = Rules::BASE_SPEED - speedReduction;
+    return max(calculatedSpeed, Rules::MIN_SPEED);
+}
+
+template <class Rules>
+uint64_t Simulation<Rules>::getStateHash() const {
+    // Every field goes into one of a few words, each mixed with its own salt
+    uint64_t words[] = {
+        static_cast<uint32_t>(timeMs) | static_cast<uint64_t>(static_cast<uint32_t>(score)) << 32,
+        static_cast<uint32_t>(tickCount) | static_cast<uint64_t>(rng.getState()) << 32,
+        static_cast<uint16_t>(foodEaten) | static_cast<uint64_t>(static_cast<uint16_t>(specialFoodEaten)) << 16 |
+            static_cast<uint64_t>(static_cast<uint16_t>(poisonFoodEaten)) << 32 |
+            static_cast<uint64_t>(static_cast<uint16_t>(shieldsCollected)) << 48,
+        static_cast<uint32_t>(lastShieldSpawnTime) | static_cast<uint64_t>(static_cast<uint32_t>(obstacleExpiry)) << 32,
+        static_cast<uint32_t>(snake.getShieldExpiry()) | static_cast<uint64_t>(snake.getGrowth()) << 32 |
+            static_cast<uint64_t>(gameOver) << 48 | static_cast<uint64_t>(deathCause) << 56,
+        static_cast<uint64_t>(static_cast<uint32_t>(specialFoodSpawned)),
+    };
+    uint64_t hash = getPositionHash();
+    for (size_t i = 0; i < sizeof(words) / sizeof(words[0]); i++) {
+        hash ^= zobristMix(words[i] ^ (0xa0761d6478bd642fULL * (i + 1)));
+    }
+    return hash;
+}
+
+template <class Rules>
+uint64_t Simulation<Rules>::rehashPosition() const {
+    uint64_t hash = ZOBRIST.head[zobristCell(snake.getHead())] ^ ZOBRIST.direction[snake.getDirection()] ^
+                    (snake.hasShield() ? ZOBRIST.shield : 0);
+    for (int i = 0; i < snake.getLength(); i++) {
+        hash ^= ZOBRIST.body[zobristCell(snake.getSegment(i))];
+    }
+    for (int slot = 0; slot < items.count(); slot++) {
+        hash ^= ZOBRIST.item[items.typeAt(slot)][zobristCell(items.cellAt(slot))];
+    }
+    for (int i = 0; i < getObstacleCount(); i++) {
+        hash ^= ZOBRIST.obstacle[zobristCell(obstacles[i])];
+    }
+    if constexpr (Rules::MAZE) {
+        for (int cell = 0; cell < CELLS; cell++) {
+            if (mazeWalls[cell]) hash ^= ZOBRIST.mazeWall[zobristCell(Cell(cell % WIDTH, cell / WIDTH))];
+        }
+    }
+    return hash;
+}
+
+template <class Rules>
+SessionRecord Simulation<Rules>::getSessionRecord() const {
+    SessionRecord record = SessionRecord();
+    record.mode = Rules::ID;
+    record.deathCause = static_cast<uint8_t>(gameOver ? deathCause : DEATH_NONE);
+    record.finalSpeed = static_cast<uint8_t>(min(getGameSpeed(), 255));
+    record.score = score;
+    record.length = static_cast<uint16_t>(snake.getLength());
+    record.foodEaten = static_cast<uint16_t>(min(foodEaten, 65535));
+    record.specialFoodEaten = static_cast<uint16_t>(min(specialFoodEaten, 65535));
+    record.poisonFoodEaten = static_cast<uint16_t>(min(poisonFoodEaten, 65535));
+    record.shieldsCollected = static_cast<uint16_t>(min(shieldsCollected, 65535));
+    record.ticks = static_cast<uint32_t>(tickCount);
+    record.gameTimeMs = static_cast<uint32_t>(timeMs);
+    return record;
+}
+
+// --- TIMER REMAINING HELPERS (For Draw) ---
+
+// Calculates remaining time for active obstacles
+template <class Rules>
+int Simulation<Rules>::getObstacleTimeRemaining() const {
+    if (!obstaclesActive) return 0;
+    return max(0, (obstacleExpiry - timeMs + 999) / 1000);
+}
+
+// Seconds until the first item of the given type disappears from the board
+template <class Rules>
+int Simulation<Rules>::getItemTimeRemaining(ItemType type) const {
+    int slot = items.findFirst(type);
+    if (slot == NO_ITEM || items.expiryAt(slot) == NEVER_EXPIRES) return 0;
+    return max(0, (items.expiryAt(slot) - timeMs + 999) / 1000);
+}
+
+// ADDED: Calculates remaining time until the next shield spawns
+template <class Rules>
+int Simulation<Rules>::getShieldSpawnRemaining() const {
+    if (items.countOf(ITEM_SHIELD) > 0 || snake.hasShield()) return 0; // Don't show spawn countdown if a shield is already on the map or active on snake
+    int elapsed = timeMs - lastShieldSpawnTime;
+    return max(0, (Rules::SHIELD_SPAWN_INTERVAL * 1000 - elapsed + 999) / 1000);
+}
+
+// --- END TIMER REMAINING HELPERS ---
+
+// Tells the distance field about a step: the tail's cell opens unless the
+// snake grew, the old head's becomes body, and the head is somewhere new
+template <class Rules>
+void Simulation<Rules>::trackMove(Cell oldHead, Cell oldTail, int oldLength) {
+    if (snake.getLength() == oldLength && oldLength > 1) field.removeBlocker(oldTail);
+    if (snake.getLength() > 1) field.addBlocker(oldHead);
+    field.moveSource(snake.getHead());
+}
+
+// Blocker counts change where the head was and is, on the old tail and
+// whatever shrinking took off, and under obstacles that came or went
+template <class Rules>
+template <class Mark>
+void Simulation<Rules>::markTouched(const Simulation& before, Mark&& mark) const {
+    snake.markTouched(before.snake, mark);
+    items.markTouched(before.items, mark);
+    field.markCell(before.snake.getHead(), mark);
+    field.markCell(snake.getHead(), mark);
+    for (int i = max(0, snake.getLength() - 2); i < before.snake.getLength(); i++) {
+        field.markCell(before.snake.getSegment(i), mark);
+    }
+    // Every placing or clearing of obstacles changes one of these
+    if (obstaclesActive != before.obstaclesActive || obstacleExpiry != before.obstacleExpiry) {
+        for (int i = 0; i < before.obstacleCount; i++) {
+            field.markCell(before.obstacles[i], mark);
+        }
+        for (int i = 0; i < obstacleCount; i++) {
+            field.markCell(obstacles[i], mark);
+        }
+    }
+    field.markSource(mark);
+    mark(obstacles, reinterpret_cast<const char*>(this + 1) - reinterpret_cast<const char*>(obstacles));
+}
+
+template <class Rules>
+void Simulation<Rules>::endGame(DeathCause cause) {
+    gameOver = true;
+    deathCause = cause;
+}
+
+template <class Rules>
+void Simulation<Rules>::update() {
+    if (gameOver) return;
+
+    // The tick that is ending lasted one game speed
+    timeMs += getGameSpeed();
+    tickCount++;
+    items.clearTouched();
+
+    Cell oldHead = snake.getHead();
+    Cell oldTail = snake.getSegment(snake.getLength() - 1);
+    int oldLength = snake.getLength();
+    snake.move();
+    // Inside the walls the field follows at once, so this tick's spawns see
+    // the new head; a head past the edge is done below, once it has wrapped
+    // (a shield spawned in between counts from where the head was)
+    Cell moved = snake.getHead();
+    bool inside = moved.x >= 0 && moved.x < WIDTH && moved.y >= 0 && moved.y < HEIGHT;
+    if (inside) trackMove(oldHead, oldTail, oldLength);
+    items.removeExpired(timeMs);
+    if constexpr (Rules::POWER_UPS) {
+        updateShield(); // New: Update shield power-up
+    }
+    if constexpr (Rules::OBSTACLES) {
+        updateObstacles();
+    }
+
+    Cell head = snake.getHead();
+
+    // Check Wall Collision (shield doesn't protect from walls unless the rules say so)
+    if (head.x < 0 || head.x >= WIDTH || 
+        head.y < 0 || head.y >= HEIGHT) {
+        if constexpr (Rules::WRAP_WALLS) {
+            snake.wrapHead();
+        } else if (Rules::SHIELD_PROTECTS_FROM_WALLS && snake.hasShield()) {
+            snake.wrapHead();
+        } else {
+            wallCrash = true;
+
+            // Determine crash position for drawing the dead snake head on the wall
+            if (head.x < 0) crashPosition = Cell(-1, head.y);
+            else if (head.x >= WIDTH) crashPosition = Cell(WIDTH, head.y);
+            else if (head.y < 0) crashPosition = Cell(head.x, -1);
+            else if (head.y >= HEIGHT) crashPosition = Cell(head.x, HEIGHT);
+
+            endGame(DEATH_WALL);
+            return;
+        }
+        head = snake.getHead();
+        trackMove(oldHead, oldTail, oldLength);
+    }
+
+    // Check Maze Wall Collision (like the outer walls, the shield doesn't help)
+    if constexpr (Rules::MAZE) {
+        if (isMazeWall(head)) {
+            endGame(DEATH_WALL);
+            return;
+        }
+    }
+
+    // Check Self Collision (skip if shield is active)
+    if (!snake.hasShield() && snake.occupies(head, 1)) {
+        endGame(DEATH_SELF);
+        return;
+    }
+    
+    // Check Obstacle Collision (skip if shield is active)
+    if constexpr (Rules::OBSTACLES) {
+        if (obstaclesActive && !snake.hasShield() && isObstacle(head)) {
+            endGame(DEATH_OBSTACLE);
+            return;
+        }
+    }
+
+    // Check item pick-up with a single cell lookup
+    int slot = items.findAt(head);
+    if (slot != NO_ITEM) {
+        consumeItem(slot);
+    }
+}
+
+// Game implementation
+template <class Rules>
+BasicGame<Rules>::BasicGame() : sim(static_cast<uint32_t>(time(0))), quit(false), paused(false), queuedTurnCount(0),
+             turnedThisTick(false), autopilot(nullptr), bot(nullptr), io(nullptr), rewind(nullptr), rewindPresses(0),
+             lastRewindNs(0), highScore(0) {
+    setupConsole();
+    screen.hideCursor();
+    
+    if (loadCustomGraphics()) {
+        // Custom graphics loaded silently
+    }
+    
+    // --- HIGH SCORE ADDITION: Load the score upon starting the game
+    loadHighScore();
+}
+
+template <class Rules>
+BasicGame<Rules>::~BasicGame() {
+    screen.showCursor();
+}
+
+// --- HIGH SCORE IMPLEMENTATIONS ---
+
+/**
+ * Loads the high score from the file, setting to 0 if the file doesn't exist
+ * or contains invalid data.
+ */
+template <class Rules>
+void BasicGame<Rules>::loadHighScore() {
+    ifstream file(HIGHSCORE_FILE);
+    if (file.is_open()) {
+        string line;
+        if (getline(file, line)) {
+            try {
+                // Attempt to convert string to integer
+                highScore = stoi(line);
+            } catch (const std::invalid_argument& e) {
+                // Non-numeric data found
+                highScore = 0; 
+            } catch (const std::out_of_range& e) {
+                // Number too large/small
+                highScore = 0;
+            }
+        }
+        file.close();
+    } else {
+        highScore = 0;
+    }
+}
+
+/**
+ * Saves the current score as the new high score if it is greater than the
+ * currently loaded high score.
+ */
+template <class Rules>
+void BasicGame<Rules>::saveHighScore() {
+    if (sim.getScore() > highScore) {
+        highScore = sim.getScore();
+        if (io) {
+            io->replace(HIGHSCORE_FILE, to_string(highScore)); // Off the game thread
+            return;
+        }
+        ofstream file(HIGHSCORE_FILE);
+        if (file.is_open()) {
+            file << highScore;
+            file.close();
+        }
+    }
+}
+
+// --- END HIGH SCORE IMPLEMENTATIONS ---
+
+template <class Rules>
+int BasicGame<Rules>::getGameSpeed() {
+    return sim.getGameSpeed();
+}
+
+template <class Rules>
+void BasicGame<Rules>::setRewind(RewindBuffer<Rules>* buffer) {
+    rewind = buffer;
+    if (rewind) rewind->reset(sim);
+}
+
+// New: Get pause state
+template <class Rules>
+bool BasicGame<Rules>::isPaused() const {
+    return paused;
+}
+
+// Timers run on game time, which stands still while paused, so no
+// compensation is needed when resuming
+template <class Rules>
+void BasicGame<Rules>::togglePause() {
+    paused = !paused;
+}
+
+// Later layers win, so the order matches the drawing priority: obstacles
+// over the head over items over the body
+template <class Rules>
+void composeBoard(const Simulation<Rules>& sim, Glyph* frame) {
+    const Snake& snake = sim.getSnake();
+    const typename Simulation<Rules>::Items& items = sim.getItems();
+    bool gameOver = sim.isGameOver();
+
+    for (int y = 0; y < FRAME_HEIGHT; y++) {
+        for (int x = 0; x < FRAME_WIDTH; x++) {
+            bool border = x == 0 || y == 0 || x == FRAME_WIDTH - 1 || y == FRAME_HEIGHT - 1;
+            frame[y * FRAME_WIDTH + x] = border || sim.isMazeWall(Cell(x - 1, y - 1)) ? GLYPH_WALL : GLYPH_EMPTY;
+        }
+    }
+
+    Glyph bodyGlyph = GLYPH_BODY;
+    if (gameOver) {
+        bodyGlyph = GLYPH_BODY_DEAD;
+    } else if (snake.hasShield() && snake.shouldBlink(sim.getTime())) {
+        bodyGlyph = GLYPH_BODY_SHIELD; // Blinking purple when shield active
+    }
+    for (int i = 1; i < snake.getLength(); i++) {
+        Cell segment = snake.getSegment(i);
+        if (segment.x >= 0 && segment.x < WIDTH && segment.y >= 0 && segment.y < HEIGHT) {
+            frame[(segment.y + 1) * FRAME_WIDTH + segment.x + 1] = bodyGlyph;
+        }
+    }
+
+    if (!gameOver) {
+        const Glyph itemGlyphs[ITEM_TYPE_COUNT] = { GLYPH_FOOD, GLYPH_SPECIAL_FOOD, GLYPH_POISON_FOOD, GLYPH_SHIELD };
+        for (int slot = 0; slot < items.count(); slot++) {
+            Cell cell = items.cellAt(slot);
+            frame[(cell.y + 1) * FRAME_WIDTH + cell.x + 1] = itemGlyphs[items.typeAt(slot)];
+        }
+    }
+
+    // A head that crashed into the outer wall is drawn on the wall
+    Cell head = snake.getHead();
+    if (sim.isWallCrash()) {
+        Cell crashPosition = sim.getCrashPosition();
+        frame[(crashPosition.y + 1) * FRAME_WIDTH + crashPosition.x + 1] = GLYPH_HEAD_DEAD;
+    } else if (head.x >= 0 && head.x < WIDTH && head.y >= 0 && head.y < HEIGHT) {
+        frame[(head.y + 1) * FRAME_WIDTH + head.x + 1] = gameOver ? GLYPH_HEAD_DEAD : GLYPH_HEAD;
+    }
+
+    if constexpr (Rules::OBSTACLES) {
+        for (int i = 0; i < sim.getObstacleCount(); i++) {
+            Cell obs = sim.getObstacles()[i];
+            frame[(obs.y + 1) * FRAME_WIDTH + obs.x + 1] = GLYPH_WALL;
+        }
+    }
+}
+
+template <class Rules>
+void BasicGame<Rules>::draw() {
+    const Snake& snake = sim.getSnake();
+    const typename Simulation<Rules>::Items& items = sim.getItems();
+    bool gameOver = sim.isGameOver();
+    int now = sim.getTime();
+    uint64_t start = monotonicNs();
+
+    screen.clear();
+    
+    screen.addToBuffer("====== 🐍 SNAKE GAME 🐍 ======\n");
+
+    Glyph frame[FRAME_HEIGHT][FRAME_WIDTH];
+    composeBoard(sim, &frame[0][0]);
+
+    // Special food cycles through SPECIAL_FOODS, one glyph per spawn
+    const string* specialGlyph = &SPECIAL_FOOD_EMOJI;
+    if (!gameOver && sim.getSpecialFoodSpawned() > 0) {
+        specialGlyph = &SPECIAL_FOODS[(sim.getSpecialFoodSpawned() - 1) % SPECIAL_FOODS.size()];
+    }
+
+    if (gameOver) {
+        screen.addBoard(&frame[0][0], FRAME_WIDTH, FRAME_HEIGHT, *specialGlyph, "G A M E  O V E R", HEIGHT / 2 - 3);
+    } else if (paused && rewind && rewind->getTicksBack() > 0) {
+        screen.addBoard(&frame[0][0], FRAME_WIDTH, FRAME_HEIGHT, *specialGlyph, "R E W I N D", HEIGHT / 2 - 2);
+    } else if (paused) {
+        screen.addBoard(&frame[0][0], FRAME_WIDTH, FRAME_HEIGHT, *specialGlyph, "P A U S E D", HEIGHT / 2 - 2);
+    } else {
+        screen.addBoard(&frame[0][0], FRAME_WIDTH, FRAME_HEIGHT, *specialGlyph);
+    }
+
+    // --- FIXED: Clean ASCII interface without box drawing characters ---
+    screen.addToBuffer("==============================================\n");
+    if (screen.getOutputLevel() >= OUTPUT_REDUCED_HUD) {
+        // The terminal can't keep up: one line of stats, which changes less often
+        const OutputStats& output = screen.getOutputStats();
+        screen.addToBuffer("Score: " + to_string(sim.getScore()) + " | Length: " + to_string(snake.getLength()) +
+                           " | Slow terminal, " + to_string(output.framesDropped) + " frames dropped      \n");
+    } else {
+        screen.addToBuffer("             GAME STATISTICS                 \n");
+        screen.addToBuffer("----------------------------------------------\n");
+    
+        // Score
+        screen.addToBuffer("Score: " + to_string(sim.getScore()) + " 🏆\n");
+    
+        // High Score
+        screen.addToBuffer("High Score: " + to_string(highScore) + " ⭐\n");
+    
+        // Length
+        screen.addToBuffer("Length: " + to_string(snake.getLength()) + " 📏\n");
+    
+        // Speed
+        screen.addToBuffer("Speed: " + to_string(getGameSpeed()) + "ms 🚀\n");
+    
+        if constexpr (Rules::POWER_UPS) {
+            // Special Food Status
+            string specialFoodStatus;
+            bool specialFoodActive = items.countOf(ITEM_SPECIAL_FOOD) > 0;
+            if (paused && specialFoodActive) {
+                specialFoodStatus = "      PAUSED      ";
+            } else if (specialFoodActive) {
+                int remaining = sim.getItemTimeRemaining(ITEM_SPECIAL_FOOD);
+                specialFoodStatus = "Active " + to_string(remaining) + " s";
+            } else {
+                specialFoodStatus = "Eaten: " + to_string(sim.getSpecialFoodEaten());
+            }
+            screen.addToBuffer("Special Food: " + specialFoodStatus + "        \n");
+        
+            // Shield status (Combined logic for active shield and spawn timer)
+            string shieldStatus;
+            bool shieldOnMap = items.countOf(ITEM_SHIELD) > 0;
+            if (paused) {
+                shieldStatus = "      PAUSED      ";
+            } else if (snake.hasShield()) {
+                // Snake has active shield
+                shieldStatus = "Active " + to_string(snake.getShieldTimeRemaining(now)) + " s 🛡️     ";
+            } else if (shieldOnMap) {
+                // Shield power-up is on the map (Time on map is SHIELD_DURATION)
+                int remaining = sim.getItemTimeRemaining(ITEM_SHIELD);
+                shieldStatus = "Available (" + to_string(remaining) + "s) " + SHIELD_EMOJI;
+            } else {
+                // Waiting for next shield spawn
+                int nextSpawn = sim.getShieldSpawnRemaining();
+                shieldStatus = "Available in " + to_string(nextSpawn) + " s  ";
+            }
+            screen.addToBuffer("Shield: " + shieldStatus + "\n");
+        }
+    
+        if constexpr (Rules::OBSTACLES) {
+            // Obstacles status - full width
+            string obstacleStr;
+            if (paused && sim.hasObstacles()) {
+                obstacleStr = "      PAUSED      ";
+            } else if (sim.hasObstacles()) {
+                int remaining = sim.getObstacleTimeRemaining();
+                obstacleStr = "Active " + to_string(remaining) + " s 🚧      ";
+            } else {
+                obstacleStr = "Clear              ";
+            }
+            screen.addToBuffer("Obstacles: " + obstacleStr + "\n");
+        }
+    
+        if (autopilot) {
+            screen.addToBuffer("Autopilot: " + to_string(static_cast<long long>(autopilot->getLastRolloutsPerSecond() / 1000)) +
+                               "k rollouts/s on " + to_string(autopilot->getThreadCount()) + " threads (" +
+                               to_string(autopilot->getBudgetMs()) + " ms) 🤖    \n");
+        }
+        if (rewind) {
+            // Tenths of a second
+            auto seconds = [](int ms) { return to_string(ms / 1000) + "." + to_string(ms / 100 % 10); };
+            string back = rewind->getTicksBack() > 0 ? ", " + seconds(rewind->getMsBack()) + " s back" : "";
+            screen.addToBuffer("Rewind: " + seconds(rewind->getMsAvailable()) + " s kept" + back + ", " +
+                               to_string(rewind->getPoolUsed() * 100 / RewindBuffer<Rules>::POOL_WORDS) +
+                               "% of store ⏪    \n");
+        }
+        if (bot) {
+            screen.addToBuffer("Bot: " + bot->getName() + ", " + to_string(bot->getOverruns()) + " overruns of " +
+                               to_string(bot->getBudgetMs()) + " ms" + (bot->isDemoted() ? " (demoted)" : "") + " 🔌    \n");
+        }
+    
+        if (AllocStats::enabled()) {
+            screen.addToBuffer("Allocs/tick: input " + to_string(AllocStats::getLastTickAllocations(PHASE_INPUT)) +
+                               " | update " + to_string(AllocStats::getLastTickAllocations(PHASE_UPDATE)) +
+                               " | draw " + to_string(AllocStats::getLastTickAllocations(PHASE_DRAW)) +
+                               " | flush " + to_string(AllocStats::getLastTickAllocations(PHASE_FLUSH)) + "    \n");
+        }
+    
+        screen.addToBuffer("Display: " + string(RENDER_MODE_NAMES[screen.getRenderMode()]) + ", board " +
+                           to_string(screen.getLastBoardBytes()) + " of " + to_string(screen.getLastFrameBytes()) +
+                           " bytes/frame" + (screen.getOutputLevel() == OUTPUT_DIFF ? ", changed lines only" : "") +
+                           "        \n");
+    }
+    
+    screen.addToBuffer("----------------------------------------------\n");
+    
+    // Controls
+    if (rewind) {
+        screen.addToBuffer("Controls: WASD/Arrows | SPACE: Pause | B: Rewind | R: Display | Q: Quit\n");
+    } else {
+        screen.addToBuffer("Controls: WASD/Arrows | SPACE: Pause | R: Display | Q: Quit\n");
+    }
+    
+    if (paused && rewind && rewind->getTicksBack() > 0) {
+        screen.addToBuffer("        *** REWOUND: SPACE plays on from here ***        \n");
+    } else if (paused) {
+        screen.addToBuffer("               *** GAME PAUSED ***               \n");
+    }
+    
+    if (gameOver && rewind) {
+        screen.addToBuffer("          💀 GAME OVER! B: Rewind | Q: Quit 💀          \n");
+    } else if (gameOver) {
+        screen.addToBuffer("                 💀 GAME OVER! 💀                \n");
+    }
+    
+    screen.addToBuffer("==============================================\n");
+
+    Metrics::observe(METRIC_FRAME_COMPOSE, monotonicNs() - start);
+    screen.draw(!paused && !gameOver);
+}
+
+template <class Rules>
+void BasicGame<Rules>::update() {
+    // Game logic stops while paused
+    if (sim.isGameOver() || paused) return;
+
+    if (autopilot) {
+        sim.changeDirection(autopilot->decide(sim));
+    } else if (bot) {
+        Direction move = bot->decide(sim); // STOP: late, busy or demoted, keep going
+        if (move != STOP) sim.changeDirection(move);
+    }
+    sim.update();
+
+    // Next queued turn for the new tick
+    turnedThisTick = false;
+    if (queuedTurnCount > 0) {
+        Direction next = queuedTurns[0];
+        queuedTurnCount--;
+        for (int i = 0; i < queuedTurnCount; i++) {
+            queuedTurns[i] = queuedTurns[i + 1];
+        }
+        turn(next);
+    }
+    if (rewind) rewind->record(sim); // After the queued turn, which is part of the state too
+
+    // A practice score isn't one: the game could be rewound past any mistake
+    if (sim.isGameOver() && !rewind) {
+        saveHighScore(); // --- HIGH SCORE ADDITION: Save on game over
+    }
+}
+
+template <class Rules>
+void BasicGame<Rules>::handleInput() {
+    // Everything waiting on stdin in one read, then every key it holds
+    unsigned char bytes[INPUT_BUFFER_SIZE];
+    Key decoded[INPUT_BUFFER_SIZE];
+    int count = keys.feed(bytes, InputHandler::readAvailable(bytes, INPUT_BUFFER_SIZE), decoded);
+
+    for (int i = 0; i < count; i++) {
+        switch (decoded[i]) {
+            case KEY_UP:    turn(UP); break;
+            case KEY_DOWN:  turn(DOWN); break;
+            case KEY_LEFT:  turn(LEFT); break;
+            case KEY_RIGHT: turn(RIGHT); break;
+            case KEY_PAUSE: togglePause(); break; // New: Spacebar toggles pause
+            case KEY_QUIT:  quit = true; break;
+            case KEY_RENDER:
+                screen.setRenderMode(static_cast<RenderMode>((screen.getRenderMode() + 1) % RENDER_MODE_COUNT));
+                break;
+            case KEY_REWIND: stepBack(); break;
+            case KEY_NONE:  break;
+        }
+    }
+}
+
+// Held down, the key repeats, and every eighth repeat doubles the step, up
+// to MAX_REWIND_STEP ticks: a minute goes by in a few seconds
+template <class Rules>
+void BasicGame<Rules>::stepBack() {
+    if (!rewind) return;
+    uint64_t now = monotonicNs();
+    bool held = now - lastRewindNs < static_cast<uint64_t>(REWIND_REPEAT_MS) * 1000000;
+    rewindPresses = held ? rewindPresses + 1 : 0;
+    lastRewindNs = now;
+
+    // Paused on the state rewound to; playing on from it drops the ticks after it
+    paused = true;
+    int step = 1 << min(rewindPresses / 8, 30);
+    rewind->rewind(sim, step < MAX_REWIND_STEP ? step : MAX_REWIND_STEP);
+    queuedTurnCount = 0; // Turns meant for the state left behind
+    turnedThisTick = false;
+}
+
+template <class Rules>
+void BasicGame<Rules>::turn(Direction dir) {
+    if (!turnedThisTick) {
+        sim.changeDirection(dir);
+        turnedThisTick = true;
+    } else if (queuedTurnCount < MAX_QUEUED_TURNS) {
+        queuedTurns[queuedTurnCount++] = dir;
+    }
+}
+
+template <class Rules>
+bool BasicGame<Rules>::isGameOver() const {
+    return sim.isGameOver();
+}
+
+template <class Rules>
+bool BasicGame<Rules>::shouldQuit() const {
+    return quit || (sim.isGameOver() && !rewind);
+}
+
+// RewindBuffer implementation
+template <class Rules>
+void RewindBuffer<Rules>::reset(const Simulation<Rules>& state) {
+    memcpy(latest, static_cast<const void*>(&state), sizeof(latest));
+    oldest = newest = cursor = 0;
+    frameOf(0) = Frame{ poolEnd, 0, state.getTime() };
+    memcpy(keyframeOf(0), latest, sizeof(latest));
+}
+
+template <class Rules>
+void RewindBuffer<Rules>::apply(long long tick, uint64_t* state) const {
+    const Frame& frame = frameOf(tick);
+    for (uint64_t i = frame.firstChange; i < frame.firstChange + frame.changes; i++) {
+        state[changedWord[i & (POOL_WORDS - 1)]] ^= changedBits[i & (POOL_WORDS - 1)];
+    }
+}
+
+template <class Rules>
+void RewindBuffer<Rules>::compare(const unsigned char* state, const uint32_t* touched) {
+    for (int block = 0; block < (WORDS + 31) / 32; block++) {
+        for (uint32_t bits = touched[block]; bits != 0; bits &= bits - 1) {
+            int i = block * 32 + lowestSetBit(bits);
+            uint64_t word, last;
+            memcpy(&word, state + i * 8, 8);
+            memcpy(&last, latest + i * 8, 8);
+            if (word != last) {
+                changedWord[poolEnd & (POOL_WORDS - 1)] = static_cast<uint16_t>(i);
+                changedBits[poolEnd & (POOL_WORDS - 1)] = word ^ last;
+                memcpy(latest + i * 8, &word, 8);
+                poolEnd++;
+            }
+        }
+    }
+}
+
+template <class Rules>
+void RewindBuffer<Rules>::record(const Simulation<Rules>& state) {
+    if (cursor != newest) {
+        // Played on from a rewind: what came after the cursor never happened
+        memcpy(latest, rewound, sizeof(latest));
+        poolEnd = frameOf(cursor + 1).firstChange;
+        newest = cursor;
+    }
+    records++;
+    newest++;
+    cursor = newest;
+    if (newest - oldest >= MAX_TICKS) oldest++; // Its slot is the new tick's
+
+    // Every word the tick can have touched first, then those words compared,
+    // as comparing writes to latest
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&state);
+    const Simulation<Rules>& before = *reinterpret_cast<const Simulation<Rules>*>(latest);
+    uint32_t touched[(WORDS + 31) / 32] = {};
+    state.markTouched(before, [&](const void* at, size_t size) {
+        size_t offset = static_cast<const unsigned char*>(at) - bytes;
+        for (size_t i = offset / 8; i < (offset + size + 7) / 8; i++) {
+            touched[i / 32] |= 1u << (i % 32);
+        }
+    });
+    uint64_t start = poolEnd;
+    compare(bytes, touched);
+    Frame& frame = frameOf(newest);
+    frame = Frame{ start, static_cast<uint32_t>(poolEnd - start), state.getTime() };
+    if (newest % KEYFRAME_INTERVAL == 0) memcpy(keyframeOf(newest), latest, sizeof(latest));
+
+    // Forget ticks whose changes were just written over, and the ones past the window
+    while (oldest < newest && (poolEnd - frameOf(oldest + 1).firstChange > static_cast<uint64_t>(POOL_WORDS) ||
+                               frame.timeMs - frameOf(oldest).timeMs > WINDOW_MS)) {
+        oldest++;
+    }
+}
+
+template <class Rules>
+int RewindBuffer<Rules>::rewind(Simulation<Rules>& state, int ticks) {
+    long long target = max(oldest, cursor - max(ticks, 0));
+    if (cursor == newest) memcpy(rewound, latest, sizeof(rewound));
+
+    // Walk from the cursor, or from the nearest keyframe if that is closer
+    long long below = target / KEYFRAME_INTERVAL * KEYFRAME_INTERVAL;
+    long long above = below + KEYFRAME_INTERVAL;
+    long long from = cursor;
+    if (below >= oldest && target - below < from - target) from = below;
+    if (above <= cursor && above - target < llabs(from - target)) from = above;
+    if (from != cursor) memcpy(rewound, keyframeOf(from), sizeof(rewound));
+    for (long long tick = from; tick > target; tick--) {
+        apply(tick, rewound);
+    }
+    for (long long tick = from + 1; tick <= target; tick++) {
+        apply(tick, rewound);
+    }
+
+    int went = static_cast<int>(cursor - target);
+    cursor = target;
+    memcpy(static_cast<void*>(&state), rewound, sizeof(rewound));
+    return went;
+}
+
+// Path pilot implementation
+template <class Rules>
+Direction pathTowardsNearestItem(const Simulation<Rules>& sim) {
+    const typename Simulation<Rules>::Items& items = sim.getItems();
+    const DistanceField<Rules::WRAP_WALLS>& field = sim.getDistanceField();
+    Cell head = sim.getSnake().getHead();
+    Direction current = sim.getSnake().getDirection();
+    int target = NO_ITEM;
+    int bestDistance = DistanceField<Rules::WRAP_WALLS>::UNREACHABLE;
+    for (int slot = 0; slot < items.count(); slot++) {
+        if (items.typeAt(slot) == ITEM_POISON_FOOD) continue;
+        int distance = field.distanceTo(items.cellAt(slot));
+        if (distance < bestDistance) {
+            bestDistance = distance;
+            target = slot;
+        }
+    }
+    if (target != NO_ITEM) {
+        // The step's direction, across the wall too
+        Cell next = field.stepTowards(items.cellAt(target));
+        int dx = next.x - head.x;
+        int dy = next.y - head.y;
+        Direction dir = dx == 1 || dx == -(WIDTH - 1) ? RIGHT
+                      : dx == -1 || dx == WIDTH - 1 ? LEFT
+                      : dy == 1 || dy == -(HEIGHT - 1) ? DOWN : UP;
+        if (!isReverse(dir, current) && !sim.wouldCollide(dir)) return dir;
+    }
+    for (Direction dir : { current, RIGHT, DOWN, LEFT, UP }) {
+        if (!isReverse(dir, current) && !sim.wouldCollide(dir)) return dir;
+    }
+    return current;
+}
+
+// Autopilot implementation
+
+// The cell a move leads to, through the walls if they wrap
+template <bool WRAP>
+static Cell stepFrom(Cell cell, Direction dir) {
+    switch (dir) {
+        case LEFT:  cell.x--; break;
+        case RIGHT: cell.x++; break;
+        case UP:    cell.y--; break;
+        case DOWN:  cell.y++; break;
+        case STOP:  break;
+    }
+    if (WRAP) cell = Cell((cell.x + WIDTH) % WIDTH, (cell.y + HEIGHT) % HEIGHT);
+    return cell;
+}
+
+template <class Rules>
+Autopilot<Rules>::Autopilot(int threadsWanted, int budget) : table(TABLE_SLOTS), hasTarget(false), root(nullptr), generation(0), pending(0), stopping(false),
+             lastRollouts(0), lastSeconds(0), totalRollouts(0), totalSeconds(0) {
+    threadCount = threadsWanted > 0 ? threadsWanted : max(1, static_cast<int>(thread::hardware_concurrency()));
+    budgetMs = min(max(budget, 1), MAX_BUDGET_MS);
+
+    // Node pools are allocated once, searching never touches the heap
+    workers.resize(threadCount);
+    for (int i = 0; i < threadCount; i++) {
+        workers[i].nodes.reserve(NODES_PER_THREAD);
+        workers[i].rng.setSeed(0x5eed + i);
+        workers[i].rollouts = 0;
+    }
+    for (int i = 1; i < threadCount; i++) {
+        threads.emplace_back(&Autopilot::workerLoop, this, i);
+    }
+}
+
+template <class Rules>
+Autopilot<Rules>::~Autopilot() {
+    {
+        lock_guard<mutex> lock(jobMutex);
+        stopping = true;
+    }
+    jobReady.notify_all();
+    for (thread& worker : threads) {
+        worker.join();
+    }
+}
+
+template <class Rules>
+void Autopilot<Rules>::workerLoop(int index) {
+    int seen = 0;
+    while (true) {
+        {
+            unique_lock<mutex> lock(jobMutex);
+            jobReady.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping) return;
+            seen = generation;
+        }
+        search(workers[index]);
+        {
+            lock_guard<mutex> lock(jobMutex);
+            if (--pending == 0) jobDone.notify_one();
+        }
+    }
+}
+
+template <class Rules>
+Direction Autopilot<Rules>::decide(const Simulation<Rules>& sim) {
+    auto start = chrono::steady_clock::now();
+    table.clear(); // Rewards are relative to the root, so last tick's don't carry over
+    aim(sim);
+    {
+        lock_guard<mutex> lock(jobMutex);
+        root = &sim;
+        deadline = start + chrono::milliseconds(budgetMs);
+        pending = threadCount - 1;
+        generation++;
+    }
+    jobReady.notify_all();
+    search(workers[0]);
+    {
+        unique_lock<mutex> lock(jobMutex);
+        jobDone.wait(lock, [&] { return pending == 0; });
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    // Add up the root statistics of every tree, indexed by Direction
+    long long visits[5] = { 0 };
+    double values[5] = { 0 };
+    long long rollouts = 0;
+    for (const Worker& worker : workers) {
+        rollouts += worker.rollouts;
+        const Node& top = worker.nodes[0];
+        for (int child = top.firstChild; child >= 0 && child < top.firstChild + top.childCount; child++) {
+            visits[worker.nodes[child].move] += worker.nodes[child].visits;
+            values[worker.nodes[child].move] += worker.nodes[child].value;
+        }
+    }
+
+    lastRollouts = rollouts;
+    lastSeconds = seconds;
+    totalRollouts += rollouts;
+    totalSeconds += seconds;
+
+    // Most visited move wins, the better average breaks ties
+    Direction best = sim.getSnake().getDirection();
+    for (int dir = LEFT; dir <= DOWN; dir++) {
+        if (visits[dir] == 0) continue;
+        if (visits[best] == 0 || visits[dir] > visits[best] ||
+            (visits[dir] == visits[best] && values[dir] > values[best])) {
+            best = static_cast<Direction>(dir);
+        }
+    }
+
+    // Rollouts sample the spawns, so a small lead in the average is as likely
+    // noise: a step along the way to the target that is about as good goes first
+    int moves = movesToTarget(sim);
+    if (moves > 0 && visits[best] > 0) {
+        for (int dir = LEFT; dir <= DOWN; dir++) {
+            if (visits[dir] == 0) continue;
+            Cell next = stepFrom<Rules::WRAP_WALLS>(sim.getSnake().getHead(), static_cast<Direction>(dir));
+            bool onBoard = next.x >= 0 && next.x < WIDTH && next.y >= 0 && next.y < HEIGHT;
+            if (onBoard && toTarget[next.y * WIDTH + next.x] == moves - 1 &&
+                values[dir] / visits[dir] >= values[best] / visits[best] - TIE_MARGIN) {
+                return static_cast<Direction>(dir);
+            }
+        }
+    }
+    return best;
+}
+
+template <class Rules>
+void Autopilot<Rules>::search(Worker& worker) {
+    const Simulation<Rules>& start = *root;
+    worker.nodes.clear();
+    worker.nodes.push_back({ 0.0f, 0, -1, 0, STOP, 0 });
+    worker.rollouts = 0;
+    if (start.isGameOver()) return;
+    expand(worker, 0, start.getSnake().getDirection());
+
+    Cell food;
+    int startDistance = movesToTarget(start);
+    bool startOnTarget = startDistance >= 0;
+    if (!startOnTarget) startDistance = nearestFood(start, food);
+    int path[HORIZON + 1];
+    do {
+        // Check the clock every few iterations only
+        for (int batch = 0; batch < 8; batch++) {
+            Playout playout = { start, 0, start.getScore(), startDistance, startOnTarget, 1.0f, 0.0f };
+            playout.state.reseed(worker.rng.next());
+            playout.state.skipReachChecks(); // A search per spawn would cost more than the playout
+
+            // Walk down the tree, replaying its moves on the copy
+            int node = 0;
+            int length = 0;
+            path[length++] = node;
+            while (worker.nodes[node].firstChild >= 0 && !playout.state.isGameOver() && length <= HORIZON) {
+                node = select(worker, node);
+                step(playout, worker.nodes[node].move);
+                worker.nodes[node].position = playout.state.getPositionHash();
+                path[length++] = node;
+            }
+
+            // Grow the tree by one level once a leaf has been tried a few times
+            if (!playout.state.isGameOver() && length <= HORIZON && worker.nodes[node].visits >= EXPAND_AFTER) {
+                int child = expand(worker, node, playout.state.getSnake().getDirection());
+                if (child >= 0) {
+                    node = child;
+                    step(playout, worker.nodes[node].move);
+                    worker.nodes[node].position = playout.state.getPositionHash();
+                    path[length++] = node;
+                }
+            }
+
+            float reward = rollout(playout, worker.rng);
+            for (int i = 0; i < length; i++) {
+                worker.nodes[path[i]].visits++;
+                worker.nodes[path[i]].value += reward;
+                if (i > 0) table.add(worker.nodes[path[i]].position, reward);
+            }
+            worker.rollouts++;
+        }
+    } while (chrono::steady_clock::now() < deadline);
+}
+
+// Adds a child for every move but the reversal and returns a random one, or
+// -1 if the node pool is full
+template <class Rules>
+int Autopilot<Rules>::expand(Worker& worker, int node, Direction current) {
+    if (static_cast<int>(worker.nodes.size()) + 4 > NODES_PER_THREAD) return -1;
+
+    int first = static_cast<int>(worker.nodes.size());
+    for (Direction dir : { LEFT, RIGHT, UP, DOWN }) {
+        if (!isReverse(dir, current)) {
+            worker.nodes.push_back({ 0.0f, 0, -1, 0, dir, 0 });
+        }
+    }
+    worker.nodes[node].firstChild = first;
+    worker.nodes[node].childCount = static_cast<unsigned char>(worker.nodes.size() - first);
+    return first + worker.rng.below(worker.nodes[node].childCount);
+}
+
+// UCT: untried children first, then the best mean reward plus exploration
+// bonus. A child whose position the table knows better (from all threads)
+// goes by the table's statistics instead of its own.
+template <class Rules>
+int Autopilot<Rules>::select(const Worker& worker, int node) const {
+    const Node& parent = worker.nodes[node];
+    int visits[4];
+    float values[4];
+    int totalVisits = 0;
+    for (int i = 0; i < parent.childCount; i++) {
+        const Node& candidate = worker.nodes[parent.firstChild + i];
+        if (candidate.visits == 0) return parent.firstChild + i;
+        visits[i] = candidate.visits;
+        values[i] = candidate.value;
+        int sharedVisits;
+        float sharedValue;
+        if (table.find(candidate.position, sharedVisits, sharedValue) && sharedVisits > visits[i]) {
+            visits[i] = sharedVisits;
+            values[i] = sharedValue;
+        }
+        totalVisits += visits[i];
+    }
+
+    float logVisits = log(static_cast<float>(totalVisits + 1));
+    int best = parent.firstChild;
+    float bestScore = -1.0f;
+    for (int i = 0; i < parent.childCount; i++) {
+        int child = parent.firstChild + i;
+        float score = values[i] / visits[i] + EXPLORATION * sqrt(logVisits / visits[i]);
+        if (score > bestScore) {
+            bestScore = score;
+            best = child;
+        }
+    }
+    return best;
+}
+
+template <class Rules>
+void Autopilot<Rules>::step(Playout& playout, Direction dir) const {
+    playout.state.changeDirection(dir);
+    playout.state.update();
+    playout.ticks++;
+    playout.weight *= DISCOUNT;
+
+    // Besides the points themselves, every step towards the food earns a
+    // little, so rollouts that don't reach any food still tell moves apart:
+    // moves along the way to the root's target while it's up, the straight
+    // line to the nearest food after. The jump to the next food after eating,
+    // or from one measure to the other, doesn't count.
+    int distance = movesToTarget(playout.state);
+    bool onTarget = distance >= 0;
+    Cell food;
+    if (!onTarget) distance = nearestFood(playout.state, food);
+    int points = playout.state.getScore() - playout.lastScore;
+    float progress = 0.0f;
+    if (points == 0 && onTarget == playout.lastOnTarget && distance >= 0 && playout.lastDistance >= 0) {
+        progress = STEP_POINTS * (playout.lastDistance - distance);
+    }
+    playout.gain += playout.weight * (points + progress);
+    playout.lastScore = playout.state.getScore();
+    playout.lastDistance = distance;
+    playout.lastOnTarget = onTarget;
+}
+
+template <class Rules>
+float Autopilot<Rules>::rollout(Playout& playout, FastRandom& rng) const {
+    while (playout.ticks < HORIZON && !playout.state.isGameOver()) {
+        step(playout, rolloutMove(playout.state, rng));
+    }
+
+    // Dying is always worse than surviving, dying later a little less so
+    if (playout.state.isGameOver()) {
+        return 0.3f * playout.ticks / HORIZON;
+    }
+
+    // Survivors score by what they gained, squashed into (0.4, 1)
+    return 0.4f + 0.6f * (0.5f + 0.5f * playout.gain / (fabs(playout.gain) + 20.0f));
+}
+
+// The safe step along the way to the root's target while it's up. After
+// that, mostly a safe step towards the nearest food, now and then a random one.
+template <class Rules>
+Direction Autopilot<Rules>::rolloutMove(const Simulation<Rules>& state, FastRandom& rng) const {
+    Direction current = state.getSnake().getDirection();
+    Direction options[4];
+    int count = 0;
+    for (Direction dir : { LEFT, RIGHT, UP, DOWN }) {
+        if (!isReverse(dir, current) && !state.wouldCollide(dir)) {
+            options[count++] = dir;
+        }
+    }
+    if (count == 0) return current;
+
+    Cell head = state.getSnake().getHead();
+    if (movesToTarget(state) >= 0) {
+        int best = 0;
+        uint16_t bestMoves = DistanceField<Rules::WRAP_WALLS>::UNREACHABLE;
+        for (int i = 0; i < count; i++) {
+            Cell next = stepFrom<Rules::WRAP_WALLS>(head, options[i]);
+            uint16_t moves = toTarget[next.y * WIDTH + next.x];
+            if (moves < bestMoves) {
+                bestMoves = moves;
+                best = i;
+            }
+        }
+        return options[best];
+    }
+
+    Cell food;
+    if (rng.below(10) != 0 && nearestFood(state, food) >= 0) {
+        for (int i = 0; i < count; i++) {
+            if ((options[i] == LEFT && food.x < head.x) || (options[i] == RIGHT && food.x > head.x) ||
+                (options[i] == UP && food.y < head.y) || (options[i] == DOWN && food.y > head.y)) {
+                return options[i];
+            }
+        }
+    }
+    return options[rng.below(count)];
+}
+
+// The special food if the snake can get there before it goes, else the
+// nearest food, by the way there as the distance field has it; then a search
+// out from it. One search more a decision, and the rollouts go around the
+// body instead of into it.
+template <class Rules>
+void Autopilot<Rules>::aim(const Simulation<Rules>& sim) {
+    typedef DistanceField<Rules::WRAP_WALLS> Field;
+    hasTarget = false;
+    if (sim.isGameOver()) return;
+    const typename Simulation<Rules>::Items& items = sim.getItems();
+    uint16_t best = Field::UNREACHABLE;
+    bool special = false;
+    for (int slot = 0; slot < items.count(); slot++) {
+        ItemType type = items.typeAt(slot);
+        if (type != ITEM_FOOD && type != ITEM_SPECIAL_FOOD) continue;
+        uint16_t moves = sim.getDistanceField().distanceTo(items.cellAt(slot));
+        if (moves == Field::UNREACHABLE) continue;
+        bool inTime = type == ITEM_SPECIAL_FOOD && (items.expiryAt(slot) == NEVER_EXPIRES ||
+                      sim.getTime() + moves * sim.getGameSpeed() < items.expiryAt(slot));
+        if ((inTime && !special) || (inTime == special && moves < best)) {
+            best = moves;
+            special = inTime;
+            target = items.cellAt(slot);
+        }
+    }
+    if (best == Field::UNREACHABLE) return;
+    Field fromTarget = sim.getDistanceField();
+    fromTarget.moveSource(target);
+    fromTarget.search(toTarget);
+    hasTarget = true;
+}
+
+template <class Rules>
+int Autopilot<Rules>::movesToTarget(const Simulation<Rules>& state) const {
+    if (!hasTarget || state.getItems().findAt(target) == NO_ITEM) return -1;
+    Cell head = state.getSnake().getHead();
+    if (head.x < 0 || head.x >= WIDTH || head.y < 0 || head.y >= HEIGHT) return -1;
+    uint16_t moves = toTarget[head.y * WIDTH + head.x];
+    return moves == DistanceField<Rules::WRAP_WALLS>::UNREACHABLE ? -1 : moves;
+}
+
+template <class Rules>
+int Autopilot<Rules>::nearestFood(const Simulation<Rules>& state, Cell& target) const {
+    const typename Simulation<Rules>::Items& items = state.getItems();
+    Cell head = state.getSnake().getHead();
+    int bestDistance = -1;
+    for (int slot = 0; slot < items.count(); slot++) {
+        ItemType type = items.typeAt(slot);
+        if (type != ITEM_FOOD && type != ITEM_SPECIAL_FOOD) continue;
+        Cell cell = items.cellAt(slot);
+        int distance = abs(cell.x - head.x) + abs(cell.y - head.y);
+        if (bestDistance < 0 || distance < bestDistance) {
+            bestDistance = distance;
+            target = cell;
+        }
+    }
+    return bestDistance;
+}
+
+template <class Rules>
+double Autopilot<Rules>::getLastRolloutsPerSecond() const {
+    return lastSeconds > 0 ? lastRollouts / lastSeconds : 0.0;
+}
+
+template <class Rules>
+double Autopilot<Rules>::getRolloutsPerSecond() const {
+    return totalSeconds > 0 ? totalRollouts / totalSeconds : 0.0;
+}
+
+// Shared state implementation
+uint64_t monotonicNs() {
+    return static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(
+        chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+StatePublisher::StatePublisher() : segment(nullptr), bellFd(-1), bellKeepAliveFd(-1), commandsTaken(0),
+             commandLatencyNs(0), maxCommandLatencyNs(0) {}
+
+#ifdef _WIN32
+bool StatePublisher::open(const string&) { return false; }
+
+StatePublisher::~StatePublisher() {}
+
+int StatePublisher::takeCommands(Direction*, int) { return 0; }
+
+StateSubscriber::StateSubscriber() : segment(nullptr), bellFd(-1) {}
+
+StateSubscriber::~StateSubscriber() {}
+
+bool StateSubscriber::open(const string&) { return false; }
+#else
+// The doorbell lives next to the segment's name under /tmp
+static string doorbellPath(const string& name) {
+    return "/tmp/" + name.substr(name.find_first_not_of('/')) + ".bell";
+}
+
+bool StatePublisher::open(const string& name) {
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd < 0) return false;
+    bool sized = ftruncate(fd, sizeof(SharedSegment)) == 0;
+    void* mapping = sized ? mmap(nullptr, sizeof(SharedSegment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        shm_unlink(name.c_str());
+        return false;
+    }
+
+    string path = doorbellPath(name);
+    unlink(path.c_str());
+    if (mkfifo(path.c_str(), 0600) == 0) {
+        bellFd = ::open(path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+        bellKeepAliveFd = ::open(path.c_str(), O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+    }
+    if (bellFd < 0 || bellKeepAliveFd < 0) {
+        if (bellFd >= 0) close(bellFd);
+        bellFd = -1;
+        unlink(path.c_str());
+        munmap(mapping, sizeof(SharedSegment));
+        shm_unlink(name.c_str());
+        return false;
+    }
+
+    // A fresh mapping is zero-filled; readers ignore it until the magic is set
+    segment = new (mapping) SharedSegment();
+    segment->version = SharedSegment::VERSION;
+    segment->size = sizeof(SharedSegment);
+    segment->magic = SharedSegment::MAGIC;
+    segment->live.store(1, memory_order_release);
+    segmentName = name;
+    bellPath = path;
+    return true;
+}
+
+StatePublisher::~StatePublisher() {
+    if (!segment) return;
+    segment->live.store(0, memory_order_release);
+    munmap(segment, sizeof(SharedSegment));
+    shm_unlink(segmentName.c_str());
+    close(bellFd);
+    close(bellKeepAliveFd);
+    unlink(bellPath.c_str());
+}
+
+int StatePublisher::takeCommands(Direction* directions, int capacity) {
+    if (!segment) return 0;
+    char drained[64];
+    while (read(bellFd, drained, sizeof(drained)) > 0) {}
+
+    int count = 0;
+    uint64_t now = monotonicNs();
+    uint32_t tail = segment->commandTail.load(memory_order_relaxed);
+    uint32_t head = segment->commandHead.load(memory_order_acquire);
+    for (; tail != head; tail++) {
+        const SharedCommand& command = segment->commands[tail % SharedSegment::COMMAND_RING_SIZE];
+        if (command.direction != STOP && command.direction <= DOWN) {
+            if (count == capacity) break; // The rest wait for the next call
+            directions[count++] = static_cast<Direction>(command.direction);
+        }
+        long long latency = static_cast<long long>(now - command.sentNs);
+        commandLatencyNs += latency;
+        maxCommandLatencyNs = max(maxCommandLatencyNs, latency);
+        commandsTaken++;
+    }
+    segment->commandTail.store(tail, memory_order_release);
+    return count;
+}
+
+StateSubscriber::StateSubscriber() : segment(nullptr), bellFd(-1) {}
+
+StateSubscriber::~StateSubscriber() {
+    if (segment) munmap(segment, sizeof(SharedSegment));
+    if (bellFd >= 0) close(bellFd);
+}
+
+bool StateSubscriber::open(const string& name) {
+    int fd = shm_open(name.c_str(), O_RDWR | O_CLOEXEC, 0);
+    if (fd < 0) return false;
+    struct stat info;
+    bool sized = fstat(fd, &info) == 0 && info.st_size >= static_cast<off_t>(sizeof(SharedSegment));
+    void* mapping = sized ? mmap(nullptr, sizeof(SharedSegment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (mapping == MAP_FAILED) return false;
+
+    SharedSegment* candidate = static_cast<SharedSegment*>(mapping);
+    if (candidate->magic != SharedSegment::MAGIC || candidate->version != SharedSegment::VERSION ||
+        candidate->size != sizeof(SharedSegment)) {
+        munmap(mapping, sizeof(SharedSegment));
+        return false;
+    }
+    bellFd = ::open(doorbellPath(name).c_str(), O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+    if (bellFd < 0) {
+        munmap(mapping, sizeof(SharedSegment));
+        return false;
+    }
+    segment = candidate;
+    return true;
+}
+#endif
+
+double StatePublisher::getAverageCommandLatencyUs() const {
+    return commandsTaken > 0 ? commandLatencyNs / 1000.0 / commandsTaken : 0.0;
+}
+
+// Writes the tick in place between the two sequence bumps
+template <class Rules>
+void StatePublisher::publish(const Simulation<Rules>& sim, bool paused) {
+    if (!segment) return;
+    uint32_t sequence = segment->sequence.load(memory_order_relaxed);
+    segment->sequence.store(sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    fillSharedState(sim, paused, segment->state);
+
+    segment->sequence.store(sequence + 2, memory_order_release);
+}
+
+template <class Rules>
+void fillSharedState(const Simulation<Rules>& sim, bool paused, SharedGameState& state) {
+    const Snake& snake = sim.getSnake();
+    const typename Simulation<Rules>::Items& items = sim.getItems();
+    state.tick = static_cast<uint64_t>(sim.getTickCount());
+    state.stateHash = sim.getStateHash();
+    state.timeMs = sim.getTime();
+    state.score = sim.getScore();
+    state.speedMs = sim.getGameSpeed();
+    state.shieldRemainingMs = snake.hasShield() ? max(0, snake.getShieldExpiry() - sim.getTime()) : 0;
+    state.shieldSpawnRemaining = sim.getShieldSpawnRemaining();
+    state.obstacleRemaining = sim.getObstacleTimeRemaining();
+    state.mode = Rules::ID;
+    state.direction = snake.getDirection();
+    state.gameOver = sim.isGameOver();
+    state.paused = paused;
+    state.deathCause = sim.getDeathCause();
+    state.length = static_cast<int16_t>(snake.getLength());
+    state.itemCount = static_cast<int16_t>(items.count());
+
+    memset(state.board, BOARD_EMPTY, sizeof(state.board));
+    if constexpr (Rules::MAZE) {
+        for (int y = 0; y < HEIGHT; y++) {
+            for (int x = 0; x < WIDTH; x++) {
+                if (sim.isMazeWall(Cell(x, y))) state.board[y][x] = BOARD_MAZE_WALL;
+            }
+        }
+    }
+    for (int i = 0; i < sim.getObstacleCount(); i++) {
+        Cell cell = sim.getObstacles()[i];
+        state.board[cell.y][cell.x] = BOARD_OBSTACLE;
+    }
+    for (int slot = 0; slot < items.count(); slot++) {
+        SharedItem& item = state.items[slot];
+        item.cell = items.cellAt(slot);
+        item.type = items.typeAt(slot);
+        item.expiresAt = items.expiryAt(slot);
+        state.board[item.cell.y][item.cell.x] = static_cast<uint8_t>(BOARD_ITEM + item.type);
+    }
+    for (int i = snake.getLength() - 1; i >= 0; i--) {
+        Cell cell = snake.getSegment(i);
+        state.body[i] = cell;
+        // The head is off the board after a wall crash
+        if (cell.x >= 0 && cell.x < WIDTH && cell.y >= 0 && cell.y < HEIGHT) {
+            state.board[cell.y][cell.x] = i == 0 ? BOARD_HEAD : BOARD_BODY;
+        }
+    }
+    state.publishedNs = monotonicNs();
+}
+
+// Seqlock read: retry while the game is mid-write or wrote during the copy.
+// A write takes a microsecond or so: spin briefly, then yield, and give up
+// if the game is gone or has left a write open for WRITE_TIMEOUT_MS.
+bool StateSubscriber::read(SharedGameState& state) const {
+    if (!segment) return false;
+    uint64_t deadline = 0;
+    for (int attempt = 0; isLive(); attempt++) {
+        uint32_t before = segment->sequence.load(memory_order_acquire);
+        if ((before & 1) == 0) {
+            memcpy(&state, &segment->state, sizeof(state));
+            atomic_thread_fence(memory_order_acquire);
+            if (segment->sequence.load(memory_order_relaxed) == before) return true;
+        }
+        if (attempt < SPIN_READS) {
+#if defined(__SSE2__) || defined(_M_X64)
+            _mm_pause();
+#endif
+            continue;
+        }
+        uint64_t now = monotonicNs();
+        if (deadline == 0) {
+            deadline = now + WRITE_TIMEOUT_MS * 1000000ULL;
+        } else if (now > deadline) {
+            return false;
+        }
+        this_thread::yield();
+    }
+    return false;
+}
+
+uint32_t StateSubscriber::send(Direction direction) {
+    if (!segment) return 0;
+    uint32_t head = segment->commandHead.load(memory_order_relaxed);
+    if (head - segment->commandTail.load(memory_order_acquire) == SharedSegment::COMMAND_RING_SIZE) return 0;
+
+    SharedCommand& command = segment->commands[head % SharedSegment::COMMAND_RING_SIZE];
+    command.id = head + 1;
+    command.direction = direction;
+    command.sentNs = monotonicNs();
+    segment->commandHead.store(head + 1, memory_order_release);
+
+    // The game may be asleep in its event loop; a full FIFO means it's awake already
+#ifndef _WIN32
+    char bell = 0;
+    if (write(bellFd, &bell, 1) < 0) {}
+#endif
+    return head + 1;
+}
+
+bool StateSubscriber::isApplied(uint32_t id) const {
+    return segment && static_cast<int32_t>(segment->commandTail.load(memory_order_acquire) - id) >= 0;
+}
+
+// BotHost implementation
+static_assert(sizeof(SnakeBotCell) == sizeof(Cell) && sizeof(SnakeBotItem) == sizeof(SharedItem) &&
+              offsetof(SnakeBotItem, expiresAt) == offsetof(SharedItem, expiresAt),
+              "The plugin view reads the snapshot arrays as they are");
+static_assert(SNAKE_BOT_ITEM == BOARD_ITEM && SNAKE_BOT_DOWN == DOWN && SNAKE_BOT_SHIELD == ITEM_SHIELD,
+              "Plugin ABI constants must match the game's");
+
+BotHost::Call::Call() : decideFn(nullptr), context(nullptr), view(), calling(false), stopping(false), answer(0),
+                        decisions(0), totalLatencyNs(0), maxLatencyNs(0), histogram() {}
+
+BotHost::BotHost(int budget) : library(nullptr), teardownFn(nullptr), budgetMs(max(1, min(budget, MAX_BUDGET_MS))),
+             call(make_shared<Call>()), overruns(0), skipped(0), overrunStreak(0), demotedAtTick(-1) {}
+
+BotHost::~BotHost() {
+    if (!library) return;
+    bool stuck;
+    {
+        lock_guard<mutex> lock(call->callMutex);
+        call->stopping = true;
+        stuck = call->calling;
+    }
+    call->callReady.notify_one();
+    if (stuck) {
+        // Still inside the plugin: leave it running in its library. The
+        // thread holds the call state, so it can finish with it after we're gone.
+        worker.detach();
+        return;
+    }
+    worker.join();
+    if (teardownFn) teardownFn(call->context);
+    unload();
+}
+
+void BotHost::unload() {
+#ifdef _WIN32
+    FreeLibrary(static_cast<HMODULE>(library));
+#else
+    dlclose(library);
+#endif
+    library = nullptr;
+}
+
+bool BotHost::load(const string& path, const string& args, string& error) {
+    SnakeBotInitFn initFn = nullptr;
+    SnakeBotDecideFn decideFn = nullptr;
+#ifdef _WIN32
+    HMODULE handle = LoadLibraryA(path.c_str());
+    if (!handle) {
+        error = "can't load " + path;
+        return false;
+    }
+    library = handle;
+    initFn = reinterpret_cast<SnakeBotInitFn>(GetProcAddress(handle, SNAKE_BOT_INIT_SYMBOL));
+    decideFn = reinterpret_cast<SnakeBotDecideFn>(GetProcAddress(handle, SNAKE_BOT_DECIDE_SYMBOL));
+    teardownFn = reinterpret_cast<SnakeBotTeardownFn>(GetProcAddress(handle, SNAKE_BOT_TEARDOWN_SYMBOL));
+#else
+    library = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (!library) {
+        error = dlerror();
+        return false;
+    }
+    initFn = reinterpret_cast<SnakeBotInitFn>(dlsym(library, SNAKE_BOT_INIT_SYMBOL));
+    decideFn = reinterpret_cast<SnakeBotDecideFn>(dlsym(library, SNAKE_BOT_DECIDE_SYMBOL));
+    teardownFn = reinterpret_cast<SnakeBotTeardownFn>(dlsym(library, SNAKE_BOT_TEARDOWN_SYMBOL));
+#endif
+    if (!initFn || !decideFn || !teardownFn) {
+        error = path + " doesn't export " SNAKE_BOT_INIT_SYMBOL ", " SNAKE_BOT_DECIDE_SYMBOL " and " SNAKE_BOT_TEARDOWN_SYMBOL;
+        unload();
+        return false;
+    }
+    if (initFn(SNAKE_BOT_ABI_VERSION, args.c_str(), &call->context) != 0) {
+        error = path + " failed to initialize";
+        unload();
+        return false;
+    }
+
+    name = path.substr(path.find_last_of("/\\") + 1);
+    call->decideFn = decideFn;
+    SnakeBotView& view = call->view;
+    view.abiVersion = SNAKE_BOT_ABI_VERSION;
+    view.width = WIDTH;
+    view.height = HEIGHT;
+    view.body = reinterpret_cast<const SnakeBotCell*>(call->state.body);
+    view.items = reinterpret_cast<const SnakeBotItem*>(call->state.items);
+    view.board = &call->state.board[0][0];
+    worker = thread(&BotHost::workerLoop, call);
+    return true;
+}
+
+void BotHost::workerLoop(shared_ptr<Call> call) {
+    unique_lock<mutex> lock(call->callMutex);
+    while (true) {
+        call->callReady.wait(lock, [&] { return call->stopping || call->calling; });
+        if (call->stopping) return;
+
+        lock.unlock();
+        auto start = chrono::steady_clock::now();
+        int result = call->decideFn(call->context, &call->view);
+        long long latencyNs = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+        lock.lock();
+
+        call->answer = result;
+        call->calling = false;
+        call->decisions++;
+        call->totalLatencyNs += latencyNs;
+        call->maxLatencyNs = max(call->maxLatencyNs, latencyNs);
+        int bucket = 0;
+        while (bucket < HISTOGRAM_BUCKETS - 1 && latencyNs >= (1000LL << bucket)) bucket++;
+        call->histogram[bucket]++;
+        call->callDone.notify_one();
+    }
+}
+
+template <class Rules>
+Direction BotHost::decide(const Simulation<Rules>& sim) {
+    unique_lock<mutex> lock(call->callMutex);
+    if (!library || demotedAtTick >= 0) return STOP;
+    if (call->calling) {
+        skipped++; // Still busy with an earlier tick
+        return STOP;
+    }
+
+    // The plugin thread is idle, so the view can be rewritten without the lock
+    lock.unlock();
+    SharedGameState& state = call->state;
+    SnakeBotView& view = call->view;
+    fillSharedState(sim, false, state);
+    view.tick = state.tick;
+    view.timeMs = state.timeMs;
+    view.score = state.score;
+    view.speedMs = state.speedMs;
+    view.shieldRemainingMs = state.shieldRemainingMs;
+    view.mode = state.mode;
+    view.direction = state.direction;
+    view.length = state.length;
+    view.itemCount = state.itemCount;
+    lock.lock();
+
+    call->calling = true;
+    call->callReady.notify_one();
+    auto deadline = chrono::steady_clock::now() + chrono::milliseconds(budgetMs);
+    if (!call->callDone.wait_until(lock, deadline, [&] { return !call->calling; })) {
+        overruns++;
+        if (++overrunStreak >= SNAKE_BOT_MAX_OVERRUNS) demotedAtTick = sim.getTickCount();
+        return STOP;
+    }
+    overrunStreak = 0;
+    int answer = call->answer;
+    return answer >= SNAKE_BOT_LEFT && answer <= SNAKE_BOT_DOWN ? static_cast<Direction>(answer) : STOP;
+}
+
+void BotHost::printReport(ostream& out) {
+    lock_guard<mutex> lock(call->callMutex);
+    long long decisions = call->decisions;
+    out << "Bot " << name << ": " << decisions << " decisions, " << fixed << setprecision(1)
+        << (decisions > 0 ? call->totalLatencyNs / 1000.0 / decisions : 0.0) << " us average, "
+        << call->maxLatencyNs / 1000.0 << " us worst, " << overruns << " over the " << budgetMs << " ms budget, "
+        << skipped << " ticks skipped while busy";
+    if (demotedAtTick >= 0) out << ", demoted at tick " << demotedAtTick;
+    out << endl << "  latency:";
+    for (int bucket = 0; bucket < HISTOGRAM_BUCKETS; bucket++) {
+        if (call->histogram[bucket] == 0) continue;
+        if (bucket < HISTOGRAM_BUCKETS - 1) out << " <" << (1LL << bucket) << "us: ";
+        else out << " >=" << (1LL << (bucket - 1)) << "us: ";
+        out << call->histogram[bucket];
+    }
+    out << endl;
+}
+
+// Arena implementation
+const char* const ARENA_PHASE_NAMES[ARENA_PHASE_COUNT] = { "bucket", "decide", "resolve", "apply", "respawn" };
+
+Arena::Arena(int boardWidth, int boardHeight, int snakes, int food, uint32_t seed, int threadsWanted)
+    : width(boardWidth), height(boardHeight), snakeCount(snakes), foodCount(food), rng(seed), ticks(0), deaths(0),
+      foodEaten(0), phase(ARENA_BUCKET), generation(0), pending(0), stopping(false), phaseSeconds() {
+    size_t cells = static_cast<size_t>(width) * height;
+    occupancy.assign(cells, EMPTY);
+    claims.assign(cells, 0);
+    bodies.assign(static_cast<size_t>(snakeCount) * MAX_LENGTH, 0);
+    headSlot.assign(snakeCount, 0);
+    lengths.assign(snakeCount, 0);
+    directions.assign(snakeCount, RIGHT);
+    targets.assign(snakeCount, NO_CELL);
+    fates.assign(snakeCount, FATE_MOVE);
+    snakeRng.reserve(snakeCount);
+    for (int id = 0; id < snakeCount; id++) {
+        snakeRng.push_back(FastRandom(seed * 2654435761U + id));
+    }
+
+    for (int id = 0; id < snakeCount; id++) {
+        placeSnake(id);
+    }
+    for (int i = 0; i < foodCount; i++) {
+        uint32_t cell = randomEmptyCell();
+        if (cell != NO_CELL) occupancy[cell] = FOOD;
+    }
+
+    bandCount = threadsWanted > 0 ? threadsWanted : max(1, static_cast<int>(thread::hardware_concurrency()));
+    bandCount = min(bandCount, height);
+    bandHeight = (height + bandCount - 1) / bandCount;
+    bandStart.assign(bandCount + 1, 0);
+    bandSnakes.assign(snakeCount, 0);
+    moves.resize(bandCount * 3);
+    for (vector<uint32_t>& list : moves) {
+        list.reserve(snakeCount / bandCount + 64);
+    }
+    bandFoodEaten.assign(bandCount, 0);
+    for (int band = 1; band < bandCount; band++) {
+        threads.emplace_back(&Arena::workerLoop, this, band);
+    }
+}
+
+Arena::~Arena() {
+    {
+        lock_guard<mutex> lock(poolMutex);
+        stopping = true;
+    }
+    phaseReady.notify_all();
+    for (thread& worker : threads) {
+        worker.join();
+    }
+}
+
+void Arena::workerLoop(int band) {
+    int seen = 0;
+    while (true) {
+        ArenaPhase work;
+        {
+            unique_lock<mutex> lock(poolMutex);
+            phaseReady.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping) return;
+            seen = generation;
+            work = phase;
+        }
+        runBand(work, band);
+        {
+            lock_guard<mutex> lock(poolMutex);
+            if (--pending == 0) phaseDone.notify_one();
+        }
+    }
+}
+
+// Runs one phase on every band and returns once all are done (the barrier)
+void Arena::runParallel(ArenaPhase parallelPhase) {
+    {
+        lock_guard<mutex> lock(poolMutex);
+        phase = parallelPhase;
+        pending = bandCount - 1;
+        generation++;
+    }
+    phaseReady.notify_all();
+    runBand(parallelPhase, 0);
+    unique_lock<mutex> lock(poolMutex);
+    phaseDone.wait(lock, [&] { return pending == 0; });
+}
+
+void Arena::runBand(ArenaPhase bandPhase, int band) {
+    switch (bandPhase) {
+        case ARENA_DECIDE:  decideBand(band); break;
+        case ARENA_RESOLVE: resolveBand(band); break;
+        case ARENA_APPLY:   applyBand(band); break;
+        default: break;
+    }
+}
+
+void Arena::tick() {
+    auto timed = [&](ArenaPhase which, auto&& work) {
+        auto start = chrono::steady_clock::now();
+        work();
+        phaseSeconds[which] += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    };
+    timed(ARENA_BUCKET, [&] { bucket(); });
+    timed(ARENA_DECIDE, [&] { runParallel(ARENA_DECIDE); });
+    timed(ARENA_RESOLVE, [&] { runParallel(ARENA_RESOLVE); });
+    timed(ARENA_APPLY, [&] { runParallel(ARENA_APPLY); });
+    timed(ARENA_RESPAWN, [&] { respawn(); });
+    ticks++;
+}
+
+uint32_t Arena::neighbor(uint32_t cell, Direction dir) const {
+    int x = static_cast<int>(cell % width), y = static_cast<int>(cell / width);
+    switch (dir) {
+        case LEFT:  x--; break;
+        case RIGHT: x++; break;
+        case UP:    y--; break;
+        case DOWN:  y++; break;
+        default: break;
+    }
+    if (x < 0 || x >= width || y < 0 || y >= height) return NO_CELL;
+    return static_cast<uint32_t>(y) * width + x;
+}
+
+// Counting sort of the live snakes by head band, keeping id order
+void Arena::bucket() {
+    fill(bandStart.begin(), bandStart.end(), 0);
+    for (int id = 0; id < snakeCount; id++) {
+        if (lengths[id] == 0) continue;
+        uint32_t head = bodies[id * MAX_LENGTH + headSlot[id]];
+        bandStart[head / width / bandHeight + 1]++;
+    }
+    for (int band = 0; band < bandCount; band++) {
+        bandStart[band + 1] += bandStart[band];
+    }
+    // Each start is advanced to the band's end while filling, then shifted back
+    for (int id = 0; id < snakeCount; id++) {
+        if (lengths[id] == 0) continue;
+        uint32_t head = bodies[id * MAX_LENGTH + headSlot[id]];
+        bandSnakes[bandStart[head / width / bandHeight]++] = id;
+    }
+    for (int band = bandCount; band > 0; band--) {
+        bandStart[band] = bandStart[band - 1];
+    }
+    bandStart[0] = 0;
+}
+
+// Each snake looks at the three cells it can enter: food first, then room
+// to move on, then keeping its direction, with a coin flip between equals
+void Arena::decideBand(int band) {
+    static const Direction TURNS[5][3] = {
+        { LEFT, RIGHT, UP }, { LEFT, UP, DOWN }, { RIGHT, UP, DOWN }, { UP, LEFT, RIGHT }, { DOWN, LEFT, RIGHT }
+    };
+    for (int offset = 0; offset < 3; offset++) {
+        moves[band * 3 + offset].clear();
+    }
+
+    for (int i = bandStart[band]; i < bandStart[band + 1]; i++) {
+        uint32_t id = bandSnakes[i];
+        uint32_t head = bodies[id * MAX_LENGTH + headSlot[id]];
+        Direction current = directions[id];
+        FastRandom& random = snakeRng[id];
+
+        Direction bestDir = current;
+        uint32_t bestCell = neighbor(head, current);
+        int bestScore = -1;
+        for (Direction dir : TURNS[current]) {
+            uint32_t cell = neighbor(head, dir);
+            if (cell == NO_CELL) continue;
+            uint32_t content = occupancy[cell];
+            if (content != EMPTY && content != FOOD) continue;
+
+            int score = content == FOOD ? 16 : 0;
+            for (Direction around : { LEFT, RIGHT, UP, DOWN }) {
+                uint32_t next = neighbor(cell, around);
+                if (next != NO_CELL && (occupancy[next] == EMPTY || occupancy[next] == FOOD)) score += 2;
+            }
+            if (dir == current) score += 1;
+            score = score * 2 + random.below(2);
+            if (score > bestScore) {
+                bestScore = score;
+                bestDir = dir;
+                bestCell = cell;
+            }
+        }
+
+        directions[id] = bestDir;
+        targets[id] = bestCell;
+        if (bestCell == NO_CELL) {
+            fates[id] = FATE_DIE; // Into the wall
+            continue;
+        }
+        int targetBand = static_cast<int>(bestCell / width / bandHeight);
+        moves[band * 3 + 1 + targetBand - band].push_back(id);
+    }
+}
+
+// Settles every move into this band's cells. Counting the claims first makes
+// the outcome independent of the order the moves are visited in.
+void Arena::resolveBand(int band) {
+    const vector<uint32_t>* incoming[3] = {
+        band > 0 ? &moves[(band - 1) * 3 + 2] : nullptr,
+        &moves[band * 3 + 1],
+        band + 1 < bandCount ? &moves[(band + 1) * 3] : nullptr
+    };
+    for (const vector<uint32_t>* list : incoming) {
+        if (!list) continue;
+        for (uint32_t id : *list) {
+            unsigned char& count = claims[targets[id]];
+            if (count < 255) count++;
+        }
+    }
+
+    long long eaten = 0;
+    for (const vector<uint32_t>* list : incoming) {
+        if (!list) continue;
+        for (uint32_t id : *list) {
+            uint32_t cell = targets[id];
+            uint32_t content = occupancy[cell];
+            if (claims[cell] > 1 || (content != EMPTY && content != FOOD)) {
+                fates[id] = FATE_DIE;
+            } else if (content == FOOD) {
+                fates[id] = FATE_GROW;
+                eaten++;
+            } else {
+                fates[id] = FATE_MOVE;
+            }
+        }
+    }
+    bandFoodEaten[band] = eaten;
+
+    for (const vector<uint32_t>* list : incoming) {
+        if (!list) continue;
+        for (uint32_t id : *list) {
+            claims[targets[id]] = 0;
+        }
+    }
+}
+
+// Heads only enter cells nobody else enters, and tails and dead bodies only
+// leave cells nobody enters, so the bands never write the same cell
+void Arena::applyBand(int band) {
+    for (int i = bandStart[band]; i < bandStart[band + 1]; i++) {
+        uint32_t id = bandSnakes[i];
+        uint32_t* body = &bodies[id * MAX_LENGTH];
+        int length = lengths[id];
+
+        if (fates[id] == FATE_DIE) {
+            for (int segment = 0; segment < length; segment++) {
+                occupancy[body[(headSlot[id] + segment) % MAX_LENGTH]] = EMPTY;
+            }
+            continue; // Length is cleared when it respawns
+        }
+
+        bool grow = fates[id] == FATE_GROW && length < MAX_LENGTH;
+        if (!grow) {
+            occupancy[body[(headSlot[id] + length - 1) % MAX_LENGTH]] = EMPTY;
+        }
+        headSlot[id] = static_cast<unsigned char>((headSlot[id] + MAX_LENGTH - 1) % MAX_LENGTH);
+        body[headSlot[id]] = targets[id];
+        occupancy[targets[id]] = id + 1;
+        if (grow) lengths[id] = static_cast<unsigned char>(length + 1);
+    }
+}
+
+// Serial and in id order, so it draws the same random numbers every run
+void Arena::respawn() {
+    long long eaten = 0;
+    for (int band = 0; band < bandCount; band++) {
+        eaten += bandFoodEaten[band];
+        bandFoodEaten[band] = 0;
+    }
+    foodEaten += eaten;
+
+    for (int id = 0; id < snakeCount; id++) {
+        if (fates[id] != FATE_DIE) continue;
+        fates[id] = FATE_MOVE;
+        lengths[id] = 0;
+        deaths++;
+        placeSnake(id);
+    }
+    for (long long i = 0; i < eaten; i++) {
+        uint32_t cell = randomEmptyCell();
+        if (cell != NO_CELL) occupancy[cell] = FOOD;
+    }
+}
+
+// A length-one snake on a random empty cell; stays out (length 0) if none is found
+bool Arena::placeSnake(uint32_t id) {
+    uint32_t cell = randomEmptyCell();
+    if (cell == NO_CELL) return false;
+    headSlot[id] = 0;
+    lengths[id] = 1;
+    bodies[id * MAX_LENGTH] = cell;
+    directions[id] = static_cast<Direction>(LEFT + rng.below(4));
+    occupancy[cell] = id + 1;
+    return true;
+}
+
+uint32_t Arena::randomEmptyCell() {
+    uint32_t cells = static_cast<uint32_t>(width) * height;
+    for (int attempt = 0; attempt < 64; attempt++) {
+        uint32_t cell = rng.next() % cells;
+        if (occupancy[cell] == EMPTY) return cell;
+    }
+    return NO_CELL;
+}
+
+double Arena::getAverageLength() const {
+    long long total = 0;
+    for (int id = 0; id < snakeCount; id++) {
+        total += lengths[id];
+    }
+    return snakeCount > 0 ? (double)total / snakeCount : 0.0;
+}
+
+uint64_t Arena::getStateHash() const {
+    uint64_t hash = 1469598103934665603ULL; // FNV-1a
+    auto mix = [&](uint64_t value) {
+        hash ^= value;
+        hash *= 1099511628211ULL;
+    };
+    for (int id = 0; id < snakeCount; id++) {
+        mix(lengths[id]);
+        mix(directions[id]);
+        for (int segment = 0; segment < lengths[id]; segment++) {
+            mix(bodies[id * MAX_LENGTH + (headSlot[id] + segment) % MAX_LENGTH]);
+        }
+    }
+    for (size_t cell = 0; cell < occupancy.size(); cell++) {
+        if (occupancy[cell] == FOOD) mix(cell);
+    }
+    return hash;
+}
+
+// World implementation
+World::World(uint32_t worldSeed) : pool(MAX_CHUNKS), table(TABLE_SLOTS, -1), resident(0), peakResident(0),
+             body(MAX_LENGTH), headIndex(0), length(1), growth(0), dir(RIGHT), nextDir(RIGHT), headChunkX(0),
+             headChunkY(0), seed(worldSeed), timeMs(0), score(0), foodEaten(0), specialFoodEaten(0), tickCount(0),
+             deathCause(DEATH_NONE), gameOver(false), chunksGenerated(0), chunksEvicted(0) {
+    freeChunks.reserve(MAX_CHUNKS);
+    for (int index = MAX_CHUNKS - 1; index >= 0; index--) {
+        pool[index].inUse = false;
+        freeChunks.push_back(index);
+    }
+
+    body[0] = WorldPos{ 0, 0 };
+    updateNeighbourhood();
+    Chunk& start = chunkOf(body[0]);
+    start.cells[cellIndex(body[0])] = CELL_SNAKE; // The start is cleared of rocks, and of food here
+    start.snakeCells++;
+}
+
+int World::findSlot(int32_t cx, int32_t cy) const {
+    int slot = homeSlot(cx, cy);
+    // The table is never more than half full, so there is always an empty slot to stop at
+    while (table[slot] >= 0) {
+        const Chunk& chunk = pool[table[slot]];
+        if (chunk.cx == cx && chunk.cy == cy) break;
+        slot = (slot + 1) & (TABLE_SLOTS - 1);
+    }
+    return slot;
+}
+
+World::Chunk* World::findChunk(int32_t cx, int32_t cy) const {
+    int index = table[findSlot(cx, cy)];
+    return index >= 0 ? const_cast<Chunk*>(&pool[index]) : nullptr;
+}
+
+World::Chunk& World::loadChunk(int32_t cx, int32_t cy) {
+    int slot = findSlot(cx, cy);
+    if (table[slot] >= 0) return pool[table[slot]];
+
+    if (freeChunks.empty()) {
+        // Only when the snake spreads over many chunks; the pool is big enough
+        // that some chunk is always free of it (see the static_assert)
+        evictFarthest();
+        slot = findSlot(cx, cy); // Evicting can move table entries
+    }
+    int index = freeChunks.back();
+    freeChunks.pop_back();
+    Chunk& chunk = pool[index];
+    chunk.cx = cx;
+    chunk.cy = cy;
+    chunk.snakeCells = 0;
+    chunk.inUse = true;
+    generate(chunk);
+    table[slot] = index;
+    resident++;
+    peakResident = max(peakResident, resident);
+    chunksGenerated++;
+    return chunk;
+}
+
+void World::evictChunk(int index) {
+    Chunk& chunk = pool[index];
+    int hole = findSlot(chunk.cx, chunk.cy);
+    table[hole] = -1;
+    // Linear probing: pull later entries of the run back into the hole, so
+    // lookups for them don't stop at it
+    for (int slot = (hole + 1) & (TABLE_SLOTS - 1); table[slot] >= 0; slot = (slot + 1) & (TABLE_SLOTS - 1)) {
+        const Chunk& moved = pool[table[slot]];
+        int home = homeSlot(moved.cx, moved.cy);
+        if (((slot - home) & (TABLE_SLOTS - 1)) >= ((slot - hole) & (TABLE_SLOTS - 1))) {
+            table[hole] = table[slot];
+            table[slot] = -1;
+            hole = slot;
+        }
+    }
+    chunk.inUse = false;
+    freeChunks.push_back(index);
+    resident--;
+    chunksEvicted++;
+}
+
+// Drops the snake-free chunk furthest from the head
+bool World::evictFarthest() {
+    int farthest = -1;
+    int32_t farthestDistance = -1;
+    for (int index = 0; index < MAX_CHUNKS; index++) {
+        const Chunk& chunk = pool[index];
+        if (!chunk.inUse || chunk.snakeCells > 0) continue;
+        int32_t distance = max(abs(chunk.cx - headChunkX), abs(chunk.cy - headChunkY));
+        if (distance > farthestDistance) {
+            farthest = index;
+            farthestDistance = distance;
+        }
+    }
+    if (farthest < 0) return false;
+    evictChunk(farthest);
+    return true;
+}
+
+// Rocks in short random walks, then food on free cells. Everything comes
+// from the chunk's own generator, so the chunk is the same every time.
+void World::generate(Chunk& chunk) {
+    uint64_t mixed = (chunkKey(chunk.cx, chunk.cy) ^ (static_cast<uint64_t>(seed) << 17)) * 0x9e3779b97f4a7c15ULL;
+    FastRandom chunkRng(static_cast<uint32_t>(mixed >> 32) ^ static_cast<uint32_t>(mixed) ^ seed);
+    memset(chunk.cells, CELL_EMPTY, sizeof(chunk.cells));
+
+    for (int cluster = 0; cluster < ROCK_CLUSTERS; cluster++) {
+        int x = chunkRng.below(CHUNK_SIZE);
+        int y = chunkRng.below(CHUNK_SIZE);
+        int rocks = 3 + chunkRng.below(8);
+        for (int i = 0; i < rocks; i++) {
+            chunk.cells[y * CHUNK_SIZE + x] = CELL_ROCK;
+            int step = chunkRng.below(4);
+            if (step == 0 && x > 0) x--;
+            else if (step == 1 && x < CHUNK_SIZE - 1) x++;
+            else if (step == 2 && y > 0) y--;
+            else if (step == 3 && y < CHUNK_SIZE - 1) y++;
+        }
+    }
+
+    // Clear the ground the snake starts on
+    if (abs(chunk.cx) <= 1 && abs(chunk.cy) <= 1) {
+        for (int y = 0; y < CHUNK_SIZE; y++) {
+            for (int x = 0; x < CHUNK_SIZE; x++) {
+                int32_t worldX = chunk.cx * CHUNK_SIZE + x;
+                int32_t worldY = chunk.cy * CHUNK_SIZE + y;
+                if (abs(worldX) <= START_CLEARING && abs(worldY) <= START_CLEARING) {
+                    chunk.cells[y * CHUNK_SIZE + x] = CELL_EMPTY;
+                }
+            }
+        }
+    }
+
+    auto place = [&](uint8_t what) {
+        for (int attempt = 0; attempt < 8; attempt++) {
+            int cell = chunkRng.below(CHUNK_CELLS);
+            if (chunk.cells[cell] != CELL_EMPTY) continue;
+            if (chunk.cx == 0 && chunk.cy == 0 && cell == 0) continue; // The snake's first cell
+            chunk.cells[cell] = what;
+            return;
+        }
+    };
+    for (int i = 0; i < FOOD_PER_CHUNK; i++) place(CELL_FOOD);
+    if (chunkRng.below(SPECIAL_FOOD_ONE_IN) == 0) place(CELL_SPECIAL_FOOD);
+}
+
+// Runs whenever the head enters a new chunk
+void World::updateNeighbourhood() {
+    for (int index = 0; index < MAX_CHUNKS; index++) {
+        const Chunk& chunk = pool[index];
+        if (chunk.inUse && chunk.snakeCells == 0 &&
+            max(abs(chunk.cx - headChunkX), abs(chunk.cy - headChunkY)) > EVICT_RADIUS) {
+            evictChunk(index);
+        }
+    }
+    for (int dy = -LOAD_RADIUS; dy <= LOAD_RADIUS; dy++) {
+        for (int dx = -LOAD_RADIUS; dx <= LOAD_RADIUS; dx++) {
+            loadChunk(headChunkX + dx, headChunkY + dy);
+        }
+    }
+}
+
+void World::changeDirection(Direction newDir) {
+    if ((dir == LEFT && newDir != RIGHT) || (dir == RIGHT && newDir != LEFT) || (dir == UP && newDir != DOWN) ||
+        (dir == DOWN && newDir != UP)) {
+        nextDir = newDir;
+    }
+}
+
+void World::update() {
+    if (gameOver) return;
+
+    timeMs += getGameSpeed();
+    tickCount++;
+    dir = nextDir;
+
+    WorldPos head = body[headIndex];
+    if (dir == LEFT) head.x--;
+    else if (dir == RIGHT) head.x++;
+    else if (dir == UP) head.y--;
+    else if (dir == DOWN) head.y++;
+
+    // The tail moves out of the way first, so the head may follow it
+    if (growth > 0 && length < MAX_LENGTH) {
+        growth--;
+        length++;
+    } else {
+        growth = 0;
+        WorldPos tail = getSegment(length - 1);
+        Chunk& tailChunk = chunkOf(tail); // Resident: it has snake on it
+        tailChunk.cells[cellIndex(tail)] &= ~CELL_SNAKE;
+        tailChunk.snakeCells--;
+    }
+    headIndex = (headIndex + MAX_LENGTH - 1) % MAX_LENGTH;
+    body[headIndex] = head;
+
+    Chunk& chunk = chunkOf(head); // Within LOAD_RADIUS, so already there
+    uint8_t& cell = chunk.cells[cellIndex(head)];
+    if (cell & CELL_SNAKE) {
+        endGame(DEATH_SELF);
+        return;
+    }
+    if (cell == CELL_ROCK) {
+        endGame(DEATH_OBSTACLE);
+        return;
+    }
+    if (cell == CELL_FOOD) {
+        score += EndlessRules::FOOD_SCORE;
+        foodEaten++;
+        growth++;
+    } else if (cell == CELL_SPECIAL_FOOD) {
+        score += SPECIAL_FOOD_SCORE;
+        specialFoodEaten++;
+        growth += SPECIAL_FOOD_GROWTH;
+    }
+    cell = CELL_SNAKE;
+    chunk.snakeCells++;
+
+    if (chunk.cx != headChunkX || chunk.cy != headChunkY) {
+        headChunkX = chunk.cx;
+        headChunkY = chunk.cy;
+        updateNeighbourhood();
+    }
+}
+
+void World::endGame(DeathCause cause) {
+    gameOver = true;
+    deathCause = cause;
+}
+
+uint8_t World::peek(WorldPos pos) const {
+    const Chunk* chunk = findChunk(chunkCoord(pos.x), chunkCoord(pos.y));
+    return chunk ? chunk->cells[cellIndex(pos)] : CELL_ROCK;
+}
+
+void World::copyRow(WorldPos start, int count, uint8_t* out) const {
+    int32_t cy = chunkCoord(start.y);
+    int row = (start.y & (CHUNK_SIZE - 1)) * CHUNK_SIZE;
+    for (int done = 0; done < count;) {
+        int32_t x = start.x + done;
+        int offset = x & (CHUNK_SIZE - 1);
+        int run = min(count - done, CHUNK_SIZE - offset);
+        const Chunk* chunk = findChunk(chunkCoord(x), cy);
+        if (chunk) {
+            memcpy(out + done, chunk->cells + row + offset, run);
+        } else {
+            memset(out + done, CELL_ROCK, run);
+        }
+        done += run;
+    }
+}
+
+int World::getGameSpeed() const {
+    int speedReduction = min(length * EndlessRules::SPEED_DECREMENT, EndlessRules::BASE_SPEED - EndlessRules::MIN_SPEED);
+    return max(EndlessRules::BASE_SPEED - speedReduction, EndlessRules::MIN_SPEED);
+}
+
+size_t World::getReservedBytes() const {
+    return pool.capacity() * sizeof(Chunk) + freeChunks.capacity() * sizeof(int) + table.capacity() * sizeof(int) +
+           body.capacity() * sizeof(WorldPos);
+}
+
+SessionRecord World::getSessionRecord() const {
+    SessionRecord record = SessionRecord();
+    record.mode = EndlessRules::ID;
+    record.deathCause = static_cast<uint8_t>(gameOver ? deathCause : DEATH_NONE);
+    record.finalSpeed = static_cast<uint8_t>(min(getGameSpeed(), 255));
+    record.score = score;
+    record.length = static_cast<uint16_t>(length);
+    record.foodEaten = static_cast<uint16_t>(min(foodEaten, 65535));
+    record.specialFoodEaten = static_cast<uint16_t>(min(specialFoodEaten, 65535));
+    record.ticks = static_cast<uint32_t>(tickCount);
+    record.gameTimeMs = static_cast<uint32_t>(timeMs);
+    return record;
+}
+
+// EndlessGame implementation
+EndlessGame::EndlessGame() : world(static_cast<uint32_t>(time(0))), quit(false), paused(false), queuedTurnCount(0),
+             turnedThisTick(false) {
+    setupConsole();
+    screen.hideCursor();
+    loadCustomGraphics();
+    WorldPos head = world.getHead();
+    viewOrigin = WorldPos{ head.x - WIDTH / 2, head.y - HEIGHT / 2 };
+}
+
+EndlessGame::~EndlessGame() {
+    screen.showCursor();
+}
+
+void EndlessGame::followHead() {
+    WorldPos head = world.getHead();
+    if (head.x < viewOrigin.x + VIEW_MARGIN || head.x >= viewOrigin.x + WIDTH - VIEW_MARGIN) {
+        viewOrigin.x = head.x - WIDTH / 2;
+    }
+    if (head.y < viewOrigin.y + VIEW_MARGIN || head.y >= viewOrigin.y + HEIGHT - VIEW_MARGIN) {
+        viewOrigin.y = head.y - HEIGHT / 2;
+    }
+}
+
+void EndlessGame::update() {
+    if (world.isGameOver() || paused) return;
+
+    world.update();
+    followHead();
+
+    // Next queued turn for the new tick
+    turnedThisTick = false;
+    if (queuedTurnCount > 0) {
+        Direction next = queuedTurns[0];
+        queuedTurnCount--;
+        for (int i = 0; i < queuedTurnCount; i++) {
+            queuedTurns[i] = queuedTurns[i + 1];
+        }
+        turn(next);
+    }
+}
+
+void EndlessGame::turn(Direction dir) {
+    if (!turnedThisTick) {
+        world.changeDirection(dir);
+        turnedThisTick = true;
+    } else if (queuedTurnCount < MAX_QUEUED_TURNS) {
+        queuedTurns[queuedTurnCount++] = dir;
+    }
+}
+
+void EndlessGame::handleInput() {
+    unsigned char bytes[INPUT_BUFFER_SIZE];
+    Key decoded[INPUT_BUFFER_SIZE];
+    int count = keys.feed(bytes, InputHandler::readAvailable(bytes, INPUT_BUFFER_SIZE), decoded);
+
+    for (int i = 0; i < count; i++) {
+        switch (decoded[i]) {
+            case KEY_UP:    turn(UP); break;
+            case KEY_DOWN:  turn(DOWN); break;
+            case KEY_LEFT:  turn(LEFT); break;
+            case KEY_RIGHT: turn(RIGHT); break;
+            case KEY_PAUSE: togglePause(); break;
+            case KEY_QUIT:  quit = true; break;
+            case KEY_RENDER:
+                screen.setRenderMode(static_cast<RenderMode>((screen.getRenderMode() + 1) % RENDER_MODE_COUNT));
+                break;
+            case KEY_REWIND: // No practice mode in the endless world
+            case KEY_NONE:  break;
+        }
+    }
+}
+
+// The view is read straight from the chunks, a few lookups per row, so
+// drawing costs the same wherever the snake is
+void EndlessGame::draw() {
+    bool gameOver = world.isGameOver();
+    uint64_t start = monotonicNs();
+
+    screen.clear();
+    screen.addToBuffer("====== 🐍 SNAKE GAME 🐍 ======\n");
+
+    const Glyph CELL_GLYPHS[4] = { GLYPH_EMPTY, GLYPH_WALL, GLYPH_FOOD, GLYPH_SPECIAL_FOOD };
+    Glyph bodyGlyph = gameOver ? GLYPH_BODY_DEAD : GLYPH_BODY;
+    Glyph frame[HEIGHT][WIDTH];
+    uint8_t row[WIDTH];
+    for (int y = 0; y < HEIGHT; y++) {
+        world.copyRow(WorldPos{ viewOrigin.x, viewOrigin.y + y }, WIDTH, row);
+        for (int x = 0; x < WIDTH; x++) {
+            frame[y][x] = row[x] & World::CELL_SNAKE ? bodyGlyph : CELL_GLYPHS[row[x] & 3];
+        }
+    }
+    WorldPos head = world.getHead();
+    int headX = head.x - viewOrigin.x;
+    int headY = head.y - viewOrigin.y;
+    if (headX >= 0 && headX < WIDTH && headY >= 0 && headY < HEIGHT) {
+        frame[headY][headX] = gameOver ? GLYPH_HEAD_DEAD : GLYPH_HEAD;
+    }
+
+    if (gameOver) {
+        screen.addBoard(&frame[0][0], WIDTH, HEIGHT, SPECIAL_FOOD_EMOJI, "G A M E  O V E R", HEIGHT / 2 - 4);
+    } else if (paused) {
+        screen.addBoard(&frame[0][0], WIDTH, HEIGHT, SPECIAL_FOOD_EMOJI, "P A U S E D", HEIGHT / 2 - 3);
+    } else {
+        screen.addBoard(&frame[0][0], WIDTH, HEIGHT, SPECIAL_FOOD_EMOJI);
+    }
+
+    screen.addToBuffer("==============================================\n");
+    if (screen.getOutputLevel() >= OUTPUT_REDUCED_HUD) {
+        const OutputStats& output = screen.getOutputStats();
+        screen.addToBuffer("Score: " + to_string(world.getScore()) + " | Length: " + to_string(world.getLength()) +
+                           " | Slow terminal, " + to_string(output.framesDropped) + " frames dropped      \n");
+    } else {
+        screen.addToBuffer("              ENDLESS WORLD                  \n");
+        screen.addToBuffer("----------------------------------------------\n");
+        screen.addToBuffer("Score: " + to_string(world.getScore()) + " 🏆\n");
+        screen.addToBuffer("Length: " + to_string(world.getLength()) + " 📏\n");
+        screen.addToBuffer("Speed: " + to_string(world.getGameSpeed()) + "ms 🚀\n");
+        screen.addToBuffer("Position: " + to_string(head.x) + ", " + to_string(-head.y) + " 🧭        \n");
+        screen.addToBuffer("Chunks: " + to_string(world.getResidentChunks()) + " of " + to_string(World::MAX_CHUNKS) +
+                           " in memory (" + to_string(world.getResidentBytes() / 1024) + " KB), " +
+                           to_string(world.getChunksGenerated()) + " made, " + to_string(world.getChunksEvicted()) +
+                           " dropped    \n");
+        screen.addToBuffer("Display: " + string(RENDER_MODE_NAMES[screen.getRenderMode()]) + ", board " +
+                           to_string(screen.getLastBoardBytes()) + " of " + to_string(screen.getLastFrameBytes()) +
+                           " bytes/frame" + (screen.getOutputLevel() == OUTPUT_DIFF ? ", changed lines only" : "") +
+                           "        \n");
+    }
+    screen.addToBuffer("----------------------------------------------\n");
+    screen.addToBuffer("Controls: WASD/Arrows | SPACE: Pause | R: Display | Q: Quit\n");
+    if (paused) {
+        screen.addToBuffer("               *** GAME PAUSED ***               \n");
+    }
+    if (gameOver) {
+        screen.addToBuffer("                 💀 GAME OVER! 💀                \n");
+    }
+    screen.addToBuffer("==============================================\n");
+
+    Metrics::observe(METRIC_FRAME_COMPOSE, monotonicNs() - start);
+    screen.draw(!paused && !gameOver);
+}
+
+// Versus implementation
+// The players start on opposite sides, a few rows apart, facing each other
+Versus::Versus(uint32_t seed)
+    : snakes{ Snake(WIDTH / 4, HEIGHT / 2 - 3, RIGHT), Snake(WIDTH - 1 - WIDTH / 4, HEIGHT / 2 + 3, LEFT) },
+      rng(seed), tickCount(0), scores{ 0, 0 }, deaths{ DEATH_NONE, DEATH_NONE }, over(false) {
+    placeFood();
+}
+
+void Versus::placeFood() {
+    int freeCells = (WIDTH - 2) * (HEIGHT - 2) - snakes[0].getLength() - snakes[1].getLength();
+    int attempts = WIDTH * HEIGHT * 4;
+    do {
+        if (freeCells <= 0 || attempts-- == 0) {
+            food = Cell(-1, -1); // Nowhere left; the game goes on without food
+            return;
+        }
+        food = Cell(rng.below(WIDTH - 2) + 1, rng.below(HEIGHT - 2) + 1);
+    } while (snakes[0].occupies(food) || snakes[1].occupies(food));
+}
+
+void Versus::update(const Direction inputs[PLAYERS]) {
+    if (over) return;
+
+    for (int p = 0; p < PLAYERS; p++) {
+        if (inputs[p] != STOP) snakes[p].changeDirection(inputs[p]);
+        snakes[p].move();
+    }
+
+    // Both snakes have moved before anyone is checked, so the order of the
+    // players never matters
+    for (int p = 0; p < PLAYERS; p++) {
+        const Snake& other = snakes[1 - p];
+        Cell head = snakes[p].getHead();
+        if (head.x < 0 || head.x >= WIDTH || head.y < 0 || head.y >= HEIGHT) {
+            deaths[p] = DEATH_WALL;
+        } else if (snakes[p].occupies(head, 1)) {
+            deaths[p] = DEATH_SELF;
+        } else if (other.occupies(head, 0)) {
+            deaths[p] = DEATH_RIVAL; // Heads meeting get both snakes here
+        }
+    }
+
+    bool eaten = false;
+    for (int p = 0; p < PLAYERS; p++) {
+        if (deaths[p] == DEATH_NONE && snakes[p].getHead() == food) {
+            scores[p] += VersusRules::FOOD_SCORE;
+            snakes[p].setGrow(true);
+            eaten = true;
+        }
+    }
+    if (eaten) placeFood();
+
+    over = deaths[0] != DEATH_NONE || deaths[1] != DEATH_NONE;
+    tickCount++;
+}
+
+int Versus::getWinner() const {
+    if (!over || (deaths[0] != DEATH_NONE && deaths[1] != DEATH_NONE)) return -1;
+    return deaths[0] == DEATH_NONE ? 0 : 1;
+}
+
+uint64_t Versus::getStateHash() const {
+    uint64_t words[] = {
+        snakes[0].getHash(),
+        snakes[1].getHash(),
+        static_cast<uint64_t>(snakes[0].getDirection()) | static_cast<uint64_t>(snakes[1].getDirection()) << 8 |
+            static_cast<uint64_t>(snakes[0].getGrowth()) << 16 | static_cast<uint64_t>(snakes[1].getGrowth()) << 32 |
+            static_cast<uint64_t>(food.key()) << 48,
+        static_cast<uint32_t>(tickCount) | static_cast<uint64_t>(rng.getState()) << 32,
+        static_cast<uint32_t>(scores[0]) | static_cast<uint64_t>(static_cast<uint32_t>(scores[1])) << 32,
+        static_cast<uint64_t>(deaths[0]) | static_cast<uint64_t>(deaths[1]) << 8 | static_cast<uint64_t>(over) << 16,
+    };
+    uint64_t hash = 0;
+    for (size_t i = 0; i < sizeof(words) / sizeof(words[0]); i++) {
+        hash ^= zobristMix(words[i] ^ (0xa0761d6478bd642fULL * (i + 1)));
+    }
+    return hash;
+}
+
+SessionRecord Versus::getSessionRecord(int player) const {
+    SessionRecord record = SessionRecord();
+    record.mode = VersusRules::ID;
+    record.deathCause = static_cast<uint8_t>(deaths[player]);
+    record.finalSpeed = static_cast<uint8_t>(VersusRules::BASE_SPEED);
+    record.score = scores[player];
+    record.length = static_cast<uint16_t>(snakes[player].getLength());
+    record.foodEaten = static_cast<uint16_t>(scores[player] / VersusRules::FOOD_SCORE);
+    record.ticks = static_cast<uint32_t>(tickCount);
+    record.gameTimeMs = static_cast<uint32_t>(tickCount) * VersusRules::BASE_SPEED;
+    return record;
+}
+
+// RollbackSession implementation
+RollbackSession::RollbackSession(uint32_t seed, int local)
+    : state(seed), localPlayer(local), tick(0), remoteConfirmed(0), rollbackFrom(NO_ROLLBACK), rollbacks(0),
+      ticksReplayed(0), deepestRollback(0), slowestRollbackNs(0), totalRollbackNs(0), stalls(0) {
+    for (int slot = 0; slot < HISTORY; slot++) {
+        inputs[slot][0] = inputs[slot][1] = STOP;
+        remoteTick[slot] = -1;
+    }
+}
+
+void RollbackSession::play(int slot) {
+    state.update(inputs[slot]);
+}
+
+void RollbackSession::advance(Direction localInput) {
+    reconcile();
+    int slot = tick & (HISTORY - 1);
+    saved[slot] = state;
+    inputs[slot][localPlayer] = localInput;
+    if (remoteTick[slot] != tick) {
+        inputs[slot][1 - localPlayer] = STOP; // The guess: it keeps going
+    }
+    play(slot);
+    tick++;
+}
+
+void RollbackSession::receiveRemote(int forTick, Direction input) {
+    // Older ticks are settled; the other side can't be MAX_ROLLBACK ticks
+    // ahead of what it has of ours, so anything further out is bogus
+    if (forTick < remoteConfirmed || forTick >= tick + MAX_ROLLBACK || input > DOWN) return;
+    int slot = forTick & (HISTORY - 1);
+    if (remoteTick[slot] == forTick) return;
+
+    int remote = 1 - localPlayer;
+    if (forTick < tick && inputs[slot][remote] != input) {
+        rollbackFrom = min(rollbackFrom, forTick);
+    }
+    inputs[slot][remote] = input;
+    remoteTick[slot] = forTick;
+    while (remoteTick[remoteConfirmed & (HISTORY - 1)] == remoteConfirmed) {
+        remoteConfirmed++;
+    }
+}
+
+// The snapshot before the first wrong guess is the one to go back to; the
+// later ones are taken again on the way, since they change too
+int RollbackSession::reconcile() {
+    if (rollbackFrom == NO_ROLLBACK) return 0;
+    uint64_t start = monotonicNs();
+
+    int from = rollbackFrom;
+    rollbackFrom = NO_ROLLBACK;
+    state = saved[from & (HISTORY - 1)];
+    for (int t = from; t < tick; t++) {
+        int slot = t & (HISTORY - 1);
+        if (t > from) saved[slot] = state;
+        play(slot);
+    }
+
+    uint64_t elapsed = monotonicNs() - start;
+    int depth = tick - from;
+    rollbacks++;
+    ticksReplayed += depth;
+    deepestRollback = max(deepestRollback, depth);
+    slowestRollbackNs = max(slowestRollbackNs, elapsed);
+    totalRollbackNs += elapsed;
+    return depth;
+}
+
+bool RollbackSession::getConfirmedHash(int beforeTick, uint64_t& hash) const {
+    // A pending rollback makes the snapshots after its tick stale
+    if (beforeTick > getConfirmedTick() || beforeTick <= tick - HISTORY || beforeTick < 0 ||
+        (rollbackFrom != NO_ROLLBACK && beforeTick > rollbackFrom)) {
+        return false;
+    }
+    hash = beforeTick == tick ? state.getStateHash() : saved[beforeTick & (HISTORY - 1)].getStateHash();
+    return true;
+}
+
+// VersusLink implementation
+VersusLink::VersusLink() : fd(-1), connected(false), lastHeardNs(0), packetsSent(0), packetsReceived(0) {}
+
+VersusPacket VersusLink::makePacket(VersusPacketType type) {
+    VersusPacket packet;
+    memset(&packet, 0, sizeof(packet));
+    memcpy(packet.magic, VERSUS_MAGIC, sizeof(packet.magic));
+    packet.type = type;
+    return packet;
+}
+
+#ifdef _WIN32
+VersusLink::~VersusLink() {}
+
+bool VersusLink::openSocket(int, string& error) {
+    error = "versus needs POSIX sockets";
+    return false;
+}
+
+bool VersusLink::host(int port, uint32_t, int, string& error) {
+    return openSocket(port, error);
+}
+
+bool VersusLink::join(const string&, int port, int, uint32_t&, string& error) {
+    return openSocket(port, error);
+}
+
+bool VersusLink::receive(VersusPacket&) { return false; }
+void VersusLink::send(const VersusPacket&) {}
+bool VersusLink::isLost() const { return true; }
+#else
+VersusLink::~VersusLink() {
+    if (fd >= 0) close(fd);
+}
+
+// port 0 takes any free port
+bool VersusLink::openSocket(int port, string& error) {
+    fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        error = strerror(errno);
+        return false;
+    }
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<uint16_t>(port));
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        error = "port " + to_string(port) + ": " + strerror(errno);
+        close(fd);
+        fd = -1;
+        return false;
+    }
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    return true;
 }
 
-// New: Spawn shield power-up
-void Game::spawnShield() {
-    bool occupied;
-    do {
-        occupied = false;
-        shield.first = rand() % (WIDTH - 2) + 1;
-        shield.second = rand() % (HEIGHT - 2) + 1;
-        
-        for (const auto& segment : snake.getBody()) {
-            if (segment.first == shield.first && shield.second == shield.second) {
-                occupied = true;
-                break;
+bool VersusLink::host(int port, uint32_t seed, int waitMs, string& error) {
+    if (!openSocket(port, error)) return false;
+
+    uint64_t deadline = monotonicNs() + static_cast<uint64_t>(waitMs) * 1000000;
+    while (monotonicNs() < deadline) {
+        pollfd pfd = { fd, POLLIN, 0 };
+        poll(&pfd, 1, 100);
+
+        VersusPacket packet;
+        sockaddr_in from;
+        socklen_t fromLength = sizeof(from);
+        ssize_t received;
+        while ((received = recvfrom(fd, &packet, sizeof(packet), 0, reinterpret_cast<sockaddr*>(&from),
+                                    &fromLength)) >= 0) {
+            if (received == static_cast<ssize_t>(sizeof(packet)) &&
+                memcmp(packet.magic, VERSUS_MAGIC, sizeof(packet.magic)) == 0 && packet.type == PACKET_HELLO) {
+                peer = from;
+                connected = true;
+                lastHeardNs = monotonicNs();
+                packetsReceived++;
+                VersusPacket start = makePacket(PACKET_START);
+                start.seed = seed;
+                send(start);
+                return true;
             }
+            fromLength = sizeof(from);
         }
-        if (shield.first == food.first && shield.second == food.second) {
-            occupied = true;
-        }
-        if (specialFoodActive && shield.first == specialFood.first && shield.second == specialFood.second) {
-            occupied = true;
-        }
-        if (poisonFoodActive && shield.first == poisonFood.first && shield.second == poisonFood.second) {
-            occupied = true;
-        }
-        if (isObstacle(shield.first, shield.second)) {
-            occupied = true;
-        }
-    } while (occupied);
-    shieldActive = true;
-    shieldSpawnTime = chrono::steady_clock::now();
+    }
+    error = "nobody joined within " + to_string(waitMs / 1000) + "s";
+    return false;
 }
 
-void Game::spawnObstacles() {
-    obstacles.clear();
-    bool occupied;
-
-    for (int i = 0; i < OBSTACLE_COUNT; ++i) {
-        pair<int, int> obs;
-        do {
-            occupied = false;
-            obs.first = rand() % WIDTH;
-            obs.second = rand() % HEIGHT;
+bool VersusLink::join(const string& address, int port, int waitMs, uint32_t& seed, string& error) {
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    addrinfo* found = nullptr;
+    int status = getaddrinfo(address.c_str(), to_string(port).c_str(), &hints, &found);
+    if (status != 0 || !found) {
+        error = address + ": " + gai_strerror(status);
+        return false;
+    }
+    memcpy(&peer, found->ai_addr, sizeof(peer));
+    freeaddrinfo(found);
+    if (!openSocket(0, error)) return false;
+    connected = true;
 
-            for (const auto& segment : snake.getBody()) {
-                if (segment.first == obs.first && segment.second == obs.second) {
-                    occupied = true;
-                    break;
-                }
-            }
+    // Hellos go out every HELLO_INTERVAL_MS until the host answers
+    const int HELLO_INTERVAL_MS = 200;
+    uint64_t deadline = monotonicNs() + static_cast<uint64_t>(waitMs) * 1000000;
+    while (monotonicNs() < deadline) {
+        send(makePacket(PACKET_HELLO));
+        pollfd pfd = { fd, POLLIN, 0 };
+        poll(&pfd, 1, HELLO_INTERVAL_MS);
 
-            if (obs.first == food.first && obs.second == food.second) {
-                occupied = true;
-            }
-            if (specialFoodActive && obs.first == specialFood.first && obs.second == specialFood.second) {
-                occupied = true;
-            }
-            if (poisonFoodActive && obs.first == poisonFood.first && obs.second == poisonFood.second) {
-                occupied = true;
+        VersusPacket packet;
+        while (receive(packet)) {
+            if (packet.type == PACKET_START) {
+                seed = packet.seed;
+                return true;
             }
-            if (shieldActive && obs.first == shield.first && obs.second == shield.second) {
-                occupied = true;
-            }
-        } while (occupied);
-        obstacles.push_back(obs);
+        }
     }
-    obstaclesActive = true;
-    obstacleSpawnTime = chrono::steady_clock::now();
+    error = "no answer from " + address + ":" + to_string(port);
+    return false;
 }
 
-void Game::updateSpecialFood() {
-    if (specialFoodActive) {
-        auto now = chrono::steady_clock::now();
-        auto duration = chrono::duration_cast<chrono::seconds>(now - specialFoodSpawnTime);
-        if (duration.count() >= SPECIAL_FOOD_DURATION) {
-            specialFoodActive = false;
+bool VersusLink::receive(VersusPacket& packet) {
+    while (true) {
+        sockaddr_in from;
+        socklen_t fromLength = sizeof(from);
+        ssize_t received = recvfrom(fd, &packet, sizeof(packet), 0, reinterpret_cast<sockaddr*>(&from), &fromLength);
+        if (received < 0) return false; // EAGAIN: nothing more for now
+        if (received != static_cast<ssize_t>(sizeof(packet)) ||
+            memcmp(packet.magic, VERSUS_MAGIC, sizeof(packet.magic)) != 0 || packet.count > VersusPacket::MAX_INPUTS ||
+            from.sin_addr.s_addr != peer.sin_addr.s_addr || from.sin_port != peer.sin_port) {
+            continue;
         }
+        packetsReceived++;
+        lastHeardNs = monotonicNs();
+        return true;
+    }
+}
+
+void VersusLink::send(const VersusPacket& packet) {
+    // A datagram that can't go out now is as good as lost, and the next
+    // packet repeats it
+    if (sendto(fd, &packet, sizeof(packet), 0, reinterpret_cast<const sockaddr*>(&peer), sizeof(peer)) ==
+        static_cast<ssize_t>(sizeof(packet))) {
+        packetsSent++;
     }
 }
 
-// New: Update poison food
-void Game::updatePoisonFood() {
-    if (poisonFoodActive) {
-        auto now = chrono::steady_clock::now();
-        auto duration = chrono::duration_cast<chrono::seconds>(now - poisonFoodSpawnTime);
-        if (duration.count() >= POISON_FOOD_DURATION) {
-            poisonFoodActive = false;
+bool VersusLink::isLost() const {
+    return connected && monotonicNs() - lastHeardNs > static_cast<uint64_t>(TIMEOUT_MS) * 1000000;
+}
+#endif
+
+// VersusGame implementation
+VersusGame::VersusGame(uint32_t seed, int localPlayer) : session(seed, localPlayer), queuedTurnCount(0), quit(false) {
+    setupConsole();
+    screen.hideCursor();
+    loadCustomGraphics();
+}
+
+VersusGame::~VersusGame() {
+    screen.showCursor();
+}
+
+void VersusGame::handleInput() {
+    unsigned char bytes[INPUT_BUFFER_SIZE];
+    Key decoded[INPUT_BUFFER_SIZE];
+    int count = keys.feed(bytes, InputHandler::readAvailable(bytes, INPUT_BUFFER_SIZE), decoded);
+
+    // No pause: the other player's game doesn't stop
+    for (int i = 0; i < count; i++) {
+        Direction turn = STOP;
+        switch (decoded[i]) {
+            case KEY_UP:    turn = UP; break;
+            case KEY_DOWN:  turn = DOWN; break;
+            case KEY_LEFT:  turn = LEFT; break;
+            case KEY_RIGHT: turn = RIGHT; break;
+            case KEY_QUIT:  quit = true; break;
+            case KEY_RENDER:
+                screen.setRenderMode(static_cast<RenderMode>((screen.getRenderMode() + 1) % RENDER_MODE_COUNT));
+                break;
+            default: break;
+        }
+        if (turn != STOP && queuedTurnCount < MAX_QUEUED_TURNS) {
+            queuedTurns[queuedTurnCount++] = turn;
         }
     }
 }
 
-// New: Update shield power-up
-void Game::updateShield() {
-    // Check if it's time to spawn a new shield
-    auto now = chrono::steady_clock::now();
-    auto timeSinceLastSpawn = chrono::duration_cast<chrono::seconds>(now - lastShieldSpawnTime);
-    
-    if (!shieldActive && timeSinceLastSpawn.count() >= SHIELD_SPAWN_INTERVAL) {
-        spawnShield();
-        lastShieldSpawnTime = now;
+bool VersusGame::tick() {
+    session.reconcile();
+    if (session.getState().isOver()) return true;
+    if (!session.canAdvance()) {
+        session.noteStall();
+        return false;
     }
-    
-    // Update existing shield duration
-    if (shieldActive) {
-        auto shieldDuration = chrono::duration_cast<chrono::seconds>(now - shieldSpawnTime);
-        if (shieldDuration.count() >= SHIELD_DURATION) {
-            shieldActive = false;
+
+    Direction turn = STOP;
+    if (queuedTurnCount > 0) {
+        turn = queuedTurns[0];
+        queuedTurnCount--;
+        for (int i = 0; i < queuedTurnCount; i++) {
+            queuedTurns[i] = queuedTurns[i + 1];
         }
     }
-    
-    // Update snake's shield status timer
-    if (snake.hasShield()) {
-        if (snake.getShieldTimeRemaining() <= 0) {
-            snake.deactivateShield();
+    session.advance(turn);
+    return true;
+}
+
+void VersusGame::draw(const string& status) {
+    const Versus& state = session.getState();
+    int local = session.getLocalPlayer();
+    bool over = state.isOver();
+    uint64_t start = monotonicNs();
+
+    screen.clear();
+    screen.addToBuffer("====== 🐍 SNAKE VERSUS 🐲 ======\n");
+
+    Glyph frame[FRAME_HEIGHT][FRAME_WIDTH];
+    for (int y = 0; y < FRAME_HEIGHT; y++) {
+        for (int x = 0; x < FRAME_WIDTH; x++) {
+            bool border = x == 0 || y == 0 || x == FRAME_WIDTH - 1 || y == FRAME_HEIGHT - 1;
+            frame[y][x] = border ? GLYPH_WALL : GLYPH_EMPTY;
         }
     }
-}
+    Cell food = state.getFood();
+    if (food.x >= 0) frame[food.y + 1][food.x + 1] = GLYPH_FOOD;
 
-void Game::updateObstacles() {
-    if (obstaclesActive) {
-        auto now = chrono::steady_clock::now();
-        auto duration = chrono::duration_cast<chrono::seconds>(now - obstacleSpawnTime);
-        if (duration.count() >= OBSTACLE_DURATION) {
-            obstaclesActive = false;
-            obstacles.clear();
+    // Own snake in the usual colours, the other one blue; a dead one goes red
+    for (int p = 0; p < Versus::PLAYERS; p++) {
+        const Snake& snake = state.getSnake(p);
+        bool dead = !state.isAlive(p);
+        Glyph body = dead ? GLYPH_BODY_DEAD : p == local ? GLYPH_BODY : GLYPH_RIVAL_BODY;
+        Glyph head = dead ? GLYPH_HEAD_DEAD : p == local ? GLYPH_HEAD : GLYPH_RIVAL_HEAD;
+        for (int i = snake.getLength() - 1; i >= 0; i--) {
+            Cell segment = snake.getSegment(i);
+            if (segment.x >= -1 && segment.x <= WIDTH && segment.y >= -1 && segment.y <= HEIGHT) {
+                frame[segment.y + 1][segment.x + 1] = i == 0 ? head : body;
+            }
         }
     }
-}
 
-int Game::getGameSpeed() {
-    int speedReduction = min(snake.getLength() * speedDecrement, baseSpeed - minSpeed);
-    int calculatedSpeed = baseSpeed - speedReduction;
-    return max(calculatedSpeed, minSpeed);
-}
+    const char* overlay = nullptr;
+    if (over) {
+        int winner = state.getWinner();
+        overlay = winner < 0 ? "D R A W" : winner == local ? "Y O U  W I N" : "Y O U  L O S E";
+    }
+    screen.addBoard(&frame[0][0], FRAME_WIDTH, FRAME_HEIGHT, SPECIAL_FOOD_EMOJI, overlay, HEIGHT / 2 - 2);
 
-// --- TIMER REMAINING HELPERS (For Draw) ---
+    screen.addToBuffer("==============================================\n");
+    screen.addToBuffer("You: " + to_string(state.getScore(local)) + " " + SNAKE_HEAD + " | Rival: " +
+                       to_string(state.getScore(1 - local)) + " " + RIVAL_HEAD + "          \n");
+    if (screen.getOutputLevel() < OUTPUT_REDUCED_HUD) {
+        screen.addToBuffer("----------------------------------------------\n");
+        screen.addToBuffer("Tick: " + to_string(session.getTick()) + ", confirmed " +
+                           to_string(session.getConfirmedTick()) + "        \n");
+        screen.addToBuffer("Rollbacks: " + to_string(session.getRollbacks()) + ", deepest " +
+                           to_string(session.getDeepestRollback()) + " ticks, worst " +
+                           to_string(session.getSlowestRollbackNs() / 1000) + "µs | Stalls: " +
+                           to_string(session.getStalls()) + "        \n");
+    }
+    screen.addToBuffer(status + "        \n");
+    screen.addToBuffer("----------------------------------------------\n");
+    screen.addToBuffer("Controls: WASD/Arrows | R: Display | Q: Quit\n");
+    screen.addToBuffer("==============================================\n");
 
-// Calculates remaining time for active obstacles
-int Game::getObstacleTimeRemaining() const {
-    if (!obstaclesActive) return 0;
-    auto now = chrono::steady_clock::now();
-    auto elapsed = chrono::duration_cast<chrono::seconds>(now - obstacleSpawnTime).count();
-    return max(0, OBSTACLE_DURATION - (int)elapsed);
+    Metrics::observe(METRIC_FRAME_COMPOSE, monotonicNs() - start);
+    screen.draw(!over);
 }
 
-// ADDED: Calculates remaining time for active special food
-int Game::getSpecialFoodTimeRemaining() const {
-    if (!specialFoodActive) return 0;
-    auto now = chrono::steady_clock::now();
-    auto elapsed = chrono::duration_cast<chrono::seconds>(now - specialFoodSpawnTime).count();
-    return max(0, SPECIAL_FOOD_DURATION - (int)elapsed);
-}
+// Dashboard implementation
 
-// ADDED: Calculates remaining time until the next shield spawns
-int Game::getShieldSpawnRemaining() const {
-    if (shieldActive || snake.hasShield()) return 0; // Don't show spawn countdown if a shield is already on the map or active on snake
-    auto now = chrono::steady_clock::now();
-    auto timeSinceLastSpawn = chrono::duration_cast<chrono::seconds>(now - lastShieldSpawnTime);
-    return max(0, SHIELD_SPAWN_INTERVAL - (int)timeSinceLastSpawn.count());
-}
+// Which glyph of a 2x2 block gives it its colour: the head, then items, then
+// the body, then walls
+static const uint8_t TILE_PRIORITY[GLYPH_COUNT] = {
+    0, // GLYPH_EMPTY
+    1, // GLYPH_WALL
+    3, // GLYPH_BODY
+    3, // GLYPH_BODY_DEAD
+    4, // GLYPH_BODY_SHIELD
+    9, // GLYPH_HEAD
+    9, // GLYPH_HEAD_DEAD
+    6, // GLYPH_FOOD
+    7, // GLYPH_SPECIAL_FOOD
+    5, // GLYPH_POISON_FOOD
+    6, // GLYPH_SHIELD
+    2, // GLYPH_RIVAL_BODY
+    8, // GLYPH_RIVAL_HEAD
+};
 
-// --- END TIMER REMAINING HELPERS ---
+// By mask: 1 top left, 2 top right, 4 bottom left, 8 bottom right
+static const char* const QUADRANT_BLOCKS[16] = {
+    " ", "▘", "▝", "▀", "▖", "▌", "▞", "▛", "▗", "▚", "▐", "▜", "▄", "▙", "▟", "█"
+};
 
-// New: Get pause state
-bool Game::isPaused() const {
-    return paused;
+Dashboard::Dashboard(int tileColumns, int tileRows, bool asciiBoards)
+    : columns(max(tileColumns, 1)), rows(max(tileRows, 1)), ascii(asciiBoards), clearFirst(true), refreshes(0),
+      bytesSent(0), cellsSent(0), lastBytes(0) {
+    rows = min(rows, max(MAX_TILES / columns, 1));
+    columns = min(columns, MAX_TILES);
+    width = columns * TILE_WIDTH - 1;
+    height = HEADER_LINES + rows * TILE_HEIGHT;
+    cells.assign(width * height, TerminalCell{ ' ', 0 });
+    shown = cells;
+    // Enough for every cell with a cursor move and a colour, so a refresh never allocates
+    output.reserve(static_cast<size_t>(width) * height * 16 + 64);
 }
 
-// MODIFIED: Toggle pause state with time compensation
-void Game::togglePause() {
-    paused = !paused;
-    
-    if (paused) {
-        pauseStartTime = chrono::steady_clock::now();
-    } else {
-        auto now = chrono::steady_clock::now();
-        // Calculate the duration of the pause. This results in steady_clock::duration.
-        auto pauseDuration = now - pauseStartTime; 
-        
-        // Compensate all active and spawning timers by ADDING the pause duration to their start times
-        
-        // 1. Special Food
-        if (specialFoodActive) {
-            specialFoodSpawnTime += pauseDuration;
-        }
-        
-        // 2. Poison Food (if active)
-        if (poisonFoodActive) {
-             poisonFoodSpawnTime += pauseDuration;
-        }
-        
-        // 3. Obstacles
-        if (obstaclesActive) {
-            obstacleSpawnTime += pauseDuration;
-        }
-
-        // 4. Shield Spawn Timer
-        lastShieldSpawnTime += pauseDuration;
-        
-        // 5. Shield Power-up Active on Snake
-        snake.adjustShieldStartTime(pauseDuration);
-        
-        // 6. Shield Power-up on map (if it hasn't been picked up)
-        if (shieldActive) {
-            shieldSpawnTime += pauseDuration;
+void Dashboard::drawTile(int tile, const Glyph* frame, const char* stats) {
+    int left = tile % columns * TILE_WIDTH;
+    int top = HEADER_LINES + tile / columns * TILE_HEIGHT;
+    for (int y = 0; y < TILE_BOARD_HEIGHT; y++) {
+        for (int x = 0; x < TILE_BOARD_WIDTH; x++) {
+            int mask = 0;
+            Glyph best = GLYPH_EMPTY;
+            for (int corner = 0; corner < 4; corner++) {
+                int frameX = x * 2 + (corner & 1);
+                int frameY = y * 2 + (corner >> 1);
+                if (frameX >= FRAME_WIDTH || frameY >= FRAME_HEIGHT) continue;
+                Glyph glyph = frame[frameY * FRAME_WIDTH + frameX];
+                if (glyph == GLYPH_EMPTY) continue;
+                mask |= 1 << corner;
+                if (TILE_PRIORITY[glyph] > TILE_PRIORITY[best]) best = glyph;
+            }
+            // Blanks are plain spaces in the default colour, whatever drew them
+            const GlyphStyle& style = GLYPH_STYLES[best];
+            uint8_t symbol = mask == 0 ? ' ' : ascii ? style.ascii : QUADRANTS | mask;
+            put(left + x, top + y, symbol, mask == 0 ? 0 : style.sgr);
         }
     }
+    bool ended = false;
+    for (int x = 0; x < TILE_BOARD_WIDTH; x++) {
+        ended = ended || stats[x] == '\0';
+        char c = ended ? ' ' : stats[x];
+        put(left + x, top + TILE_BOARD_HEIGHT, c > ' ' && c < 0x7f ? c : ' ', 0);
+    }
 }
 
-void Game::draw() {
-    screen.clear();
-    
-    screen.addToBuffer("====== 🐍 SNAKE GAME 🐍 ======\n");
-    
-    for (int i = 0; i < WIDTH + 2; i++) {
-        screen.addToBuffer(WALL);
+void Dashboard::drawHeader(const char* text) {
+    bool ended = false;
+    for (int x = 0; x < width; x++) {
+        ended = ended || text[x] == '\0';
+        char c = ended ? ' ' : text[x];
+        put(x, 0, c > ' ' && c < 0x7f ? c : ' ', 0);
     }
-    screen.addToBuffer("\n");
+}
 
-    for (int y = 0; y < HEIGHT; y++) {
-        if (wallCrash && crashPosition.first == -1 && crashPosition.second == y) {
-            screen.addToBuffer(SNAKE_HEAD_DEAD);
+// Cells go out in reading order. The cursor jumps over unchanged ones,
+// unless writing them again is shorter (a cell or two in the colour already
+// set, or blank); colours are only sent when they change, and blanks don't
+// need one.
+const string& Dashboard::refresh() {
+    output.clear();
+    if (clearFirst) {
+        output += "\033[0m\033[2J";
+        fill(shown.begin(), shown.end(), TerminalCell{ ' ', 0 });
+        clearFirst = false;
+    }
+    auto symbolText = [](uint8_t symbol, string& out) {
+        if (symbol & QUADRANTS) {
+            out += QUADRANT_BLOCKS[symbol & 15];
         } else {
-            screen.addToBuffer(WALL);
+            out += static_cast<char>(symbol);
         }
-        
-        for (int x = 0; x < WIDTH; x++) {
-            if (gameOver && y == HEIGHT/2 - 4 && x == WIDTH/2 - 4) {
-                screen.addToBuffer("G A M E  O V E R");
-                x += 7;
-                continue;
-            }
-            
-            if (paused && y == HEIGHT/2 - 3 && x == WIDTH/2 - 3) {
-                screen.addToBuffer("P A U S E D");
-                x += 5;
-                continue;
-            }
-            
-            string cellContent = EMPTY_SPACE;
-            bool isOccupied = false;
-            
-            if (obstaclesActive) {
-                for (const auto& obs : obstacles) {
-                    if (x == obs.first && y == obs.second) {
-                        cellContent = WALL;
-                        isOccupied = true;
-                        break;
-                    }
-                }
-            }
-            
-            if (!isOccupied) {
-                if (x == snake.getHead().first && y == snake.getHead().second) {
-                    if (gameOver && !wallCrash) {
-                        cellContent = SNAKE_HEAD_DEAD;
-                    } else {
-                        cellContent = SNAKE_HEAD;
-                    }
-                }
-                else if (specialFoodActive && x == specialFood.first && y == specialFood.second && !gameOver) {
-                    cellContent = SPECIAL_FOOD_EMOJI;
-                }
-                else if (poisonFoodActive && x == poisonFood.first && y == poisonFood.second && !gameOver) {
-                    cellContent = POISON_FOOD_EMOJI;
-                }
-                else if (shieldActive && x == shield.first && y == shield.second && !gameOver) {
-                    cellContent = SHIELD_EMOJI;
-                }
-                else if (x == food.first && y == food.second && !gameOver) {
-                    cellContent = FOOD_EMOJI;
+    };
+    char sequence[24];
+    int color = 0; // Every refresh ends in the default colour
+    int cursorX = -1, cursorY = -1;
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            const TerminalCell& cell = cells[y * width + x];
+            if (cell == shown[y * width + x]) continue;
+
+            if (y == cursorY && x == cursorX) {
+                // Right where the last cell left it
+            } else if (y == cursorY && x > cursorX) {
+                int jump = snprintf(sequence, sizeof(sequence), "\033[%dC", x - cursorX);
+                int rewrite = 0;
+                for (int gap = cursorX; gap < x && rewrite <= jump; gap++) {
+                    const TerminalCell& same = cells[y * width + gap];
+                    bool colored = same.symbol != ' ' && same.color != color;
+                    rewrite += colored ? jump + 1 : (same.symbol & QUADRANTS) ? 3 : 1;
                 }
-                else {
-                    for (size_t i = 1; i < snake.getBody().size(); i++) {
-                        if (x == snake.getBody()[i].first && y == snake.getBody()[i].second) {
-                            if (gameOver) {
-                                cellContent = SNAKE_BODY_DEAD;
-                            } else if (snake.hasShield() && snake.shouldBlink()) {
-                                cellContent = SNAKE_BODY_SHIELD; // Blinking purple when shield active
-                            } else {
-                                cellContent = SNAKE_BODY;
-                            }
-                            break;
-                        }
+                if (rewrite < jump) {
+                    for (int gap = cursorX; gap < x; gap++) {
+                        symbolText(cells[y * width + gap].symbol, output);
                     }
+                } else {
+                    output.append(sequence, jump);
                 }
+            } else {
+                output.append(sequence, snprintf(sequence, sizeof(sequence), "\033[%d;%dH", y + 1, x + 1));
             }
-            
-            screen.addToBuffer(cellContent);
-        }
-        
-        if (wallCrash && crashPosition.first == WIDTH && crashPosition.second == y) {
-            screen.addToBuffer(SNAKE_HEAD_DEAD);
-        } else {
-            screen.addToBuffer(WALL);
+            if (cell.symbol != ' ' && cell.color != color) {
+                output.append(sequence, snprintf(sequence, sizeof(sequence), "\033[%dm", cell.color));
+                color = cell.color;
+            }
+            symbolText(cell.symbol, output);
+            shown[y * width + x] = cell;
+            cursorX = x + 1;
+            cursorY = y;
+            cellsSent++;
         }
-        screen.addToBuffer("\n");
     }
+    if (color != 0) output += "\033[0m";
+    if (cursorY >= 0) {
+        output.append(sequence, snprintf(sequence, sizeof(sequence), "\033[%d;1H", height + 1)); // Out of the way
+    }
+    refreshes++;
+    bytesSent += output.size();
+    lastBytes = output.size();
+    return output;
+}
 
-    for (int i = 0; i < WIDTH + 2; i++) {
-        if (wallCrash && crashPosition.first == i && crashPosition.second == HEIGHT) {
-            screen.addToBuffer(SNAKE_HEAD_DEAD);
-        } else {
-            screen.addToBuffer(WALL);
-        }
+// SessionServer implementation
+template <class Rules>
+SessionServer<Rules>::Session::Session(int connection, uint32_t seed, RenderMode mode)
+    : sim(seed), fd(connection), paused(false), writeWatched(false), queuedTurnCount(0), turnedThisTick(false),
+      timerSerial(0) {
+    screen.setRenderMode(mode);
+    screen.setOutputFd(connection);
+    screen.leaveOutOfMetrics();
+    screen.startOutput();
+}
+
+template <class Rules>
+SessionServer<Rules>::Worker::Worker()
+    : epollFd(-1), wakeFd(-1), nextMemoryCheckNs(0), sessions(0), sessionsTotal(0), gamesStarted(0), ticks(0),
+      lateTicks(0), worstLatenessNs(0), framesSent(0), framesDropped(0), sessionBytes(0), closedFramesSent(0),
+      closedFramesDropped(0) {}
+
+template <class Rules>
+SessionServer<Rules>::SessionServer()
+    : config(), unixFd(-1), tcpFd(-1), liveSessions(0), refused(0),
+      seedCounter(static_cast<uint32_t>(time(nullptr))), running(false) {}
+
+template <class Rules>
+SessionServer<Rules>::~SessionServer() {
+    stop();
+}
+
+template <class Rules>
+ServerStats SessionServer<Rules>::getStats() const {
+    ServerStats stats = ServerStats();
+    stats.refused = refused.load(memory_order_relaxed);
+    for (const unique_ptr<Worker>& worker : workers) {
+        stats.sessions += worker->sessions.load(memory_order_relaxed);
+        stats.sessionsTotal += worker->sessionsTotal.load(memory_order_relaxed);
+        stats.gamesStarted += worker->gamesStarted.load(memory_order_relaxed);
+        stats.ticks += worker->ticks.load(memory_order_relaxed);
+        stats.lateTicks += worker->lateTicks.load(memory_order_relaxed);
+        stats.worstLatenessNs = max(stats.worstLatenessNs, worker->worstLatenessNs.load(memory_order_relaxed));
+        stats.framesSent += worker->framesSent.load(memory_order_relaxed);
+        stats.framesDropped += worker->framesDropped.load(memory_order_relaxed);
+        stats.sessionBytes += worker->sessionBytes.load(memory_order_relaxed);
     }
-    screen.addToBuffer("\n");
+    return stats;
+}
 
-    // --- FIXED: Clean ASCII interface without box drawing characters ---
-    screen.addToBuffer("==============================================\n");
-    screen.addToBuffer("             GAME STATISTICS                 \n");
-    screen.addToBuffer("----------------------------------------------\n");
-    
-    // Score
-    screen.addToBuffer("Score: " + to_string(score) + " 🏆\n");
-    
-    // High Score
-    screen.addToBuffer("High Score: " + to_string(highScore) + " ⭐\n");
-    
-    // Length
-    screen.addToBuffer("Length: " + to_string(snake.getLength()) + " 📏\n");
-    
-    // Speed
-    screen.addToBuffer("Speed: " + to_string(getGameSpeed()) + "ms 🚀\n");
-    
-    // Special Food Status
-    string specialFoodStatus;
-    if (paused && specialFoodActive) {
-        specialFoodStatus = "      PAUSED      ";
-    } else if (specialFoodActive) {
-        int remaining = getSpecialFoodTimeRemaining();
-        specialFoodStatus = "Active " + to_string(remaining) + " s";
-    } else {
-        specialFoodStatus = "Eaten: " + to_string(specialFoodEaten);
+template <class Rules>
+int SessionServer<Rules>::tickInterval(const Session& session) const {
+    return config.tickMs > 0 ? config.tickMs : session.sim.getGameSpeed();
+}
+
+template <class Rules>
+void SessionServer<Rules>::turn(Session& session, Direction dir) {
+    if (!session.turnedThisTick) {
+        session.sim.changeDirection(dir);
+        session.turnedThisTick = true;
+    } else if (session.queuedTurnCount < MAX_QUEUED_TURNS) {
+        session.queuedTurns[session.queuedTurnCount++] = dir;
     }
-    screen.addToBuffer("Special Food: " + specialFoodStatus + "        \n");
-    
-    // Shield status (Combined logic for active shield and spawn timer)
-    string shieldStatus;
-    if (paused) {
-        if (snake.hasShield() || shieldActive) {
-             shieldStatus = "      PAUSED      "; 
-        } else {
-             shieldStatus = "      PAUSED      ";
-        }
-    } else if (snake.hasShield()) {
-        // Snake has active shield
-        shieldStatus = "Active " + to_string(snake.getShieldTimeRemaining()) + " s 🛡️     ";
-    } else if (shieldActive) {
-        // Shield power-up is on the map (Time on map is SHIELD_DURATION)
-        auto now = chrono::steady_clock::now();
-        auto elapsed = chrono::duration_cast<chrono::seconds>(now - shieldSpawnTime).count();
-        int remaining = max(0, SHIELD_DURATION - (int)elapsed); 
-        shieldStatus = "Available (" + to_string(remaining) + "s) " + SHIELD_EMOJI;
-    } else {
-        // Waiting for next shield spawn
-        int nextSpawn = getShieldSpawnRemaining();
-        shieldStatus = "Available in " + to_string(nextSpawn) + " s  ";
+}
+
+// A shorter version of the game's screen: the board and one line of stats
+template <class Rules>
+void SessionServer<Rules>::draw(Session& session) {
+    const Simulation<Rules>& sim = session.sim;
+    Screen& screen = session.screen;
+    bool gameOver = sim.isGameOver();
+
+    screen.clear();
+    screen.addToBuffer("====== 🐍 SNAKE GAME 🐍 ======\n");
+
+    Glyph frame[FRAME_HEIGHT][FRAME_WIDTH];
+    composeBoard(sim, &frame[0][0]);
+    const string* specialGlyph = &SPECIAL_FOOD_EMOJI;
+    if (!gameOver && sim.getSpecialFoodSpawned() > 0) {
+        specialGlyph = &SPECIAL_FOODS[(sim.getSpecialFoodSpawned() - 1) % SPECIAL_FOODS.size()];
     }
-    screen.addToBuffer("Shield: " + shieldStatus + "\n");
-    
-    // Obstacles status - full width
-    string obstacleStr;
-    if (paused && obstaclesActive) {
-        obstacleStr = "      PAUSED      ";
-    } else if (obstaclesActive) {
-        int remaining = getObstacleTimeRemaining();
-        obstacleStr = "Active " + to_string(remaining) + " s 🚧      ";
+    if (gameOver) {
+        screen.addBoard(&frame[0][0], FRAME_WIDTH, FRAME_HEIGHT, *specialGlyph, "G A M E  O V E R", HEIGHT / 2 - 3);
+    } else if (session.paused) {
+        screen.addBoard(&frame[0][0], FRAME_WIDTH, FRAME_HEIGHT, *specialGlyph, "P A U S E D", HEIGHT / 2 - 2);
     } else {
-        obstacleStr = "Clear              ";
-    }
-    screen.addToBuffer("Obstacles: " + obstacleStr + "\n");
-    
-    screen.addToBuffer("----------------------------------------------\n");
-    
-    // Controls
-    screen.addToBuffer("Controls: WASD/Arrows | SPACE: Pause | Q: Quit\n");
-    
-    if (paused) {
-        screen.addToBuffer("               *** GAME PAUSED ***               \n");
+        screen.addBoard(&frame[0][0], FRAME_WIDTH, FRAME_HEIGHT, *specialGlyph);
     }
-    
+
+    screen.addToBuffer("==============================================\n");
+    screen.addToBuffer("Score: " + to_string(sim.getScore()) + " 🏆 | Length: " + to_string(sim.getSnake().getLength()) +
+                       " 📏 | Speed: " + to_string(tickInterval(session)) + "ms 🚀      \n");
     if (gameOver) {
-        screen.addToBuffer("                 💀 GAME OVER! 💀                \n");
+        screen.addToBuffer("💀 GAME OVER! Any key: play again | Q: Quit 💀\n");
+    } else {
+        screen.addToBuffer("Controls: WASD/Arrows | SPACE: Pause | R: Display | Q: Quit\n");
     }
-    
     screen.addToBuffer("==============================================\n");
+    screen.draw(!session.paused && !gameOver);
+}
+
+#ifdef __linux__
+// epoll tags besides sessions, which are tagged with their slot and generation
+static const uint64_t SERVER_EVENT_WAKE = ~0ULL;
+static const uint64_t SERVER_EVENT_UNIX = ~0ULL - 1;
+static const uint64_t SERVER_EVENT_TCP = ~0ULL - 2;
+static const char SERVER_GREETING[] = "\033[2J\033[?25l"; // Clear the screen, hide the cursor
+static const char SERVER_FULL[] = "Server full, try again later\r\n";
 
-    screen.draw();
+static uint64_t packSession(int slot, uint32_t generation) {
+    return static_cast<uint64_t>(generation) << 32 | static_cast<uint32_t>(slot);
 }
-void Game::update() {
-    // If paused, timers are stopped via togglePause, but game logic must stop
-    if (gameOver || paused) return;
 
-    snake.move();
-    updateSpecialFood();
-    updatePoisonFood(); // New: Update poison food
-    updateShield(); // New: Update shield power-up
-    updateObstacles();
-
-    pair<int, int> head = snake.getHead();
-
-    // Check Wall Collision (shield doesn't protect from walls)
-    if (head.first < 0 || head.first >= WIDTH || 
-        head.second < 0 || head.second >= HEIGHT) {
-        gameOver = true;
-        wallCrash = true;
-        
-        // Determine crash position for drawing the dead snake head on the wall
-        if (head.first < 0) crashPosition = make_pair(-1, head.second);
-        else if (head.first >= WIDTH) crashPosition = make_pair(WIDTH, head.second);
-        else if (head.second < 0) crashPosition = make_pair(head.first, -1);
-        else if (head.second >= HEIGHT) crashPosition = make_pair(head.first, HEIGHT);
-        
-        saveHighScore(); // --- HIGH SCORE ADDITION: Save on game over
-        return;
+template <class Rules>
+bool SessionServer<Rules>::start(const ServerConfig& serverConfig, string& error) {
+    config = serverConfig;
+    config.threads = max(1, config.threads);
+    // Before any thread exists: from here on the emoji strings are only read
+    loadCustomGraphics();
+
+    // Thousands of connections need more descriptors than the usual soft
+    // limit; the cap leaves some for everything else
+    rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+        if (limit.rlim_cur < limit.rlim_max) {
+            limit.rlim_cur = limit.rlim_max;
+            setrlimit(RLIMIT_NOFILE, &limit);
+            getrlimit(RLIMIT_NOFILE, &limit);
+        }
+        if (limit.rlim_cur != RLIM_INFINITY) {
+            config.maxSessions = min<long long>(config.maxSessions, static_cast<long long>(limit.rlim_cur) - 64);
+        }
     }
 
-    // Check Self Collision (skip if shield is active)
-    if (!snake.hasShield()) {
-        for (size_t i = 1; i < snake.getBody().size(); i++) {
-            if (head.first == snake.getBody()[i].first && 
-                head.second == snake.getBody()[i].second) {
-                gameOver = true;
-                saveHighScore(); // --- HIGH SCORE ADDITION: Save on game over
-                return;
+    if (!config.unixPath.empty()) {
+        sockaddr_un address;
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        if (config.unixPath.size() >= sizeof(address.sun_path)) {
+            error = config.unixPath + ": path too long";
+            return false;
+        }
+        memcpy(address.sun_path, config.unixPath.c_str(), config.unixPath.size());
+        // A socket left behind by an earlier server is taken over; anything else stays
+        struct stat existing;
+        if (lstat(config.unixPath.c_str(), &existing) == 0 && S_ISSOCK(existing.st_mode)) {
+            unlink(config.unixPath.c_str());
+        }
+        unixFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (unixFd < 0 || bind(unixFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+            listen(unixFd, SOMAXCONN) != 0) {
+            error = config.unixPath + ": " + strerror(errno);
+            stop();
+            return false;
+        }
+    }
+    if (config.tcpPort > 0) {
+        sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_port = htons(static_cast<uint16_t>(config.tcpPort));
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        tcpFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        int reuse = 1;
+        if (tcpFd >= 0) setsockopt(tcpFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        if (tcpFd < 0 || bind(tcpFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+            listen(tcpFd, SOMAXCONN) != 0) {
+            error = "127.0.0.1:" + to_string(config.tcpPort) + ": " + strerror(errno);
+            stop();
+            return false;
+        }
+    }
+    if (unixFd < 0 && tcpFd < 0) {
+        error = "no socket to listen on";
+        return false;
+    }
+
+    // Every thread waits on both listening sockets; EPOLLEXCLUSIVE wakes one
+    // of them per connection instead of all
+    for (int i = 0; i < config.threads; i++) {
+        unique_ptr<Worker> worker(new Worker());
+        worker->epollFd = epoll_create1(EPOLL_CLOEXEC);
+        worker->wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (worker->epollFd < 0 || worker->wakeFd < 0) {
+            error = strerror(errno);
+            if (worker->epollFd >= 0) ::close(worker->epollFd);
+            if (worker->wakeFd >= 0) ::close(worker->wakeFd);
+            stop();
+            return false;
+        }
+        epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.u64 = SERVER_EVENT_WAKE;
+        epoll_ctl(worker->epollFd, EPOLL_CTL_ADD, worker->wakeFd, &event);
+        event.events = EPOLLIN | EPOLLEXCLUSIVE;
+        if (unixFd >= 0) {
+            event.data.u64 = SERVER_EVENT_UNIX;
+            epoll_ctl(worker->epollFd, EPOLL_CTL_ADD, unixFd, &event);
+        }
+        if (tcpFd >= 0) {
+            event.data.u64 = SERVER_EVENT_TCP;
+            epoll_ctl(worker->epollFd, EPOLL_CTL_ADD, tcpFd, &event);
+        }
+        workers.push_back(move(worker));
+    }
+    running = true;
+    for (unique_ptr<Worker>& worker : workers) {
+        worker->runner = thread(&SessionServer::run, this, ref(*worker));
+    }
+    return true;
+}
+
+// The threads close their own sessions on the way out. The workers stay, so
+// the totals can still be read.
+template <class Rules>
+void SessionServer<Rules>::stop() {
+    for (unique_ptr<Worker>& worker : workers) {
+        if (worker->runner.joinable()) {
+            uint64_t one = 1;
+            if (write(worker->wakeFd, &one, sizeof(one)) < 0) {
+                // Can't fail for an eventfd that is far from overflowing
             }
+            worker->runner.join();
         }
+        if (worker->epollFd >= 0) ::close(worker->epollFd);
+        if (worker->wakeFd >= 0) ::close(worker->wakeFd);
+        worker->epollFd = worker->wakeFd = -1;
     }
-    
-    // Check Obstacle Collision (skip if shield is active)
-    if (obstaclesActive && !snake.hasShield()) {
-        for (const auto& obs : obstacles) {
-            if (head.first == obs.first && head.second == obs.second) {
-                gameOver = true;
-                saveHighScore(); // --- HIGH SCORE ADDITION: Save on game over
-                return;
+    if (unixFd >= 0) {
+        ::close(unixFd);
+        unlink(config.unixPath.c_str());
+        unixFd = -1;
+    }
+    if (tcpFd >= 0) {
+        ::close(tcpFd);
+        tcpFd = -1;
+    }
+    running = false;
+}
+
+template <class Rules>
+void SessionServer<Rules>::run(Worker& worker) {
+    epoll_event events[MAX_EVENTS];
+    // A client that hangs up makes writes fail with EPIPE instead of killing
+    // the process; blocked per thread, as the signal goes to the writer
+    sigset_t pipeSignal;
+    sigemptyset(&pipeSignal);
+    sigaddset(&pipeSignal, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &pipeSignal, nullptr);
+    bool stopping = false;
+    while (!stopping) {
+        // Every session that is due, earliest first
+        uint64_t now = monotonicNs();
+        while (!worker.timers.empty() && worker.timers.top().dueNs <= now) {
+            Timer timer = worker.timers.top();
+            worker.timers.pop();
+            Session* session = worker.slots[timer.slot].get();
+            if (session && worker.generations[timer.slot] == timer.generation && session->timerSerial == timer.serial) {
+                tick(worker, timer.slot, timer.dueNs, now);
+            }
+        }
+        if (now >= worker.nextMemoryCheckNs) checkMemory(worker);
+
+        uint64_t wakeNs = worker.nextMemoryCheckNs;
+        if (!worker.timers.empty()) wakeNs = min(wakeNs, worker.timers.top().dueNs);
+        int timeout = wakeNs > now ? static_cast<int>((wakeNs - now + 999999) / 1000000) : 0;
+        int count = epoll_wait(worker.epollFd, events, MAX_EVENTS, timeout);
+        if (count < 0 && errno != EINTR) break;
+
+        for (int i = 0; i < count; i++) {
+            uint64_t tag = events[i].data.u64;
+            if (tag == SERVER_EVENT_WAKE) {
+                stopping = true;
+            } else if (tag == SERVER_EVENT_UNIX || tag == SERVER_EVENT_TCP) {
+                accept(worker, tag == SERVER_EVENT_UNIX ? unixFd : tcpFd);
+            } else {
+                // A session closed earlier in this batch may have lent its slot to a new one
+                int slot = static_cast<int>(static_cast<uint32_t>(tag));
+                if (!worker.slots[slot] || worker.generations[slot] != static_cast<uint32_t>(tag >> 32)) continue;
+                if (events[i].events & EPOLLERR) {
+                    close(worker, slot);
+                    continue;
+                }
+                if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLRDHUP)) readInput(worker, slot);
+                if (worker.slots[slot] && (events[i].events & EPOLLOUT)) flush(worker, slot);
             }
         }
     }
+    for (int slot = 0; slot < static_cast<int>(worker.slots.size()); slot++) {
+        if (worker.slots[slot]) close(worker, slot);
+    }
+    checkMemory(worker);
+}
 
-    // Check Food consumption
-    if (head.first == food.first && head.second == food.second) {
-        score += 10;
-        snake.setGrow(true, 1);
-        foodEaten++;
-        spawnFood();
-        
-        if (foodEaten % 4 == 0) {
-            spawnSpecialFood();
-            spawnPoisonFood(); // Spawn poison food along with special food
+template <class Rules>
+void SessionServer<Rules>::accept(Worker& worker, int listenFd) {
+    while (true) {
+        int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            return; // EAGAIN: none left, or another thread took it
+        }
+        if (liveSessions.fetch_add(1, memory_order_relaxed) >= config.maxSessions) {
+            liveSessions.fetch_sub(1, memory_order_relaxed);
+            refused.fetch_add(1, memory_order_relaxed);
+            if (write(fd, SERVER_FULL, sizeof(SERVER_FULL) - 1) < 0) {
+                // Gone already
+            }
+            ::close(fd);
+            continue;
+        }
+        if (listenFd == tcpFd) {
+            int noDelay = 1; // Diff frames are small, and must not wait for the last one's ack
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+        }
+
+        int slot;
+        if (worker.freeSlots.empty()) {
+            slot = static_cast<int>(worker.slots.size());
+            worker.slots.emplace_back();
+            worker.generations.push_back(0);
+        } else {
+            slot = worker.freeSlots.back();
+            worker.freeSlots.pop_back();
         }
-        if (foodEaten % 5 == 0) {
-            spawnObstacles();
+        worker.slots[slot].reset(new Session(fd, seedCounter.fetch_add(1, memory_order_relaxed), config.renderMode));
+        if (write(fd, SERVER_GREETING, sizeof(SERVER_GREETING) - 1) < 0) {
+            // A client that left at once is noticed by epoll
         }
+        epoll_event event = {};
+        event.events = EPOLLIN | EPOLLRDHUP;
+        event.data.u64 = packSession(slot, worker.generations[slot]);
+        epoll_ctl(worker.epollFd, EPOLL_CTL_ADD, fd, &event);
+        worker.sessions.fetch_add(1, memory_order_relaxed);
+        worker.sessionsTotal.fetch_add(1, memory_order_relaxed);
+        worker.gamesStarted.fetch_add(1, memory_order_relaxed);
+
+        Session& session = *worker.slots[slot];
+        draw(session);
+        watchOutput(worker, slot);
+        schedule(worker, slot, monotonicNs() + static_cast<uint64_t>(tickInterval(session)) * 1000000);
     }
+}
 
-    // Check Special Food consumption
-    if (specialFoodActive && head.first == specialFood.first && head.second == specialFood.second) {
-        score += 30;
-        snake.setGrow(true, 3);
-        specialFoodActive = false;
-        specialFoodEaten++;
+template <class Rules>
+void SessionServer<Rules>::close(Worker& worker, int slot) {
+    Session& session = *worker.slots[slot];
+    const OutputStats& output = session.screen.getOutputStats();
+    worker.closedFramesSent += output.framesSent;
+    worker.closedFramesDropped += output.framesDropped;
+    session.screen.discardOutput();
+    ::close(session.fd); // Also takes it out of epoll
+    worker.slots[slot].reset();
+    worker.generations[slot]++;
+    worker.freeSlots.push_back(slot);
+    worker.sessions.fetch_sub(1, memory_order_relaxed);
+    liveSessions.fetch_sub(1, memory_order_relaxed);
+}
+
+template <class Rules>
+void SessionServer<Rules>::schedule(Worker& worker, int slot, uint64_t dueNs) {
+    Session& session = *worker.slots[slot];
+    session.timerSerial++; // Whatever was in the heap for it is stale now
+    worker.timers.push(Timer{ dueNs, slot, worker.generations[slot], session.timerSerial });
+}
+
+template <class Rules>
+void SessionServer<Rules>::tick(Worker& worker, int slot, uint64_t dueNs, uint64_t now) {
+    Session& session = *worker.slots[slot];
+    uint64_t lateness = now - dueNs;
+    worker.ticks.fetch_add(1, memory_order_relaxed);
+    if (lateness > static_cast<uint64_t>(LATE_MS) * 1000000) worker.lateTicks.fetch_add(1, memory_order_relaxed);
+    if (lateness > worker.worstLatenessNs.load(memory_order_relaxed)) {
+        worker.worstLatenessNs.store(lateness, memory_order_relaxed); // Only this thread writes it
     }
 
-    // New: Check Poison Food consumption
-    if (poisonFoodActive && head.first == poisonFood.first && head.second == poisonFood.second) {
-        score = max(0, score - 30); // Decrease score, but not below 0
-        
-        // Decrease length by 3 by removing tail segments
-        snake.shrink(3);
-        
-        poisonFoodActive = false;
-        poisonFoodEaten++;
+    session.sim.update();
+    session.turnedThisTick = false;
+    if (session.queuedTurnCount > 0) {
+        Direction next = session.queuedTurns[0];
+        session.queuedTurnCount--;
+        for (int i = 0; i < session.queuedTurnCount; i++) {
+            session.queuedTurns[i] = session.queuedTurns[i + 1];
+        }
+        turn(session, next);
     }
+    draw(session);
+    watchOutput(worker, slot);
 
-    // New: Check Shield Power-up consumption
-    if (shieldActive && head.first == shield.first && head.second == shield.second) {
-        snake.activateShield();
-        shieldActive = false;
+    // On the original schedule, unless it fell a whole tick behind
+    if (!session.sim.isGameOver()) {
+        uint64_t interval = static_cast<uint64_t>(tickInterval(session)) * 1000000;
+        schedule(worker, slot, dueNs + interval > now ? dueNs + interval : now + interval);
     }
 }
 
-void Game::handleInput() {
-    if (InputHandler::isKeyPressed()) {
-        int ch = InputHandler::getChar();
-        
-        if (ch == 224) {
-            ch = InputHandler::getChar();
-            switch (ch) {
-                case 72: snake.changeDirection(UP); break;
-                case 80: snake.changeDirection(DOWN); break;
-                case 75: snake.changeDirection(LEFT); break;
-                case 77: snake.changeDirection(RIGHT); break;
-            }
-        } 
-        else if (ch == 27) {
-            if (InputHandler::isKeyPressed()) {
-                ch = InputHandler::getChar();
-                if (ch == 91) {
-                    if (InputHandler::isKeyPressed()) {
-                        ch = InputHandler::getChar();
-                        switch (ch) {
-                            case 65: snake.changeDirection(UP); break;
-                            case 66: snake.changeDirection(DOWN); break;
-                            case 67: snake.changeDirection(RIGHT); break;
-                            case 68: snake.changeDirection(LEFT); break;
-                        }
-                    }
+template <class Rules>
+void SessionServer<Rules>::newGame(Worker& worker, int slot) {
+    Session& session = *worker.slots[slot];
+    session.sim = Simulation<Rules>(seedCounter.fetch_add(1, memory_order_relaxed));
+    session.paused = false;
+    session.queuedTurnCount = 0;
+    session.turnedThisTick = false;
+    worker.gamesStarted.fetch_add(1, memory_order_relaxed);
+    schedule(worker, slot, monotonicNs() + static_cast<uint64_t>(tickInterval(session)) * 1000000);
+}
+
+template <class Rules>
+void SessionServer<Rules>::readInput(Worker& worker, int slot) {
+    Session& session = *worker.slots[slot];
+    unsigned char bytes[INPUT_BUFFER_SIZE];
+    Key decoded[INPUT_BUFFER_SIZE];
+    bool redraw = false;
+    while (true) {
+        ssize_t received = read(session.fd, bytes, sizeof(bytes));
+        if (received < 0 && errno == EINTR) continue;
+        if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        if (received <= 0) {
+            close(worker, slot); // Hung up or failed
+            return;
+        }
+
+        int count = session.keys.feed(bytes, static_cast<int>(received), decoded);
+        for (int i = 0; i < count; i++) {
+            if (decoded[i] == KEY_QUIT) {
+                close(worker, slot);
+                return;
+            }
+            if (session.sim.isGameOver()) {
+                if (decoded[i] != KEY_NONE) {
+                    newGame(worker, slot);
+                    redraw = true;
                 }
+                continue;
             }
-        } else {
-            switch (tolower(ch)) {
-                case 'w': snake.changeDirection(UP); break;
-                case 's': snake.changeDirection(DOWN); break;
-                case 'a': snake.changeDirection(LEFT); break;
-                case 'd': snake.changeDirection(RIGHT); break;
-                case ' ': togglePause(); break; // New: Spacebar toggles pause
-                case 'q': quit = true; break;
+            switch (decoded[i]) {
+                case KEY_UP:    turn(session, UP); break;
+                case KEY_DOWN:  turn(session, DOWN); break;
+                case KEY_LEFT:  turn(session, LEFT); break;
+                case KEY_RIGHT: turn(session, RIGHT); break;
+                case KEY_PAUSE:
+                    session.paused = !session.paused;
+                    if (session.paused) {
+                        session.timerSerial++; // No ticks until it goes on
+                    } else {
+                        schedule(worker, slot,
+                                 monotonicNs() + static_cast<uint64_t>(tickInterval(session)) * 1000000);
+                    }
+                    redraw = true;
+                    break;
+                case KEY_RENDER:
+                    session.screen.setRenderMode(
+                        static_cast<RenderMode>((session.screen.getRenderMode() + 1) % RENDER_MODE_COUNT));
+                    redraw = true;
+                    break;
+                default: break;
             }
         }
     }
+    if (redraw) {
+        draw(session);
+        watchOutput(worker, slot);
+    }
+}
+
+template <class Rules>
+void SessionServer<Rules>::flush(Worker& worker, int slot) {
+    worker.slots[slot]->screen.flushOutput();
+    watchOutput(worker, slot);
 }
 
-bool Game::isGameOver() const {
-    return gameOver;
+// EPOLLOUT only while part of a frame waits, or epoll would report the
+// socket writable over and over
+template <class Rules>
+void SessionServer<Rules>::watchOutput(Worker& worker, int slot) {
+    Session& session = *worker.slots[slot];
+    bool wanted = session.screen.hasPendingOutput();
+    if (wanted == session.writeWatched) return;
+    epoll_event event = {};
+    event.events = EPOLLIN | EPOLLRDHUP | (wanted ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+    event.data.u64 = packSession(slot, worker.generations[slot]);
+    epoll_ctl(worker.epollFd, EPOLL_CTL_MOD, session.fd, &event);
+    session.writeWatched = wanted;
 }
 
-bool Game::shouldQuit() const {
-    return quit || gameOver;
+template <class Rules>
+void SessionServer<Rules>::checkMemory(Worker& worker) {
+    size_t bytes = 0;
+    long long sent = worker.closedFramesSent, dropped = worker.closedFramesDropped;
+    for (const unique_ptr<Session>& session : worker.slots) {
+        if (!session) continue;
+        bytes += sizeof(Session) + session->screen.getBufferBytes();
+        sent += session->screen.getOutputStats().framesSent;
+        dropped += session->screen.getOutputStats().framesDropped;
+    }
+    worker.sessionBytes.store(bytes, memory_order_relaxed);
+    worker.framesSent.store(sent, memory_order_relaxed);
+    worker.framesDropped.store(dropped, memory_order_relaxed);
+    worker.nextMemoryCheckNs = monotonicNs() + 1000000000ULL;
+}
+#else
+template <class Rules>
+bool SessionServer<Rules>::start(const ServerConfig& serverConfig, string& error) {
+    config = serverConfig;
+    error = "the session server needs Linux (epoll)";
+    return false;
 }
+
+template <class Rules>
+void SessionServer<Rules>::stop() {}
+#endif
+
+// One specialized engine per rule set
+template class ItemStore<ClassicRules::ITEM_CAPACITY>;
+template class ItemStore<FrenzyRules::ITEM_CAPACITY>;
+
+template class Simulation<ClassicRules>;
+template class Simulation<WrapRules>;
+template class Simulation<NoPowerUpRules>;
+template class Simulation<ObstacleHeavyRules>;
+template class Simulation<FrenzyRules>;
+template class Simulation<MazeRules>;
+
+template class BasicGame<ClassicRules>;
+template class BasicGame<WrapRules>;
+template class BasicGame<NoPowerUpRules>;
+template class BasicGame<ObstacleHeavyRules>;
+template class BasicGame<FrenzyRules>;
+template class BasicGame<MazeRules>;
+
+template class Autopilot<ClassicRules>;
+template class Autopilot<WrapRules>;
+template class Autopilot<NoPowerUpRules>;
+template class Autopilot<ObstacleHeavyRules>;
+template class Autopilot<FrenzyRules>;
+template class Autopilot<MazeRules>;
+
+template void StatePublisher::publish(const Simulation<ClassicRules>&, bool);
+template void StatePublisher::publish(const Simulation<WrapRules>&, bool);
+template void StatePublisher::publish(const Simulation<NoPowerUpRules>&, bool);
+template void StatePublisher::publish(const Simulation<ObstacleHeavyRules>&, bool);
+template void StatePublisher::publish(const Simulation<FrenzyRules>&, bool);
+template void StatePublisher::publish(const Simulation<MazeRules>&, bool);
+template Direction pathTowardsNearestItem(const Simulation<ClassicRules>&);
+template Direction pathTowardsNearestItem(const Simulation<WrapRules>&);
+template Direction pathTowardsNearestItem(const Simulation<NoPowerUpRules>&);
+template Direction pathTowardsNearestItem(const Simulation<ObstacleHeavyRules>&);
+template Direction pathTowardsNearestItem(const Simulation<FrenzyRules>&);
+template Direction pathTowardsNearestItem(const Simulation<MazeRules>&);
+template void composeBoard(const Simulation<ClassicRules>&, Glyph*);
+template void composeBoard(const Simulation<WrapRules>&, Glyph*);
+template void composeBoard(const Simulation<NoPowerUpRules>&, Glyph*);
+template void composeBoard(const Simulation<ObstacleHeavyRules>&, Glyph*);
+template void composeBoard(const Simulation<FrenzyRules>&, Glyph*);
+template void composeBoard(const Simulation<MazeRules>&, Glyph*);
+template void fillSharedState(const Simulation<ClassicRules>&, bool, SharedGameState&);
+template void fillSharedState(const Simulation<WrapRules>&, bool, SharedGameState&);
+template void fillSharedState(const Simulation<NoPowerUpRules>&, bool, SharedGameState&);
+template void fillSharedState(const Simulation<ObstacleHeavyRules>&, bool, SharedGameState&);
+template void fillSharedState(const Simulation<FrenzyRules>&, bool, SharedGameState&);
+template void fillSharedState(const Simulation<MazeRules>&, bool, SharedGameState&);
+template Direction BotHost::decide(const Simulation<ClassicRules>&);
+template Direction BotHost::decide(const Simulation<WrapRules>&);
+template Direction BotHost::decide(const Simulation<NoPowerUpRules>&);
+template Direction BotHost::decide(const Simulation<ObstacleHeavyRules>&);
+template Direction BotHost::decide(const Simulation<FrenzyRules>&);
+template Direction BotHost::decide(const Simulation<MazeRules>&);
+
+template void ReplayRecorder::start(const string&, const Simulation<ClassicRules>&);
+template void ReplayRecorder::start(const string&, const Simulation<WrapRules>&);
+template void ReplayRecorder::start(const string&, const Simulation<NoPowerUpRules>&);
+template void ReplayRecorder::start(const string&, const Simulation<ObstacleHeavyRules>&);
+template void ReplayRecorder::start(const string&, const Simulation<FrenzyRules>&);
+template void ReplayRecorder::start(const string&, const Simulation<MazeRules>&);
+template void ReplayRecorder::record(const Simulation<ClassicRules>&);
+template void ReplayRecorder::record(const Simulation<WrapRules>&);
+template void ReplayRecorder::record(const Simulation<NoPowerUpRules>&);
+template void ReplayRecorder::record(const Simulation<ObstacleHeavyRules>&);
+template void ReplayRecorder::record(const Simulation<FrenzyRules>&);
+template void ReplayRecorder::record(const Simulation<MazeRules>&);
+
+template class ReplayPlayer<ClassicRules>;
+template class ReplayPlayer<WrapRules>;
+template class ReplayPlayer<NoPowerUpRules>;
+template class ReplayPlayer<ObstacleHeavyRules>;
+template class ReplayPlayer<FrenzyRules>;
+template class ReplayPlayer<MazeRules>;
+
+template class SessionServer<ClassicRules>;
+template class SessionServer<WrapRules>;
+template class SessionServer<NoPowerUpRules>;
+template class SessionServer<ObstacleHeavyRules>;
+template class SessionServer<FrenzyRules>;
+template class SessionServer<MazeRules>;
+
+template class RewindBuffer<ClassicRules>;
+template class RewindBuffer<WrapRules>;
+template class RewindBuffer<NoPowerUpRules>;
+template class RewindBuffer<ObstacleHeavyRules>;
+template class RewindBuffer<FrenzyRules>;
+template class RewindBuffer<MazeRules>;
+
+template class DistanceField<false>;
+template class DistanceField<true>;
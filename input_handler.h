@@ -20,12 +20,19 @@ private:
     static struct termios oldt, newt;
     static bool rawModeEnabled;
 #endif
+    static long long readCalls;
+    static long long bytesRead;
 
 public:
     static void enableRawInput();
     static void disableRawInput();
     static bool isKeyPressed();
     static int getChar();
+    // Reads everything that is waiting (up to capacity) with one read() and
+    // returns the byte count. Only call it when input is ready, it blocks otherwise.
+    static int readAvailable(unsigned char* buffer, int capacity);
+    static long long getReadCalls() { return readCalls; }
+    static long long getBytesRead() { return bytesRead; }
 };
 
 #endif
@@ -0,0 +1,89 @@
+#ifndef ITEM_STORE_H
+#define ITEM_STORE_H
+
+#include "screen.h"
+#include "cell.h"
+
+// Kinds of pick-up items that can lie on the board
+enum ItemType : unsigned char {
+    ITEM_FOOD = 0,
+    ITEM_SPECIAL_FOOD,
+    ITEM_POISON_FOOD,
+    ITEM_SHIELD,
+    ITEM_TYPE_COUNT
+};
+
+// What happens when the snake's head lands on an item of a given type
+struct ItemEffect {
+    int score;   // Added to the score (score never drops below 0)
+    int grow;    // Segments to grow by
+    int shrink;  // Segments removed from the tail
+    bool shield; // Grants the shield power-up
+};
+
+// Effect table, indexed by ItemType
+extern const ItemEffect ITEM_EFFECTS[ITEM_TYPE_COUNT];
+
+const int NO_ITEM = -1;
+const int NEVER_EXPIRES = -1;
+
+// Structure-of-arrays store for every item on the board.
+// Live items are kept densely packed in slots [0, count()), removal swaps the
+// last item into the freed slot. Large stores keep a per-cell slot index for
+// O(1) lookup by position; small ones (the usual handful of items) skip the
+// index and scan their packed positions with findCell() instead, which keeps
+// the whole store a few dozen bytes.
+template <int Capacity>
+class ItemStore {
+public:
+    static const int CAPACITY = Capacity;
+    static const bool INDEXED = Capacity > 16;
+    static_assert(Capacity < 255, "Slots are stored in one byte");
+
+private:
+    static constexpr unsigned char EMPTY_CELL = 255;
+    static constexpr int MAX_TOUCHED = 6; // A tick eats an item or two and places as many
+
+    short size;
+    short typeCounts[ITEM_TYPE_COUNT];
+    short touchedCount; // Slots written or emptied since clearTouched(), MAX_TOUCHED + 1 for too many to list
+    unsigned char touched[MAX_TOUCHED];
+    uint64_t hash; // XOR of the Zobrist keys of every item (see zobrist.h)
+    unsigned char types[Capacity];
+    Cell cells[Capacity];
+    int expiries[Capacity]; // Game time in ms, NEVER_EXPIRES for permanent items
+    unsigned char cellSlot[INDEXED ? WIDTH * HEIGHT : 1]; // Slot of the item on each cell (indexed stores only)
+
+    void touch(int slot);
+
+public:
+    ItemStore();
+    void clear();
+
+    // Returns the new slot, or NO_ITEM if the store is full or the cell is taken
+    int add(ItemType type, Cell cell, int expiresAt);
+    void removeAt(int slot);
+    // Removes every item whose expiry has passed, returns how many were removed
+    int removeExpired(int now);
+
+    int findAt(Cell cell) const;
+    int findFirst(ItemType type) const;
+    int count() const { return size; }
+    int countOf(ItemType type) const { return typeCounts[type]; }
+    bool isFull() const { return size == CAPACITY; }
+
+    ItemType typeAt(int slot) const { return static_cast<ItemType>(types[slot]); }
+    Cell cellAt(int slot) const { return cells[slot]; }
+    int expiryAt(int slot) const { return expiries[slot]; }
+    uint64_t getHash() const { return hash; }
+
+    // Starts a new count of the slots changed (Simulation does every tick)
+    void clearTouched() { touchedCount = 0; }
+    // Calls mark(at, bytes) on every part of the store that can differ from
+    // before, the store as it was at clearTouched(): the counts, the touched
+    // slots and the cell index where their items came or went
+    template <class Mark>
+    void markTouched(const ItemStore& before, Mark& mark) const;
+};
+
+#endif
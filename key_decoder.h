@@ -0,0 +1,34 @@
+#ifndef KEY_DECODER_H
+#define KEY_DECODER_H
+
+// Game commands that keyboard input decodes to
+enum Key : unsigned char { KEY_NONE = 0, KEY_UP, KEY_DOWN, KEY_LEFT, KEY_RIGHT, KEY_PAUSE, KEY_QUIT, KEY_RENDER,
+                           KEY_REWIND };
+
+// Table-driven decoder from raw keyboard bytes to keys.
+//
+// Understands WASD, space, q, r and b, CSI (ESC [ A, also with parameters
+// such as ESC [ 1 ; 5 A) and SS3 (ESC O A) arrow keys, and on Windows the
+// 224/0 prefix that _getch() puts before arrow codes. The state is kept
+// between calls, so an escape sequence split across two reads still decodes,
+// and a burst of bytes yields all of its keys from a single call.
+class KeyDecoder {
+public:
+    enum State : unsigned char { GROUND = 0, ESCAPE, CSI, SS3, WIN_PREFIX, STATE_COUNT };
+
+private:
+    State state;
+    long long keysDecoded;
+
+public:
+    KeyDecoder() : state(GROUND), keysDecoded(0) {}
+
+    // Decodes count bytes, writes the keys found to keys (at most one per
+    // byte) and returns how many there are
+    int feed(const unsigned char* bytes, int count, Key* keys);
+
+    State getState() const { return state; }
+    long long getKeysDecoded() const { return keysDecoded; }
+};
+
+#endif
@@ -0,0 +1,199 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <csignal>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+using namespace std;
+
+// Bad network in a box, for trying versus games on one machine.
+//
+// Usage: snake_lagproxy <listen port> <host>:<port> [--delay=<ms>] [--jitter=<ms>]
+//                       [--loss=<percent>]
+//
+// Relays UDP datagrams between whoever sends to the listen port first (the
+// joining game) and host:port (the hosting game), holding each one back for
+// delay ms plus or minus up to jitter ms and dropping loss percent of them,
+// both ways. With jitter, datagrams overtake each other, as they do on real
+// networks. Runs until interrupted, then prints what it did. POSIX only.
+
+const int MAX_DATAGRAM = 2048;
+
+struct Held {
+    double dueMs;
+    int toHost;   // 1: client to host, 0: host to client
+    vector<char> data;
+};
+
+static volatile sig_atomic_t stopping = 0;
+
+static void onSignal(int) {
+    stopping = 1;
+}
+
+static double nowMs() {
+    return chrono::duration<double, milli>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static int openSocket(int port) {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) return -1;
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<uint16_t>(port));
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        close(fd);
+        return -1;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    return fd;
+}
+
+int main(int argc, char* argv[]) {
+    int listenPort = 0;
+    string target;
+    int delayMs = 50;
+    int jitterMs = 0;
+    double lossPercent = 0;
+    bool usage = argc < 3;
+    for (int i = 1; i < argc && !usage; i++) {
+        string arg = argv[i];
+        if (arg.rfind("--delay=", 0) == 0) {
+            delayMs = atoi(arg.c_str() + 8);
+        } else if (arg.rfind("--jitter=", 0) == 0) {
+            jitterMs = atoi(arg.c_str() + 9);
+        } else if (arg.rfind("--loss=", 0) == 0) {
+            lossPercent = atof(arg.c_str() + 7);
+        } else if (listenPort == 0) {
+            listenPort = atoi(arg.c_str());
+        } else if (target.empty()) {
+            target = arg;
+        } else {
+            usage = true;
+        }
+    }
+    size_t colon = target.rfind(':');
+    if (usage || listenPort <= 0 || listenPort > 65535 || colon == string::npos || delayMs < 0 || jitterMs < 0 ||
+        jitterMs > delayMs || lossPercent < 0 || lossPercent > 100) {
+        cout << "Usage: " << argv[0] << " <listen port> <host>:<port> [--delay=<ms>] [--jitter=<ms, up to delay>]"
+             << " [--loss=<percent>]" << endl;
+        return 1;
+    }
+
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    addrinfo* found = nullptr;
+    int status = getaddrinfo(target.substr(0, colon).c_str(), target.substr(colon + 1).c_str(), &hints, &found);
+    if (status != 0 || !found) {
+        cerr << target << ": " << gai_strerror(status) << endl;
+        return 1;
+    }
+    sockaddr_in host;
+    memcpy(&host, found->ai_addr, sizeof(host));
+    freeaddrinfo(found);
+
+    // One socket faces the client, the other the host, so the host sees a
+    // single peer however the client's side changes
+    int clientFd = openSocket(listenPort);
+    int hostFd = openSocket(0);
+    if (clientFd < 0 || hostFd < 0) {
+        cerr << "Can't open port " << listenPort << ": " << strerror(errno) << endl;
+        return 1;
+    }
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = onSignal; // No SA_RESTART: poll() returns at once
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+
+    cout << "Relaying port " << listenPort << " <-> " << target << ", " << delayMs << "+-" << jitterMs << " ms, "
+         << lossPercent << "% lost" << endl;
+
+    mt19937 rng(static_cast<uint32_t>(time(nullptr)));
+    uniform_int_distribution<int> jitter(-jitterMs, jitterMs);
+    uniform_real_distribution<double> chance(0, 100);
+    sockaddr_in client;
+    bool haveClient = false;
+    vector<Held> held;
+    long long relayed[2] = { 0, 0 };
+    long long dropped[2] = { 0, 0 };
+    long long reordered[2] = { 0, 0 };
+    double lastDue[2] = { 0, 0 };
+
+    while (!stopping) {
+        double now = nowMs();
+        int timeout = -1;
+        for (const Held& datagram : held) {
+            int wait = max(0, static_cast<int>(datagram.dueMs - now + 0.999));
+            timeout = timeout < 0 ? wait : min(timeout, wait);
+        }
+        pollfd fds[2] = { { clientFd, POLLIN, 0 }, { hostFd, POLLIN, 0 } };
+        if (poll(fds, 2, timeout) < 0 && errno != EINTR) break;
+
+        for (int side = 0; side < 2; side++) {
+            char buffer[MAX_DATAGRAM];
+            sockaddr_in from;
+            socklen_t fromLength = sizeof(from);
+            ssize_t received;
+            while ((received = recvfrom(fds[side].fd, buffer, sizeof(buffer), 0, reinterpret_cast<sockaddr*>(&from),
+                                        &fromLength)) >= 0) {
+                fromLength = sizeof(from);
+                int toHost = side == 0 ? 1 : 0;
+                if (toHost) {
+                    client = from;
+                    haveClient = true;
+                }
+                if (chance(rng) < lossPercent) {
+                    dropped[toHost]++;
+                    continue;
+                }
+                double due = nowMs() + delayMs + jitter(rng);
+                if (due < lastDue[toHost]) reordered[toHost]++;
+                lastDue[toHost] = max(lastDue[toHost], due);
+                held.push_back(Held{ due, toHost, vector<char>(buffer, buffer + received) });
+            }
+        }
+
+        now = nowMs();
+        for (size_t i = 0; i < held.size();) {
+            if (held[i].dueMs > now) {
+                i++;
+                continue;
+            }
+            const Held& datagram = held[i];
+            if (datagram.toHost) {
+                sendto(hostFd, datagram.data.data(), datagram.data.size(), 0, reinterpret_cast<sockaddr*>(&host),
+                       sizeof(host));
+                relayed[1]++;
+            } else if (haveClient) {
+                sendto(clientFd, datagram.data.data(), datagram.data.size(), 0,
+                       reinterpret_cast<sockaddr*>(&client), sizeof(client));
+                relayed[0]++;
+            }
+            held[i] = held.back();
+            held.pop_back();
+        }
+    }
+
+    cout << "\nTo host: " << relayed[1] << " relayed, " << dropped[1] << " dropped, " << reordered[1]
+         << " overtaken\nTo client: " << relayed[0] << " relayed, " << dropped[0] << " dropped, " << reordered[0]
+         << " overtaken" << endl;
+    close(clientFd);
+    close(hostFd);
+    return 0;
+}
@@ -0,0 +1,67 @@
+#ifndef LEVEL_GENERATOR_H
+#define LEVEL_GENERATOR_H
+
+#include "screen.h"
+#include "fast_random.h"
+#include "cell.h"
+
+using namespace std;
+
+// Procedural obstacle and maze generator that never seals the snake in.
+//
+// Cells are either free, blocked (wall/obstacle) or reserved (free, but may not
+// be blocked: snake body, items, the lane ahead of the head). The generator
+// keeps track of the free region reachable from the head and only accepts a new
+// block if every target (items) stays reachable and the region stays above a
+// minimum size.
+//
+// Connectivity is maintained incrementally: a cell whose free neighbours stay
+// linked around it (a "simple" cell) can be blocked without a flood fill, which
+// covers almost every placement. Only the rare cut cell triggers a full flood.
+class LevelGenerator {
+private:
+    static const int CELLS = WIDTH * HEIGHT;
+    static const int SAFE_LANE_LENGTH = 4; // Cells ahead of the head kept open
+
+    unsigned char blocked[CELLS];
+    unsigned char reserved[CELLS];
+    unsigned char reachable[CELLS]; // Free cells connected to the head
+    int targets[CELLS];
+    int targetCount;
+    int headCell;
+    int regionSize;    // Number of reachable cells
+    int minRegionSize;
+    int floodFills;    // Full floods run since reset(), for profiling
+
+    bool isSimpleCell(int cell) const;
+    bool isFreeAt(int x, int y) const;
+    void floodFromHead();
+    bool targetsReachable() const;
+
+public:
+    LevelGenerator();
+
+    // Clears the board and sets where the head is and which way it is going
+    void reset(int headX, int headY, int dirX, int dirY);
+    void addWall(int x, int y);
+    void reserve(int x, int y);
+    void addTarget(int x, int y);
+    void setMinRegionSize(int cells);
+
+    // Blocks the cell unless that would cut a target off or shrink the head's region too far
+    bool tryBlock(int x, int y);
+    // Places up to count obstacles on random inner cells, writes the cells used
+    // to placed and returns how many there are
+    int placeObstacles(int count, FastRandom& rng, Cell* placed);
+    // Carves a braided maze (loopPercent of the remaining inner walls are knocked
+    // out to create loops) and writes it to walls, one flag per cell (CELLS of
+    // them, 1 for a wall). The head's cell and the lane ahead of it are always
+    // left open.
+    void generateMaze(int loopPercent, FastRandom& rng, unsigned char* walls);
+
+    bool isReachable(int x, int y) const;
+    int getRegionSize() const { return regionSize; }
+    int getFloodFillCount() const { return floodFills; }
+};
+
+#endif
@@ -1,55 +1,808 @@
 #include <iostream>
 #include <thread>
 #include <chrono>
+#include <string>
+#include <iomanip>
 #include "game.h"
+#include "alloc_stats.h"
+#include "autopilot.h"
+#include "event_loop.h"
+#include "telemetry.h"
+#include "shared_state.h"
+#include "bot_host.h"
+#include "metrics.h"
+#include "replay.h"
+#include "background_io.h"
+#include "world.h"
+#include "versus.h"
+#include "rewind.h"
 
 using namespace std;
 
-int main() {
-    cout << "Starting Cross-Platform Snake Game..." << endl;
-    cout << "Make sure your terminal supports emojis!" << endl;
-    cout << "Starting in 2 seconds..." << endl;
+const char* const TELEMETRY_FILE = "telemetry.snk";
+const char* const DEFAULT_SHARE_NAME = "/snake_byte";
+const int TAG_SHARED_COMMANDS = 0;
+const int TAG_OUTPUT = 1;
+const int TAG_NET = 2;
+
+// Command line options for one game
+struct RunOptions {
+    int autopilotBudget; // Positive: the search pilot plays, thinking this many ms per tick
+    string shareName;    // Non-empty: publish the state to this shared-memory segment
+    string botPath;      // Non-empty: a controller plugin steers
+    string botArgs;
+    int botBudget;       // ms per decision
+    RenderMode renderMode;
+    int metricsPort;     // Positive: serve metrics on this localhost port
+    string replayPath;   // Non-empty: record the game to this replay file
+    string versusAddress; // Versus: <port> to host, <host>:<port> to join
+    bool practice;       // The rewind key goes back up to a minute; no high score
+    OutputLevel outputLevel; // OUTPUT_LEVEL_COUNT: follow the terminal
+};
+
+// Runs one game with the given rule set until the player quits
+template <class Rules>
+int runGame(const RunOptions& options) {
+    // Enable raw input
+    InputHandler::enableRawInput();
     
-    this_thread::sleep_for(chrono::seconds(2));
+    // Created before the autopilot's threads so they inherit its signal mask
+    EventLoop loop;
+    // Every file write goes through here, so the game thread never waits on the disk
+    BackgroundIO io;
+    // Every game, finished or quit, becomes one row of the log (see snake_stats)
+    TelemetryWriter telemetry(TELEMETRY_FILE, io);
+    // Scrape endpoint for monitoring, on its own thread (also after the event loop)
+    MetricsServer metrics;
+    if (options.metricsPort > 0) {
+        string error;
+        if (!metrics.start(options.metricsPort, error)) {
+            InputHandler::disableRawInput();
+            cerr << "Can't serve metrics: " << error << endl;
+            return 1;
+        }
+    }
     
-    // Clear screen properly at start
-#ifdef _WIN32
-    system("cls");
-#else
-    system("clear");
+    BasicGame<Rules> game;
+    game.setRenderMode(options.renderMode);
+    game.setBackgroundIO(&io);
+    Autopilot<Rules>* pilot = nullptr;
+    if (options.autopilotBudget > 0) {
+        pilot = new Autopilot<Rules>(0, options.autopilotBudget);
+        game.setAutopilot(pilot);
+    }
+    
+    BotHost bot(options.botBudget);
+    if (!options.botPath.empty()) {
+        string error;
+        if (!bot.load(options.botPath, options.botArgs, error)) {
+            InputHandler::disableRawInput();
+            cerr << "Can't use bot: " << error << endl;
+            delete pilot;
+            return 1;
+        }
+        game.setBot(&bot);
+    }
+    
+    // Seed, moves and state hashes, enough to play the game back and check it (see snake_replay)
+    ReplayRecorder replay;
+    if (!options.replayPath.empty()) {
+        replay.start(options.replayPath, game.getSimulation());
+    }
+    
+    // External viewers and bots read the game from shared memory and send
+    // directions back through its command ring
+    StatePublisher publisher;
+    if (!options.shareName.empty()) {
+        if (publisher.open(options.shareName)) {
+            loop.watch(publisher.getDoorbellFd(), TAG_SHARED_COMMANDS);
+            publisher.publish(game.getSimulation(), false);
+        } else {
+            InputHandler::disableRawInput();
+            cerr << "Can't create shared memory segment " << options.shareName << endl;
+            delete pilot;
+            return 1;
+        }
+    }
+    
+    // Practice mode keeps the last minute of play, so mistakes can be undone
+    RewindBuffer<Rules>* rewind = nullptr;
+    if (options.practice) {
+        rewind = new RewindBuffer<Rules>();
+        game.setRewind(rewind);
+    }
+    
+    // Main game loop. Everything happens in response to an event: a key, a
+    // tick of the timer (stopped while paused) or a signal. In between, the
+    // process sleeps in loop.wait().
+    bool interrupted = false;
+    long long inputWakeups = 0;
+    uint64_t keySeenNs = 0; // When the oldest key not yet on screen was read, 0 if none
+    uint32_t startTime = static_cast<uint32_t>(time(nullptr));
+    loop.setTickInterval(game.getGameSpeed());
+    Metrics::add(METRIC_GAMES_STARTED);
+    Metrics::set(METRIC_LENGTH, game.getSimulation().getSnake().getLength());
+    Metrics::set(METRIC_SPEED_MS, game.getGameSpeed());
+    // Frames are written without blocking, so a slow terminal costs frames, not ticks
+    Screen& screen = game.getScreen();
+    screen.startOutput();
+    if (options.outputLevel != OUTPUT_LEVEL_COUNT) screen.pinOutputLevel(options.outputLevel);
+    bool outputWatched = false;
+    game.draw();
+    while (!game.shouldQuit()) {
+        LoopEvents events = loop.wait();
+        if (events.quit) {
+            interrupted = true;
+            break;
+        }
+        bool redraw = events.resized;
+        
+        for (int i = 0; i < events.readyCount; i++) {
+            if (events.ready[i] == TAG_OUTPUT) screen.flushOutput();
+            if (events.ready[i] != TAG_SHARED_COMMANDS) continue;
+            Direction commands[SharedSegment::COMMAND_RING_SIZE];
+            int count = publisher.takeCommands(commands, SharedSegment::COMMAND_RING_SIZE);
+            for (int c = 0; c < count; c++) {
+                game.turn(commands[c]);
+            }
+        }
+        
+        if (events.input) {
+            AllocPhaseScope phase(PHASE_INPUT);
+            inputWakeups++;
+            bool wasPaused = game.isPaused();
+            RenderMode wasRenderMode = game.getRenderMode();
+            uint64_t readNs = monotonicNs();
+            long long keysBefore = game.getKeysDecoded();
+            int ticksBefore = game.getSimulation().getTickCount();
+            game.handleInput();
+            if (keySeenNs == 0 && game.getKeysDecoded() > keysBefore) keySeenNs = readNs;
+            redraw = redraw || game.getRenderMode() != wasRenderMode;
+            if (game.isPaused() != wasPaused) {
+                loop.setTickInterval(game.isPaused() ? 0 : game.getGameSpeed());
+                publisher.publish(game.getSimulation(), game.isPaused());
+                redraw = true;
+            } else if (game.getSimulation().getTickCount() != ticksBefore) {
+                publisher.publish(game.getSimulation(), game.isPaused()); // Rewound further
+                redraw = true;
+            }
+        }
+        
+        // Ticks that ran late are dropped rather than played back to back
+        if (events.ticks > 0 && !game.isPaused() && !game.shouldQuit()) {
+            int ticksBefore = game.getSimulation().getTickCount();
+            {
+                AllocPhaseScope phase(PHASE_UPDATE);
+                game.update();
+            }
+            AllocStats::endTick();
+            if (replay.isRecording() && game.getSimulation().getTickCount() != ticksBefore) {
+                replay.record(game.getSimulation());
+            }
+            Metrics::add(METRIC_TICKS);
+            if (events.ticks > 1) Metrics::add(METRIC_TICK_OVERRUNS, events.ticks - 1);
+            Metrics::set(METRIC_LENGTH, game.getSimulation().getSnake().getLength());
+            Metrics::set(METRIC_SPEED_MS, game.getGameSpeed());
+            publisher.publish(game.getSimulation(), false);
+            redraw = true;
+            
+            // Control game speed with dynamic speed based on snake length
+            if (!game.isGameOver() && game.getGameSpeed() != loop.getTickInterval()) {
+                loop.setTickInterval(game.getGameSpeed());
+            } else if (game.isGameOver()) {
+                loop.setTickInterval(0); // Practice: waits for a rewind or Q
+            }
+        }
+        
+        if (redraw && !game.shouldQuit()) {
+            AllocPhaseScope phase(PHASE_DRAW);
+            game.draw();
+            // A turn shows on the first frame after its tick, a pause or display switch right away
+            if (keySeenNs != 0) {
+                Metrics::observe(METRIC_INPUT_LATENCY, monotonicNs() - keySeenNs);
+                keySeenNs = 0;
+            }
+        }
+        
+#ifndef _WIN32
+        // Wake up to write the rest of a frame the terminal couldn't take yet
+        if (screen.hasPendingOutput() != outputWatched) {
+            outputWatched = screen.hasPendingOutput();
+            if (outputWatched) {
+                loop.watch(STDOUT_FILENO, TAG_OUTPUT, true);
+            } else {
+                loop.unwatch(STDOUT_FILENO);
+            }
+        }
 #endif
+    }
+#ifndef _WIN32
+    if (outputWatched) loop.unwatch(STDOUT_FILENO);
+#endif
+    if (game.isGameOver()) Metrics::add(METRIC_GAMES_FINISHED);
     
-    // Enable raw input
+    // Queued now, so the write happens while the game over screen is up
+    SessionRecord record = game.getSimulation().getSessionRecord();
+    record.startTime = startTime;
+    record.flags = (pilot ? SESSION_AUTOPILOT : 0) | (rewind ? SESSION_PRACTICE : 0);
+    telemetry.append(record);
+    
+    // If game over, show the final screen (in practice it was up already, until Q)
+    if (game.isGameOver() && !interrupted && !rewind) {
+        loop.setTickInterval(0);
+        game.draw();
+        screen.finishOutput(); // No more ticks to keep time for, so the last frame may block
+        // Wait for any key press before exiting
+        while (loop.isInputOpen()) {
+            LoopEvents events = loop.wait();
+            if (events.quit || events.inputClosed) break;
+            if (events.input) {
+                unsigned char pressed[64];
+                InputHandler::readAvailable(pressed, sizeof(pressed)); // Clear the key press
+                break;
+            }
+            if (events.resized) game.draw();
+        }
+    }
+    
+    // Disable raw input
+    InputHandler::disableRawInput();
+    screen.finishOutput();
+    
+    // Filled in on the I/O thread, read after the flush below
+    bool replaySaved = false;
+    string replayError;
+    if (replay.isRecording()) {
+        replay.save(io, [&](bool ok, const string& error) {
+            replaySaved = ok;
+            replayError = error;
+        });
+    }
+    io.flush(); // The game is over, so waiting on the disk is fine now
+    if (replay.isRecording()) {
+        if (replaySaved) {
+            cout << "Replay: " << replay.getTickCount() << " ticks saved to " << options.replayPath << endl;
+        } else {
+            cerr << "Replay: " << replayError << endl;
+        }
+    }
+    
+    // Input cost: each keyboard wakeup is one epoll_wait() plus one read()
+    long long keys = game.getKeysDecoded();
+    if (keys > 0) {
+        cout << "Input: " << keys << " keys, " << InputHandler::getBytesRead() << " bytes in "
+             << InputHandler::getReadCalls() << " reads, " << fixed << setprecision(2)
+             << (double)(InputHandler::getReadCalls() + inputWakeups) / keys << " syscalls per key" << endl;
+    }
+    if (publisher.getCommandsTaken() > 0) {
+        cout << "Shared memory: " << publisher.getCommandsTaken() << " commands, " << fixed << setprecision(1)
+             << publisher.getAverageCommandLatencyUs() << " us average and " << publisher.getMaxCommandLatencyUs()
+             << " us worst from send to apply" << endl;
+    }
+    const OutputStats& output = screen.getOutputStats();
+    if (output.stalls > 0) {
+        cout << "Output: " << output.stalls << " stalls (" << output.stallNs / 1000000 << " ms backed up), "
+             << output.framesDropped << " of " << output.framesSent + output.framesDropped << " frames dropped, "
+             << output.diffFrames << " sent as changed lines, " << output.maxQueuedBytes << " bytes queued at most"
+             << endl;
+    }
+    cout << "Disk: " << io.getCompleted() << " writes via " << (io.usesUring() ? "io_uring" : "I/O thread") << ", "
+         << io.getFsyncs() << " fsyncs, " << io.getSubmissions() << " submissions";
+    if (io.getFailures() > 0) cout << ", " << io.getFailures() << " failed";
+    cout << endl;
+    if (metrics.isRunning()) {
+        cout << "Metrics: " << metrics.getScrapes() << " scrapes on http://127.0.0.1:" << options.metricsPort
+             << "/metrics" << endl;
+    }
+    if (!options.botPath.empty()) {
+        bot.printReport(cout);
+    }
+    if (pilot) {
+        cout << "Autopilot: " << static_cast<long long>(pilot->getRolloutsPerSecond()) << " rollouts/s on "
+             << pilot->getThreadCount() << " threads" << endl;
+        delete pilot;
+    }
+    if (rewind) {
+        cout << "Rewind: " << rewind->getRecords() << " ticks recorded, " << RewindBuffer<Rules>::getMemoryBytes() / 1024
+             << " KB kept for the last " << RewindBuffer<Rules>::WINDOW_MS / 1000 << " s" << endl;
+        delete rewind;
+    }
+    AllocStats::printSummary(cout);
+    return 0;
+}
+
+// Runs the endless world until the player quits. Same loop as runGame, without
+// the drivers, sharing and replays, which need a fixed board.
+int runEndless(const RunOptions& options) {
     InputHandler::enableRawInput();
     
-    Game game;
+    EventLoop loop;
+    BackgroundIO io;
+    TelemetryWriter telemetry(TELEMETRY_FILE, io);
+    MetricsServer metrics;
+    if (options.metricsPort > 0) {
+        string error;
+        if (!metrics.start(options.metricsPort, error)) {
+            InputHandler::disableRawInput();
+            cerr << "Can't serve metrics: " << error << endl;
+            return 1;
+        }
+    }
     
-    // Main game loop
+    EndlessGame game;
+    game.setRenderMode(options.renderMode);
+    
+    bool interrupted = false;
+    uint64_t keySeenNs = 0;
+    uint32_t startTime = static_cast<uint32_t>(time(nullptr));
+    loop.setTickInterval(game.getGameSpeed());
+    Metrics::add(METRIC_GAMES_STARTED);
+    Screen& screen = game.getScreen();
+    screen.startOutput();
+    if (options.outputLevel != OUTPUT_LEVEL_COUNT) screen.pinOutputLevel(options.outputLevel);
+    bool outputWatched = false;
+    game.draw();
     while (!game.shouldQuit()) {
-        game.draw();
-        game.handleInput();
+        LoopEvents events = loop.wait();
+        if (events.quit) {
+            interrupted = true;
+            break;
+        }
+        bool redraw = events.resized;
+        for (int i = 0; i < events.readyCount; i++) {
+            if (events.ready[i] == TAG_OUTPUT) screen.flushOutput();
+        }
         
-        if (!game.isGameOver() && !game.isPaused()) {
+        if (events.input) {
+            bool wasPaused = game.isPaused();
+            RenderMode wasRenderMode = game.getRenderMode();
+            uint64_t readNs = monotonicNs();
+            long long keysBefore = game.getKeysDecoded();
+            game.handleInput();
+            if (keySeenNs == 0 && game.getKeysDecoded() > keysBefore) keySeenNs = readNs;
+            redraw = redraw || game.getRenderMode() != wasRenderMode;
+            if (game.isPaused() != wasPaused) {
+                loop.setTickInterval(game.isPaused() ? 0 : game.getGameSpeed());
+                redraw = true;
+            }
+        }
+        
+        if (events.ticks > 0 && !game.isPaused() && !game.shouldQuit()) {
             game.update();
+            Metrics::add(METRIC_TICKS);
+            if (events.ticks > 1) Metrics::add(METRIC_TICK_OVERRUNS, events.ticks - 1);
+            Metrics::set(METRIC_LENGTH, game.getWorld().getLength());
+            Metrics::set(METRIC_SPEED_MS, game.getGameSpeed());
+            redraw = true;
+            if (!game.isGameOver() && game.getGameSpeed() != loop.getTickInterval()) {
+                loop.setTickInterval(game.getGameSpeed());
+            }
         }
         
-        // Control game speed with dynamic speed based on snake length
-        int gameSpeed = game.getGameSpeed();
-        this_thread::sleep_for(chrono::milliseconds(gameSpeed));
+        if (redraw && !game.shouldQuit()) {
+            game.draw();
+            if (keySeenNs != 0) {
+                Metrics::observe(METRIC_INPUT_LATENCY, monotonicNs() - keySeenNs);
+                keySeenNs = 0;
+            }
+        }
+        
+#ifndef _WIN32
+        if (screen.hasPendingOutput() != outputWatched) {
+            outputWatched = screen.hasPendingOutput();
+            if (outputWatched) {
+                loop.watch(STDOUT_FILENO, TAG_OUTPUT, true);
+            } else {
+                loop.unwatch(STDOUT_FILENO);
+            }
+        }
+#endif
     }
+#ifndef _WIN32
+    if (outputWatched) loop.unwatch(STDOUT_FILENO);
+#endif
+    if (game.isGameOver()) Metrics::add(METRIC_GAMES_FINISHED);
     
-    // If game over, show the final screen
-    if (game.isGameOver()) {
+    SessionRecord record = game.getWorld().getSessionRecord();
+    record.startTime = startTime;
+    telemetry.append(record);
+    
+    if (game.isGameOver() && !interrupted) {
+        loop.setTickInterval(0);
         game.draw();
-        // Wait for any key press before exiting
-        while (!InputHandler::isKeyPressed()) {
-            this_thread::sleep_for(chrono::milliseconds(100));
+        screen.finishOutput();
+        while (loop.isInputOpen()) {
+            LoopEvents events = loop.wait();
+            if (events.quit || events.inputClosed) break;
+            if (events.input) {
+                unsigned char pressed[64];
+                InputHandler::readAvailable(pressed, sizeof(pressed));
+                break;
+            }
+            if (events.resized) game.draw();
         }
-        InputHandler::getChar(); // Clear the key press
     }
     
-    // Disable raw input
     InputHandler::disableRawInput();
+    screen.finishOutput();
+    io.flush();
     
+    const World& world = game.getWorld();
+    cout << "World: " << world.getChunksGenerated() << " chunks made, " << world.getChunksEvicted() << " dropped, "
+         << world.getPeakResidentChunks() << " of " << World::MAX_CHUNKS << " in memory at most ("
+         << world.getReservedBytes() / 1024 << " KB reserved)" << endl;
+    if (metrics.isRunning()) {
+        cout << "Metrics: " << metrics.getScrapes() << " scrapes on http://127.0.0.1:" << options.metricsPort
+             << "/metrics" << endl;
+    }
     return 0;
 }
+
+// Sends every local input the other side hasn't acknowledged, what we have
+// of theirs, and the hash of our latest confirmed state
+static void sendInputs(VersusLink& link, const RollbackSession& session, int peerAck) {
+    VersusPacket packet = VersusLink::makePacket(PACKET_INPUTS);
+    int first = max(peerAck, session.getTick() - VersusPacket::MAX_INPUTS);
+    packet.firstTick = first;
+    packet.count = static_cast<uint8_t>(session.getTick() - first);
+    for (int i = 0; i < packet.count; i++) {
+        packet.inputs[i] = session.getLocalInput(first + i);
+    }
+    packet.ack = session.getConfirmedTick();
+    packet.hashTick = session.getConfirmedTick();
+    if (!session.getConfirmedHash(packet.hashTick, packet.hash)) packet.hashTick = -1;
+    link.send(packet);
+}
+
+// Runs a two-player game over UDP: address is a port to host on, or
+// host:port to join. Each side plays every tick at once and lets the rollback
+// session fix up the rival's moves as they come in.
+int runVersus(const RunOptions& options) {
+    const int WAIT_MS = 60000;  // For the other player to show up
+    const int LINGER_MS = 2000; // After the end, for our last inputs to arrive
+
+    VersusLink link;
+    uint32_t seed = 0;
+    int localPlayer = 0;
+    string error;
+    size_t colon = options.versusAddress.rfind(':');
+    bool hosting = colon == string::npos;
+    int port = atoi(options.versusAddress.c_str() + (hosting ? 0 : colon + 1));
+    if (port <= 0 || port > 65535) {
+        cerr << "Bad versus port: " << options.versusAddress << endl;
+        return 1;
+    }
+    if (hosting) {
+        seed = static_cast<uint32_t>(time(nullptr));
+        cout << "Waiting for a player on UDP port " << port << "..." << endl;
+        if (!link.host(port, seed, WAIT_MS, error)) {
+            cerr << "Can't host: " << error << endl;
+            return 1;
+        }
+    } else {
+        localPlayer = 1;
+        cout << "Joining " << options.versusAddress << "..." << endl;
+        if (!link.join(options.versusAddress.substr(0, colon), port, WAIT_MS, seed, error)) {
+            cerr << "Can't join: " << error << endl;
+            return 1;
+        }
+    }
+
+    InputHandler::enableRawInput();
+
+    EventLoop loop;
+    BackgroundIO io;
+    TelemetryWriter telemetry(TELEMETRY_FILE, io);
+    MetricsServer metrics;
+    if (options.metricsPort > 0) {
+        if (!metrics.start(options.metricsPort, error)) {
+            InputHandler::disableRawInput();
+            cerr << "Can't serve metrics: " << error << endl;
+            return 1;
+        }
+    }
+
+    VersusGame game(seed, localPlayer);
+    game.setRenderMode(options.renderMode);
+    RollbackSession& session = game.getSession();
+    loop.watch(link.getFd(), TAG_NET);
+
+    bool interrupted = false;
+    bool peerLeft = false;
+    bool stalled = false;
+    int peerAck = 0;           // The other side has our inputs before this tick
+    int peerHashTick = -1;     // and its confirmed state before this tick hashes to peerHash
+    uint64_t peerHash = 0;
+    int desyncTick = -1;
+    uint64_t settledNs = 0;
+    uint32_t startTime = static_cast<uint32_t>(time(nullptr));
+    loop.setTickInterval(VersusRules::BASE_SPEED);
+    Metrics::add(METRIC_GAMES_STARTED);
+    Screen& screen = game.getScreen();
+    screen.startOutput();
+    if (options.outputLevel != OUTPUT_LEVEL_COUNT) screen.pinOutputLevel(options.outputLevel);
+    bool outputWatched = false;
+    string status = "Playing as " + (localPlayer == 0 ? SNAKE_HEAD + " (host)" : SNAKE_HEAD + " (joined)");
+    game.draw(status);
+    while (!game.shouldQuit()) {
+        LoopEvents events = loop.wait();
+        if (events.quit) {
+            interrupted = true;
+            break;
+        }
+        bool redraw = events.resized;
+        bool readable = false;
+        for (int i = 0; i < events.readyCount; i++) {
+            if (events.ready[i] == TAG_OUTPUT) screen.flushOutput();
+            if (events.ready[i] == TAG_NET) readable = true;
+        }
+
+        if (readable) {
+            VersusPacket packet;
+            while (link.receive(packet)) {
+                if (packet.type == PACKET_HELLO && hosting) {
+                    // Our start got lost
+                    VersusPacket start = VersusLink::makePacket(PACKET_START);
+                    start.seed = seed;
+                    link.send(start);
+                } else if (packet.type == PACKET_BYE) {
+                    peerLeft = true;
+                } else if (packet.type == PACKET_INPUTS) {
+                    for (int i = 0; i < packet.count; i++) {
+                        session.receiveRemote(packet.firstTick + i, static_cast<Direction>(packet.inputs[i]));
+                    }
+                    peerAck = max(peerAck, static_cast<int>(packet.ack));
+                    if (packet.hashTick > peerHashTick) {
+                        peerHashTick = packet.hashTick;
+                        peerHash = packet.hash;
+                    }
+                }
+            }
+            // Late inputs are applied now, not at the next tick, so the
+            // frame below already shows the rival where it really is
+            if (session.reconcile() > 0) redraw = true;
+        }
+
+        if (events.input) {
+            RenderMode wasRenderMode = game.getRenderMode();
+            game.handleInput();
+            redraw = redraw || game.getRenderMode() != wasRenderMode;
+        }
+        if (game.shouldQuit()) break;
+
+        if (events.ticks > 0) {
+            // Ticks missed by a slow loop are played too, so both sides keep
+            // to the same clock
+            for (int i = 0; i < events.ticks; i++) {
+                stalled = !game.tick();
+            }
+            Metrics::add(METRIC_TICKS, events.ticks);
+            if (events.ticks > 1) Metrics::add(METRIC_TICK_OVERRUNS, events.ticks - 1);
+            Metrics::set(METRIC_LENGTH, game.getState().getSnake(localPlayer).getLength());
+            sendInputs(link, session, peerAck);
+            redraw = true;
+        }
+
+        uint64_t ourHash = 0;
+        if (desyncTick < 0 && session.getConfirmedHash(peerHashTick, ourHash) && ourHash != peerHash) {
+            desyncTick = peerHashTick;
+        }
+
+        if (session.isSettled()) {
+            if (settledNs == 0) settledNs = monotonicNs();
+            if (peerAck >= game.getState().getTickCount() ||
+                monotonicNs() - settledNs > static_cast<uint64_t>(LINGER_MS) * 1000000) {
+                break;
+            }
+        }
+        if (peerLeft || link.isLost()) break;
+
+        if (redraw) {
+            if (desyncTick >= 0) {
+                status = "Out of sync with the rival since tick " + to_string(desyncTick) + "!";
+            } else if (game.getState().isOver()) {
+                status = "Waiting for the rival's last moves...";
+            } else if (stalled) {
+                status = "Waiting for the rival (" + to_string(session.getTick() - session.getConfirmedTick()) +
+                         " ticks ahead)";
+            } else {
+                status = "Playing as " + (localPlayer == 0 ? SNAKE_HEAD + " (host)" : SNAKE_HEAD + " (joined)");
+            }
+            game.draw(status);
+        }
+
+#ifndef _WIN32
+        if (screen.hasPendingOutput() != outputWatched) {
+            outputWatched = screen.hasPendingOutput();
+            if (outputWatched) {
+                loop.watch(STDOUT_FILENO, TAG_OUTPUT, true);
+            } else {
+                loop.unwatch(STDOUT_FILENO);
+            }
+        }
+#endif
+    }
+#ifndef _WIN32
+    if (outputWatched) loop.unwatch(STDOUT_FILENO);
+#endif
+    loop.unwatch(link.getFd());
+    if (!session.isSettled()) {
+        // A few times over, in case some are lost
+        for (int i = 0; i < 3; i++) link.send(VersusLink::makePacket(PACKET_BYE));
+    }
+
+    const Versus& state = game.getState();
+    bool finished = session.isSettled();
+    if (finished) Metrics::add(METRIC_GAMES_FINISHED);
+    SessionRecord record = state.getSessionRecord(localPlayer);
+    record.startTime = startTime;
+    telemetry.append(record);
+
+    if (finished && !interrupted && !game.shouldQuit()) {
+        loop.setTickInterval(0);
+        game.draw("Game over. Press any key.");
+        screen.finishOutput();
+        while (loop.isInputOpen()) {
+            LoopEvents events = loop.wait();
+            if (events.quit || events.inputClosed) break;
+            if (events.input) {
+                unsigned char pressed[64];
+                InputHandler::readAvailable(pressed, sizeof(pressed));
+                break;
+            }
+            if (events.resized) game.draw("Game over. Press any key.");
+        }
+    }
+
+    InputHandler::disableRawInput();
+    screen.finishOutput();
+    io.flush();
+
+    int winner = state.getWinner();
+    if (finished) {
+        cout << "Versus: " << (winner < 0 ? "draw" : winner == localPlayer ? "you won" : "you lost") << ", "
+             << state.getScore(localPlayer) << " to " << state.getScore(1 - localPlayer) << endl;
+    } else {
+        cout << "Versus: " << (peerLeft ? "the rival left" : link.isLost() ? "connection lost" : "you left")
+             << " at tick " << session.getTick() << endl;
+    }
+    cout << "Rollback: " << session.getRollbacks() << " rollbacks, " << session.getTicksReplayed()
+         << " ticks replayed, deepest " << session.getDeepestRollback() << ", worst "
+         << session.getSlowestRollbackNs() / 1000.0 << " us, average " << session.getAverageRollbackNs() / 1000.0
+         << " us; " << session.getStalls() << " ticks waited for the rival" << endl;
+    cout << "Network: " << link.getPacketsSent() << " packets sent, " << link.getPacketsReceived() << " received"
+         << endl;
+    if (desyncTick >= 0) {
+        cout << "Desync: the two games differed from tick " << desyncTick << " on" << endl;
+    }
+    if (metrics.isRunning()) {
+        cout << "Metrics: " << metrics.getScrapes() << " scrapes on http://127.0.0.1:" << options.metricsPort
+             << "/metrics" << endl;
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    string mode = ClassicRules::NAME;
+    RunOptions options = { 0, "", "", "", BotHost::DEFAULT_BUDGET_MS, RENDER_EMOJI, 0, "", "", false,
+                           OUTPUT_LEVEL_COUNT };
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg.rfind("--mode=", 0) == 0) {
+            mode = arg.substr(7);
+        } else if (arg == "--frenzy") {
+            mode = FrenzyRules::NAME;
+        } else if (arg == "--maze") {
+            mode = MazeRules::NAME;
+        } else if (arg == "--endless") {
+            mode = EndlessRules::NAME;
+        } else if (arg.rfind("--versus=", 0) == 0 && arg.size() > 9) {
+            mode = VersusRules::NAME;
+            options.versusAddress = arg.substr(9);
+        } else if (arg == "--autopilot") {
+            options.autopilotBudget = Autopilot<ClassicRules>::DEFAULT_BUDGET_MS;
+        } else if (arg.rfind("--autopilot=", 0) == 0) {
+            options.autopilotBudget = atoi(arg.c_str() + 12);
+            if (options.autopilotBudget <= 0 || options.autopilotBudget > Autopilot<ClassicRules>::MAX_BUDGET_MS) {
+                mode = "";
+                break;
+            }
+        } else if (arg.rfind("--bot=", 0) == 0 && arg.size() > 6) {
+            options.botPath = arg.substr(6);
+        } else if (arg.rfind("--bot-args=", 0) == 0) {
+            options.botArgs = arg.substr(11);
+        } else if (arg.rfind("--bot-budget=", 0) == 0) {
+            options.botBudget = atoi(arg.c_str() + 13);
+            if (options.botBudget <= 0 || options.botBudget > BotHost::MAX_BUDGET_MS) {
+                mode = "";
+                break;
+            }
+        } else if (arg.rfind("--render=", 0) == 0) {
+            int found = RENDER_MODE_COUNT;
+            for (int i = 0; i < RENDER_MODE_COUNT; i++) {
+                if (arg.substr(9) == RENDER_MODE_NAMES[i]) found = i;
+            }
+            if (found == RENDER_MODE_COUNT) {
+                mode = "";
+                break;
+            }
+            options.renderMode = static_cast<RenderMode>(found);
+        } else if (arg.rfind("--output=", 0) == 0) {
+            int found = OUTPUT_LEVEL_COUNT;
+            for (int i = 0; i < OUTPUT_LEVEL_COUNT; i++) {
+                if (arg.substr(9) == OUTPUT_LEVEL_NAMES[i]) found = i;
+            }
+            if (found == OUTPUT_LEVEL_COUNT) {
+                mode = "";
+                break;
+            }
+            options.outputLevel = static_cast<OutputLevel>(found);
+        } else if (arg == "--metrics") {
+            options.metricsPort = MetricsServer::DEFAULT_PORT;
+        } else if (arg.rfind("--metrics=", 0) == 0) {
+            options.metricsPort = atoi(arg.c_str() + 10);
+            if (options.metricsPort <= 0 || options.metricsPort > 65535) {
+                mode = "";
+                break;
+            }
+        } else if (arg.rfind("--record=", 0) == 0 && arg.size() > 9) {
+            options.replayPath = arg.substr(9);
+        } else if (arg == "--practice") {
+            options.practice = true;
+        } else if (arg == "--share") {
+            options.shareName = DEFAULT_SHARE_NAME;
+        } else if (arg.rfind("--share=/", 0) == 0 && arg.size() > 9) {
+            options.shareName = arg.substr(8);
+        } else {
+            mode = "";
+            break;
+        }
+    }
+
+    if (options.autopilotBudget > 0 && !options.botPath.empty()) {
+        mode = ""; // One driver at a time
+    }
+    if (options.practice && !options.replayPath.empty()) {
+        mode = ""; // A replay plays forward only
+    }
+
+    int (*run)(const RunOptions&) = nullptr;
+    if (mode == ClassicRules::NAME) run = runGame<ClassicRules>;
+    else if (mode == WrapRules::NAME) run = runGame<WrapRules>;
+    else if (mode == NoPowerUpRules::NAME) run = runGame<NoPowerUpRules>;
+    else if (mode == ObstacleHeavyRules::NAME) run = runGame<ObstacleHeavyRules>;
+    else if (mode == FrenzyRules::NAME) run = runGame<FrenzyRules>;
+    else if (mode == MazeRules::NAME) run = runGame<MazeRules>;
+    else if (mode == EndlessRules::NAME && options.autopilotBudget == 0 && options.botPath.empty() &&
+             options.shareName.empty() && options.replayPath.empty() && !options.practice) run = runEndless;
+    else if (mode == VersusRules::NAME && !options.versusAddress.empty() && options.autopilotBudget == 0 &&
+             options.botPath.empty() && options.shareName.empty() && options.replayPath.empty() && !options.practice)
+        run = runVersus;
+
+    if (!run) {
+        cout << "Usage: " << argv[0] << " [--mode=classic|wrap|nopowerups|obstacles|frenzy|maze|endless]\n"
+             << "       [--frenzy] [--maze] [--endless] [--versus=<port>|<host>:<port>]\n"
+             << "       [--autopilot[=<ms per tick, 1-" << Autopilot<ClassicRules>::MAX_BUDGET_MS << ">]]"
+             << " [--share[=/<shm name>]] [--record=<replay file> | --practice]\n"
+             << "       [--render=emoji|halfblock|halfblock256|ascii] [--output=full|lines|hud]\n"
+             << "       [--metrics[=<localhost port>]]\n"
+             << "       [--bot=<plugin library> [--bot-args=<text>] [--bot-budget=<ms per tick, 1-"
+             << BotHost::MAX_BUDGET_MS << ">]]" << endl;
+        return 1;
+    }
+
+    cout << "Starting Cross-Platform Snake Game..." << endl;
+    cout << "Make sure your terminal supports emojis!" << endl;
+    cout << "Starting in 2 seconds..." << endl;
+    
+    this_thread::sleep_for(chrono::seconds(2));
+    
+    // Clear screen properly at start
+#ifdef _WIN32
+    system("cls");
+#else
+    system("clear");
+#endif
+    
+    return run(options);
+}
@@ -0,0 +1,82 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+using namespace std;
+
+// Ever-growing totals
+enum MetricCounter {
+    METRIC_TICKS = 0,
+    METRIC_TICK_OVERRUNS,   // Tick periods that ran out before the game got to them (dropped)
+    METRIC_BYTES_WRITTEN,   // Frame bytes sent to the terminal
+    METRIC_GAMES_STARTED,
+    METRIC_GAMES_FINISHED,  // Games that ended in a game over (quits are started minus finished)
+    METRIC_OUTPUT_STALLS,   // Times a frame found the terminal still busy with earlier ones
+    METRIC_FRAMES_DROPPED,  // Frames replaced by a newer one before they could be sent
+    METRIC_COUNTER_COUNT
+};
+
+// Current values
+enum MetricGauge { METRIC_LENGTH = 0, METRIC_SPEED_MS, METRIC_OUTPUT_LEVEL, METRIC_GAUGE_COUNT };
+
+// Latency distributions
+enum MetricHistogram {
+    METRIC_FRAME_COMPOSE = 0, // Building a frame in memory
+    METRIC_FRAME_FLUSH,       // Writing it to the terminal
+    METRIC_INPUT_LATENCY,     // From the wakeup that read a key to the flush of the frame showing it
+    METRIC_HISTOGRAM_COUNT
+};
+
+// Process-wide metrics for monitoring.
+//
+// The game thread updates them with relaxed atomic operations on fixed
+// arrays: no locks, no allocation and a handful of nanoseconds each, so the
+// tick doesn't notice. Readers (MetricsServer) load the same atomics from
+// their own thread; a scrape may see one update and not the next, which is
+// fine for monitoring.
+class Metrics {
+public:
+    static const int HISTOGRAM_BUCKETS = 16; // Bucket i counts values up to 2^(i+4) us (16 us to 262 ms), the last one the rest
+
+    static void add(MetricCounter counter, uint64_t amount = 1);
+    static void set(MetricGauge gauge, int64_t value);
+    static void observe(MetricHistogram histogram, uint64_t ns);
+
+    static uint64_t get(MetricCounter counter);
+    static int64_t get(MetricGauge gauge);
+
+    // Everything in the Prometheus text exposition format
+    static string format();
+};
+
+// Serves Metrics::format() over HTTP on 127.0.0.1 from a thread of its own,
+// for GET /metrics (or /). One connection at a time, each closed after the
+// reply. POSIX only; start() fails on Windows.
+class MetricsServer {
+public:
+    static const int DEFAULT_PORT = 9464;
+
+private:
+    int listenFd;
+    int stopPipe[2]; // Written by the destructor to wake the thread
+    thread worker;
+    atomic<long long> scrapes;
+
+    void run();
+    void serve(int connection);
+
+public:
+    MetricsServer();
+    ~MetricsServer();
+
+    // Binds to 127.0.0.1:port and starts serving; on failure returns false with a message in error
+    bool start(int port, string& error);
+    bool isRunning() const { return listenFd >= 0; }
+    long long getScrapes() const { return scrapes.load(memory_order_relaxed); }
+};
+
+#endif
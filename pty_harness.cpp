@@ -0,0 +1,522 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <csignal>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/wait.h>
+#include "screen.h"
+
+using namespace std;
+
+// End-to-end latency harness: runs the real game under a pseudo-terminal,
+// types scripted keys into it and watches what it writes back.
+//
+// Usage: snake_latency [--game=<path>] [--duration=<s>] [--interval=<ms>]
+//                      [--script=<file>] [--check] [-- <game arguments>]
+//
+// The game is started with --render=ascii so the head is a single '@' in the
+// output. Every turn key is timed from the write() into the terminal to the
+// moment the head is read back having moved the new way, which is what a
+// player sees: the wait for the next tick, the game's input handling, the
+// frame and the terminal. One key is in flight at a time. Without a script
+// the keys steer towards the middle of the board, turning every interval
+// (+-50%). A script has one "<ms> <key>" line per key, ms from the first
+// frame; keys are w, a, s, d, space, r or q. Games that end are started
+// again until the time is up. --check plays once with whole frames and once
+// with changed lines only (--output=full and --output=lines) and fails unless
+// both show the turns and the same number of frames per head move.
+// Linux (and other systems with posix_openpt).
+
+const int HEADER_ROWS = 1;      // Title line above the board
+const int DEFAULT_DURATION_S = 30;
+const int DEFAULT_INTERVAL_MS = 400;
+const int GIVE_UP_MS = 2000;    // A key that shows no effect by then counts as lost
+
+enum Move { MOVE_NONE = 0, MOVE_LEFT, MOVE_RIGHT, MOVE_UP, MOVE_DOWN };
+const char MOVE_KEYS[5] = { 0, 'a', 'd', 'w', 's' };
+
+struct ScriptKey {
+    long long atMs;
+    char key;
+};
+
+static double nowMs() {
+    return chrono::duration<double, milli>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static Move keyMove(char key) {
+    for (int move = MOVE_LEFT; move <= MOVE_DOWN; move++) {
+        if (MOVE_KEYS[move] == key) return static_cast<Move>(move);
+    }
+    return MOVE_NONE;
+}
+
+static bool isReverse(Move a, Move b) {
+    return (a == MOVE_LEFT && b == MOVE_RIGHT) || (a == MOVE_RIGHT && b == MOVE_LEFT) ||
+           (a == MOVE_UP && b == MOVE_DOWN) || (a == MOVE_DOWN && b == MOVE_UP);
+}
+
+// Follows the cursor through the game's output the way a terminal would,
+// as far as needed to know where each frame puts the head
+class OutputTracker {
+private:
+    enum State { TEXT, ESCAPE, CSI };
+    State state;
+    string params;
+    int row;
+    int column;
+    bool lineMove; // The last byte was a cursor move to a changed line, or what ends a frame
+    string recent; // Last few printable bytes, to spot "GAME OVER"
+
+    // The text written after a cursor move shows it placed a changed line
+    // rather than ending the frame
+    void lineWritten() {
+        if (lineMove) frames--;
+        lineMove = false;
+    }
+
+public:
+    long long frames;
+    long long bytes;
+    // Where the last head was drawn
+    bool headSeen;
+    int headRow;
+    int headColumn;
+    bool gameOver;
+
+    OutputTracker() { reset(); }
+
+    void reset() {
+        state = TEXT;
+        params.clear();
+        row = column = 0;
+        lineMove = false;
+        recent.clear();
+        frames = bytes = 0;
+        headSeen = false;
+        headRow = headColumn = 0;
+        gameOver = false;
+    }
+
+    // Calls onHead(row, column) for every head drawn
+    template <class OnHead>
+    void feed(const char* data, size_t length, OnHead onHead) {
+        bytes += length;
+        for (size_t i = 0; i < length; i++) {
+            unsigned char byte = data[i];
+            switch (state) {
+                case TEXT:
+                    if (byte == 0x1b) {
+                        state = ESCAPE;
+                    } else if (byte == '\n') {
+                        lineWritten();
+                        row++;
+                        column = 0;
+                    } else if (byte == '\r') {
+                        column = 0;
+                    } else if ((byte & 0xc0) != 0x80) { // One column per character, continuation bytes aside
+                        lineWritten();
+                        if (byte == '@' && row > HEADER_ROWS) {
+                            headSeen = true;
+                            headRow = row;
+                            headColumn = column;
+                            onHead(row, column);
+                        }
+                        recent.push_back(static_cast<char>(byte));
+                        if (recent.size() > 32) recent.erase(0, recent.size() - 16);
+                        if (recent.find("GAME OVER") != string::npos) gameOver = true;
+                        column++;
+                    }
+                    break;
+                case ESCAPE:
+                    state = byte == '[' ? CSI : TEXT;
+                    params.clear();
+                    break;
+                case CSI:
+                    if (byte >= 0x40 && byte <= 0x7e) {
+                        int count = params.empty() || params[0] == '?' ? 1 : max(1, atoi(params.c_str()));
+                        if (byte == 'H' || byte == 'f') {
+                            // A whole frame starts with a bare ESC[H. Changed lines are each placed
+                            // with ESC[<row>;1H, and one more move below the last line ends the frame.
+                            lineMove = false;
+                            if (params.empty()) {
+                                row = column = 0;
+                            } else {
+                                size_t separator = params.find(';');
+                                row = max(1, atoi(params.c_str())) - 1;
+                                column = separator == string::npos ? 0 : max(1, atoi(params.c_str() + separator + 1)) - 1;
+                                lineMove = true;
+                            }
+                            frames++;
+                        } else if (byte == 'C') {
+                            column += count;
+                        } else if (byte == 'K') {
+                            lineWritten(); // Every changed line ends in an erase, even an empty one
+                        } else if (byte == 'J') {
+                            lineMove = false; // Erases what's left of a longer frame; the cursor stays
+                        }
+                        state = TEXT;
+                    } else {
+                        params.push_back(static_cast<char>(byte));
+                    }
+                    break;
+            }
+        }
+    }
+};
+
+// The game on the other end of a pseudo-terminal
+class GameProcess {
+private:
+    pid_t pid;
+    int master;
+
+public:
+    GameProcess() : pid(-1), master(-1) {}
+    ~GameProcess() { stop(); }
+
+    bool start(const string& path, const vector<string>& arguments) {
+        master = posix_openpt(O_RDWR | O_NOCTTY);
+        if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) return false;
+        const char* slaveName = ptsname(master);
+        if (!slaveName) return false;
+        string slavePath = slaveName;
+
+        winsize size = {};
+        size.ws_row = 50;
+        size.ws_col = 120;
+
+        pid = fork();
+        if (pid < 0) return false;
+        if (pid == 0) {
+            // Child: the terminal's slave side becomes its controlling terminal and stdio
+            setsid();
+            int slave = open(slavePath.c_str(), O_RDWR);
+            if (slave < 0) _exit(127);
+            ioctl(slave, TIOCSCTTY, 0);
+            ioctl(slave, TIOCSWINSZ, &size);
+            dup2(slave, 0);
+            dup2(slave, 1);
+            dup2(slave, 2);
+            if (slave > 2) close(slave);
+            close(master);
+            setenv("TERM", "xterm-256color", 1);
+
+            vector<char*> argv;
+            argv.push_back(const_cast<char*>(path.c_str()));
+            for (const string& argument : arguments) argv.push_back(const_cast<char*>(argument.c_str()));
+            argv.push_back(nullptr);
+            execv(path.c_str(), argv.data());
+            _exit(127);
+        }
+        fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+        return true;
+    }
+
+    int getFd() const { return master; }
+
+    void send(char key) {
+        if (write(master, &key, 1) < 0) {} // A game that has gone shows up as end of output
+    }
+
+    // Reaps the game; true if it exited by itself
+    bool stop() {
+        bool exited = false;
+        if (pid > 0) {
+            int status;
+            if (waitpid(pid, &status, WNOHANG) == pid) {
+                exited = true;
+            } else {
+                kill(pid, SIGTERM);
+                waitpid(pid, &status, 0);
+            }
+            pid = -1;
+        }
+        if (master >= 0) {
+            close(master);
+            master = -1;
+        }
+        return exited;
+    }
+};
+
+static bool loadScript(const string& path, vector<ScriptKey>& script) {
+    ifstream file(path);
+    if (!file) return false;
+    string line;
+    while (getline(file, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        istringstream fields(line);
+        ScriptKey key;
+        string name;
+        if (!(fields >> key.atMs >> name)) return false;
+        key.key = name == "space" ? ' ' : name[0];
+        script.push_back(key);
+    }
+    sort(script.begin(), script.end(), [](const ScriptKey& a, const ScriptKey& b) { return a.atMs < b.atMs; });
+    return true;
+}
+
+static double percentile(const vector<double>& sorted, double fraction) {
+    if (sorted.empty()) return 0;
+    return sorted[min(sorted.size() - 1, static_cast<size_t>(fraction * sorted.size()))];
+}
+
+// What the games of one run added up to
+struct Results {
+    vector<double> latencies; // Sorted once the run is over
+    long long keysSent = 0, keysLost = 0, games = 0, frames = 0, bytes = 0, moves = 0;
+    double moveGapsMs = 0; // Between consecutive head moves, to tell the tick wait from the rest
+    double activeMs = 0; // Time spent in games, from their first frame
+};
+
+// Plays games until durationS is up (or the script is done); false if the
+// game couldn't be started
+static bool play(const string& gamePath, const vector<string>& gameArguments, const vector<ScriptKey>& script,
+                 int durationS, int intervalMs, Results& results) {
+    double deadline = nowMs() + durationS * 1000.0;
+    unsigned randomState = 12345;
+    auto nextRandom = [&randomState]() {
+        randomState = randomState * 1103515245u + 12345u;
+        return (randomState >> 8) & 0xffff;
+    };
+
+    while (nowMs() < deadline) {
+        GameProcess game;
+        if (!game.start(gamePath, gameArguments)) {
+            cerr << "Can't start " << gamePath << " in a pseudo-terminal: " << strerror(errno) << endl;
+            return false;
+        }
+        results.games++;
+        OutputTracker output;
+        double firstFrameAt = 0;
+        size_t scriptIndex = 0;
+
+        // The key in flight
+        bool pending = false;
+        Move expected = MOVE_NONE;
+        double sentAt = 0;
+        double nextKeyAt = 0;
+        Move moving = MOVE_RIGHT; // The game starts moving right
+        int lastRow = -1, lastColumn = -1;
+        double lastMoveAt = 0;
+        bool gameOverHandled = false;
+
+        auto onHead = [&](int row, int column) {
+            if (lastRow >= 0 && (row != lastRow || column != lastColumn)) {
+                double now = nowMs();
+                if (lastMoveAt > 0) {
+                    results.moveGapsMs += now - lastMoveAt;
+                    results.moves++;
+                }
+                lastMoveAt = now;
+                int dx = column - lastColumn, dy = row - lastRow;
+                // A jump across the board is a wrap the other way
+                if (abs(dx) > 1) dx = -dx;
+                if (abs(dy) > 1) dy = -dy;
+                moving = dx < 0 ? MOVE_LEFT : dx > 0 ? MOVE_RIGHT : dy < 0 ? MOVE_UP : MOVE_DOWN;
+                if (pending && moving == expected) {
+                    results.latencies.push_back(now - sentAt);
+                    pending = false;
+                }
+            }
+            lastRow = row;
+            lastColumn = column;
+        };
+
+        char buffer[65536];
+        bool running = true;
+        while (running) {
+            double now = nowMs();
+            if (now >= deadline) break;
+
+            // Send the next key once the previous one showed (or was given up on)
+            if (pending && now - sentAt > GIVE_UP_MS) {
+                results.keysLost++;
+                pending = false;
+            }
+            if (firstFrameAt > 0 && !pending && !output.gameOver) {
+                if (!script.empty()) {
+                    if (scriptIndex < script.size() && now - firstFrameAt >= script[scriptIndex].atMs) {
+                        char key = script[scriptIndex++].key;
+                        Move move = keyMove(key);
+                        game.send(key);
+                        // Only a real turn changes anything on screen
+                        if (move != MOVE_NONE && move != moving && !isReverse(move, moving)) {
+                            pending = true;
+                            expected = move;
+                            sentAt = nowMs();
+                            results.keysSent++;
+                        }
+                    }
+                } else if (now >= nextKeyAt && output.headSeen) {
+                    // Turn towards the middle of the board
+                    int middleRow = HEADER_ROWS + 1 + HEIGHT / 2, middleColumn = 1 + WIDTH / 2;
+                    if (moving == MOVE_LEFT || moving == MOVE_RIGHT) {
+                        expected = output.headRow > middleRow ? MOVE_UP : MOVE_DOWN;
+                    } else {
+                        expected = output.headColumn > middleColumn ? MOVE_LEFT : MOVE_RIGHT;
+                    }
+                    game.send(MOVE_KEYS[expected]);
+                    pending = true;
+                    sentAt = nowMs();
+                    results.keysSent++;
+                    nextKeyAt = sentAt + intervalMs / 2 + nextRandom() % max(1, intervalMs);
+                }
+            }
+
+            // Any key leaves the game over screen and ends the game
+            if (output.gameOver && !gameOverHandled) {
+                gameOverHandled = true;
+                pending = false;
+                game.send('q');
+            }
+
+            pollfd watch = { game.getFd(), POLLIN, 0 };
+            if (poll(&watch, 1, 1) < 0 && errno != EINTR) break;
+            while (true) {
+                ssize_t got = read(game.getFd(), buffer, sizeof(buffer));
+                if (got > 0) {
+                    output.feed(buffer, got, onHead);
+                    if (firstFrameAt == 0 && output.headSeen) firstFrameAt = nowMs();
+                    continue;
+                }
+                if (got < 0 && errno == EAGAIN) break;
+                running = false; // EIO: the game closed its terminal
+                break;
+            }
+            if (!script.empty() && scriptIndex >= script.size() && !pending && firstFrameAt > 0) {
+                deadline = min(deadline, nowMs() + 500); // Let the last frames arrive, then finish
+            }
+        }
+
+        if (pending) results.keysLost++;
+        if (firstFrameAt > 0) results.activeMs += nowMs() - firstFrameAt;
+        results.frames += output.frames;
+        results.bytes += output.bytes;
+        game.stop();
+        if (!script.empty()) break; // A script plays once
+    }
+    sort(results.latencies.begin(), results.latencies.end());
+    return true;
+}
+
+static void report(const Results& results) {
+    const vector<double>& latencies = results.latencies;
+    double seconds = max(results.activeMs / 1000.0, 1e-9);
+    cout << "Games: " << results.games << ", " << fixed << setprecision(1) << seconds << " s of play" << endl;
+    cout << "Keys: " << results.keysSent << " turns sent, " << latencies.size() << " seen on screen, "
+         << results.keysLost << " without a visible effect" << endl;
+    if (!latencies.empty()) {
+        double sum = 0;
+        for (double latency : latencies) sum += latency;
+        cout << "Key to screen (ms): min " << setprecision(1) << latencies.front() << "  p50 "
+             << percentile(latencies, 0.5) << "  p90 " << percentile(latencies, 0.9) << "  p99 "
+             << percentile(latencies, 0.99) << "  max " << latencies.back() << "  mean " << sum / latencies.size()
+             << endl;
+
+        // Histogram in 25 ms steps
+        const int STEP_MS = 25;
+        vector<int> counts(static_cast<size_t>(latencies.back() / STEP_MS) + 1);
+        for (double latency : latencies) counts[static_cast<size_t>(latency / STEP_MS)]++;
+        int most = *max_element(counts.begin(), counts.end());
+        for (size_t i = 0; i < counts.size(); i++) {
+            cout << setw(5) << i * STEP_MS << "-" << setw(4) << (i + 1) * STEP_MS << " ms " << setw(6) << counts[i]
+                 << " " << string(counts[i] * 50 / max(most, 1), '#') << endl;
+        }
+    }
+    if (results.moves > 0) {
+        cout << "Head moved every " << setprecision(1) << results.moveGapsMs / results.moves
+             << " ms on average, so about half of that is waiting for the next tick" << endl;
+    }
+    cout << "Output: " << setprecision(1) << results.frames / seconds << " frames/s, " << setprecision(0)
+         << results.bytes / seconds << " bytes/s (" << results.bytes / max(results.frames, 1LL) << " bytes/frame)"
+         << endl;
+}
+
+int main(int argc, char* argv[]) {
+    string gamePath = "./snake_game";
+    string scriptPath;
+    int durationS = DEFAULT_DURATION_S;
+    int intervalMs = DEFAULT_INTERVAL_MS;
+    vector<string> gameArguments;
+    bool check = false;
+    bool usage = false;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg.rfind("--game=", 0) == 0) {
+            gamePath = arg.substr(7);
+        } else if (arg.rfind("--duration=", 0) == 0) {
+            durationS = atoi(arg.c_str() + 11);
+        } else if (arg.rfind("--interval=", 0) == 0) {
+            intervalMs = atoi(arg.c_str() + 11);
+        } else if (arg.rfind("--script=", 0) == 0) {
+            scriptPath = arg.substr(9);
+        } else if (arg == "--check") {
+            check = true;
+        } else if (arg == "--") {
+            gameArguments.assign(argv + i + 1, argv + argc);
+            break;
+        } else {
+            usage = true;
+        }
+    }
+    if (usage || durationS <= 0 || intervalMs <= 0) {
+        cout << "Usage: " << argv[0] << " [--game=<path>] [--duration=<s>] [--interval=<ms>] [--script=<file>]"
+             << " [--check] [-- <game arguments>]" << endl;
+        return 1;
+    }
+    vector<ScriptKey> script;
+    if (!scriptPath.empty() && !loadScript(scriptPath, script)) {
+        cerr << "Can't read script " << scriptPath << endl;
+        return 1;
+    }
+    gameArguments.push_back("--render=ascii");
+    signal(SIGPIPE, SIG_IGN);
+
+    if (!check) {
+        Results results;
+        if (!play(gamePath, gameArguments, script, durationS, intervalMs, results)) return 1;
+        report(results);
+        return 0;
+    }
+
+    // The same keys against whole frames and against changed lines only. The
+    // head has to be followed and frames counted alike at both levels, or the
+    // tracker has fallen out of step with what the game writes.
+    const char* const LEVELS[2] = { "full", "lines" };
+    double framesPerMove[2];
+    bool passed = true;
+    for (int i = 0; i < 2; i++) {
+        vector<string> arguments = gameArguments;
+        arguments.push_back(string("--output=") + LEVELS[i]);
+        Results results;
+        if (!play(gamePath, arguments, script, durationS, intervalMs, results)) return 1;
+        cout << "--output=" << LEVELS[i] << endl;
+        report(results);
+        framesPerMove[i] = static_cast<double>(results.frames) / max(results.moves, 1LL);
+        if (results.latencies.empty() || results.keysLost * 20 > results.keysSent) {
+            cout << "FAIL: turns not seen on screen with --output=" << LEVELS[i] << endl;
+            passed = false;
+        }
+    }
+    if (fabs(framesPerMove[0] - framesPerMove[1]) > 0.1 * max(framesPerMove[0], framesPerMove[1])) {
+        cout << "FAIL: " << setprecision(2) << framesPerMove[0] << " frames per head move with whole frames, "
+             << framesPerMove[1] << " with changed lines" << endl;
+        passed = false;
+    }
+    if (passed) cout << "Check passed" << endl;
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,85 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "game.h"
+#include "background_io.h"
+
+using namespace std;
+
+const char REPLAY_MAGIC[4] = { 'S', 'N', 'K', 'R' };
+const uint16_t REPLAY_VERSION = 2; // 2: items spawn where the head can reach them
+
+// A replay file is this header followed by one ReplayTick per tick played.
+// Games are fully determined by their seed and moves, so that is all it takes
+// to play one back; the state hash stored with every tick lets the playback
+// check that it is still in step with the original run.
+struct ReplayHeader {
+    char magic[4];      // REPLAY_MAGIC
+    uint16_t version;   // REPLAY_VERSION
+    uint8_t mode;       // Rules::ID
+    uint8_t unused;
+    uint32_t seed;
+    uint32_t unused2;
+    uint64_t startHash; // Simulation::getStateHash() before the first tick
+};
+
+struct ReplayTick {
+    uint8_t direction;  // Direction the snake moved in
+    uint8_t unused[7];
+    uint64_t hash;      // Simulation::getStateHash() after the tick
+};
+
+static_assert(sizeof(ReplayHeader) == 24 && sizeof(ReplayTick) == 16, "Replay records are written as they are");
+
+// Keeps a game's moves and hashes in memory while it runs and writes the
+// replay file in one go at the end, through the background I/O thread
+class ReplayRecorder {
+private:
+    string path;
+    ReplayHeader header;
+    vector<ReplayTick> ticks;
+
+public:
+    template <class Rules>
+    void start(const string& replayPath, const Simulation<Rules>& sim);
+    // Call after every update() that played a tick
+    template <class Rules>
+    void record(const Simulation<Rules>& sim);
+
+    bool isRecording() const { return !path.empty(); }
+    size_t getTickCount() const { return ticks.size(); }
+    // Queues the whole file as an atomic replace; done runs once it is on disk
+    void save(BackgroundIO& io, IoCallback done) const;
+};
+
+// Reads a whole replay file; on failure returns false with a message in error
+bool loadReplay(const string& path, ReplayHeader& header, vector<ReplayTick>& ticks, string& error);
+
+// Plays a replay back through the rules one tick at a time, comparing the
+// state hash with the recorded one after each
+template <class Rules>
+class ReplayPlayer {
+private:
+    Simulation<Rules> sim;
+    const ReplayTick* ticks;
+    long long tickCount;
+    long long played;
+    bool inStep;
+
+public:
+    ReplayPlayer(const ReplayHeader& header, const ReplayTick* replayTicks, long long count);
+
+    // Plays the next tick; false at the end or once the game is out of step
+    bool step();
+
+    const Simulation<Rules>& getSimulation() const { return sim; }
+    long long getTicksPlayed() const { return played; }
+    long long getTickCount() const { return tickCount; }
+    // False if a hash didn't match: the tick that didn't is getTicksPlayed()
+    bool isInStep() const { return inStep; }
+};
+
+#endif
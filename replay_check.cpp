@@ -0,0 +1,100 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include "replay.h"
+
+using namespace std;
+
+// Plays a replay recorded with --record back through the rules and checks
+// that every tick comes out with the state hash the original run had.
+//
+// Usage: snake_replay [--trace] <replay file>
+//
+// --trace prints every tick's move and hash. Exits with 0 if the whole game
+// replayed in step, 2 on a desync and 1 if the file can't be read.
+
+const char* const DIRECTION_NAMES[5] = { "stop", "left", "right", "up", "down" };
+
+template <class Rules>
+int check(const ReplayHeader& header, const vector<ReplayTick>& ticks, bool trace) {
+    ReplayPlayer<Rules> player(header, ticks.data(), static_cast<long long>(ticks.size()));
+    cout << "Replay: " << Rules::NAME << " mode, seed " << header.seed << ", " << ticks.size() << " ticks" << endl;
+
+    auto start = chrono::steady_clock::now();
+    long long positionErrors = 0;
+    while (player.step()) {
+        const Simulation<Rules>& sim = player.getSimulation();
+        // The incremental hash against one worked out from scratch
+        if (sim.getPositionHash() != sim.rehashPosition()) positionErrors++;
+        if (trace) {
+            const ReplayTick& tick = ticks[player.getTicksPlayed() - 1];
+            cout << "tick " << setw(6) << player.getTicksPlayed() << "  " << setw(5) << left
+                 << DIRECTION_NAMES[tick.direction % 5] << right << "  score " << setw(5) << sim.getScore()
+                 << "  hash " << hex << setw(16) << setfill('0') << tick.hash << dec << setfill(' ') << endl;
+        }
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    const Simulation<Rules>& sim = player.getSimulation();
+    if (!player.isInStep()) {
+        long long tick = player.getTicksPlayed();
+        cout << "DESYNC at tick " << tick + 1 << ": ";
+        if (tick == 0 && sim.getTickCount() == 0) {
+            cout << "the starting state hashes to " << hex << sim.getStateHash() << ", the recording has "
+                 << header.startHash << dec << endl;
+        } else {
+            cout << "replay hashes to " << hex << sim.getStateHash() << ", the recording has " << ticks[tick].hash
+                 << dec << endl;
+        }
+        return 2;
+    }
+    cout << "In step for all " << player.getTicksPlayed() << " ticks (" << fixed << setprecision(0)
+         << player.getTicksPlayed() / max(seconds, 1e-9) << " ticks/s), final score " << sim.getScore()
+         << ", length " << sim.getSnake().getLength() << ", hash " << hex << sim.getStateHash() << dec << endl;
+    if (positionErrors > 0) {
+        cout << "Incremental position hash disagreed with a full rehash on " << positionErrors << " ticks" << endl;
+        return 2;
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    bool trace = false;
+    string path;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--trace") {
+            trace = true;
+        } else if (arg[0] != '-' && path.empty()) {
+            path = arg;
+        } else {
+            path = "";
+            break;
+        }
+    }
+    if (path.empty()) {
+        cout << "Usage: " << argv[0] << " [--trace] <replay file>" << endl;
+        return 1;
+    }
+
+    ReplayHeader header;
+    vector<ReplayTick> ticks;
+    string error;
+    if (!loadReplay(path, header, ticks, error)) {
+        cerr << error << endl;
+        return 1;
+    }
+
+    switch (header.mode) {
+        case ClassicRules::ID:       return check<ClassicRules>(header, ticks, trace);
+        case WrapRules::ID:          return check<WrapRules>(header, ticks, trace);
+        case NoPowerUpRules::ID:     return check<NoPowerUpRules>(header, ticks, trace);
+        case ObstacleHeavyRules::ID: return check<ObstacleHeavyRules>(header, ticks, trace);
+        case FrenzyRules::ID:        return check<FrenzyRules>(header, ticks, trace);
+        case MazeRules::ID:          return check<MazeRules>(header, ticks, trace);
+    }
+    cerr << path << " was recorded in unknown mode " << (int)header.mode << endl;
+    return 1;
+}
@@ -0,0 +1,468 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "replay.h"
+
+using namespace std;
+
+// Turns a replay recorded with --record into one image per tick, without a
+// terminal, for highlight reels and bug reports.
+//
+// Usage: snake_render [--scale=<pixels per cell>] [--format=ppm|png] [--threads=<n>]
+//                     [--out=<file prefix> | --stdout | --dry-run] <replay file>
+//
+// Frame 0 is the starting position and frame n the board after tick n, drawn
+// from the same glyphs and colours as the terminal renderers. Files are named
+// <prefix>000000.ppm and so on (default prefix "frame_"). --stdout writes the
+// images back to back in order instead, e.g. for
+//   snake_render --stdout game.snr | ffmpeg -f image2pipe -c:v ppm -i - game.mp4
+// and --dry-run renders and encodes without writing, to measure throughput.
+//
+// The work is a pipeline: this thread plays the replay and drops each tick's
+// glyph grid into a ring of slots, and a pool of workers rasterizes and
+// encodes the slots in parallel (and writes the files). Frames are
+// independent once the glyphs are taken, so only the playback is sequential,
+// and it is the cheap part. Rasterizing copies prebuilt tile rows into an
+// 8-bit image of glyph numbers, which PNG keeps as a palette image and PPM
+// expands to RGB.
+
+const int DEFAULT_SCALE = 8;
+const int MAX_SCALE = 64;
+const int SLOTS_PER_WORKER = 4;
+
+enum ImageFormat { FORMAT_PPM, FORMAT_PNG };
+enum OutputMode { OUTPUT_FILES, OUTPUT_STDOUT, OUTPUT_NONE };
+
+struct RenderOptions {
+    int scale;
+    ImageFormat format;
+    int threads;
+    OutputMode output;
+    string prefix;
+};
+
+// Shape a glyph is drawn in, inside its square of scale x scale pixels
+enum TileShape { TILE_FULL, TILE_INSET, TILE_ROUND };
+
+const TileShape TILE_SHAPES[GLYPH_COUNT] = {
+    TILE_FULL,  // GLYPH_EMPTY
+    TILE_FULL,  // GLYPH_WALL
+    TILE_INSET, // GLYPH_BODY
+    TILE_INSET, // GLYPH_BODY_DEAD
+    TILE_INSET, // GLYPH_BODY_SHIELD
+    TILE_INSET, // GLYPH_HEAD
+    TILE_INSET, // GLYPH_HEAD_DEAD
+    TILE_ROUND, // GLYPH_FOOD
+    TILE_ROUND, // GLYPH_SPECIAL_FOOD
+    TILE_ROUND, // GLYPH_POISON_FOOD
+    TILE_ROUND, // GLYPH_SHIELD
+    TILE_INSET, // GLYPH_RIVAL_BODY
+    TILE_INSET, // GLYPH_RIVAL_HEAD
+};
+
+// One scale x scale bitmap of glyph numbers per glyph, built once
+class Tiles {
+private:
+    int scale;
+    vector<unsigned char> pixels; // GLYPH_COUNT tiles, row by row
+
+public:
+    explicit Tiles(int tileScale) : scale(tileScale), pixels(GLYPH_COUNT * tileScale * tileScale, GLYPH_EMPTY) {
+        int inset = scale >= 4 ? 1 : 0; // Keeps neighbouring segments apart
+        float radius = scale * 0.4f, middle = (scale - 1) * 0.5f;
+        for (int glyph = 0; glyph < GLYPH_COUNT; glyph++) {
+            for (int y = 0; y < scale; y++) {
+                for (int x = 0; x < scale; x++) {
+                    bool inside = true;
+                    if (TILE_SHAPES[glyph] == TILE_INSET) {
+                        inside = x >= inset && y >= inset && x < scale - inset && y < scale - inset;
+                    } else if (TILE_SHAPES[glyph] == TILE_ROUND) {
+                        float dx = x - middle, dy = y - middle;
+                        inside = dx * dx + dy * dy <= radius * radius + 0.5f;
+                    }
+                    pixels[(glyph * scale + y) * scale + x] = inside ? glyph : GLYPH_EMPTY;
+                }
+            }
+        }
+    }
+
+    const unsigned char* row(int glyph, int y) const { return &pixels[(glyph * scale + y) * scale]; }
+};
+
+// Writes a glyph grid into an image of glyph numbers, FRAME_WIDTH * scale
+// pixels wide, one tile row at a time
+static void rasterize(const Glyph* glyphs, const Tiles& tiles, int scale, unsigned char* image) {
+    int stride = FRAME_WIDTH * scale;
+    for (int y = 0; y < FRAME_HEIGHT; y++) {
+        const Glyph* glyphRow = glyphs + y * FRAME_WIDTH;
+        for (int tileY = 0; tileY < scale; tileY++) {
+            unsigned char* out = image + (y * scale + tileY) * stride;
+            for (int x = 0; x < FRAME_WIDTH; x++) {
+                memcpy(out + x * scale, tiles.row(glyphRow[x], tileY), scale);
+            }
+        }
+    }
+}
+
+static void encodePpm(const unsigned char* image, int width, int height, string& out) {
+    char header[32];
+    out.assign(header, snprintf(header, sizeof(header), "P6\n%d %d\n255\n", width, height));
+    size_t start = out.size();
+    out.resize(start + static_cast<size_t>(width) * height * 3);
+    char* rgb = &out[start];
+    for (int i = 0; i < width * height; i++) {
+        const GlyphStyle& style = GLYPH_STYLES[image[i]];
+        rgb[i * 3] = style.red;
+        rgb[i * 3 + 1] = style.green;
+        rgb[i * 3 + 2] = style.blue;
+    }
+}
+
+// PNG checksums
+static uint32_t CRC_TABLE[256];
+
+static void buildCrcTable() {
+    for (uint32_t n = 0; n < 256; n++) {
+        uint32_t c = n;
+        for (int k = 0; k < 8; k++) c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+        CRC_TABLE[n] = c;
+    }
+}
+
+static uint32_t crc32(const char* data, size_t length, uint32_t crc = 0) {
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++) crc = CRC_TABLE[(crc ^ static_cast<unsigned char>(data[i])) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+static void appendBig32(string& out, uint32_t value) {
+    out += static_cast<char>(value >> 24);
+    out += static_cast<char>(value >> 16);
+    out += static_cast<char>(value >> 8);
+    out += static_cast<char>(value);
+}
+
+static void appendChunk(string& out, const char* type, const string& data) {
+    appendBig32(out, static_cast<uint32_t>(data.size()));
+    size_t typeAt = out.size();
+    out.append(type, 4);
+    out += data;
+    appendBig32(out, crc32(out.data() + typeAt, out.size() - typeAt));
+}
+
+// An 8-bit palette PNG with the glyph colours as the palette. The image data
+// goes into stored (uncompressed) deflate blocks: no zlib needed and nothing
+// to compute beyond the checksums, and any PNG optimizer can squeeze the
+// files afterwards.
+static void encodePng(const unsigned char* image, int width, int height, string& out, string& scratch) {
+    static const char SIGNATURE[8] = { '\x89', 'P', 'N', 'G', '\r', '\n', '\x1a', '\n' };
+    out.assign(SIGNATURE, 8);
+
+    scratch.clear();
+    appendBig32(scratch, width);
+    appendBig32(scratch, height);
+    scratch += '\x08'; // Bit depth
+    scratch += '\x03'; // Palette colour
+    scratch.append(3, '\0');
+    appendChunk(out, "IHDR", scratch);
+
+    scratch.clear();
+    for (int glyph = 0; glyph < GLYPH_COUNT; glyph++) {
+        scratch += static_cast<char>(GLYPH_STYLES[glyph].red);
+        scratch += static_cast<char>(GLYPH_STYLES[glyph].green);
+        scratch += static_cast<char>(GLYPH_STYLES[glyph].blue);
+    }
+    appendChunk(out, "PLTE", scratch);
+
+    // zlib stream: header, stored blocks of up to 65535 bytes of filter-byte-prefixed rows, Adler-32
+    const size_t MAX_BLOCK = 65535;
+    size_t rawSize = static_cast<size_t>(width + 1) * height;
+    scratch.clear();
+    scratch.reserve(2 + rawSize + (rawSize / MAX_BLOCK + 1) * 5 + 4);
+    scratch += '\x78';
+    scratch += '\x01';
+    uint32_t a = 1, b = 0;
+    size_t blockLeft = 0, rawLeft = rawSize;
+    for (int y = 0; y < height; y++) {
+        for (int x = -1; x < width; x++) {
+            if (blockLeft == 0) {
+                blockLeft = min(MAX_BLOCK, rawLeft);
+                scratch += static_cast<char>(rawLeft == blockLeft ? 1 : 0); // Last block?
+                scratch += static_cast<char>(blockLeft & 0xff);
+                scratch += static_cast<char>(blockLeft >> 8);
+                scratch += static_cast<char>(~blockLeft & 0xff);
+                scratch += static_cast<char>((~blockLeft >> 8) & 0xff);
+            }
+            unsigned char byte = x < 0 ? 0 : image[y * width + x]; // Filter type 0 before each row
+            scratch += static_cast<char>(byte);
+            a = (a + byte) % 65521;
+            b = (b + a) % 65521;
+            blockLeft--;
+            rawLeft--;
+        }
+    }
+    appendBig32(scratch, (b << 16) | a);
+    appendChunk(out, "IDAT", scratch);
+    appendChunk(out, "IEND", string());
+}
+
+enum SlotStage { SLOT_FREE, SLOT_SIMULATED, SLOT_ENCODING, SLOT_ENCODED };
+
+// A frame on its way through the pipeline
+struct FrameSlot {
+    long long number;
+    SlotStage stage;
+    Glyph glyphs[FRAME_HEIGHT * FRAME_WIDTH];
+    string encoded;
+};
+
+class RenderPipeline {
+private:
+    const RenderOptions& options;
+    Tiles tiles;
+    vector<FrameSlot> slots;
+    mutex lock;
+    condition_variable changed;
+    long long nextToEncode; // Frame the next free worker takes
+    long long frameCount;   // Known once playback ends, -1 until then
+    bool failed;
+    string error;
+    vector<double> busySeconds; // Per worker
+
+    FrameSlot& slotFor(long long frame) { return slots[frame % slots.size()]; }
+
+    void work(int worker) {
+        int width = FRAME_WIDTH * options.scale, height = FRAME_HEIGHT * options.scale;
+        vector<unsigned char> image(static_cast<size_t>(width) * height);
+        string scratch;
+        char name[32];
+        while (true) {
+            long long frame;
+            FrameSlot* slot;
+            {
+                unique_lock<mutex> guard(lock);
+                changed.wait(guard, [&] {
+                    frame = nextToEncode; // Another worker may have taken the one we were waiting for
+                    return failed || (frameCount >= 0 && frame >= frameCount) ||
+                           (slotFor(frame).number == frame && slotFor(frame).stage == SLOT_SIMULATED);
+                });
+                if (failed || (frameCount >= 0 && frame >= frameCount)) return;
+                nextToEncode++;
+                slot = &slotFor(frame);
+                slot->stage = SLOT_ENCODING;
+            }
+            changed.notify_all(); // The next frame may be waiting for its worker
+
+            auto start = chrono::steady_clock::now();
+            rasterize(slot->glyphs, tiles, options.scale, image.data());
+            if (options.format == FORMAT_PNG) {
+                encodePng(image.data(), width, height, slot->encoded, scratch);
+            } else {
+                encodePpm(image.data(), width, height, slot->encoded);
+            }
+            bool written = true;
+            if (options.output == OUTPUT_FILES) {
+                snprintf(name, sizeof(name), "%06lld.%s", frame, options.format == FORMAT_PNG ? "png" : "ppm");
+                ofstream file(options.prefix + name, ios::binary);
+                written = static_cast<bool>(file.write(slot->encoded.data(), slot->encoded.size()));
+            }
+            busySeconds[worker] += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+            {
+                lock_guard<mutex> guard(lock);
+                if (!written && !failed) {
+                    failed = true;
+                    error = "Can't write " + options.prefix + name;
+                }
+                slot->stage = options.output == OUTPUT_STDOUT ? SLOT_ENCODED : SLOT_FREE;
+            }
+            changed.notify_all();
+        }
+    }
+
+    // Sends the frames to stdout in order as they come out of the workers
+    void writeInOrder() {
+        for (long long frame = 0;; frame++) {
+            FrameSlot* slot;
+            {
+                unique_lock<mutex> guard(lock);
+                changed.wait(guard, [&] {
+                    return failed || (frameCount >= 0 && frame >= frameCount) ||
+                           (slotFor(frame).number == frame && slotFor(frame).stage == SLOT_ENCODED);
+                });
+                if (failed || (frameCount >= 0 && frame >= frameCount)) return;
+                slot = &slotFor(frame);
+            }
+            bool written = fwrite(slot->encoded.data(), 1, slot->encoded.size(), stdout) == slot->encoded.size();
+            {
+                lock_guard<mutex> guard(lock);
+                if (!written && !failed) {
+                    failed = true;
+                    error = "Can't write to stdout";
+                }
+                slot->stage = SLOT_FREE;
+            }
+            changed.notify_all();
+        }
+    }
+
+public:
+    RenderPipeline(const RenderOptions& renderOptions)
+        : options(renderOptions), tiles(renderOptions.scale), slots(renderOptions.threads * SLOTS_PER_WORKER),
+          nextToEncode(0), frameCount(-1), failed(false), busySeconds(renderOptions.threads, 0) {
+        for (FrameSlot& slot : slots) {
+            slot.number = -1;
+            slot.stage = SLOT_FREE;
+        }
+    }
+
+    // Plays the replay on this thread, feeding the workers; returns the
+    // number of frames, or -1 with a message in getError()
+    template <class Rules>
+    long long run(ReplayPlayer<Rules>& player, double& playbackSeconds) {
+        vector<thread> workers;
+        for (int i = 0; i < options.threads; i++) workers.emplace_back([this, i] { work(i); });
+        thread writer;
+        if (options.output == OUTPUT_STDOUT) writer = thread([this] { writeInOrder(); });
+
+        playbackSeconds = 0;
+        long long frame = 0;
+        bool more = true;
+        while (more) {
+            FrameSlot& slot = slotFor(frame);
+            {
+                unique_lock<mutex> guard(lock);
+                changed.wait(guard, [&] { return failed || slot.stage == SLOT_FREE; });
+                if (failed) break;
+            }
+            // The slot is ours until it is marked simulated
+            auto start = chrono::steady_clock::now();
+            composeBoard(player.getSimulation(), slot.glyphs);
+            more = player.step();
+            playbackSeconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            {
+                lock_guard<mutex> guard(lock);
+                slot.number = frame++;
+                slot.stage = SLOT_SIMULATED;
+            }
+            changed.notify_all();
+        }
+        // A replay that went out of step ends at the last frame that was still right
+        {
+            lock_guard<mutex> guard(lock);
+            frameCount = frame;
+        }
+        changed.notify_all();
+        for (thread& worker : workers) worker.join();
+        if (writer.joinable()) writer.join();
+        if (options.output == OUTPUT_STDOUT) fflush(stdout);
+        return failed ? -1 : frameCount;
+    }
+
+    const string& getError() const { return error; }
+    double getBusySeconds() const {
+        double total = 0;
+        for (double seconds : busySeconds) total += seconds;
+        return total;
+    }
+};
+
+template <class Rules>
+int render(const ReplayHeader& header, const vector<ReplayTick>& ticks, const RenderOptions& options) {
+    ReplayPlayer<Rules> player(header, ticks.data(), static_cast<long long>(ticks.size()));
+    RenderPipeline pipeline(options);
+    // Progress goes to stderr so --stdout stays clean
+    cerr << "Rendering: " << Rules::NAME << " mode, " << ticks.size() << " ticks, "
+         << FRAME_WIDTH * options.scale << "x" << FRAME_HEIGHT * options.scale << " pixels, workers: "
+         << options.threads << endl;
+
+    auto start = chrono::steady_clock::now();
+    double playbackSeconds;
+    long long frames = pipeline.run(player, playbackSeconds);
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    if (frames < 0) {
+        cerr << pipeline.getError() << endl;
+        return 1;
+    }
+
+    double busy = pipeline.getBusySeconds();
+    cerr << fixed << setprecision(0) << frames << " frames in " << setprecision(3) << seconds << " s: "
+         << setprecision(0) << frames / max(seconds, 1e-9) << " frames/s, "
+         << frames / max(busy, 1e-9) << " frames per worker-second (raster, encode"
+         << (options.output == OUTPUT_FILES ? ", write" : "") << "), playback "
+         << setprecision(2) << playbackSeconds * 1e6 / max(frames, 1LL) << " us/frame" << endl;
+    if (!player.isInStep()) {
+        cerr << "Replay went out of step at tick " << player.getTicksPlayed()
+             << "; frames stop at the last tick that matched" << endl;
+        return 2;
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    RenderOptions options = { DEFAULT_SCALE, FORMAT_PPM, static_cast<int>(thread::hardware_concurrency()),
+                              OUTPUT_FILES, "frame_" };
+    string path;
+    bool usage = false;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg.rfind("--scale=", 0) == 0) {
+            options.scale = atoi(arg.c_str() + 8);
+            usage = usage || options.scale < 1 || options.scale > MAX_SCALE;
+        } else if (arg == "--format=ppm") {
+            options.format = FORMAT_PPM;
+        } else if (arg == "--format=png") {
+            options.format = FORMAT_PNG;
+        } else if (arg.rfind("--threads=", 0) == 0) {
+            options.threads = atoi(arg.c_str() + 10);
+            usage = usage || options.threads < 1;
+        } else if (arg.rfind("--out=", 0) == 0) {
+            options.output = OUTPUT_FILES;
+            options.prefix = arg.substr(6);
+        } else if (arg == "--stdout") {
+            options.output = OUTPUT_STDOUT;
+        } else if (arg == "--dry-run") {
+            options.output = OUTPUT_NONE;
+        } else if (arg[0] != '-' && path.empty()) {
+            path = arg;
+        } else {
+            usage = true;
+        }
+    }
+    options.threads = max(1, options.threads);
+    if (usage || path.empty()) {
+        cerr << "Usage: " << argv[0] << " [--scale=<pixels per cell, 1-" << MAX_SCALE << ">] [--format=ppm|png]"
+             << " [--threads=<n>]\n       [--out=<file prefix> | --stdout | --dry-run] <replay file>" << endl;
+        return 1;
+    }
+
+    ReplayHeader header;
+    vector<ReplayTick> ticks;
+    string error;
+    if (!loadReplay(path, header, ticks, error)) {
+        cerr << error << endl;
+        return 1;
+    }
+    buildCrcTable();
+
+    switch (header.mode) {
+        case ClassicRules::ID:       return render<ClassicRules>(header, ticks, options);
+        case WrapRules::ID:          return render<WrapRules>(header, ticks, options);
+        case NoPowerUpRules::ID:     return render<NoPowerUpRules>(header, ticks, options);
+        case ObstacleHeavyRules::ID: return render<ObstacleHeavyRules>(header, ticks, options);
+        case FrenzyRules::ID:        return render<FrenzyRules>(header, ticks, options);
+        case MazeRules::ID:          return render<MazeRules>(header, ticks, options);
+    }
+    cerr << path << " was recorded in unknown mode " << (int)header.mode << endl;
+    return 1;
+}
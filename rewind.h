@@ -0,0 +1,95 @@
+#ifndef REWIND_H
+#define REWIND_H
+
+#include <cstdint>
+#include "game.h"
+
+// The last minute of a game, tick by tick, for the rewind key of practice mode.
+//
+// A Simulation is plain fixed-size data, so it is kept as 8-byte words and
+// each tick stores only the words that changed, XORed with what they were:
+// the new head and the old tail, the counters, an item now and then. XOR
+// works both ways, so applying a tick's changes to the state after it gives
+// the state before it: a step back is a few dozen word writes. Every KEYFRAME_INTERVAL ticks
+// the whole state is kept too, so a jump of many ticks starts from the
+// nearest keyframe instead of walking every tick in between.
+//
+// All storage is set aside up front: MAX_TICKS ticks, POOL_WORDS changed words
+// and KEYFRAMES states, whatever the snake's length. The oldest ticks are
+// dropped to make room, and so is anything more than WINDOW_MS of game time
+// old. Recording never allocates, and compares only the words the tick can
+// have touched (Simulation::markTouched()): the scalars, the new head's slot,
+// the item slots that changed and a few blocker counts, so it costs the same
+// few hundred ns however big the board-sized arrays make the state.
+template <class Rules>
+class RewindBuffer {
+public:
+    static constexpr int WINDOW_MS = 60000;
+    static constexpr int WORDS = sizeof(Simulation<Rules>) / 8;
+    static constexpr int MAX_TICKS = WINDOW_MS / Rules::MIN_SPEED + 1; // The whole window at top speed
+    static constexpr int KEYFRAME_INTERVAL = 32;
+    static constexpr int KEYFRAMES = MAX_TICKS / KEYFRAME_INTERVAL + 2;
+    static constexpr int POOL_WORDS = 1 << 15; // A power of two; about 40 words a tick over the window
+
+private:
+    static_assert(sizeof(Simulation<Rules>) % 8 == 0, "States are compared a word at a time");
+    static_assert(POOL_WORDS >= 2 * WORDS && (POOL_WORDS & (POOL_WORDS - 1)) == 0, "Bad pool size");
+    static_assert(KEYFRAMES * KEYFRAME_INTERVAL > MAX_TICKS, "Every tick kept needs a keyframe near it");
+
+    // What tick t changed, for t after the oldest tick kept, at [t % MAX_TICKS]
+    struct Frame {
+        uint64_t firstChange; // Into the pool, counting every change ever recorded
+        uint32_t changes;
+        int32_t timeMs;       // Game time after the tick
+    };
+
+    Frame frames[MAX_TICKS];
+    uint16_t changedWord[POOL_WORDS]; // The pool: ring buffers of which word changed
+    uint64_t changedBits[POOL_WORDS]; // and its old value XOR its new one
+    uint64_t poolEnd;                 // Changes ever recorded
+    // The state after the newest tick. Read as a Simulation too, for what
+    // the next tick can touch, so it's bytes (which may hold any object).
+    alignas(8) unsigned char latest[WORDS * 8];
+    uint64_t rewound[WORDS];          // The state after the cursor's tick, while rewound
+    uint64_t keyframes[KEYFRAMES][WORDS]; // The state after tick t, for t % KEYFRAME_INTERVAL == 0
+    long long oldest;                 // Ticks kept: oldest..newest
+    long long newest;
+    long long cursor;                 // The tick the game was rewound to; newest when it wasn't
+    long long records;
+
+    Frame& frameOf(long long tick) { return frames[tick % MAX_TICKS]; }
+    const Frame& frameOf(long long tick) const { return frames[tick % MAX_TICKS]; }
+    uint64_t* keyframeOf(long long tick) { return keyframes[(tick / KEYFRAME_INTERVAL) % KEYFRAMES]; }
+    // Turns the state after tick into the one before it, or back
+    void apply(long long tick, uint64_t* state) const;
+    // Adds the words set in touched (one bit a word) that differ from latest to the pool
+    void compare(const unsigned char* state, const uint32_t* touched);
+
+public:
+    RewindBuffer() : poolEnd(0), oldest(0), newest(0), cursor(0), records(0) {}
+
+    // Starts over with state as the only tick kept
+    void reset(const Simulation<Rules>& state);
+    // Keeps the state after a tick: one update() (and any turns) on from the
+    // state last recorded, or rewound to. If the game was rewound, the ticks
+    // it was rewound over are dropped first: this tick follows the cursor.
+    void record(const Simulation<Rules>& state);
+    // Sets state to the one up to ticks before the cursor and moves the
+    // cursor there; returns how many ticks it went (fewer at the oldest tick
+    // kept). Anything done to state since it was recorded or rewound to, such
+    // as a turn, is lost.
+    int rewind(Simulation<Rules>& state, int ticks);
+
+    // Ticks before the cursor that can still be rewound to
+    int getTicksAvailable() const { return static_cast<int>(cursor - oldest); }
+    // Ticks the game has been rewound by since it was last played on
+    int getTicksBack() const { return static_cast<int>(newest - cursor); }
+    int getMsAvailable() const { return frameOf(cursor).timeMs - frameOf(oldest).timeMs; }
+    int getMsBack() const { return frameOf(newest).timeMs - frameOf(cursor).timeMs; }
+    // Changed words in the pool now, of POOL_WORDS
+    int getPoolUsed() const { return oldest < newest ? static_cast<int>(poolEnd - frameOf(oldest + 1).firstChange) : 0; }
+    long long getRecords() const { return records; }
+    static size_t getMemoryBytes() { return sizeof(RewindBuffer); }
+};
+
+#endif
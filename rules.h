@@ -0,0 +1,105 @@
+#ifndef RULES_H
+#define RULES_H
+
+// Rule sets for the game engine.
+//
+// Every rule is a constexpr member of a policy struct, and the engine is
+// instantiated once per policy (see Simulation/BasicGame in game.h). Features a
+// mode turns off are removed at compile time through `if constexpr`, so a
+// simple mode pays nothing for the power-ups or obstacles it doesn't use.
+// New modes derive from an existing policy and override what they change.
+
+// The original game
+struct ClassicRules {
+    static constexpr const char* NAME = "classic";
+    static constexpr int ID = 0;                         // Stable number for logs and files
+
+    // Board
+    static constexpr bool WRAP_WALLS = false;            // Leaving the board comes back in on the other side
+    static constexpr bool SHIELD_PROTECTS_FROM_WALLS = false; // A shielded snake wraps instead of crashing
+    static constexpr bool MAZE = false;                  // Permanent maze walls
+    static constexpr int MAZE_LOOP_PERCENT = 25;
+
+    // Food
+    static constexpr int FOOD_COUNT = 1;                 // Apples kept on the board at all times
+    static constexpr int ITEM_CAPACITY = 16;             // Most items on the board at once
+    static constexpr int FOOD_SCORE = 10;
+
+    // Power-ups: special food, poison food and the shield
+    static constexpr bool POWER_UPS = true;
+    static constexpr int SPECIAL_FOOD_EVERY = 4;         // Special + poison food after every Nth apple
+    static constexpr int SPECIAL_FOOD_DURATION = 10;
+    static constexpr int POISON_FOOD_DURATION = 10;
+    static constexpr int SHIELD_DURATION = 10;           // Seconds the shield stays on the map
+    static constexpr int SHIELD_ACTIVE_DURATION = 10;    // Seconds of protection once picked up
+    static constexpr int SHIELD_SPAWN_INTERVAL = 45;
+
+    // Temporary obstacles
+    static constexpr bool OBSTACLES = true;
+    static constexpr int OBSTACLES_EVERY = 5;            // Obstacles after every Nth apple
+    static constexpr int OBSTACLE_COUNT = 7;
+    static constexpr int OBSTACLE_DURATION = 10;
+    static constexpr int MIN_FREE_REGION_PERCENT = 75;   // Obstacles may not cut the head off from more than this
+
+    // Speed control (ms per tick)
+    static constexpr int BASE_SPEED = 200;
+    static constexpr int MIN_SPEED = 75;
+    static constexpr int SPEED_DECREMENT = 9;
+};
+
+// Walls wrap around instead of killing
+struct WrapRules : ClassicRules {
+    static constexpr const char* NAME = "wrap";
+    static constexpr int ID = 1;
+    static constexpr bool WRAP_WALLS = true;
+};
+
+// Apples only
+struct NoPowerUpRules : ClassicRules {
+    static constexpr const char* NAME = "nopowerups";
+    static constexpr int ID = 2;
+    static constexpr bool POWER_UPS = false;
+    static constexpr bool OBSTACLES = false;
+};
+
+// Obstacles come often, in large numbers, and stay longer
+struct ObstacleHeavyRules : ClassicRules {
+    static constexpr const char* NAME = "obstacles";
+    static constexpr int ID = 3;
+    static constexpr int OBSTACLES_EVERY = 2;
+    static constexpr int OBSTACLE_COUNT = 40;
+    static constexpr int OBSTACLE_DURATION = 15;
+    static constexpr int MIN_FREE_REGION_PERCENT = 60;
+};
+
+// The board is kept stocked with apples
+struct FrenzyRules : ClassicRules {
+    static constexpr const char* NAME = "frenzy";
+    static constexpr int ID = 4;
+    static constexpr int FOOD_COUNT = 200;
+    static constexpr int ITEM_CAPACITY = 240;
+};
+
+// Permanent maze walls
+struct MazeRules : ClassicRules {
+    static constexpr const char* NAME = "maze";
+    static constexpr int ID = 5;
+    static constexpr bool MAZE = true;
+};
+
+// Endless world (see World in world.h). It has its own engine, so only the
+// name, id, scoring and speed here are used.
+struct EndlessRules : ClassicRules {
+    static constexpr const char* NAME = "endless";
+    static constexpr int ID = 6;
+};
+
+// Two-player versus over the network (see Versus in versus.h): the classic
+// board and apples, at a fixed speed so both sides tick at the same rate
+struct VersusRules : ClassicRules {
+    static constexpr const char* NAME = "versus";
+    static constexpr int ID = 7;
+    static constexpr int BASE_SPEED = 150;
+};
+
+#endif
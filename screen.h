@@ -2,6 +2,7 @@
 #define SCREEN_H
 
 #include <iostream>
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -29,29 +30,173 @@ extern string FOOD_EMOJI;
 extern string SPECIAL_FOOD_EMOJI;
 extern string POISON_FOOD_EMOJI; // New: Poison food emoji
 extern string SHIELD_EMOJI; // New: Shield power-up emoji
+extern string RIVAL_HEAD;  // The other snake in versus
+extern string RIVAL_BODY;
 extern string WALL;
 extern string EMPTY_SPACE;
 
 // Special food types
-extern vector<string> SPECIAL_FOODS;
-extern int currentSpecialFoodIndex;
+extern const vector<string> SPECIAL_FOODS;
+
+// How the board is drawn. Emoji cells are two columns wide; half-block cells
+// are one column and half a row, ASCII cells one column and one row.
+enum RenderMode : unsigned char {
+    RENDER_EMOJI = 0,
+    RENDER_HALF_BLOCK,      // Two board rows per line, 24-bit colour
+    RENDER_HALF_BLOCK_256,  // Same with the 256-colour palette
+    RENDER_ASCII,           // Plain characters, 16 colours
+    RENDER_MODE_COUNT
+};
+
+extern const char* const RENDER_MODE_NAMES[RENDER_MODE_COUNT];
+
+// What lies on a board cell, as far as drawing goes
+enum Glyph : unsigned char {
+    GLYPH_EMPTY = 0,
+    GLYPH_WALL,
+    GLYPH_BODY,
+    GLYPH_BODY_DEAD,
+    GLYPH_BODY_SHIELD,
+    GLYPH_HEAD,
+    GLYPH_HEAD_DEAD,
+    GLYPH_FOOD,
+    GLYPH_SPECIAL_FOOD,
+    GLYPH_POISON_FOOD,
+    GLYPH_SHIELD,
+    GLYPH_RIVAL_BODY,
+    GLYPH_RIVAL_HEAD,
+    GLYPH_COUNT
+};
+
+// Colours and characters of the glyphs for the compact renderers (and the
+// offline image renderer)
+struct GlyphStyle {
+    unsigned char red, green, blue;
+    unsigned char palette; // 256-colour index
+    unsigned char sgr;     // 16-colour foreground code
+    char ascii;
+};
+
+extern const GlyphStyle GLYPH_STYLES[GLYPH_COUNT];
+
+// How much of each frame goes to the terminal. The game steps down when the
+// terminal can't keep up and back up once it does.
+enum OutputLevel : unsigned char {
+    OUTPUT_FULL = 0,    // Whole frames
+    OUTPUT_DIFF,        // Only the lines that changed since the last frame sent
+    OUTPUT_REDUCED_HUD, // Changed lines, with a one-line stats panel
+    OUTPUT_LEVEL_COUNT
+};
+
+// Names for --output=
+extern const char* const OUTPUT_LEVEL_NAMES[OUTPUT_LEVEL_COUNT];
+
+struct OutputStats {
+    long long framesSent;
+    long long framesDropped; // Replaced by a newer frame before they could be sent
+    long long diffFrames;    // Sent as changed lines only
+    long long stalls;        // Times a frame found the terminal still busy
+    uint64_t stallNs;        // Time spent with output backed up
+    size_t maxQueuedBytes;   // Most bytes waiting, ours plus the terminal's queue
+    int levelChanges;
+};
 
 class Screen {
+public:
+    static const int DROPS_TO_STEP_DOWN = 3;      // Dropped frames (without a clean run between) before sending less
+    static const int CLEAN_FRAMES_TO_STEP_UP = 200;
+
 private:
     string screenBuffer;
+    RenderMode mode;
+    bool modeChanged; // The next draw clears the whole terminal first
+    size_t lastBoardBytes;
+    size_t lastFrameBytes;
+
+    // Non-blocking output (POSIX). A frame that can't go out at once waits
+    // in waitingFrame, and a newer one takes its place.
+    int outputFd;        // stdout, or a client's connection
+    bool nonBlocking;
+    int savedFlags;
+    string pending;      // Bytes of the frame being written
+    size_t pendingSent;
+    string waitingFrame;
+    bool frameWaiting;
+    string lastSent;     // Text of the last frame sent, to diff against
+    uint64_t stallStart; // 0 unless output is backed up
+    OutputLevel level;
+    int recentDrops;
+    int cleanFrames;
+    OutputStats stats;
+    bool reportMetrics; // Counts toward the process-wide Metrics
+    bool levelPinned;   // The level stays put whatever the terminal does
+
+    size_t terminalQueued() const;
+    void send(string& frame);
+    void writePending();
+    void noteDrop();
+    void setLevel(OutputLevel newLevel);
+
+    void addEmojiBoard(const Glyph* glyphs, int width, int height, const string& specialFood,
+                       const char* overlay, int overlayRow);
+    void addHalfBlockBoard(const Glyph* glyphs, int width, int height, const char* overlay, int overlayRow);
+    void addAsciiBoard(const Glyph* glyphs, int width, int height, const char* overlay, int overlayRow);
 
 public:
+    Screen();
+    ~Screen();
     void clear();
     void addToBuffer(const string& content);
-    void draw();
+    // Appends a width x height grid of glyphs (row by row) in the current
+    // render mode. overlay, if not null, is written across the middle of
+    // overlayRow. specialFood is the emoji for GLYPH_SPECIAL_FOOD.
+    void addBoard(const Glyph* glyphs, int width, int height, const string& specialFood,
+                  const char* overlay = nullptr, int overlayRow = 0);
+    // Sends the frame. Frames that may be dropped (not pause or game over
+    // screens) wait while the terminal is still behind on earlier ones.
+    void draw(bool droppable = true);
     void hideCursor();
     void showCursor();
+
+    void setRenderMode(RenderMode newMode);
+    RenderMode getRenderMode() const { return mode; }
+    size_t getLastBoardBytes() const { return lastBoardBytes; }
+    size_t getLastFrameBytes() const { return lastFrameBytes; }
+
+    // Frames go to fd (a connection) instead of stdout; call before startOutput()
+    void setOutputFd(int fd) { outputFd = fd; }
+    // Keeps this screen out of the process-wide Metrics, which only the game
+    // thread may write (a server's sessions draw on several threads)
+    void leaveOutOfMetrics() { reportMetrics = false; }
+    // Switches the output to non-blocking writes (POSIX); finishOutput() sends
+    // whatever is left and switches back, before anything else is printed
+    void startOutput();
+    void finishOutput();
+    // Forgets unsent output without waiting, for a connection about to close
+    void discardOutput();
+    // Writes more of a frame that didn't go out in one piece; call when
+    // stdout turns writable
+    void flushOutput();
+    bool hasPendingOutput() const { return pendingSent < pending.size(); }
+    OutputLevel getOutputLevel() const { return level; }
+    // Fixes the output level instead of following the terminal (from the
+    // first frame on, which always goes out whole)
+    void pinOutputLevel(OutputLevel newLevel);
+    // Board lines end in the default colours, so they can be sent on their own
+    bool hasSelfContainedLines() const { return level >= OUTPUT_DIFF; }
+    const OutputStats& getOutputStats() const { return stats; }
+    // Heap memory held by the frame buffers
+    size_t getBufferBytes() const {
+        return screenBuffer.capacity() + pending.capacity() + waitingFrame.capacity() + lastSent.capacity();
+    }
 };
 
 // Cross-platform console setup
 void setupConsole();
 
-// Function to load custom graphics from files
+// Loads custom graphics from files into the emoji strings above. Only the
+// first call reads the files; after that the strings are never written
+// again, so any number of games and threads can read them.
 bool loadCustomGraphics();
 
 #endif
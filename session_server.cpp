@@ -0,0 +1,286 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <random>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <csignal>
+#include "game.h"
+#include "event_loop.h"
+#include "session_server.h"
+#include "shared_state.h"
+
+#ifdef __linux__
+    #include <fcntl.h>
+    #include <netinet/in.h>
+    #include <sys/resource.h>
+    #include <sys/socket.h>
+    #include <sys/un.h>
+#endif
+
+using namespace std;
+
+// Hosts games for many players at once, and puts load on such a server.
+//
+// Usage: snake_server [--unix=<path>] [--port=<n>] [--threads=<n>] [--mode=<rules>]
+//                     [--tick=<ms>] [--max-sessions=<n>] [--render=emoji|halfblock|...]
+//        snake_server --load=<clients> [--duration=<s>] (--unix=<path> | --port=<n>)
+//
+// As a server it listens on the Unix socket (default snake.sock) and/or the
+// TCP port on 127.0.0.1, and prints a status line every few seconds until
+// Ctrl+C: sessions, ticks per second, how many ran late and by how much at
+// worst, frames dropped for slow clients, and memory per session. Play with
+//   socat -,raw,echo=0 UNIX-CONNECT:snake.sock
+// --tick runs every game at a fixed speed instead of speeding up as it grows.
+//
+// --load connects that many clients, each reading and throwing away its
+// frames and pressing a random direction about once a second, and reports
+// the data received and how evenly the frames arrived. Linux only.
+
+const int STATUS_INTERVAL_MS = 5000;
+const int DEFAULT_THREADS = 4;
+const int DEFAULT_MAX_SESSIONS = 10000;
+const int DEFAULT_LOAD_SECONDS = 30;
+
+template <class Rules>
+int serve(const ServerConfig& config) {
+    EventLoop loop; // Before the server's threads, so they leave the signals to it
+    SessionServer<Rules> server;
+    string error;
+    if (!server.start(config, error)) {
+        cerr << "Can't start the server: " << error << endl;
+        return 1;
+    }
+    cout << "Serving " << Rules::NAME << " games";
+    if (!config.unixPath.empty()) cout << " on " << config.unixPath;
+    if (config.tcpPort > 0) cout << " on 127.0.0.1:" << config.tcpPort;
+    cout << " with " << config.threads << " thread(s)"
+         << (config.tickMs > 0 ? ", every tick " + to_string(config.tickMs) + " ms" : "") << endl;
+
+    loop.setTickInterval(STATUS_INTERVAL_MS);
+    ServerStats last = server.getStats();
+    uint64_t lastNs = monotonicNs();
+    while (true) {
+        LoopEvents events = loop.wait();
+        if (events.quit) break;
+        if (events.ticks == 0) continue;
+
+        ServerStats stats = server.getStats();
+        uint64_t now = monotonicNs();
+        double seconds = (now - lastNs) / 1e9;
+        cout << fixed << setprecision(1) << "sessions " << stats.sessions << " (" << stats.sessionsTotal
+             << " total, " << stats.refused << " refused)  ticks/s " << (stats.ticks - last.ticks) / seconds
+             << "  late " << stats.lateTicks - last.lateTicks << "  worst " << stats.worstLatenessNs / 1e6
+             << " ms  dropped " << stats.framesDropped - last.framesDropped << "/"
+             << stats.framesSent + stats.framesDropped - last.framesSent - last.framesDropped << " frames";
+        if (stats.sessions > 0) cout << "  memory " << stats.sessionBytes / stats.sessions << " B/session";
+        cout << endl;
+        last = stats;
+        lastNs = now;
+    }
+
+    server.stop();
+    ServerStats stats = server.getStats();
+    cout << "\nServed " << stats.sessionsTotal << " sessions (" << stats.refused << " refused), "
+         << stats.gamesStarted << " games, " << stats.ticks << " ticks (" << stats.lateTicks << " over " << SessionServer<Rules>::LATE_MS << " ms late), "
+         << stats.framesSent << " frames sent, " << stats.framesDropped << " dropped. Session object: "
+         << SessionServer<Rules>::getSessionObjectSize() << " bytes" << endl;
+    return 0;
+}
+
+#ifdef __linux__
+struct LoadClient {
+    int fd;
+    uint64_t lastReadNs;
+    uint64_t nextKeyNs;
+};
+
+int openClient(const string& unixPath, int port) {
+    int fd;
+    if (!unixPath.empty()) {
+        sockaddr_un address;
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        strncpy(address.sun_path, unixPath.c_str(), sizeof(address.sun_path) - 1);
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd >= 0 && connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+            close(fd);
+            return -1;
+        }
+    } else {
+        sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_port = htons(static_cast<uint16_t>(port));
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd >= 0 && connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+            close(fd);
+            return -1;
+        }
+    }
+    if (fd >= 0) fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    return fd;
+}
+
+// Many players at once from one thread: an epoll set over every connection
+int runLoad(const string& unixPath, int port, int clientCount, int durationSeconds) {
+    rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+    signal(SIGPIPE, SIG_IGN); // Connections the server turned away fail with EPIPE
+    int epollFd = epoll_create1(EPOLL_CLOEXEC);
+    mt19937 rng(static_cast<uint32_t>(time(nullptr)));
+    uniform_int_distribution<int> keyDelayMs(500, 1500);
+    vector<LoadClient> clients;
+    clients.reserve(clientCount);
+    uint64_t now = monotonicNs();
+    for (int i = 0; i < clientCount; i++) {
+        int fd = openClient(unixPath, port);
+        if (fd < 0) {
+            cerr << "Connection " << i + 1 << " failed: " << strerror(errno) << endl;
+            break;
+        }
+        epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.u32 = static_cast<uint32_t>(clients.size());
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event);
+        clients.push_back(LoadClient{ fd, 0, now + static_cast<uint64_t>(keyDelayMs(rng)) * 1000000 });
+    }
+    cout << "Connected " << clients.size() << " clients, running " << durationSeconds << " s" << endl;
+
+    const char KEYS[] = "wasd";
+    vector<float> gapsMs; // Between a client's reads that brought data
+    gapsMs.reserve(1 << 20);
+    long long bytes = 0, keysSent = 0, closed = 0;
+    char buffer[65536];
+    epoll_event events[256];
+    uint64_t start = monotonicNs();
+    uint64_t end = start + static_cast<uint64_t>(durationSeconds) * 1000000000ULL;
+    uint64_t nextKeyRound = start;
+    while ((now = monotonicNs()) < end) {
+        int count = epoll_wait(epollFd, events, 256, 10);
+        now = monotonicNs();
+        for (int i = 0; i < count; i++) {
+            LoadClient& client = clients[events[i].data.u32];
+            ssize_t received;
+            bool gotData = false;
+            while ((received = read(client.fd, buffer, sizeof(buffer))) > 0) {
+                bytes += received;
+                gotData = true;
+            }
+            if (received == 0 || (received < 0 && errno != EAGAIN && errno != EINTR)) {
+                epoll_ctl(epollFd, EPOLL_CTL_DEL, client.fd, nullptr);
+                closed++;
+                continue;
+            }
+            if (gotData) {
+                if (client.lastReadNs != 0) gapsMs.push_back((now - client.lastReadNs) / 1e6f);
+                client.lastReadNs = now;
+            }
+        }
+        if (now >= nextKeyRound) {
+            for (LoadClient& client : clients) {
+                if (client.nextKeyNs > now) continue;
+                char key = KEYS[rng() % 4];
+                if (write(client.fd, &key, 1) == 1) keysSent++;
+                client.nextKeyNs = now + static_cast<uint64_t>(keyDelayMs(rng)) * 1000000;
+            }
+            nextKeyRound = now + 50000000; // Every 50 ms is close enough
+        }
+    }
+
+    double seconds = (monotonicNs() - start) / 1e9;
+    for (LoadClient& client : clients) close(client.fd);
+    close(epollFd);
+    sort(gapsMs.begin(), gapsMs.end());
+    double totalGap = 0;
+    for (float gap : gapsMs) totalGap += gap;
+    cout << fixed << setprecision(1) << "Received " << bytes / seconds / 1024 << " KB/s, " << keysSent
+         << " keys sent, " << closed << " connections closed by the server" << endl;
+    if (!gapsMs.empty()) {
+        cout << "Gap between frames: average " << totalGap / gapsMs.size() << " ms, median "
+             << gapsMs[gapsMs.size() / 2] << " ms, p99 " << gapsMs[gapsMs.size() * 99 / 100] << " ms, max "
+             << gapsMs.back() << " ms over " << gapsMs.size() << " gaps" << endl;
+    }
+    return 0;
+}
+#else
+int runLoad(const string&, int, int, int) {
+    cerr << "--load needs Linux" << endl;
+    return 1;
+}
+#endif
+
+int main(int argc, char* argv[]) {
+    ServerConfig config;
+    config.tcpPort = 0;
+    config.threads = DEFAULT_THREADS;
+    config.tickMs = 0;
+    config.maxSessions = DEFAULT_MAX_SESSIONS;
+    config.renderMode = RENDER_EMOJI;
+    string mode = ClassicRules::NAME;
+    int loadClients = 0;
+    int duration = DEFAULT_LOAD_SECONDS;
+    bool usage = false;
+    for (int i = 1; i < argc && !usage; i++) {
+        string arg = argv[i];
+        if (arg.rfind("--unix=", 0) == 0) {
+            config.unixPath = arg.substr(7);
+        } else if (arg.rfind("--port=", 0) == 0) {
+            config.tcpPort = atoi(arg.c_str() + 7);
+            usage = config.tcpPort <= 0 || config.tcpPort > 65535;
+        } else if (arg.rfind("--threads=", 0) == 0) {
+            config.threads = atoi(arg.c_str() + 10);
+            usage = config.threads <= 0;
+        } else if (arg.rfind("--mode=", 0) == 0) {
+            mode = arg.substr(7);
+        } else if (arg.rfind("--tick=", 0) == 0) {
+            config.tickMs = atoi(arg.c_str() + 7);
+            usage = config.tickMs <= 0;
+        } else if (arg.rfind("--max-sessions=", 0) == 0) {
+            config.maxSessions = atoi(arg.c_str() + 15);
+            usage = config.maxSessions <= 0;
+        } else if (arg.rfind("--render=", 0) == 0) {
+            int found = RENDER_MODE_COUNT;
+            for (int j = 0; j < RENDER_MODE_COUNT; j++) {
+                if (arg.substr(9) == RENDER_MODE_NAMES[j]) found = j;
+            }
+            usage = found == RENDER_MODE_COUNT;
+            if (!usage) config.renderMode = static_cast<RenderMode>(found);
+        } else if (arg.rfind("--load=", 0) == 0) {
+            loadClients = atoi(arg.c_str() + 7);
+            usage = loadClients <= 0;
+        } else if (arg.rfind("--duration=", 0) == 0) {
+            duration = atoi(arg.c_str() + 11);
+            usage = duration <= 0;
+        } else {
+            usage = true;
+        }
+    }
+    if (config.unixPath.empty() && config.tcpPort == 0) config.unixPath = "snake.sock";
+
+    int (*run)(const ServerConfig&) = nullptr;
+    if (mode == ClassicRules::NAME) run = serve<ClassicRules>;
+    else if (mode == WrapRules::NAME) run = serve<WrapRules>;
+    else if (mode == NoPowerUpRules::NAME) run = serve<NoPowerUpRules>;
+    else if (mode == ObstacleHeavyRules::NAME) run = serve<ObstacleHeavyRules>;
+    else if (mode == FrenzyRules::NAME) run = serve<FrenzyRules>;
+    else if (mode == MazeRules::NAME) run = serve<MazeRules>;
+    if (usage || !run) {
+        cout << "Usage: " << argv[0] << " [--unix=<path>] [--port=<n>] [--threads=<n>]"
+             << " [--mode=classic|wrap|nopowerups|obstacles|frenzy|maze]\n"
+             << "       [--tick=<ms>] [--max-sessions=<n>] [--render=emoji|halfblock|halfblock256|ascii]\n"
+             << "   or: " << argv[0] << " --load=<clients> [--duration=<s>] (--unix=<path> | --port=<n>)" << endl;
+        return 1;
+    }
+    if (loadClients > 0) {
+        return runLoad(config.tcpPort > 0 ? "" : config.unixPath, config.tcpPort, loadClients, duration);
+    }
+    return run(config);
+}
@@ -0,0 +1,153 @@
+#ifndef SESSION_SERVER_H
+#define SESSION_SERVER_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+#include "game.h"
+
+using namespace std;
+
+// Settings for a SessionServer
+struct ServerConfig {
+    string unixPath;       // Non-empty: listen on this Unix socket
+    int tcpPort;           // Positive: listen on this port on 127.0.0.1
+    int threads;           // Event-loop threads
+    int tickMs;            // Positive: every game ticks this often instead of at its own speed
+    int maxSessions;       // Connections past this get a "server full" line and are closed
+    RenderMode renderMode; // How new sessions are drawn (R switches, as in the game)
+};
+
+// Totals over the server's threads; the memory figures are refreshed about
+// once a second
+struct ServerStats {
+    long long sessions;      // Connected now
+    long long sessionsTotal; // Ever accepted
+    long long refused;       // Turned away because the server was full
+    long long gamesStarted;
+    long long ticks;
+    long long lateTicks;     // Ran more than LATE_MS after they were due
+    uint64_t worstLatenessNs;
+    long long framesSent;
+    long long framesDropped; // Replaced by a newer frame while the client was behind
+    size_t sessionBytes;     // Session objects plus their frame buffers
+};
+
+// Hosts single-player games for clients on a Unix or TCP socket. Every
+// connection gets its own game, drawn to it as terminal output and steered
+// by the bytes it sends, so a terminal in raw mode makes a client (e.g.
+// `socat -,raw,echo=0 UNIX-CONNECT:snake.sock`). After a game over any key
+// starts the next game; Q or closing the connection ends the session.
+//
+// A few event-loop threads share the listening sockets. Each keeps the
+// connections it accepts for good, so a session is only ever touched by one
+// thread and nothing is locked. A thread sleeps in epoll until one of its
+// connections has input, can take more output, or its earliest session
+// timer is due. Every session has its own tick deadline (games speed up as
+// they grow), kept in a per-thread heap, so a thread wakes once per due
+// session whatever the count. Frames go out through the session's Screen,
+// which writes without blocking and drops or diffs frames for a slow client
+// as it does for a slow terminal. Nothing the sessions share is written
+// after start(). Linux only (epoll); start() fails elsewhere.
+template <class Rules>
+class SessionServer {
+public:
+    static constexpr int LATE_MS = 5;           // A tick this late counts as late
+    static constexpr int MAX_EVENTS = 256;      // Per epoll_wait
+    static constexpr int INPUT_BUFFER_SIZE = 64;
+    static constexpr int MAX_QUEUED_TURNS = 2;
+
+private:
+    // One client: its game, keyboard and screen. Only its thread touches it.
+    struct Session {
+        Simulation<Rules> sim;
+        KeyDecoder keys;
+        Screen screen;
+        int fd;
+        bool paused;
+        bool writeWatched; // EPOLLOUT is on while a frame waits for the client
+        Direction queuedTurns[MAX_QUEUED_TURNS];
+        int queuedTurnCount;
+        bool turnedThisTick;
+        uint32_t timerSerial; // Bumped to cancel the timer in the heap
+
+        Session(int connection, uint32_t seed, RenderMode mode);
+    };
+
+    // A session's next tick. Entries of sessions that closed, paused or were
+    // rescheduled stay in the heap until they come up and are skipped.
+    struct Timer {
+        uint64_t dueNs;
+        int slot;
+        uint32_t generation; // Of the slot, which is reused after a close
+        uint32_t serial;
+        bool operator>(const Timer& other) const { return dueNs > other.dueNs; }
+    };
+
+    struct Worker {
+        int epollFd;
+        int wakeFd; // eventfd written by stop()
+        thread runner;
+        vector<unique_ptr<Session>> slots;
+        vector<uint32_t> generations;
+        vector<int> freeSlots;
+        priority_queue<Timer, vector<Timer>, greater<Timer>> timers;
+        uint64_t nextMemoryCheckNs;
+
+        atomic<long long> sessions;
+        atomic<long long> sessionsTotal;
+        atomic<long long> gamesStarted;
+        atomic<long long> ticks;
+        atomic<long long> lateTicks;
+        atomic<uint64_t> worstLatenessNs;
+        atomic<long long> framesSent;   // Of sessions that closed, plus live ones at the last check
+        atomic<long long> framesDropped;
+        atomic<size_t> sessionBytes;
+        long long closedFramesSent;     // Thread-local totals of closed sessions
+        long long closedFramesDropped;
+
+        Worker();
+    };
+
+    ServerConfig config;
+    int unixFd;
+    int tcpFd;
+    vector<unique_ptr<Worker>> workers;
+    atomic<long long> liveSessions; // Across the threads, for maxSessions
+    atomic<long long> refused;
+    atomic<uint32_t> seedCounter;
+    bool running;
+
+    void run(Worker& worker);
+    void accept(Worker& worker, int listenFd);
+    void close(Worker& worker, int slot);
+    void readInput(Worker& worker, int slot);
+    void tick(Worker& worker, int slot, uint64_t dueNs, uint64_t now);
+    void schedule(Worker& worker, int slot, uint64_t dueNs);
+    void flush(Worker& worker, int slot);
+    void draw(Session& session);
+    void turn(Session& session, Direction dir);
+    void newGame(Worker& worker, int slot);
+    void watchOutput(Worker& worker, int slot);
+    void checkMemory(Worker& worker);
+    int tickInterval(const Session& session) const;
+
+public:
+    SessionServer();
+    ~SessionServer();
+
+    // Opens the sockets and starts the threads; on failure returns false with a message in error
+    bool start(const ServerConfig& serverConfig, string& error);
+    // Closes every session and joins the threads
+    void stop();
+
+    ServerStats getStats() const;
+    // Bytes of one session object, before its frame buffers
+    static size_t getSessionObjectSize() { return sizeof(Session); }
+};
+
+#endif
@@ -0,0 +1,162 @@
+#ifndef SHARED_STATE_H
+#define SHARED_STATE_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include "game.h"
+
+using namespace std;
+
+// What lies on each board cell in a published snapshot
+enum BoardCode : unsigned char {
+    BOARD_EMPTY = 0,
+    BOARD_BODY,
+    BOARD_HEAD,
+    BOARD_OBSTACLE,
+    BOARD_MAZE_WALL,
+    BOARD_ITEM // BOARD_ITEM + ItemType for pick-ups
+};
+
+struct SharedItem {
+    Cell cell;
+    uint8_t type;      // ItemType
+    uint8_t unused;
+    int32_t expiresAt; // Game time in ms, NEVER_EXPIRES for permanent items
+};
+
+// One published tick. Readers copy it out under the seqlock (see StateSubscriber).
+struct SharedGameState {
+    static const int MAX_ITEMS = 255;
+
+    uint64_t tick;          // Simulation ticks so far
+    uint64_t publishedNs;   // steady_clock time of publication (CLOCK_MONOTONIC on Linux)
+    uint64_t stateHash;     // Simulation::getStateHash(), to check a mirror of the game is in step
+    int32_t timeMs;         // Game time
+    int32_t score;
+    int32_t speedMs;        // Current tick length
+    int32_t shieldRemainingMs;      // While the snake is shielded
+    int32_t shieldSpawnRemaining;   // Seconds until the next shield spawns, 0 if there is one
+    int32_t obstacleRemaining;      // Seconds until the obstacles vanish
+    uint8_t mode;           // Rules::ID
+    uint8_t direction;      // Direction
+    uint8_t gameOver;
+    uint8_t paused;
+    uint8_t deathCause;     // DeathCause
+    uint8_t unused[3];
+    int16_t length;
+    int16_t itemCount;
+    SharedItem items[MAX_ITEMS];
+    Cell body[Snake::CAPACITY]; // Head first
+    uint8_t board[HEIGHT][WIDTH]; // BoardCode per cell
+};
+
+// Direction request from a bot. STOP applies nothing and only gets
+// acknowledged, which is how round trips are measured.
+struct SharedCommand {
+    uint32_t id;
+    uint8_t direction;
+    uint8_t unused[3];
+    uint64_t sentNs;        // steady_clock time the bot sent it
+};
+
+// Layout of the shared-memory segment.
+//
+// The game is the only writer of `state`, guarded by a seqlock: `sequence` is
+// odd while a tick is being written and readers retry if it was odd or changed
+// while they copied, so the game never waits for a reader. Commands travel the
+// other way through a single-producer ring: the bot fills a slot, bumps
+// commandHead and writes a byte to the doorbell FIFO, which wakes the game's
+// event loop; the game bumps commandTail once a command is applied, which is
+// the acknowledgement. One bot at a time.
+struct SharedSegment {
+    static const uint32_t MAGIC = 0x534e4b53; // "SNKS"
+    static const uint32_t VERSION = 2;
+    static const uint32_t COMMAND_RING_SIZE = 64;
+
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;          // sizeof(SharedSegment)
+    atomic<uint32_t> live;  // Cleared when the game exits
+    atomic<uint32_t> sequence;
+    SharedGameState state;
+
+    alignas(64) atomic<uint32_t> commandHead; // Written by the bot
+    alignas(64) atomic<uint32_t> commandTail; // Written by the game
+    SharedCommand commands[COMMAND_RING_SIZE];
+};
+
+static_assert(atomic<uint32_t>::is_always_lock_free, "Shared counters must be lock-free to work across processes");
+
+// Game side: creates the segment (shm_open) and doorbell FIFO and publishes
+// straight into the mapping every tick, so nothing is copied on the way.
+// POSIX only; open() fails on Windows.
+class StatePublisher {
+private:
+    string segmentName;
+    string bellPath;
+    SharedSegment* segment;
+    int bellFd;
+    int bellKeepAliveFd; // Our own writer, so the FIFO never reports end of file
+    long long commandsTaken;
+    long long commandLatencyNs; // Summed from send to apply
+    long long maxCommandLatencyNs;
+
+public:
+    StatePublisher();
+    ~StatePublisher();
+
+    // name is a shm_open() name such as "/snake_byte"
+    bool open(const string& name);
+    bool isOpen() const { return segment != nullptr; }
+    // Readable when a bot has sent commands; watch it in the event loop
+    int getDoorbellFd() const { return bellFd; }
+
+    template <class Rules>
+    void publish(const Simulation<Rules>& sim, bool paused);
+
+    // Empties the doorbell and the ring, writes up to capacity directions
+    // (STOP pings excluded) and returns how many
+    int takeCommands(Direction* directions, int capacity);
+
+    long long getCommandsTaken() const { return commandsTaken; }
+    double getAverageCommandLatencyUs() const;
+    double getMaxCommandLatencyUs() const { return maxCommandLatencyNs / 1000.0; }
+};
+
+// Bot and viewer side of the segment
+class StateSubscriber {
+public:
+    static const int SPIN_READS = 64;          // Tries with a CPU pause before yielding between them
+    static const int WRITE_TIMEOUT_MS = 100;   // A write open this long means the game died in it
+
+private:
+    SharedSegment* segment;
+    int bellFd;
+
+public:
+    StateSubscriber();
+    ~StateSubscriber();
+
+    bool open(const string& name);
+    // Copies the latest consistent snapshot; false once the game has gone,
+    // or if it stopped halfway through a write (crashed) and never finished
+    bool read(SharedGameState& state) const;
+    // Cheap check for a new tick: the seqlock counter, even when stable
+    uint32_t getSequence() const { return segment->sequence.load(memory_order_acquire); }
+    bool isLive() const { return segment->live.load(memory_order_acquire) != 0; }
+
+    // Queues a direction (STOP for a ping) and returns its id, 0 if the ring is full
+    uint32_t send(Direction direction);
+    // True once the game has taken the command with this id
+    bool isApplied(uint32_t id) const;
+};
+
+// Fills a snapshot from a game (what publish() writes into the segment)
+template <class Rules>
+void fillSharedState(const Simulation<Rules>& sim, bool paused, SharedGameState& state);
+
+// steady_clock in nanoseconds, comparable between processes on the same machine
+uint64_t monotonicNs();
+
+#endif
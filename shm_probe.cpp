@@ -0,0 +1,112 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <chrono>
+#include "shared_state.h"
+
+using namespace std;
+
+// Reader for the state a game started with --share publishes.
+//
+// Usage: snake_probe [--latency[=<pings>]] [shm name]
+//
+// By default it follows the game and prints one line per tick with how long
+// the snapshot took to arrive. --latency sends pings through the command ring
+// instead and reports the round trip: send, the game's event loop wakes and
+// takes the command, the acknowledgement is seen here.
+
+const char* const DEFAULT_SHARE_NAME = "/snake_byte";
+const uint64_t PING_TIMEOUT_NS = 1000000000; // A ping not taken in a second: the game is stuck or gone
+
+int follow(StateSubscriber& subscriber) {
+    SharedGameState state;
+    uint32_t lastSequence = 0;
+    uint64_t lastTick = ~0ULL;
+    while (subscriber.isLive()) {
+        uint32_t sequence = subscriber.getSequence();
+        if (sequence == lastSequence) {
+            this_thread::sleep_for(chrono::microseconds(200));
+            continue;
+        }
+        lastSequence = sequence;
+        if (!subscriber.read(state)) break; // Gone, or died in the middle of a write
+        if (state.tick == lastTick) continue; // Only the pause flag changed
+        lastTick = state.tick;
+
+        uint64_t age = monotonicNs() - state.publishedNs;
+        cout << "tick " << setw(6) << state.tick << "  score " << setw(5) << state.score
+             << "  length " << setw(4) << state.length << "  items " << setw(3) << state.itemCount
+             << "  head " << setw(2) << (int)state.body[0].x << "," << setw(2) << (int)state.body[0].y
+             << "  hash " << hex << setw(16) << setfill('0') << state.stateHash << dec << setfill(' ')
+             << "  seen after " << fixed << setprecision(1) << age / 1000.0 << " us" << endl;
+        if (state.gameOver) break;
+    }
+    cout << "Game has ended" << endl;
+    return 0;
+}
+
+int measureLatency(StateSubscriber& subscriber, int pings) {
+    vector<double> roundTrips;
+    roundTrips.reserve(pings);
+    for (int i = 0; i < pings && subscriber.isLive(); i++) {
+        uint64_t start = monotonicNs();
+        uint32_t id = subscriber.send(STOP);
+        if (id == 0) {
+            this_thread::sleep_for(chrono::milliseconds(1));
+            continue;
+        }
+        while (!subscriber.isApplied(id) && subscriber.isLive() && monotonicNs() - start < PING_TIMEOUT_NS) {}
+        if (!subscriber.isApplied(id)) break; // The game stopped taking commands
+        roundTrips.push_back((monotonicNs() - start) / 1000.0);
+    }
+    if (roundTrips.empty()) {
+        cerr << "No pings came back" << endl;
+        return 1;
+    }
+
+    sort(roundTrips.begin(), roundTrips.end());
+    auto percentile = [&](double fraction) { return roundTrips[static_cast<size_t>(fraction * (roundTrips.size() - 1))]; };
+    cout << roundTrips.size() << " pings, round trip in us: min " << fixed << setprecision(1) << roundTrips.front()
+         << ", p50 " << percentile(0.5) << ", p99 " << percentile(0.99) << ", max " << roundTrips.back() << endl;
+
+    // Cost of taking a consistent snapshot on this side
+    SharedGameState state;
+    const int reads = 10000;
+    uint64_t start = monotonicNs();
+    for (int i = 0; i < reads && subscriber.read(state); i++) {}
+    cout << "snapshot read: " << setprecision(2) << (monotonicNs() - start) / 1000.0 / reads << " us ("
+         << sizeof(SharedGameState) << " bytes)" << endl;
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    string name = DEFAULT_SHARE_NAME;
+    int pings = 0;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--latency") {
+            pings = 1000;
+        } else if (arg.rfind("--latency=", 0) == 0) {
+            pings = atoi(arg.c_str() + 10);
+        } else if (arg[0] == '/') {
+            name = arg;
+        } else {
+            pings = -1;
+            break;
+        }
+    }
+    if (pings < 0) {
+        cout << "Usage: " << argv[0] << " [--latency[=<pings>]] [shm name, default " << DEFAULT_SHARE_NAME << "]" << endl;
+        return 1;
+    }
+
+    StateSubscriber subscriber;
+    if (!subscriber.open(name)) {
+        cerr << "No game is sharing " << name << " (start one with --share)" << endl;
+        return 1;
+    }
+    return pings > 0 ? measureLatency(subscriber, pings) : follow(subscriber);
+}
@@ -0,0 +1,93 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <atomic>
+#include "background_io.h"
+
+using namespace std;
+
+// Summary of one finished game
+struct SessionRecord {
+    uint32_t startTime;        // Unix time the game started
+    uint8_t mode;              // Rules::ID
+    uint8_t deathCause;        // DeathCause, DEATH_NONE if the player quit
+    uint8_t flags;             // SESSION_* bits
+    uint8_t finalSpeed;        // Tick length in ms at the end (the speed tier reached)
+    int32_t score;
+    uint16_t length;
+    uint16_t foodEaten;
+    uint16_t specialFoodEaten;
+    uint16_t poisonFoodEaten;
+    uint16_t shieldsCollected;
+    uint32_t ticks;
+    uint32_t gameTimeMs;
+};
+
+const uint8_t SESSION_AUTOPILOT = 1; // Played by the autopilot
+const uint8_t SESSION_PRACTICE = 2;  // Played with the rewind key (--practice)
+
+// Columns of the log, in file order
+enum TelemetryColumn {
+    COL_START_TIME = 0, COL_MODE, COL_DEATH_CAUSE, COL_FLAGS, COL_FINAL_SPEED, COL_SCORE, COL_LENGTH,
+    COL_FOOD, COL_SPECIAL_FOOD, COL_POISON_FOOD, COL_SHIELDS, COL_TICKS, COL_GAME_TIME, COLUMN_COUNT
+};
+
+extern const int TELEMETRY_COLUMN_WIDTHS[COLUMN_COUNT]; // Bytes per value
+extern const char* const TELEMETRY_COLUMN_NAMES[COLUMN_COUNT];
+
+// Telemetry log format.
+//
+// The log is a sequence of self-contained blocks, each appended with a single
+// write() to a file opened for appending, so concurrent game processes never
+// interleave their data. A block is this header followed by one array per
+// column in column order, each padded to a multiple of 8 bytes, values in
+// little-endian order. The game appends one-row blocks; snake_stats --compact
+// rewrites a log into blocks of up to TELEMETRY_BLOCK_ROWS rows.
+struct TelemetryBlockHeader {
+    char magic[4];        // TELEMETRY_MAGIC
+    uint16_t version;
+    uint16_t columnCount;
+    uint32_t rowCount;
+    uint32_t byteSize;    // Whole block, header included
+};
+
+const char TELEMETRY_MAGIC[4] = { 'S', 'N', 'K', 'T' };
+const uint16_t TELEMETRY_VERSION = 1;
+const uint32_t TELEMETRY_BLOCK_ROWS = 65536;
+
+// Size of a block holding rowCount rows, and where a column starts inside it
+size_t telemetryBlockSize(uint32_t rowCount);
+size_t telemetryColumnOffset(uint32_t rowCount, int column);
+// Appends one block holding the given records to out
+void encodeTelemetryBlock(const SessionRecord* records, uint32_t count, vector<char>& out);
+// Reads row `row` back out of an encoded block
+void decodeTelemetryRow(const char* block, uint32_t rowCount, uint32_t row, SessionRecord& record);
+// Checks a block header found at data[offset] against the end of the data
+bool isValidTelemetryBlock(const char* data, size_t size, size_t offset);
+
+// Appends session records to a telemetry log through the background I/O
+// thread, so the game never waits for the disk. The destructor waits for
+// everything appended to be written.
+class TelemetryWriter {
+private:
+    string path;
+    BackgroundIO& io;
+    atomic<long long> written;
+    atomic<long long> failures;
+
+public:
+    TelemetryWriter(const string& logPath, BackgroundIO& backgroundIO);
+    ~TelemetryWriter();
+
+    // Queues the record and returns straight away
+    void append(const SessionRecord& record);
+
+    long long getWritten() const { return written.load(memory_order_relaxed); }
+    long long getFailures() const { return failures.load(memory_order_relaxed); }
+};
+
+#endif
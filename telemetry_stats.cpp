@@ -0,0 +1,378 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <cstring>
+#include "game.h"
+#include "telemetry.h"
+
+#ifndef _WIN32
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+#endif
+
+using namespace std;
+
+// Offline analyzer for the telemetry log the game writes (telemetry.snk).
+//
+// The log is mapped into memory, the block headers are scanned once, and the
+// blocks are split across one thread per core. Each thread walks only the
+// columns a statistic needs, a whole column array at a time, into its own
+// totals, which are added up at the end.
+//
+// Usage: snake_stats [log file]
+//        snake_stats --compact <log file> <output file>
+//
+// --compact rewrites a log of many small blocks (one per game) into blocks of
+// up to TELEMETRY_BLOCK_ROWS rows, which scan faster.
+
+const int MODE_COUNT = 8;
+const char* const MODE_NAMES[MODE_COUNT] = {
+    ClassicRules::NAME, WrapRules::NAME, NoPowerUpRules::NAME,
+    ObstacleHeavyRules::NAME, FrenzyRules::NAME, MazeRules::NAME, EndlessRules::NAME,
+    VersusRules::NAME
+};
+const char* const DEATH_NAMES[] = { "quit", "wall", "self", "obstacle", "rival" };
+const int DEATH_CAUSES = sizeof(DEATH_NAMES) / sizeof(DEATH_NAMES[0]);
+
+const int SCORE_BUCKET = 10;      // Points per histogram bucket
+const int SCORE_BUCKETS = 4096;   // The last one also holds everything above
+const int POISON_BUCKETS = 16;    // Games with 0..15+ poison foods eaten
+
+struct Totals {
+    long long sessions;
+    long long autopilot;
+    long long practice;
+    long long scoreSum;
+    long long maxScore;
+    long long ticks;
+    long long gameTimeMs;
+    long long shieldUsers;   // Games where at least one shield was picked up
+    long long shields;
+    long long poison;
+    long long deaths[DEATH_CAUSES];
+    long long modes[MODE_COUNT + 1]; // The last one counts unknown modes
+    long long speeds[256];           // By final tick length in ms
+    long long poisonGames[POISON_BUCKETS];
+    long long scores[SCORE_BUCKETS];
+
+    void add(const Totals& other) {
+        sessions += other.sessions;
+        autopilot += other.autopilot;
+        practice += other.practice;
+        scoreSum += other.scoreSum;
+        maxScore = max(maxScore, other.maxScore);
+        ticks += other.ticks;
+        gameTimeMs += other.gameTimeMs;
+        shieldUsers += other.shieldUsers;
+        shields += other.shields;
+        poison += other.poison;
+        for (int i = 0; i < DEATH_CAUSES; i++) deaths[i] += other.deaths[i];
+        for (int i = 0; i <= MODE_COUNT; i++) modes[i] += other.modes[i];
+        for (int i = 0; i < 256; i++) speeds[i] += other.speeds[i];
+        for (int i = 0; i < POISON_BUCKETS; i++) poisonGames[i] += other.poisonGames[i];
+        for (int i = 0; i < SCORE_BUCKETS; i++) scores[i] += other.scores[i];
+    }
+};
+
+// Column values are stored packed and little-endian, so they are copied out
+template <class T>
+T columnValue(const char* column, uint32_t row) {
+    T value;
+    memcpy(&value, column + static_cast<size_t>(row) * sizeof(T), sizeof(T));
+    return value;
+}
+
+void aggregateBlock(const char* block, Totals& totals) {
+    TelemetryBlockHeader header;
+    memcpy(&header, block, sizeof(header));
+    uint32_t rows = header.rowCount;
+    auto column = [&](int index) { return block + telemetryColumnOffset(rows, index); };
+
+    totals.sessions += rows;
+
+    const char* scores = column(COL_SCORE);
+    for (uint32_t row = 0; row < rows; row++) {
+        int32_t score = columnValue<int32_t>(scores, row);
+        totals.scoreSum += score;
+        totals.maxScore = max<long long>(totals.maxScore, score);
+        int bucket = score < 0 ? 0 : min(score / SCORE_BUCKET, SCORE_BUCKETS - 1);
+        totals.scores[bucket]++;
+    }
+
+    const char* modes = column(COL_MODE);
+    const char* deaths = column(COL_DEATH_CAUSE);
+    const char* flags = column(COL_FLAGS);
+    const char* speeds = column(COL_FINAL_SPEED);
+    for (uint32_t row = 0; row < rows; row++) {
+        totals.modes[min<int>(columnValue<uint8_t>(modes, row), MODE_COUNT)]++;
+        totals.deaths[min<int>(columnValue<uint8_t>(deaths, row), DEATH_CAUSES - 1)]++;
+        totals.autopilot += columnValue<uint8_t>(flags, row) & SESSION_AUTOPILOT;
+        totals.practice += (columnValue<uint8_t>(flags, row) & SESSION_PRACTICE) != 0;
+        totals.speeds[columnValue<uint8_t>(speeds, row)]++;
+    }
+
+    const char* shields = column(COL_SHIELDS);
+    const char* poison = column(COL_POISON_FOOD);
+    for (uint32_t row = 0; row < rows; row++) {
+        uint16_t collected = columnValue<uint16_t>(shields, row);
+        totals.shields += collected;
+        totals.shieldUsers += collected > 0;
+        uint16_t eaten = columnValue<uint16_t>(poison, row);
+        totals.poison += eaten;
+        totals.poisonGames[min<int>(eaten, POISON_BUCKETS - 1)]++;
+    }
+
+    const char* ticks = column(COL_TICKS);
+    const char* gameTime = column(COL_GAME_TIME);
+    for (uint32_t row = 0; row < rows; row++) {
+        totals.ticks += columnValue<uint32_t>(ticks, row);
+        totals.gameTimeMs += columnValue<uint32_t>(gameTime, row);
+    }
+}
+
+// A log file held in memory: mapped on POSIX, read in on Windows
+class LogData {
+private:
+    const char* data;
+    size_t size;
+    vector<char> buffer;
+#ifndef _WIN32
+    void* mapping;
+#endif
+
+public:
+    LogData() : data(nullptr), size(0) {
+#ifndef _WIN32
+        mapping = nullptr;
+#endif
+    }
+
+    ~LogData() {
+#ifndef _WIN32
+        if (mapping) munmap(mapping, size);
+#endif
+    }
+
+    bool open(const string& path) {
+#ifdef _WIN32
+        ifstream file(path, ios::binary);
+        if (!file) return false;
+        buffer.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+        data = buffer.data();
+        size = buffer.size();
+        return true;
+#else
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return false;
+        struct stat info;
+        bool ok = fstat(fd, &info) == 0;
+        size = ok ? static_cast<size_t>(info.st_size) : 0;
+        if (ok && size > 0) {
+            mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapping == MAP_FAILED) {
+                mapping = nullptr;
+                ok = false;
+            } else {
+                madvise(mapping, size, MADV_SEQUENTIAL);
+                data = static_cast<const char*>(mapping);
+            }
+        }
+        close(fd);
+        return ok;
+#endif
+    }
+
+    const char* getData() const { return data; }
+    size_t getSize() const { return size; }
+};
+
+// Offsets of the blocks in the log. A torn or foreign tail ends the scan.
+vector<size_t> findBlocks(const LogData& log, long long& rows, size_t& validBytes) {
+    vector<size_t> blocks;
+    size_t offset = 0;
+    rows = 0;
+    while (isValidTelemetryBlock(log.getData(), log.getSize(), offset)) {
+        TelemetryBlockHeader header;
+        memcpy(&header, log.getData() + offset, sizeof(header));
+        blocks.push_back(offset);
+        rows += header.rowCount;
+        offset += header.byteSize;
+    }
+    validBytes = offset;
+    return blocks;
+}
+
+// Score below which the given fraction of games ended, to a bucket's precision
+long long scorePercentile(const Totals& totals, double fraction) {
+    long long wanted = static_cast<long long>(fraction * totals.sessions);
+    long long seen = 0;
+    for (int bucket = 0; bucket < SCORE_BUCKETS; bucket++) {
+        seen += totals.scores[bucket];
+        if (seen > wanted) return (long long)bucket * SCORE_BUCKET;
+    }
+    return totals.maxScore;
+}
+
+void printReport(const Totals& totals) {
+    double sessions = max<long long>(totals.sessions, 1);
+    cout << fixed << setprecision(1);
+    cout << "Sessions: " << totals.sessions << " (" << totals.autopilot << " by the autopilot, " << totals.practice
+         << " in practice)" << endl;
+    cout << "Score: avg " << totals.scoreSum / sessions << ", max " << totals.maxScore
+         << ", p50 " << scorePercentile(totals, 0.5) << ", p90 " << scorePercentile(totals, 0.9)
+         << ", p99 " << scorePercentile(totals, 0.99) << endl;
+    cout << "Length of a game: avg " << totals.ticks / sessions << " ticks, "
+         << totals.gameTimeMs / sessions / 1000.0 << " s of game time" << endl;
+
+    cout << "Modes:";
+    for (int mode = 0; mode <= MODE_COUNT; mode++) {
+        if (totals.modes[mode] == 0) continue;
+        cout << " " << (mode < MODE_COUNT ? MODE_NAMES[mode] : "unknown") << " "
+             << 100.0 * totals.modes[mode] / sessions << "%";
+    }
+    cout << endl;
+
+    cout << "Ended by:";
+    for (int cause = 0; cause < DEATH_CAUSES; cause++) {
+        cout << " " << DEATH_NAMES[cause] << " " << 100.0 * totals.deaths[cause] / sessions << "%";
+    }
+    cout << endl;
+
+    cout << "Shields: picked up in " << 100.0 * totals.shieldUsers / sessions << "% of games, "
+         << totals.shields / sessions << " per game" << endl;
+    cout << "Poison: " << totals.poison / sessions << " eaten per game, games by count:";
+    for (int count = 0; count < POISON_BUCKETS; count++) {
+        if (totals.poisonGames[count] == 0) continue;
+        cout << " " << count << (count == POISON_BUCKETS - 1 ? "+" : "") << ": " << totals.poisonGames[count];
+    }
+    cout << endl;
+
+    // Fastest tier first; the tick gets shorter as the snake grows
+    cout << "Speed tier reached (tick ms):";
+    for (int speed = 0; speed < 256; speed++) {
+        if (totals.speeds[speed] == 0) continue;
+        cout << " " << speed << ": " << 100.0 * totals.speeds[speed] / sessions << "%";
+    }
+    cout << endl;
+}
+
+int analyze(const string& path) {
+    LogData log;
+    if (!log.open(path)) {
+        cerr << "Can't read " << path << endl;
+        return 1;
+    }
+
+    auto start = chrono::steady_clock::now();
+    long long rows = 0;
+    size_t validBytes = 0;
+    vector<size_t> blocks = findBlocks(log, rows, validBytes);
+    if (validBytes < log.getSize()) {
+        cerr << "Warning: ignoring " << log.getSize() - validBytes << " unreadable bytes at the end of " << path << endl;
+    }
+
+    // Split the blocks into runs of about the same number of rows
+    int threadCount = max(1, static_cast<int>(thread::hardware_concurrency()));
+    threadCount = static_cast<int>(min<size_t>(threadCount, max<size_t>(blocks.size(), 1)));
+    vector<size_t> firstBlock(threadCount + 1, blocks.size());
+    firstBlock[0] = 0;
+    long long rowsSoFar = 0;
+    int part = 1;
+    for (size_t i = 0; i < blocks.size() && part < threadCount; i++) {
+        if (rowsSoFar >= rows * part / threadCount) firstBlock[part++] = i;
+        TelemetryBlockHeader header;
+        memcpy(&header, log.getData() + blocks[i], sizeof(header));
+        rowsSoFar += header.rowCount;
+    }
+    for (; part < threadCount; part++) firstBlock[part] = blocks.size();
+
+    // Totals are large, so they live on the heap, one per thread
+    vector<Totals> partial(threadCount, Totals());
+    vector<thread> threads;
+    for (int t = 0; t < threadCount; t++) {
+        threads.emplace_back([&, t] {
+            for (size_t i = firstBlock[t]; i < firstBlock[t + 1]; i++) {
+                aggregateBlock(log.getData() + blocks[i], partial[t]);
+            }
+        });
+    }
+    for (thread& worker : threads) {
+        worker.join();
+    }
+
+    Totals totals = Totals();
+    for (const Totals& part : partial) {
+        totals.add(part);
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    printReport(totals);
+    cout << "Scanned " << blocks.size() << " blocks, " << validBytes / (1024.0 * 1024.0) << " MiB on "
+         << threadCount << " threads in " << setprecision(3) << seconds * 1000 << " ms ("
+         << setprecision(0) << totals.sessions / max(seconds, 1e-9) << " sessions/s)" << endl;
+    return 0;
+}
+
+int compact(const string& inPath, const string& outPath) {
+    LogData log;
+    if (!log.open(inPath)) {
+        cerr << "Can't read " << inPath << endl;
+        return 1;
+    }
+    long long rows = 0;
+    size_t validBytes = 0;
+    vector<size_t> blocks = findBlocks(log, rows, validBytes);
+
+    ofstream out(outPath, ios::binary | ios::trunc);
+    if (!out) {
+        cerr << "Can't write " << outPath << endl;
+        return 1;
+    }
+
+    vector<SessionRecord> pending;
+    vector<char> encoded;
+    auto flush = [&] {
+        encoded.clear();
+        encodeTelemetryBlock(pending.data(), static_cast<uint32_t>(pending.size()), encoded);
+        out.write(encoded.data(), encoded.size());
+        pending.clear();
+    };
+    for (size_t offset : blocks) {
+        TelemetryBlockHeader header;
+        memcpy(&header, log.getData() + offset, sizeof(header));
+        for (uint32_t row = 0; row < header.rowCount; row++) {
+            SessionRecord record;
+            decodeTelemetryRow(log.getData() + offset, header.rowCount, row, record);
+            pending.push_back(record);
+            if (pending.size() == TELEMETRY_BLOCK_ROWS) flush();
+        }
+    }
+    if (!pending.empty()) flush();
+
+    if (!out.flush()) {
+        cerr << "Can't write " << outPath << endl;
+        return 1;
+    }
+    cout << "Compacted " << rows << " sessions from " << blocks.size() << " blocks into "
+         << (rows + TELEMETRY_BLOCK_ROWS - 1) / TELEMETRY_BLOCK_ROWS << endl;
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc == 4 && string(argv[1]) == "--compact") {
+        return compact(argv[2], argv[3]);
+    }
+    if (argc > 2 || (argc == 2 && argv[1][0] == '-')) {
+        cout << "Usage: " << argv[0] << " [log file]\n"
+             << "       " << argv[0] << " --compact <log file> <output file>" << endl;
+        return 1;
+    }
+    return analyze(argc == 2 ? argv[1] : "telemetry.snk");
+}
@@ -0,0 +1,236 @@
+#ifndef VERSUS_H
+#define VERSUS_H
+
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include "game.h"
+
+#ifndef _WIN32
+    #include <netinet/in.h>
+#endif
+
+using namespace std;
+
+// Two snakes on the classic board, one apple at a time. The first to hit a
+// wall, itself or the other snake loses; heads meeting kill both (a draw).
+//
+// Plain fixed-size data like Simulation, so saving and restoring a state is
+// one memcpy of a few KB, which is what rollback needs.
+class Versus {
+public:
+    static const int PLAYERS = 2;
+
+private:
+    Snake snakes[PLAYERS];
+    Cell food;
+    FastRandom rng;
+    int tickCount;
+    int scores[PLAYERS];
+    DeathCause deaths[PLAYERS]; // DEATH_NONE while alive
+    bool over;
+
+    void placeFood();
+
+public:
+    // The default seed is for arrays of snapshots, which get overwritten
+    explicit Versus(uint32_t seed = 1);
+
+    // Plays one tick with a direction for each player; STOP keeps going
+    void update(const Direction inputs[PLAYERS]);
+
+    const Snake& getSnake(int player) const { return snakes[player]; }
+    Cell getFood() const { return food; }
+    int getScore(int player) const { return scores[player]; }
+    DeathCause getDeathCause(int player) const { return deaths[player]; }
+    bool isAlive(int player) const { return deaths[player] == DEATH_NONE; }
+    int getTickCount() const { return tickCount; }
+    bool isOver() const { return over; }
+    // The player left alive, or -1 for a draw (or while the game goes on)
+    int getWinner() const;
+    int getGameSpeed() const { return VersusRules::BASE_SPEED; }
+    uint64_t getStateHash() const;
+    // Telemetry row for one player; startTime and flags are left for the caller
+    SessionRecord getSessionRecord(int player) const;
+};
+
+static_assert(is_trivially_copyable<Versus>::value, "Versus states are saved and restored with memcpy");
+
+// Rollback netcode for one side of a versus game.
+//
+// Every tick plays at once with the local input and a guess for the remote
+// one: STOP, the remote snake keeps going, which is right on most ticks.
+// The state before each tick is kept, with the inputs it was played with.
+// When a remote input arrives that differs from the guess, reconcile()
+// restores the state before that tick and plays the ticks since then again
+// with what is now known, all before the next frame is drawn. The game never
+// runs more than MAX_ROLLBACK ticks past the last tick whose remote input is
+// known, so a rollback replays at most that many ticks; past that advance()
+// has to wait (canAdvance() is false).
+//
+// No I/O here: the caller moves inputs over the network (see VersusLink).
+class RollbackSession {
+public:
+    static const int MAX_ROLLBACK = 8;
+    static const int HISTORY = 32; // Ticks of states and inputs kept, a power of two
+    static const int NO_ROLLBACK = 0x7fffffff;
+
+private:
+    // Everything that needs saving or may be sent on is inside the window
+    static_assert(HISTORY >= 2 * MAX_ROLLBACK + 1 && (HISTORY & (HISTORY - 1)) == 0, "Bad history size");
+
+    Versus state;                 // Before tick `tick`
+    Versus saved[HISTORY];        // State before tick t at [t % HISTORY]
+    Direction inputs[HISTORY][Versus::PLAYERS]; // Inputs tick t was played with
+    int remoteTick[HISTORY];      // Tick whose remote input is at the slot, -1 if none yet
+    int localPlayer;
+    int tick;                     // Next tick to play
+    int remoteConfirmed;          // The remote input of every tick before this is known
+    int rollbackFrom;             // Earliest tick played with a wrong guess, NO_ROLLBACK if none
+
+    long long rollbacks;
+    long long ticksReplayed;
+    int deepestRollback;
+    uint64_t slowestRollbackNs;
+    uint64_t totalRollbackNs;
+    long long stalls;
+
+    void play(int slot);
+
+public:
+    RollbackSession(uint32_t seed, int local);
+
+    bool canAdvance() const { return tick < remoteConfirmed + MAX_ROLLBACK; }
+    // Plays the next tick with the local input and a guess for the remote one
+    void advance(Direction localInput);
+    // The remote player's input for a tick; in any order, repeats are ignored
+    void receiveRemote(int forTick, Direction input);
+    // Replays from the first wrong guess, if any; returns the ticks replayed
+    int reconcile();
+    // Counts a tick the caller had to skip because canAdvance() was false
+    void noteStall() { stalls++; }
+
+    const Versus& getState() const { return state; }
+    int getLocalPlayer() const { return localPlayer; }
+    int getTick() const { return tick; }
+    // Every tick before this was played with both real inputs
+    int getConfirmedTick() const { return min(tick, remoteConfirmed); }
+    // Over, and no late input can change how
+    bool isSettled() const { return state.isOver() && remoteConfirmed >= state.getTickCount(); }
+    // The local input of a recent tick, for sending
+    Direction getLocalInput(int forTick) const { return inputs[forTick & (HISTORY - 1)][localPlayer]; }
+    // Hash of the state before a confirmed tick still in the history (see
+    // getConfirmedTick), to compare with the other side; false if unknown
+    bool getConfirmedHash(int beforeTick, uint64_t& hash) const;
+
+    long long getRollbacks() const { return rollbacks; }
+    long long getTicksReplayed() const { return ticksReplayed; }
+    int getDeepestRollback() const { return deepestRollback; }
+    uint64_t getSlowestRollbackNs() const { return slowestRollbackNs; }
+    uint64_t getAverageRollbackNs() const { return rollbacks ? totalRollbackNs / rollbacks : 0; }
+    long long getStalls() const { return stalls; }
+};
+
+// Versus datagrams. Both sides must have the same byte order.
+enum VersusPacketType : uint8_t {
+    PACKET_HELLO = 0, // Joiner to host, repeated until the game starts
+    PACKET_START,     // Host to joiner: the seed
+    PACKET_INPUTS,    // Inputs, acknowledgement and a state hash
+    PACKET_BYE        // The player quit
+};
+
+const char VERSUS_MAGIC[4] = { 'S', 'N', 'K', 'V' };
+
+// Each packet repeats every input the other side hasn't acknowledged yet,
+// so a lost packet costs nothing once the next one arrives
+struct VersusPacket {
+    static const int MAX_INPUTS = RollbackSession::HISTORY;
+
+    char magic[4];      // VERSUS_MAGIC
+    uint8_t type;       // VersusPacketType
+    uint8_t count;      // Inputs carried
+    uint16_t unused;
+    uint32_t seed;      // PACKET_START
+    int32_t firstTick;  // Tick of inputs[0]
+    int32_t ack;        // The sender has every input of the receiver before this tick
+    int32_t hashTick;   // The sender's confirmed state before this tick hashes to hash
+    uint32_t unused2;
+    uint64_t hash;
+    uint8_t inputs[MAX_INPUTS]; // Direction per tick
+};
+
+static_assert(sizeof(VersusPacket) == 72, "Versus packets are sent as they are");
+
+// One UDP socket to the other player. The host binds a port and takes the
+// first peer that says hello; the joiner sends from any port. POSIX only;
+// host() and join() fail on Windows.
+class VersusLink {
+public:
+    static const int TIMEOUT_MS = 5000; // Silence before the link counts as lost
+
+private:
+    int fd;
+#ifndef _WIN32
+    sockaddr_in peer;
+#endif
+    bool connected;
+    uint64_t lastHeardNs;
+    long long packetsSent;
+    long long packetsReceived;
+
+    bool openSocket(int port, string& error);
+
+public:
+    VersusLink();
+    ~VersusLink();
+
+    // Waits up to waitMs for a joiner and sends it the seed
+    bool host(int port, uint32_t seed, int waitMs, string& error);
+    // Says hello to host:port until the start arrives (up to waitMs)
+    bool join(const string& address, int port, int waitMs, uint32_t& seed, string& error);
+
+    // Non-blocking; drops anything that isn't a versus packet from the peer
+    bool receive(VersusPacket& packet);
+    void send(const VersusPacket& packet);
+    // The packet with the current magic and type
+    static VersusPacket makePacket(VersusPacketType type);
+
+    int getFd() const { return fd; }
+    bool isLost() const;
+    long long getPacketsSent() const { return packetsSent; }
+    long long getPacketsReceived() const { return packetsReceived; }
+};
+
+// The terminal front end of a versus game: keyboard, drawing and the
+// rollback session. The caller's loop moves packets (see runVersus in main).
+class VersusGame {
+private:
+    static const int INPUT_BUFFER_SIZE = 64;
+    static const int MAX_QUEUED_TURNS = 2;
+
+    RollbackSession session;
+    KeyDecoder keys;
+    Direction queuedTurns[MAX_QUEUED_TURNS]; // One goes out per tick
+    int queuedTurnCount;
+    bool quit;
+    Screen screen;
+
+public:
+    VersusGame(uint32_t seed, int localPlayer);
+    ~VersusGame();
+
+    void handleInput();
+    // Plays the next tick if the remote player isn't too far behind; false if it had to wait
+    bool tick();
+    // status is a line about the link from the caller (waiting, lost, ...)
+    void draw(const string& status);
+
+    RollbackSession& getSession() { return session; }
+    const Versus& getState() const { return session.getState(); }
+    bool shouldQuit() const { return quit; }
+    Screen& getScreen() { return screen; }
+    void setRenderMode(RenderMode mode) { screen.setRenderMode(mode); }
+    RenderMode getRenderMode() const { return screen.getRenderMode(); }
+};
+
+#endif
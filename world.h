@@ -0,0 +1,196 @@
+#ifndef WORLD_H
+#define WORLD_H
+
+#include <cstdint>
+#include <vector>
+#include "game.h"
+
+using namespace std;
+
+// A cell of the endless world: 32 bits per axis, no edges in practice
+struct WorldPos {
+    int32_t x;
+    int32_t y;
+};
+
+// Endless mode: the snake roams a world with no walls.
+//
+// The world is cut into CHUNK_SIZE x CHUNK_SIZE chunks, made the first time
+// the snake comes near them. A chunk's rocks and food come from a random
+// generator seeded with the world seed and the chunk's coordinates, so a
+// chunk nobody has been near costs nothing, and one that was dropped comes
+// back the same (food included) when the snake returns.
+//
+// Chunks live in a pool of MAX_CHUNKS allocated up front, found through an
+// open-addressing table keyed by chunk coordinates. Whenever the head enters
+// a new chunk, the chunks within LOAD_RADIUS of it are made and those beyond
+// EVICT_RADIUS without any snake on them go back to the pool. A tick touches
+// the head's and the tail's cells only, and the chunk bookkeeping runs once
+// per chunk crossed over a fixed-size neighbourhood, so neither grows with the
+// distance travelled; nothing is allocated after construction.
+class World {
+public:
+    static constexpr int CHUNK_SHIFT = 5;
+    static constexpr int CHUNK_SIZE = 1 << CHUNK_SHIFT;
+    static constexpr int CHUNK_CELLS = CHUNK_SIZE * CHUNK_SIZE;
+    static constexpr int LOAD_RADIUS = 2;  // 5x5 chunks around the head's are always there
+    static constexpr int EVICT_RADIUS = 4; // Snake-free chunks further out are dropped
+    static constexpr int MAX_LENGTH = 2048; // Longer snakes stop growing
+    static constexpr int MAX_CHUNKS = 256;  // The memory budget
+    static constexpr int TABLE_SLOTS = 512; // Power of two, at most half full
+
+    // Chunk cell contents. SNAKE is a flag on top of the terrain underneath.
+    static constexpr uint8_t CELL_EMPTY = 0;
+    static constexpr uint8_t CELL_ROCK = 1;
+    static constexpr uint8_t CELL_FOOD = 2;
+    static constexpr uint8_t CELL_SPECIAL_FOOD = 3;
+    static constexpr uint8_t CELL_SNAKE = 0x80;
+
+    // Generation
+    static constexpr int ROCK_CLUSTERS = 5;     // Per chunk, 3 to 10 rocks each
+    static constexpr int FOOD_PER_CHUNK = 6;
+    static constexpr int SPECIAL_FOOD_ONE_IN = 4; // Chunks with one special food
+    static constexpr int SPECIAL_FOOD_SCORE = 50;
+    static constexpr int SPECIAL_FOOD_GROWTH = 3;
+    static constexpr int START_CLEARING = 6;    // Rock-free cells around the start
+
+private:
+    struct Chunk {
+        int32_t cx;
+        int32_t cy;
+        int snakeCells; // Segments on it; it stays while there are any
+        bool inUse;
+        uint8_t cells[CHUNK_CELLS];
+    };
+
+    // Chunk snakes can span (a staircase crosses a chunk every CHUNK_SIZE / 2
+    // cells) plus the whole eviction window must fit in the pool
+    static_assert(MAX_CHUNKS >= 2 * MAX_LENGTH / CHUNK_SIZE + 2 + (2 * EVICT_RADIUS + 1) * (2 * EVICT_RADIUS + 1),
+                  "Chunk pool too small for the longest snake");
+    static_assert(TABLE_SLOTS >= 2 * MAX_CHUNKS && (TABLE_SLOTS & (TABLE_SLOTS - 1)) == 0, "Bad table size");
+
+    vector<Chunk> pool;
+    vector<int> freeChunks;
+    vector<int> table; // Chunk index per slot, -1 if empty
+    int resident;
+    int peakResident;
+
+    // Snake: ring buffer of MAX_LENGTH positions, head at body[headIndex]
+    vector<WorldPos> body;
+    int headIndex;
+    int length;
+    int growth;
+    Direction dir;
+    Direction nextDir;
+    int32_t headChunkX;
+    int32_t headChunkY;
+
+    uint32_t seed;
+    int timeMs;
+    int score;
+    int foodEaten;
+    int specialFoodEaten;
+    int tickCount;
+    DeathCause deathCause;
+    bool gameOver;
+    long long chunksGenerated;
+    long long chunksEvicted;
+
+    static uint64_t chunkKey(int32_t cx, int32_t cy) {
+        return static_cast<uint64_t>(static_cast<uint32_t>(cx)) << 32 | static_cast<uint32_t>(cy);
+    }
+    static int homeSlot(int32_t cx, int32_t cy) {
+        return static_cast<int>((chunkKey(cx, cy) * 0x9e3779b97f4a7c15ULL) >> 32) & (TABLE_SLOTS - 1);
+    }
+    // Right shifts of negative coordinates round down (two's complement), so
+    // chunk -1 holds cells -CHUNK_SIZE to -1
+    static int32_t chunkCoord(int32_t cellCoord) { return cellCoord >> CHUNK_SHIFT; }
+    static int cellIndex(WorldPos pos) { return (pos.y & (CHUNK_SIZE - 1)) * CHUNK_SIZE + (pos.x & (CHUNK_SIZE - 1)); }
+    int findSlot(int32_t cx, int32_t cy) const; // Slot holding the chunk, or the empty slot it would go in
+    Chunk* findChunk(int32_t cx, int32_t cy) const;
+    Chunk& loadChunk(int32_t cx, int32_t cy);
+    void evictChunk(int index);
+    bool evictFarthest();
+    void generate(Chunk& chunk);
+    void updateNeighbourhood();
+    Chunk& chunkOf(WorldPos pos) { return loadChunk(chunkCoord(pos.x), chunkCoord(pos.y)); } // Loads it if needed
+    void endGame(DeathCause cause);
+
+public:
+    explicit World(uint32_t worldSeed);
+
+    void changeDirection(Direction newDir);
+    void update();
+
+    // What is on a cell, without loading anything: CELL_ROCK where no chunk is
+    // resident (the view never reaches there, it is inside LOAD_RADIUS)
+    uint8_t peek(WorldPos pos) const;
+    // Copies count cells of a row from start on, one chunk lookup per chunk crossed
+    void copyRow(WorldPos start, int count, uint8_t* out) const;
+    WorldPos getHead() const { return body[headIndex]; }
+    WorldPos getSegment(int index) const { return body[(headIndex + index) % MAX_LENGTH]; }
+    int getLength() const { return length; }
+    Direction getDirection() const { return dir; }
+    int getTime() const { return timeMs; }
+    int getScore() const { return score; }
+    int getFoodEaten() const { return foodEaten; }
+    int getSpecialFoodEaten() const { return specialFoodEaten; }
+    int getTickCount() const { return tickCount; }
+    bool isGameOver() const { return gameOver; }
+    DeathCause getDeathCause() const { return deathCause; }
+    int getGameSpeed() const;
+    uint32_t getSeed() const { return seed; }
+
+    int getResidentChunks() const { return resident; }
+    int getPeakResidentChunks() const { return peakResident; }
+    long long getChunksGenerated() const { return chunksGenerated; }
+    long long getChunksEvicted() const { return chunksEvicted; }
+    // Bytes in chunks in use, and everything the world allocated (fixed)
+    size_t getResidentBytes() const { return resident * sizeof(Chunk); }
+    size_t getReservedBytes() const;
+    // Telemetry row for the game so far; startTime and flags are left for the caller
+    SessionRecord getSessionRecord() const;
+};
+
+// The terminal front end for a World: keyboard, pause and drawing, like
+// BasicGame. The view follows the head but only scrolls, by half a screen,
+// when the head comes within VIEW_MARGIN cells of its edge, so most frames
+// change only a few lines.
+class EndlessGame {
+private:
+    static const int INPUT_BUFFER_SIZE = 64;
+    static const int MAX_QUEUED_TURNS = 2;
+    static const int VIEW_MARGIN = 4;
+
+    World world;
+    bool quit;
+    bool paused;
+    KeyDecoder keys;
+    Direction queuedTurns[MAX_QUEUED_TURNS];
+    int queuedTurnCount;
+    bool turnedThisTick;
+    WorldPos viewOrigin; // World position of the view's top left cell
+    Screen screen;
+
+    void followHead();
+
+public:
+    EndlessGame();
+    ~EndlessGame();
+    void draw();
+    void update();
+    void handleInput();
+    void turn(Direction dir);
+    void togglePause() { paused = !paused; }
+    bool isGameOver() const { return world.isGameOver(); }
+    bool shouldQuit() const { return quit || world.isGameOver(); }
+    bool isPaused() const { return paused; }
+    int getGameSpeed() const { return world.getGameSpeed(); }
+    long long getKeysDecoded() const { return keys.getKeysDecoded(); }
+    void setRenderMode(RenderMode mode) { screen.setRenderMode(mode); }
+    RenderMode getRenderMode() const { return screen.getRenderMode(); }
+    Screen& getScreen() { return screen; }
+    const World& getWorld() const { return world; }
+};
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef ZOBRIST_H
+#define ZOBRIST_H
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+#include "item_store.h"
+
+using namespace std;
+
+// Cells with a key: the board and the ring just outside it, where a head
+// that crashed into a wall ends up
+const int ZOBRIST_CELLS = (WIDTH + 2) * (HEIGHT + 2);
+
+inline int zobristCell(Cell cell) {
+    return (cell.y + 1) * (WIDTH + 2) + cell.x + 1;
+}
+
+// Random keys for Zobrist hashing of game state.
+//
+// A position hashes to the XOR of the keys of everything on the board: a body
+// key for every snake segment, a head key for the head, an item key per item
+// and a wall key per obstacle or maze wall. Adding or removing anything is
+// one XOR with its key, so the game keeps its hash up to date as it changes
+// (see Snake::getHash, ItemStore::getHash and Simulation::getPositionHash)
+// instead of walking the board. The keys are fixed, so hashes can be
+// compared between runs, processes and machines.
+struct ZobristKeys {
+    uint64_t body[ZOBRIST_CELLS];
+    uint64_t head[ZOBRIST_CELLS];
+    uint64_t item[ITEM_TYPE_COUNT][ZOBRIST_CELLS];
+    uint64_t obstacle[ZOBRIST_CELLS];
+    uint64_t mazeWall[ZOBRIST_CELLS];
+    uint64_t direction[5]; // By Direction
+    uint64_t shield;       // While the snake is shielded
+};
+
+extern const ZobristKeys ZOBRIST;
+
+// Scrambles a value into 64 well-mixed bits (splitmix64), for folding plain
+// numbers such as the score into a hash
+inline uint64_t zobristMix(uint64_t value) {
+    value += 0x9e3779b97f4a7c15ULL;
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+    return value ^ (value >> 31);
+}
+
+// Search statistics per position, shared by any number of threads without
+// locks.
+//
+// Each slot holds a position hash and its visit count and summed reward
+// packed into one 64-bit word, stored as key ^ data next to the data (the
+// "lockless hashing" trick): a slot torn by two threads writing at once no
+// longer matches its key and simply reads as empty. Updates from several
+// threads to one slot can occasionally lose one of them, which search
+// statistics shrug off. A position whose slot holds another one replaces it.
+class TranspositionTable {
+public:
+    static const int VALUE_BITS = 40;   // Reward sum in 1/4096ths, the rest is the visit count
+    static const int VALUE_SCALE = 4096;
+
+private:
+    struct Slot {
+        atomic<uint64_t> check; // key ^ data
+        atomic<uint64_t> data;
+    };
+
+    vector<Slot> slots;
+    uint64_t mask;
+
+public:
+    // slotCount is rounded up to a power of two
+    explicit TranspositionTable(int slotCount);
+
+    void clear();
+    // Adds one visit with the given reward (in [0, 1])
+    void add(uint64_t key, float reward);
+    // Visits and summed reward of a position; false if it isn't in the table
+    bool find(uint64_t key, int& visits, float& value) const;
+    size_t getSlotCount() const { return slots.size(); }
+};
+
+#endif